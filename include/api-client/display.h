@@ -11,4 +11,5 @@ struct ApiDisplayResult
 
 void addHeaders(HTTPClient &https, ApiDisplayInputs &apiDisplayInputs);
 
-ApiDisplayResult fetchApiDisplay(ApiDisplayInputs &apiDisplayInputs);
\ No newline at end of file
+/** Fetch /api/display and parse the response in place into result */
+void fetchApiDisplay(ApiDisplayInputs &apiDisplayInputs, ApiDisplayResult &result);
\ No newline at end of file
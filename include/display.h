@@ -3,6 +3,9 @@
 
 #include <Arduino.h>
 #include "DEV_Config.h"
+#include <overlay_widgets.h>
+#include <frame_delta.h>
+#include <capabilities.h>
 
 enum MSG
 {
@@ -95,6 +98,57 @@ void Paint_DrawMultilineText(UWORD x_start, UWORD y_start, const char *message,
 
 void display_show_image(uint8_t *image_buffer, int data_size, bool bWait);
 
+/**
+ * @brief Function to draw a display list sent by the server instead of an image
+ * @param list display list (see display_list.h)
+ * @param size length of the list in bytes
+ * @return true if it was shown; false if the image has to be downloaded instead
+ */
+bool display_show_list(const uint8_t *list, size_t size);
+
+/**
+ * @brief Function to redraw overlay widgets over the image that is on the display
+ * @param frame the image as it was shown (PNG or BMP)
+ * @param size length of the image in bytes
+ * @param plan widgets and what they show now; the texts of the redrawn widgets are updated
+ * @param texts what each widget should show
+ * @return true if the widgets were redrawn; false if the image has to be downloaded again instead
+ */
+bool display_show_overlays(const uint8_t *frame, int size, OverlayPlan &plan, const char texts[][OVERLAY_TEXT_SIZE]);
+
+/**
+ * @brief Function to read the checksum of the image on the display
+ * @param none
+ * @return frameCrc() of the full screen 1-bit image that was shown last; 0 if there is none
+ */
+uint32_t display_frame_crc(void);
+
+/**
+ * @brief Function to fill in what the decoders and the panel can do
+ * @param caps receives the formats, refresh features and bit planes
+ * @return none
+ */
+void display_capabilities(DeviceCapabilities &caps);
+
+/**
+ * @brief Function to decode a full screen 1-bit image into memory without touching the EPD
+ * @param image PNG or BMP
+ * @param size length of the image in bytes
+ * @param frame receives the top row of the 1-bit image
+ * @param pitch bytes from one row to the next, negative for a bottom-up bitmap
+ * @return true on success; false if it isn't a full screen 1-bit image
+ */
+bool display_decode_frame(const uint8_t *image, int size, uint8_t *frame, int pitch);
+
+/**
+ * @brief Function to apply a frame delta to the image in memory and refresh only its tiles
+ * @param frame top row of the 1-bit image on the display; patched in place
+ * @param pitch bytes from one row to the next, negative for a bottom-up bitmap
+ * @param delta parsed delta (see frame_delta.h)
+ * @return true if the tiles were shown; false if nothing changed on the display
+ */
+bool display_show_tiles(uint8_t *frame, int pitch, const FrameDelta &delta);
+
 /**
  * @brief Function to read an image from the file system
  * @param filename
@@ -103,6 +157,15 @@ void display_show_image(uint8_t *image_buffer, int data_size, bool bWait);
  */
 uint8_t * display_read_file(const char *filename, int *file_size);
 
+/**
+ * @brief Function to get an image from the file system without copying it if it can
+ * @param filename
+ * @param pointer to file size returned
+ * @param owned set to the buffer to free when the file had to be read into RAM, else nullptr
+ * @return pointer to the image (read-only when it is mapped from flash); nullptr if it can't be read
+ */
+uint8_t * display_map_file(const char *filename, int *file_size, uint8_t **owned);
+
 /**
  * @brief Function to show the image with message on the display
  * @param image_buffer pointer to the uint8_t image buffer
@@ -33,6 +33,22 @@ bool filesystem_read_from_file(const char *name, uint8_t *out_buffer, size_t siz
  */
 size_t filesystem_write_to_file(const char *name, uint8_t *in_buffer, size_t size);
 
+/**
+ * @brief Function to get the free space of SPIFFS
+ * @param none
+ * @return size_t bytes that can still be written
+ */
+size_t filesystem_free_bytes(void);
+
+/**
+ * @brief Function to write a file that may be lost (e.g. a partial download) to SPIFFS
+ * @param name filename
+ * @param in_buffer pointer to input buffer
+ * @param size size of the input buffer
+ * @return size of written bytes; 0 if it doesn't fit, then only this file is removed (SPIFFS is never formatted)
+ */
+size_t filesystem_write_spare_file(const char *name, const uint8_t *in_buffer, size_t size);
+
 /**
  * @brief Function to check if file exists
  * @param name filename
@@ -55,4 +71,19 @@ bool filesystem_file_delete(const char *name);
  */
 bool filesystem_file_rename(const char *old_name, const char *new_name);
 
+/**
+ * @brief Function to find a file in the image store
+ * @param name filename
+ * @param size size of the file returned
+ * @return pointer to the file in memory mapped flash (read-only); nullptr if it isn't in the store
+ */
+const uint8_t *filesystem_map_file(const char *name, size_t *size);
+
+/**
+ * @brief Function to check if a file is kept in the image store (not in SPIFFS)
+ * @param name filename
+ * @return result - true if it is in the store; false - if it isn't or there is no store
+ */
+bool filesystem_in_image_store(const char *name);
+
 void list_files();
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <frame_history.h>
+
+/**
+ * @brief Function to move the last image into the frame history before the current image replaces it
+ * @param none
+ * @return none
+ */
+void history_keep_last(void);
+
+/**
+ * @brief Function to show the next older frame kept on flash (a local SF_REWIND)
+ * @param none
+ * @return bool true if a frame was shown; false if there is none left and the server has to handle the rewind
+ */
+bool history_show_older(void);
+
+/**
+ * @brief Function to put the current image back on screen after a local rewind
+ * @param none
+ * @return bool true if it was shown; false if the screen wasn't rewound
+ */
+bool history_show_current(void);
+
+/**
+ * @brief Function to count the frames kept on flash for a local rewind
+ * @param none
+ * @return uint8_t frames before the current image that can be shown, the last image included
+ */
+uint8_t history_frames(void);
+
+/**
+ * @brief Function to forget the rewind position (something else is on screen now)
+ * @param none
+ * @return none
+ */
+void history_reset(void);
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <HTTPClient.h>
+#include <resumable_download.h>
+
+/**
+ * RangeTransport for a single request on an HTTPClient that the caller has
+ * already set up (begin(), timeouts, extra headers).
+ */
+class HttpRangeRequest : public RangeTransport
+{
+public:
+  /**
+   * @param https client after begin()
+   * @param redirectBase prepended to the Location of a 307/308 redirect (empty: don't follow)
+   */
+  HttpRangeRequest(HTTPClient &https, const String &redirectBase = "");
+
+  bool get(uint32_t from, const char *ifRange, RangeHandler &handler) override;
+
+  /** HTTP status of the last response, negative for HTTPClient errors */
+  int status() const { return httpCode; }
+  String contentType() { return https.header("Content-Type"); }
+
+private:
+  int send(uint32_t from, const char *ifRange);
+
+  HTTPClient &https;
+  String redirectBase;
+  int httpCode;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+#include <resumable_download.h>
+
+#define IMAGE_PARTIAL_FILE "/partial.img"
+
+/** Progress of an interrupted image download, kept in RTC memory over deep sleep */
+extern DownloadCheckpoint imageCheckpoint;
+
+/**
+ * Downloaded image in RAM. An interrupted download can be parked on SPIFFS
+ * with savePartial() and is loaded back (and checked) when it is resumed.
+ */
+class ImageBufferSink : public ResumableSink
+{
+public:
+  explicit ImageBufferSink(const DownloadCheckpoint &checkpoint);
+  ~ImageBufferSink();
+
+  bool resumeAt(uint32_t offset, uint32_t total) override;
+  bool write(const uint8_t *data, size_t length) override;
+
+  /** Store the committed part of an interrupted download for the next wake; false if there was no room */
+  bool savePartial();
+
+  /** Hand the buffer (malloc'ed) to the caller */
+  uint8_t *release();
+
+  bool tooBig() const { return wasTooBig; }
+  bool outOfMemory() const { return wasOutOfMemory; }
+
+private:
+  bool reserve(size_t size);
+
+  const DownloadCheckpoint &checkpoint;
+  uint8_t *data;
+  size_t capacity;
+  size_t length;
+  bool wasTooBig;
+  bool wasOutOfMemory;
+};
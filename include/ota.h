@@ -0,0 +1,28 @@
+#pragma once
+
+#include <HTTPClient.h>
+#include <ota_decoder.h>
+#include <resumable_download.h>
+
+/**
+ * @brief Function to stream an encoded (compressed and/or delta) firmware download into Update
+ * @param https client with the successful GET response
+ * @param encoding encoding advertised by /api/display
+ * @return bool true if the whole image was decoded and written; Update.begin() must have been called
+ */
+bool ota_write_encoded(HTTPClient &https, OtaEncoding encoding);
+
+/**
+ * @brief Function to download a plain firmware image into the inactive slot, continuing an interrupted download
+ * @param https client after begin() for the firmware URL; the request is sent here
+ * @param url firmware URL, identifies the download between wakes
+ * @return DownloadOutcome Complete once the image was verified and set as boot partition
+ */
+DownloadOutcome ota_download(HTTPClient &https, const char *url);
+
+/**
+ * @brief Function to drop the progress of an interrupted download (before something else writes the inactive slot)
+ * @param none
+ * @return none
+ */
+void ota_forget_partial(void);
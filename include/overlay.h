@@ -0,0 +1,48 @@
+#pragma once
+
+#include <overlay_widgets.h>
+
+/**
+ * @brief Function to start redrawing the widgets of the current image locally until the next online wake
+ * @param spec overlay field of the /api/display response (see overlay_widgets.h)
+ * @param newImage a new image was shown on this wake; the widgets on screen are gone
+ * @param rssi WiFi signal strength shown by the rssi widget
+ * @param refreshRate seconds until the device has to go online again
+ * @return bool true if the widgets will be drawn; false if the spec is empty, invalid or can't be used
+ */
+bool overlay_start(const char *spec, bool newImage, int rssi, uint32_t refreshRate);
+
+/**
+ * @brief Function to redraw the widgets whose text changed
+ * @param vBatt battery voltage for the battery widget
+ * @return bool true if the widgets are up to date; false if they can't be drawn (the plan is stopped)
+ */
+bool overlay_update(float vBatt);
+
+/**
+ * @brief Function to check whether this timer wake only has to update the widgets
+ * @param none
+ * @return bool true if the device doesn't have to go online yet
+ */
+bool overlay_due(void);
+
+/**
+ * @brief Function to show the offline widget after the server could not be reached
+ * @param vBatt battery voltage for the battery widget
+ * @return none
+ */
+void overlay_offline(float vBatt);
+
+/**
+ * @brief Function to get the time until the next widget update
+ * @param none
+ * @return uint32_t seconds to sleep, 0 if the next wake has to go online
+ */
+uint32_t overlay_sleep_time(void);
+
+/**
+ * @brief Function to stop drawing widgets (the screen no longer shows the image they belong to)
+ * @param none
+ * @return none
+ */
+void overlay_stop(void);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <HTTPClient.h>
+#include <frame_bundle.h>
+
+/**
+ * @brief Function to download a frame bundle into the SPIFFS frame store and start playing it
+ * @param https client with the successful GET response for bundle_url
+ * @param validFor seconds after which the device goes back online even if frames are left (0 = no limit)
+ * @return bool true if all frames were stored
+ */
+bool playlist_download(HTTPClient &https, uint32_t validFor);
+
+/**
+ * @brief Function to get the room for the frames of a bundle
+ * @param none
+ * @return uint32_t bytes a new bundle can take on SPIFFS, with enough left for the next image (0 = none fits)
+ */
+uint32_t playlist_budget(void);
+
+/**
+ * @brief Function to load the next prefetched frame, if the playlist has one left
+ * @param frame receives size, display duration and name of the frame
+ * @return uint8_t* malloc'ed image (PNG/JPEG/BMP), nullptr when it is time to go online
+ */
+uint8_t *playlist_next_frame(BundleFrame &frame);
+
+/**
+ * @brief Function to stop playing the stored bundle (the server sent a new plan)
+ * @param none
+ * @return none
+ */
+void playlist_stop(void);
@@ -19,6 +19,10 @@ public:
 
   size_t writeUint(const char *key, const uint32_t value) override;
 
+  int32_t readInt(const char *key, const int32_t defaultValue) override;
+
+  size_t writeInt(const char *key, const int32_t value) override;
+
   size_t writeString(const char *key, const char *value) override;
 
   uint8_t readUChar(const char *key, const uint8_t defaultValue) override;
@@ -33,6 +37,14 @@ public:
 
   bool remove(const char *key) override;
 
+  /** Number of NVS reads (including existence checks) since boot */
+  uint32_t readCount() const;
+
+  /** Number of NVS writes (including removals) since boot */
+  uint32_t writeCount() const;
+
 private:
   Preferences& _preferences;
+  uint32_t _reads = 0;
+  uint32_t _writes = 0;
 };
\ No newline at end of file
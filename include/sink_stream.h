@@ -0,0 +1,29 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ota_stream.h>
+
+/**
+ * Stream that hands everything written to it to an OtaSink, so that
+ * HTTPClient::writeToStream can feed a decoder or downloader directly
+ * (it also takes care of chunked transfer encoding). A failed write
+ * reports 0 bytes, which makes writeToStream stop the transfer.
+ */
+class SinkStream : public Stream
+{
+public:
+  explicit SinkStream(OtaSink &sink) : sink(sink) {}
+
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size) override
+  {
+    return sink.write(buffer, size) ? size : 0;
+  }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+  void flush() override {}
+
+private:
+  OtaSink &sink;
+};
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <HTTPClient.h>
+#include <frame_delta.h>
+
+/**
+ * @brief Function to download a frame delta and show its tiles over the image on the display
+ * @param https client with the successful GET response for delta_url
+ * @param size receives the size of the returned image
+ * @return uint8_t* malloc'ed BMP of the patched frame, to be stored as the current image; nullptr if the full image has to be downloaded
+ */
+uint8_t *tile_delta_download(HTTPClient &https, int *size);
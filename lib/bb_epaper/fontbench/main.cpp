@@ -0,0 +1,107 @@
+//
+// Text rendering benchmark for bb_epaper
+// Renders the text of every message screen of the TRMNL firmware into an
+// 800x480 back buffer (no display attached) and reports the time per screen.
+//
+// Example usage:
+// make bench
+//
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// The I/O layer is not needed to draw into the back buffer
+#include "../host/bb_ep_host.h"
+
+#include "../src/bb_ep.inl"
+#include "../src/bb_ep_gfx.inl"
+#include "../Fonts/nicoclean_8.h"
+#include "../Fonts/Inter_18.h"
+#include "../Fonts/Roboto_Black_24.h"
+
+#define MAX_LINES 6
+typedef struct {
+    const char *name;
+    const char *lines[MAX_LINES];
+} SCREEN;
+
+// text of display_show_msg() / display_show_msg2()
+static const SCREEN screens[] = {
+    {"WIFI_CONNECT", {"Connect to TRMNL WiFi", "on your phone or computer"}},
+    {"WIFI_FAILED", {"TRMNL firmware 1.6.0", "Can't establish WiFi connection.", "Hold button on the back to reset WiFi, or scan QR Code for help."}},
+    {"WIFI_INTERNAL_ERROR", {"WiFi connected, but", "API connection cannot be", "established. Try to refresh,", "or scan QR Code for help."}},
+    {"WIFI_WEAK", {"WiFi connected but signal is weak"}},
+    {"API_REQUEST_FAILED", {"WiFi connected, request to API failed.", "Short click the button on back,", "otherwise check your internet."}},
+    {"API_UNABLE_TO_CONNECT", {"WiFi connected, unable connect to API.", "Short click the button on back,", "otherwise check your internet."}},
+    {"API_SETUP_FAILED", {"WiFi connected, /api/setup returned error.", "Short click the button on back,", "otherwise check your internet."}},
+    {"API_SIZE_ERROR", {"WiFi connected, TRMNL content malformed.", "Wait or reset by holding button on back."}},
+    {"API_FIRMWARE_UPDATE_ERROR", {"WiFi connected, could not get firmware update from api.", "Wait or reset by holding button on back."}},
+    {"API_IMAGE_DOWNLOAD_ERROR", {"WiFi connected, API could not deliver image to device.", "Wait or reset by holding button on back."}},
+    {"FW_UPDATE", {"Firmware update available! Starting now..."}},
+    {"FW_UPDATE_FAILED", {"Firmware update failed. Device will restart..."}},
+    {"FW_UPDATE_SUCCESS", {"Firmware update success. Device will restart..."}},
+    {"QA_START", {"Starting QA test"}},
+    {"MSG_TOO_BIG", {"The image file from this URL is too large.", "https://usetrmnl.com/images/plugin-2025-01-01T00-00-00Z.png", "PNG images can be a maximum of", "90000 bytes each and 1 or 2-bpp"}},
+    {"MSG_FORMAT_ERROR", {"The image format is incorrect"}},
+    {"FRIENDLY_ID", {"Please sign up at usetrmnl.com/signup", "with Friendly ID ABC123 to finish setup"}},
+    {"WIFI_CONNECT2", {"TRMNL firmware 1.6.0", "Connect your phone or computer to TRMNL WiFi network", "or scan the QR code for help"}},
+};
+
+static BBEPDISP bbep;
+
+// same as BBEPAPER::print(): measure, then one character at a time through write()
+static void drawLine(const void *pFont, const char *szMsg, int y)
+{
+    BB_RECT rect;
+    char szTemp[2];
+    bbep.pFont = (void *)pFont;
+    bbep.iCursorX = 0; bbep.iCursorY = 0;
+    bbepGetStringBox(&bbep, szMsg, &rect);
+    bbep.iCursorX = (bbep.width - rect.w) / 2;
+    bbep.iCursorY = y;
+    for (int i = 0; szMsg[i]; i++) {
+        szTemp[0] = szMsg[i]; szTemp[1] = 0;
+        bbepWriteStringCustom(&bbep, (void *)pFont, -1, -1, szTemp, BBEP_BLACK, 0);
+    }
+}
+
+// FNV-1a over every rendered screen, to check that an optimization didn't change the output
+static uint32_t u32Checksum = 2166136261u;
+
+static double renderAll(const void *pFont, int iRepeat)
+{
+    clock_t start = clock();
+    for (int r = 0; r < iRepeat; r++) {
+        for (size_t s = 0; s < sizeof(screens) / sizeof(screens[0]); s++) {
+            memset(bbep.ucScreen, 0xff, bbep.width * bbep.height / 8);
+            for (int l = 0; l < MAX_LINES && screens[s].lines[l]; l++) {
+                drawLine(pFont, screens[s].lines[l], 100 + l * 40);
+            }
+            if (r == 0) {
+                for (int i = 0; i < bbep.width * bbep.height / 8; i++) {
+                    u32Checksum = (u32Checksum ^ bbep.ucScreen[i]) * 16777619;
+                }
+            }
+        }
+    }
+    return (double)(clock() - start) * 1000000.0 / CLOCKS_PER_SEC / (iRepeat * (sizeof(screens) / sizeof(screens[0])));
+}
+
+int main(int argc, char *argv[])
+{
+    static uint8_t u8Buffer[800 * 480 / 8];
+    int iRepeat = (argc > 1) ? atoi(argv[1]) : 200;
+
+    bbepSetPanelType(&bbep, EP75_800x480);
+    bbep.ucScreen = u8Buffer;
+    bbep.iBG = BBEP_WHITE;
+    bbep.iFG = BBEP_BLACK;
+
+    printf("%d message screens, %d passes\n", (int)(sizeof(screens) / sizeof(screens[0])), iRepeat);
+    printf("nicoclean_8:     %8.1f us/screen\n", renderAll(nicoclean_8, iRepeat));
+    printf("Inter_18:        %8.1f us/screen\n", renderAll(Inter_18, iRepeat));
+    printf("Roboto_Black_24: %8.1f us/screen\n", renderAll(Roboto_Black_24, iRepeat));
+    printf("checksum:        %08x\n", u32Checksum);
+    return 0;
+}
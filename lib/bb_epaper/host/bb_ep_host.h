@@ -0,0 +1,41 @@
+//
+// bb_epaper on a PC, for the tests and the benchmarks
+// The C core is compiled without its I/O layer: this supplies the Arduino
+// calls it makes and a panel that ignores everything sent to it.
+// Include it before bb_ep.inl. To see what goes to the panel, define
+// BB_EP_HOST_PANEL and write bbepWriteCmd(), bbepWriteData() and bbepCMD2().
+//
+#ifndef __BB_EP_HOST__
+#define __BB_EP_HOST__
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "../src/bb_epaper.h"
+
+#define __BB_EP_IO__
+#define pgm_read_byte(a) (*(uint8_t *)a)
+#define pgm_read_word(a) (*(uint16_t *)a)
+#define pgm_read_dword(a) (*(uint32_t *)a)
+#define memcpy_P memcpy
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define LOW 0
+#define HIGH 1
+int digitalRead(int iPin) { return LOW; }
+void digitalWrite(int iPin, int iState) {}
+void pinMode(int iPin, int iMode) {}
+void delay(int iMS) {}
+static void delayMicroseconds(int iUS) {}
+long millis(void) { return (long)(clock() / (CLOCKS_PER_SEC / 1000)); }
+void bbepWakeUp(BBEPDISP *pBBEP);
+#ifndef BB_EP_HOST_PANEL
+void bbepWriteCmd(BBEPDISP *pBBEP, uint8_t cmd) {}
+void bbepWriteData(BBEPDISP *pBBEP, uint8_t *pData, int iLen) {}
+void bbepCMD2(BBEPDISP *pBBEP, uint8_t cmd1, uint8_t cmd2) {}
+#endif
+void bbepSetCS2(BBEPDISP *pBBEP, uint8_t cs) {}
+void bbepInitIO(BBEPDISP *pBBEP, uint8_t u8DC, uint8_t u8RST, uint8_t u8BUSY, uint8_t u8CS, uint8_t u8MOSI, uint8_t u8SCK, uint32_t u32Speed) {}
+
+#endif // __BB_EP_HOST__
@@ -5,9 +5,20 @@
 //
 
 #include <stdio.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <strings.h>
+#include <zlib.h>
 #define MAX_IMAGE_FLIPS 256
 #include "../src/Group5.h"
 #include "../src/g5enc.inl"
+#include "../src/g5dec.inl"
+#include "../../trmnl/src/frame_rle_enc.inl"
+#include "../../trmnl/include/g5_planes.h"
 //
 // Read a Windows BMP file into memory
 //
@@ -52,11 +63,7 @@ uint8_t * ReadBMP(const char *fname, int *width, int *height, int *bpp, unsigned
         }
     }
     offset = *(int32_t *)&pTemp[10]; // offset to bits
-    if (bits == 1) {
-        bytewidth = (w+7) >> 3;
-    } else {
-        bytewidth = (w * bits) >> 3;
-    }
+    bytewidth = (w * bits + 7) >> 3; // the last byte of a 2 or 4-bpp row can be partial
     pitch = (bytewidth + 3) & 0xfffc; // DWORD aligned
 // move up the pixels
     d = pBitmap;
@@ -89,6 +96,124 @@ uint8_t * ReadBMP(const char *fname, int *width, int *height, int *bpp, unsigned
     return pBitmap;
     
 } /* ReadBMP() */
+//
+// Read a grayscale or palette PNG of 1 to 8 bits per pixel into memory
+// The rows and the palette come out in the same layout as from ReadBMP()
+//
+uint8_t * ReadPNG(const char *fname, int *width, int *height, int *bpp, unsigned char *pPal)
+{
+    int i, y, w = 0, h = 0, bits = 0, color = -1, interlace = 0, pitch, off;
+    int iSize, iIDAT = 0;
+    uint32_t len;
+    uint8_t *pFile, *pIDAT = NULL, *pRaw, *pBitmap, *s, *d, *prev, *chunk;
+    uLongf rawSize;
+    FILE *infile;
+
+    infile = fopen(fname, "r+b");
+    if (infile == NULL) {
+        printf("Error opening input file %s\n", fname);
+        return NULL;
+    }
+    fseek(infile, 0, SEEK_END);
+    iSize = (int)ftell(infile);
+    fseek(infile, 0, SEEK_SET);
+    pFile = (uint8_t *)malloc(iSize);
+    fread(pFile, 1, iSize, infile);
+    fclose(infile);
+    if (iSize < 8 || memcmp(pFile, "\x89PNG\r\n\x1a\n", 8) != 0) {
+        free(pFile);
+        printf("Not a PNG file!\n");
+        return NULL;
+    }
+    // collect the header, the palette and the compressed data
+    for (off = 8; off + 12 <= iSize; off += 12 + len) {
+        chunk = &pFile[off];
+        len = (chunk[0] << 24) | (chunk[1] << 16) | (chunk[2] << 8) | chunk[3];
+        if (len > (uint32_t)(iSize - off - 12)) break;
+        if (memcmp(&chunk[4], "IHDR", 4) == 0 && len >= 13) {
+            w = (chunk[8] << 24) | (chunk[9] << 16) | (chunk[10] << 8) | chunk[11];
+            h = (chunk[12] << 24) | (chunk[13] << 16) | (chunk[14] << 8) | chunk[15];
+            bits = chunk[16];
+            color = chunk[17];
+            interlace = chunk[20];
+        } else if (memcmp(&chunk[4], "PLTE", 4) == 0 && len <= 768) {
+            memcpy(pPal, &chunk[8], len); // RGB triplets, like ReadBMP()
+        } else if (memcmp(&chunk[4], "IDAT", 4) == 0) {
+            pIDAT = (uint8_t *)realloc(pIDAT, iIDAT + len);
+            memcpy(&pIDAT[iIDAT], &chunk[8], len);
+            iIDAT += len;
+        } else if (memcmp(&chunk[4], "IEND", 4) == 0) {
+            break;
+        }
+    }
+    free(pFile);
+    if ((color != 0 && color != 3) || (bits != 1 && bits != 2 && bits != 4 && bits != 8) || interlace || w < 1 || h < 1 || !pIDAT) {
+        free(pIDAT);
+        printf("Only non-interlaced grayscale or palette PNGs of up to 8-bpp are supported\n");
+        return NULL;
+    }
+    if (color == 0) { // make a gray ramp palette
+        for (i=0; i<(1<<bits); i++) {
+            pPal[i*3] = pPal[i*3+1] = pPal[i*3+2] = (uint8_t)(i * 255 / ((1<<bits) - 1));
+        }
+    }
+    pitch = (w * bits + 7) >> 3;
+    rawSize = (uLongf)(pitch + 1) * h; // each row starts with its filter type
+    pRaw = (uint8_t *)malloc(rawSize);
+    pBitmap = (uint8_t *)malloc(pitch * h);
+    if (uncompress(pRaw, &rawSize, pIDAT, iIDAT) != Z_OK || rawSize != (uLongf)(pitch + 1) * h) {
+        free(pIDAT);
+        free(pRaw);
+        free(pBitmap);
+        printf("Error decompressing the PNG data\n");
+        return NULL;
+    }
+    free(pIDAT);
+    // undo the filters; with one channel of up to 8 bits a "pixel" is 1 byte
+    for (y=0; y<h; y++) {
+        s = &pRaw[y * (pitch + 1)];
+        d = &pBitmap[y * pitch];
+        prev = y ? d - pitch : NULL;
+        for (i=0; i<pitch; i++) {
+            int a = i ? d[i-1] : 0, b = prev ? prev[i] : 0, c = (i && prev) ? prev[i-1] : 0;
+            int p, pa, pb, pc;
+            switch (s[0]) {
+                case 1: // sub
+                    d[i] = s[i+1] + a;
+                    break;
+                case 2: // up
+                    d[i] = s[i+1] + b;
+                    break;
+                case 3: // average
+                    d[i] = s[i+1] + ((a + b) >> 1);
+                    break;
+                case 4: // paeth
+                    p = a + b - c;
+                    pa = abs(p - a);
+                    pb = abs(p - b);
+                    pc = abs(p - c);
+                    d[i] = s[i+1] + ((pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c);
+                    break;
+                default: // none
+                    d[i] = s[i+1];
+                    break;
+            }
+        } // for i
+    } // for y
+    free(pRaw);
+    *width = w;
+    *height = h;
+    *bpp = bits;
+    return pBitmap;
+} /* ReadPNG() */
+//
+// See if a file name ends with the given extension (not case sensitive)
+//
+int HasExtension(const char *fname, const char *ext)
+{
+    int i = (int)strlen(fname) - (int)strlen(ext);
+    return (i > 0 && strcasecmp(&fname[i], ext) == 0);
+} /* HasExtension() */
 
 //
 // Create the comments and const array boilerplate for the hex data bytes
@@ -108,17 +233,17 @@ void StartHexFile(FILE *f, int iLen, int w, int h, const char *fname)
 //
 // Add N bytes of hex data to the output
 // The data will be arranged in rows of 16 bytes each
+// pCount holds the number of bytes written to the file so far
 //
-void AddHexBytes(FILE *f, void *pData, int iLen, int bLast)
+void AddHexBytes(FILE *f, void *pData, int iLen, int bLast, int *pCount)
 {
-    static int iCount = 0; // number of bytes processed so far
     int i;
     uint8_t *s = (uint8_t *)pData;
     for (i=0; i<iLen; i++) { // process the given data
         fprintf(f, "0x%02x", *s++);
-        iCount++;
+        (*pCount)++;
         if (i < iLen-1 || !bLast) fprintf(f, ",");
-        if ((iCount & 15) == 0) fprintf(f, "\n"); // next row of 16
+        if ((*pCount & 15) == 0) fprintf(f, "\n"); // next row of 16
     }
     if (bLast) {
         fprintf(f, "};\n");
@@ -133,10 +258,8 @@ void ConvertTo1Bpp(uint8_t *pBMP, int w, int h, int iBpp, uint8_t *palette)
     int g, x, y, iDelta, iPitch, iDestPitch;
     uint8_t *s, *d, *pPal, u8, count;
     
-    iPitch = (w * iBpp)/8;
-    iPitch = (iPitch + 3) & 0xfffc;
-    iDestPitch = (w+7)/8;
-    iDestPitch = (iDestPitch + 3) & 0xfffc; // round to nearest "DWORD"
+    iPitch = (w * iBpp + 7) >> 3; // ReadBMP() and ReadPNG() pack the rows
+    iDestPitch = (w+7)/8; // and so does the encoder
     iDelta = iBpp/8;
     for (y=0; y<h; y++) {
         s = &pBMP[iPitch * y];
@@ -159,17 +282,22 @@ void ConvertTo1Bpp(uint8_t *pBMP, int w, int h, int iBpp, uint8_t *palette)
                     s += 2;
                     break;
                 case 8:
-                    pPal = &palette[s[0] * 4];
+                    pPal = &palette[s[0] * 3];
                     g = (pPal[0] + pPal[1]*2 + pPal[2])/4;
                     s++;
                     break;
+                case 2:
+                    pPal = &palette[((s[0] >> (6 - 2*(x & 3))) & 3) * 3];
+                    g = (pPal[0] + pPal[1]*2 + pPal[2])/4;
+                    if ((x & 3) == 3) s++;
+                    break;
                 case 4:
                     if (x & 1) {
-                        pPal = &palette[(s[0] & 0xf) * 4];
+                        pPal = &palette[(s[0] & 0xf) * 3];
                         g = (pPal[0] + pPal[1]*2 + pPal[2])/4;
                         s++;
                     } else {
-                        pPal = &palette[(s[0]>>4) * 4];
+                        pPal = &palette[(s[0]>>4) * 3];
                         g = (pPal[0] + pPal[1]*2 + pPal[2])/4;
                     }
                     break;
@@ -182,8 +310,613 @@ void ConvertTo1Bpp(uint8_t *pBMP, int w, int h, int iBpp, uint8_t *palette)
                 count = 8;
             }
         } // for x
+        if (count != 8) *d = u8 << count; // the last pixels of the row
     } // for y
 } /* ConvertTo1Bpp() */
+//
+// Split an image of any bit depth into the two planes of a 4-gray TRLE image
+// Plane 0 gets bit 0 of each gray level (0 = black, 3 = white), plane 1 bit 1
+//
+void ConvertTo2Planes(uint8_t *pBMP, int w, int h, int iBpp, uint8_t *palette, uint8_t *pPlanes)
+{
+    int g, x, y, iPitch, iDestPitch;
+    uint8_t *s, *d0, *d1, *pPal, mask;
+
+    iPitch = (w * iBpp + 7) >> 3; // ReadBMP() packs the rows
+    iDestPitch = (w+7)/8;
+    memset(pPlanes, 0, iDestPitch * h * 2);
+    for (y=0; y<h; y++) {
+        s = &pBMP[iPitch * y];
+        d0 = &pPlanes[iDestPitch * y];
+        d1 = d0 + iDestPitch * h;
+        for (x=0; x<w; x++) {
+            switch (iBpp) {
+                case 24:
+                case 32:
+                    g = (s[x*iBpp/8] + s[x*iBpp/8+1]*2 + s[x*iBpp/8+2])/4;
+                    break;
+                case 16:
+                    g = s[2*x+1] & 0xf8; // red
+                    g += ((s[2*x] | s[2*x+1] << 8) << 2) & 0x1f0; // green x 2
+                    g += (s[2*x] << 3) & 0xf8; // blue
+                    g /= 4;
+                    break;
+                default: // 2, 4 or 8-bpp palette index
+                    pPal = &palette[((s[(x * iBpp) >> 3] >> (8 - iBpp - ((x * iBpp) & 7))) & ((1 << iBpp) - 1)) * 3];
+                    g = (pPal[0] + pPal[1]*2 + pPal[2])/4;
+                    break;
+            } // switch on bpp
+            g >>= 6; // 4 gray levels
+            mask = 0x80 >> (x & 7);
+            if (g & 1) d0[x >> 3] |= mask;
+            if (g & 2) d1[x >> 3] |= mask;
+        } // for x
+    } // for y
+} /* ConvertTo2Planes() */
+//
+// Bring a 1-bpp image to 1 = white, the way the G5, PNG and TRLE outputs take it
+//
+void Normalize1Bpp(uint8_t *pBMP, int w, int h, uint8_t *palette)
+{
+    int i, iSize = ((w+7)/8) * h;
+    // the BMP palette says which bit is white
+    if (palette[0] + palette[1]*2 + palette[2] > palette[3] + palette[4]*2 + palette[5]) {
+        for (i=0; i<iSize; i++) {
+            pBMP[i] = ~pBMP[i];
+        }
+    }
+} /* Normalize1Bpp() */
+//
+// G5 compress a 1-bpp image into a BB_BITMAP file in memory
+// Returns NULL if it doesn't get smaller than the raw bits
+//
+uint8_t * EncodeG5(uint8_t *pPlane, int w, int h, int *pSize)
+{
+    G5ENCIMAGE g5enc;
+    BB_BITMAP bbbm;
+    uint8_t *pOut, *s = pPlane;
+    int y, rc, iPitch = (w+7)/8;
+
+    pOut = (uint8_t *)malloc(sizeof(BB_BITMAP) + iPitch * h);
+    rc = g5_encode_init(&g5enc, w, h, &pOut[sizeof(BB_BITMAP)], iPitch * h);
+    for (y=0; y<h && rc == G5_SUCCESS; y++) {
+        rc = g5_encode_encodeLine(&g5enc, s);
+        s += iPitch;
+    }
+    if (rc != G5_ENCODE_COMPLETE) {
+        free(pOut);
+        return NULL;
+    }
+    bbbm.u16Marker = BB_BITMAP_MARKER;
+    bbbm.width = w;
+    bbbm.height = h;
+    bbbm.size = g5_encode_getOutSize(&g5enc);
+    memcpy(pOut, &bbbm, sizeof(BB_BITMAP));
+    *pSize = sizeof(BB_BITMAP) + bbbm.size;
+    return pOut;
+} /* EncodeG5() */
+//
+// Compress the two gray planes from ConvertTo2Planes() into a G5 planes
+// file in memory (see lib/trmnl/include/g5_planes.h). The planes get the
+// inverted gray bits the 4-gray mode of the panel takes, so the device sends
+// them to PLANE_0 and PLANE_1 without converting them
+// Returns NULL if a plane doesn't get smaller than its raw bits
+//
+uint8_t * EncodeG5Planes(uint8_t *pPlanes, int w, int h, int *pSize)
+{
+    G5PlanesHeader hdr;
+    uint8_t *pInverted, *pOut, *pG5;
+    int i, iG5Size, iOutSize = sizeof(hdr);
+    int iPitch = (w+7)/8;
+
+    memset(&hdr, 0, sizeof(hdr));
+    pInverted = (uint8_t *)malloc(iPitch * h * 2);
+    pOut = (uint8_t *)malloc(sizeof(hdr) + iPitch * h * 2 + 2 * sizeof(BB_BITMAP));
+    for (i=0; i<iPitch * h * 2; i++) {
+        pInverted[i] = ~pPlanes[i];
+    }
+    for (i=0; i<2; i++) {
+        pG5 = EncodeG5(&pInverted[i * iPitch * h], w, h, &iG5Size);
+        if (!pG5) {
+            free(pInverted);
+            free(pOut);
+            return NULL;
+        }
+        hdr.size[i] = iG5Size - sizeof(BB_BITMAP); // the bare G5 data
+        memcpy(&pOut[iOutSize], &pG5[sizeof(BB_BITMAP)], hdr.size[i]);
+        iOutSize += hdr.size[i];
+        free(pG5);
+    }
+    hdr.u16Marker = G5_PLANES_MARKER;
+    hdr.width = w;
+    hdr.height = h;
+    hdr.mode = G5_PLANES_GRAY4;
+    memcpy(pOut, &hdr, sizeof(hdr));
+    free(pInverted);
+    *pSize = iOutSize;
+    return pOut;
+} /* EncodeG5Planes() */
+//
+// Compress 1 or 2 planes of 1 = white bits into a TRLE file in memory
+// (see lib/trmnl/include/frame_rle.h)
+//
+uint8_t * EncodeRLE(uint8_t *pPlanes, int w, int h, int iPlanes, uint8_t ucPalette, int *pSize)
+{
+    FrameRleHeader hdr;
+    uint8_t *pOut;
+    int i, iPitch = (w+7)/8, iOutSize = sizeof(hdr);
+
+    pOut = (uint8_t *)malloc(sizeof(hdr) + iPlanes * h * FRAME_RLE_ROW_BOUND(iPitch));
+    frameRleHeaderInit(&hdr, w, h, iPlanes, ucPalette);
+    memcpy(pOut, &hdr, sizeof(hdr));
+    for (i=0; i<iPlanes; i++) {
+        iOutSize += frameRleEncodePlane(&pPlanes[i * iPitch * h], iPitch, h, &pOut[iOutSize]);
+    }
+    *pSize = iOutSize;
+    return pOut;
+} /* EncodeRLE() */
+//
+// Add a chunk to a PNG file in memory
+//
+static uint8_t * AddPNGChunk(uint8_t *d, const char *szType, const uint8_t *pData, uint32_t u32Len)
+{
+    uint32_t u32CRC;
+    d[0] = (uint8_t)(u32Len >> 24); d[1] = (uint8_t)(u32Len >> 16);
+    d[2] = (uint8_t)(u32Len >> 8); d[3] = (uint8_t)u32Len;
+    memcpy(&d[4], szType, 4);
+    if (u32Len) memcpy(&d[8], pData, u32Len);
+    u32CRC = (uint32_t)crc32(0, &d[4], u32Len + 4);
+    d += 8 + u32Len;
+    d[0] = (uint8_t)(u32CRC >> 24); d[1] = (uint8_t)(u32CRC >> 16);
+    d[2] = (uint8_t)(u32CRC >> 8); d[3] = (uint8_t)u32CRC;
+    return d + 4;
+} /* AddPNGChunk() */
+//
+// Compress 1 or 2 planes of 1 = white bits into a 1 or 2-bit grayscale PNG
+// file in memory. Rows are not filtered, it doesn't pay off at these depths
+//
+uint8_t * EncodePNG(uint8_t *pPlanes, int w, int h, int iPlanes, int *pSize)
+{
+    uint8_t ihdr[13], *pRaw, *pZ, *pOut, *d, *s0, *s1;
+    int x, y, iPitch = (w+7)/8, iRowSize = (w * iPlanes + 7) / 8;
+    uLongf zSize;
+
+    pRaw = (uint8_t *)malloc((iRowSize + 1) * h);
+    for (y=0; y<h; y++) {
+        d = &pRaw[y * (iRowSize + 1)];
+        s0 = &pPlanes[y * iPitch];
+        *d++ = 0; // filter type none
+        if (iPlanes == 1) {
+            memcpy(d, s0, iPitch);
+            if (w & 7) d[iPitch-1] &= (uint8_t)(0xff << (8 - (w & 7)));
+        } else { // 2-bit gray levels, 4 pixels per byte
+            s1 = s0 + iPitch * h;
+            memset(d, 0, iRowSize);
+            for (x=0; x<w; x++) {
+                uint8_t mask = 0x80 >> (x & 7);
+                int g = ((s1[x >> 3] & mask) ? 2 : 0) | ((s0[x >> 3] & mask) ? 1 : 0);
+                d[x >> 2] |= g << (6 - 2 * (x & 3));
+            }
+        }
+    }
+    zSize = compressBound((uLong)(iRowSize + 1) * h);
+    pZ = (uint8_t *)malloc(zSize);
+    compress2(pZ, &zSize, pRaw, (uLong)(iRowSize + 1) * h, Z_BEST_COMPRESSION);
+    free(pRaw);
+    ihdr[0] = (uint8_t)(w >> 24); ihdr[1] = (uint8_t)(w >> 16); ihdr[2] = (uint8_t)(w >> 8); ihdr[3] = (uint8_t)w;
+    ihdr[4] = (uint8_t)(h >> 24); ihdr[5] = (uint8_t)(h >> 16); ihdr[6] = (uint8_t)(h >> 8); ihdr[7] = (uint8_t)h;
+    ihdr[8] = (uint8_t)iPlanes; // bit depth
+    ihdr[9] = 0; // grayscale
+    ihdr[10] = ihdr[11] = ihdr[12] = 0; // deflate, adaptive filtering, not interlaced
+    pOut = (uint8_t *)malloc(8 + 25 + 12 + zSize + 12);
+    memcpy(pOut, "\x89PNG\r\n\x1a\n", 8);
+    d = AddPNGChunk(&pOut[8], "IHDR", ihdr, sizeof(ihdr));
+    d = AddPNGChunk(d, "IDAT", pZ, (uint32_t)zSize);
+    d = AddPNGChunk(d, "IEND", NULL, 0);
+    free(pZ);
+    *pSize = (int)(d - pOut);
+    return pOut;
+} /* EncodePNG() */
+//
+// Write an encoded image as a binary file or, if bHFile, as a .H file of hex
+// data with the array named after szName
+//
+int WriteOutput(const char *fname, int bHFile, const char *szName, uint8_t *pData, int iSize, int w, int h)
+{
+    FILE *f = fopen(fname, "w+b");
+    int iCount = 0;
+    if (!f) {
+        printf("Error opening: %s\n", fname);
+        return 0;
+    }
+    if (bHFile) { // generate HEX file to include in a project
+        StartHexFile(f, iSize, w, h, szName);
+        AddHexBytes(f, pData, iSize, 1, &iCount);
+    } else {
+        fwrite(pData, 1, iSize, f);
+    }
+    fflush(f);
+    fclose(f);
+    return 1;
+} /* WriteOutput() */
+//
+// Write the image as TRLE run-length planes (see lib/trmnl/include/frame_rle.h)
+// 1-bpp images keep their bits, the others become 4 grays
+//
+int WriteRLE(const char *fname, uint8_t *pBMP, int w, int h, int bpp, uint8_t *palette)
+{
+    uint8_t *pPlanes, *pOut;
+    int rc, iPitch = (w+7)/8, iPlanes, iOutSize;
+
+    if (bpp == 1) {
+        iPlanes = 1;
+        pPlanes = pBMP;
+        Normalize1Bpp(pBMP, w, h, palette);
+    } else {
+        printf("Converting from %d-bpp to 4 grays\n", bpp);
+        iPlanes = 2;
+        pPlanes = (uint8_t *)malloc(iPitch * h * 2);
+        ConvertTo2Planes(pBMP, w, h, bpp, palette, pPlanes);
+    }
+    pOut = EncodeRLE(pPlanes, w, h, iPlanes, FRAME_RLE_PALETTE, &iOutSize);
+    printf("Input data size:  %d bytes, compressed size: %d bytes\n", iPitch*h*iPlanes, iOutSize - (int)sizeof(FrameRleHeader));
+    printf("Compression ratio: %2.1f:1\n", (float)(iPitch*h*iPlanes) / (float)(iOutSize - sizeof(FrameRleHeader)));
+    rc = WriteOutput(fname, 0, fname, pOut, iOutSize, w, h);
+    if (rc) printf("TRLE file created successfully!\n");
+    if (pPlanes != pBMP) free(pPlanes);
+    free(pOut);
+    return rc;
+} /* WriteRLE() */
+//
+// Write a 4-gray image as two G5 planes (see lib/trmnl/include/g5_planes.h)
+//
+int WriteG5Planes(const char *fname, int bHFile, uint8_t *pBMP, int w, int h, int bpp, uint8_t *palette)
+{
+    uint8_t *pPlanes, *pOut;
+    int rc, iOutSize, iPitch = (w+7)/8;
+    G5PlanesHeader *pHdr;
+
+    pPlanes = (uint8_t *)malloc(iPitch * h * 2);
+    ConvertTo2Planes(pBMP, w, h, bpp, palette, pPlanes);
+    pOut = EncodeG5Planes(pPlanes, w, h, &iOutSize);
+    free(pPlanes);
+    if (!pOut) {
+        printf("Error encoding the planes: %d\n", G5_DATA_OVERFLOW);
+        return 0;
+    }
+    pHdr = (G5PlanesHeader *)pOut;
+    printf("Input data size:  %d bytes, compressed size: %d + %d bytes\n", iPitch*h*2, pHdr->size[0], pHdr->size[1]);
+    printf("Compression ratio: %2.1f:1\n", (float)(iPitch*h*2) / (float)(pHdr->size[0] + pHdr->size[1]));
+    rc = WriteOutput(fname, bHFile, fname, pOut, iOutSize, w, h);
+    if (rc) printf(bHFile ? ".H file created successfully!\n" : "4-gray G5 file created successfully!\n");
+    free(pOut);
+    return rc;
+} /* WriteG5Planes() */
+//
+// Batch mode: many images are converted by a pool of threads, each one
+// to the smallest of the formats the device can show it from
+//
+enum {
+    FMT_G5 = 0, // 1-bit
+    FMT_PNG1,
+    FMT_RLE1,
+    FMT_G5_PLANES, // 4 grays
+    FMT_PNG2,
+    FMT_RLE2,
+    FMT_COUNT
+};
+static const char *szFormats[FMT_COUNT] = {"g5", "png1", "rle1", "g5gray", "png2", "rle2"};
+static const char *szExtensions[FMT_COUNT] = {".g5", ".png", ".rle", ".g5p", ".png", ".rle"};
+
+typedef struct batch_queue_tag
+{
+    pthread_mutex_t mutex;
+    const char **pFiles;
+    int iCount;
+    int iNext; // next file to take
+    const char *szOutDir;
+    int iErrors;
+    long long llIn, llOut; // bytes of the raw planes and of the outputs
+    int iChosen[FMT_COUNT];
+} BATCHQUEUE;
+
+static double TimeMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+} /* TimeMs() */
+//
+// Name the outputs and the C array of a batch input after its file name:
+// the extension is dropped and anything but letters and digits becomes '_'
+//
+static void BatchName(const char *szFile, char *szName, int iSize)
+{
+    const char *leaf = strrchr(szFile, '/');
+    int i;
+
+    leaf = leaf ? leaf + 1 : szFile;
+    snprintf(szName, iSize, "%s", leaf);
+    if (strrchr(szName, '.')) *strrchr(szName, '.') = 0; // drop the extension
+    for (i=0; szName[i]; i++) {
+        if (!isalnum((uint8_t)szName[i])) szName[i] = '_';
+    }
+} /* BatchName() */
+//
+// Inputs with the same output name (a.bmp and a.png, x/a.bmp and y/a.bmp)
+// would overwrite each other's files; returns how many of them there are
+//
+static int CheckBatchNames(const char **pFiles, int iCount)
+{
+    char (*pNames)[256] = (char (*)[256])malloc(iCount * sizeof(*pNames));
+    int i, j, iClashes = 0;
+
+    for (i=0; i<iCount; i++) {
+        BatchName(pFiles[i], pNames[i], sizeof(pNames[i]));
+        for (j=0; j<i; j++) { // case too, some file systems ignore it
+            if (strcasecmp(pNames[i], pNames[j]) == 0) {
+                printf("%s and %s would both be written as %s\n", pFiles[j], pFiles[i], pNames[i]);
+                iClashes++;
+                break;
+            }
+        }
+    }
+    free(pNames);
+    return iClashes;
+} /* CheckBatchNames() */
+//
+// Convert one image of the batch, returns 0 on failure
+//
+static int ConvertBest(BATCHQUEUE *pQueue, const char *szFile)
+{
+    uint8_t palette[1024], *pBMP, *pPlanes, *pOut[FMT_COUNT];
+    int i, w, h, bpp, iPitch, iPlanes, iBest = -1, iSize[FMT_COUNT];
+    double dTime[FMT_COUNT], dStart;
+    char szName[256], szPath[1024], szLine[512];
+    int rc, iLen = 0;
+
+    pBMP = HasExtension(szFile, ".png") ? ReadPNG(szFile, &w, &h, &bpp, palette) : ReadBMP(szFile, &w, &h, &bpp, palette);
+    if (!pBMP) return 0;
+    iPitch = (w+7)/8;
+    if (bpp == 1) {
+        Normalize1Bpp(pBMP, w, h, palette);
+        pPlanes = pBMP;
+        iPlanes = 1;
+    } else {
+        pPlanes = (uint8_t *)malloc(iPitch * h * 2);
+        ConvertTo2Planes(pBMP, w, h, bpp, palette, pPlanes);
+        // only black and white: both bits of every gray level are the same
+        iPlanes = memcmp(pPlanes, &pPlanes[iPitch * h], iPitch * h) ? 2 : 1;
+    }
+    memset(pOut, 0, sizeof(pOut));
+    for (i=0; i<FMT_COUNT; i++) {
+        if ((iPlanes == 1) != (i < FMT_G5_PLANES)) continue; // lossless choices only
+        dStart = TimeMs();
+        switch (i) {
+            case FMT_G5:
+                pOut[i] = EncodeG5(pPlanes, w, h, &iSize[i]);
+                break;
+            case FMT_G5_PLANES:
+                pOut[i] = EncodeG5Planes(pPlanes, w, h, &iSize[i]);
+                break;
+            case FMT_PNG1:
+            case FMT_PNG2:
+                pOut[i] = EncodePNG(pPlanes, w, h, iPlanes, &iSize[i]);
+                break;
+            default:
+                pOut[i] = EncodeRLE(pPlanes, w, h, iPlanes, FRAME_RLE_PALETTE, &iSize[i]);
+                break;
+        }
+        dTime[i] = TimeMs() - dStart;
+        if (pOut[i] && (iBest < 0 || iSize[i] < iSize[iBest])) iBest = i;
+    }
+    if (iBest < 0) { // the G5 outputs can fail, but the others never do
+        if (pPlanes != pBMP) free(pPlanes);
+        free(pBMP);
+        return 0;
+    }
+    BatchName(szFile, szName, sizeof(szName));
+    snprintf(szPath, sizeof(szPath), "%s/%s%s", pQueue->szOutDir, szName, szExtensions[iBest]);
+    rc = WriteOutput(szPath, 0, szName, pOut[iBest], iSize[iBest], w, h);
+    snprintf(szPath, sizeof(szPath), "%s/%s.h", pQueue->szOutDir, szName);
+    strcat(szName, ".h"); // StartHexFile() takes the array name from the file name
+    rc = rc && WriteOutput(szPath, 1, szName, pOut[iBest], iSize[iBest], w, h);
+    iLen = snprintf(szLine, sizeof(szLine), "%s: %dx%d", szFile, w, h);
+    for (i=0; i<FMT_COUNT; i++) {
+        if (pOut[i]) iLen += snprintf(&szLine[iLen], sizeof(szLine) - iLen, ", %s %d bytes %.2f ms", szFormats[i], iSize[i], dTime[i]);
+    }
+    printf("%s -> %s\n", szLine, szFormats[iBest]);
+
+    pthread_mutex_lock(&pQueue->mutex);
+    pQueue->llIn += iPitch * h * iPlanes;
+    pQueue->llOut += iSize[iBest];
+    pQueue->iChosen[iBest]++;
+    pthread_mutex_unlock(&pQueue->mutex);
+    for (i=0; i<FMT_COUNT; i++) {
+        free(pOut[i]);
+    }
+    if (pPlanes != pBMP) free(pPlanes);
+    free(pBMP);
+    return rc;
+} /* ConvertBest() */
+
+static void * BatchThread(void *pArg)
+{
+    BATCHQUEUE *pQueue = (BATCHQUEUE *)pArg;
+    int i, rc;
+    for (;;) {
+        pthread_mutex_lock(&pQueue->mutex);
+        i = pQueue->iNext++;
+        pthread_mutex_unlock(&pQueue->mutex);
+        if (i >= pQueue->iCount) break;
+        rc = ConvertBest(pQueue, pQueue->pFiles[i]);
+        if (!rc) {
+            pthread_mutex_lock(&pQueue->mutex);
+            pQueue->iErrors++;
+            pthread_mutex_unlock(&pQueue->mutex);
+            printf("%s: not converted\n", pQueue->pFiles[i]);
+        }
+    }
+    return NULL;
+} /* BatchThread() */
+//
+// Add a file, or the BMP and PNG files of a directory, to the batch
+//
+static void AddBatchInput(const char *szPath, const char ***ppFiles, int *piCount)
+{
+    DIR *pDir = opendir(szPath);
+    struct dirent *pEntry;
+    char *szFile;
+
+    if (!pDir) {
+        *ppFiles = (const char **)realloc(*ppFiles, (*piCount + 1) * sizeof(char *));
+        (*ppFiles)[(*piCount)++] = strdup(szPath);
+        return;
+    }
+    while ((pEntry = readdir(pDir)) != NULL) {
+        if (!HasExtension(pEntry->d_name, ".bmp") && !HasExtension(pEntry->d_name, ".png")) continue;
+        szFile = (char *)malloc(strlen(szPath) + strlen(pEntry->d_name) + 2);
+        sprintf(szFile, "%s/%s", szPath, pEntry->d_name);
+        *ppFiles = (const char **)realloc(*ppFiles, (*piCount + 1) * sizeof(char *));
+        (*ppFiles)[(*piCount)++] = szFile;
+    }
+    closedir(pDir);
+} /* AddBatchInput() */
+//
+// ./imgconvert -t <images or directories>...
+// Check that every image comes back from the G5 decoder exactly as it went
+// into the encoder, and measure how fast the encoder runs
+//
+int TestG5(int argc, const char *argv[])
+{
+    const char **pFiles = NULL;
+    uint8_t palette[1024], *pBMP, *pPlanes, *pPlane, *pOut, *pRow;
+    int i, y, w, h, bpp, iPitch, iSize, iReps, iCount = 0, iFailed = 0;
+    long long llBytes = 0;
+    double dTime, dTotal = 0.0;
+    G5DECIMAGE g5dec;
+
+    for (i=2; i<argc; i++) {
+        AddBatchInput(argv[i], &pFiles, &iCount);
+    }
+    for (i=0; i<iCount; i++) {
+        pBMP = HasExtension(pFiles[i], ".png") ? ReadPNG(pFiles[i], &w, &h, &bpp, palette) : ReadBMP(pFiles[i], &w, &h, &bpp, palette);
+        if (!pBMP) {
+            iFailed++;
+            continue;
+        }
+        iPitch = (w+7)/8;
+        pPlanes = NULL;
+        if (bpp == 1) {
+            Normalize1Bpp(pBMP, w, h, palette);
+            pPlane = pBMP;
+        } else { // bit 1 of the gray level: white from 128 on
+            pPlanes = (uint8_t *)malloc(iPitch * h * 2);
+            ConvertTo2Planes(pBMP, w, h, bpp, palette, pPlanes);
+            pPlane = &pPlanes[iPitch * h];
+        }
+        // encode it for at least 100ms to time it
+        iReps = 0;
+        dTime = TimeMs();
+        for (;;) {
+            pOut = EncodeG5(pPlane, w, h, &iSize);
+            iReps++;
+            if (!pOut || TimeMs() - dTime >= 100.0) break;
+            free(pOut);
+        }
+        dTime = TimeMs() - dTime;
+        if (!pOut) {
+            printf("%s: %dx%d can't be G5 encoded\n", pFiles[i], w, h);
+            iFailed++;
+        } else {
+            int bOK = (g5_decode_init(&g5dec, w, h, &pOut[sizeof(BB_BITMAP)], iSize - sizeof(BB_BITMAP)) == G5_SUCCESS);
+            uint8_t ucEndMask = (w & 7) ? (uint8_t)(0xff << (8 - (w & 7))) : 0xff;
+            pRow = (uint8_t *)malloc(iPitch);
+            for (y=0; y<h && bOK; y++) {
+                int rc = g5_decode_line(&g5dec, pRow);
+                bOK = (rc == G5_SUCCESS || rc == G5_DECODE_COMPLETE) &&
+                      memcmp(pRow, &pPlane[y * iPitch], iPitch - 1) == 0 &&
+                      ((pRow[iPitch-1] ^ pPlane[y * iPitch + iPitch - 1]) & ucEndMask) == 0;
+            }
+            printf("%s: %dx%d, %d bytes, encoded in %.3f ms (%.1f MB/s), round trip %s\n", pFiles[i], w, h, iSize,
+                   dTime / iReps, (double)iPitch * h * iReps / dTime / 1000.0, bOK ? "OK" : "FAILED");
+            if (!bOK) iFailed++;
+            llBytes += (long long)iPitch * h * iReps;
+            dTotal += dTime;
+            free(pRow);
+            free(pOut);
+        }
+        free(pPlanes);
+        free(pBMP);
+    }
+    if (dTotal > 0.0) {
+        printf("%d images, %d failed, encoder throughput %.1f MB/s of 1-bpp pixels\n", iCount, iFailed, llBytes / dTotal / 1000.0);
+    }
+    for (i=0; i<iCount; i++) {
+        free((void *)pFiles[i]);
+    }
+    free(pFiles);
+    return iFailed ? -1 : 0;
+} /* TestG5() */
+//
+// ./imgconvert -b <output dir> [-j <threads>] <images or directories>...
+//
+int BatchConvert(int argc, const char *argv[])
+{
+    BATCHQUEUE queue;
+    pthread_t *pThreads;
+    int i, iThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    double dStart;
+
+    memset(&queue, 0, sizeof(queue));
+    pthread_mutex_init(&queue.mutex, NULL);
+    queue.szOutDir = argv[2];
+    for (i=3; i<argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i+1 < argc) {
+            iThreads = atoi(argv[++i]);
+        } else {
+            AddBatchInput(argv[i], &queue.pFiles, &queue.iCount);
+        }
+    }
+    if (iThreads < 1) iThreads = 1;
+    if (iThreads > queue.iCount) iThreads = queue.iCount;
+    if (queue.iCount == 0) {
+        printf("No BMP or PNG images to convert\n");
+        return -1;
+    }
+    if (CheckBatchNames(queue.pFiles, queue.iCount)) {
+        printf("Nothing converted: rename those images or convert them in separate batches\n");
+        for (i=0; i<queue.iCount; i++) {
+            free((void *)queue.pFiles[i]);
+        }
+        free(queue.pFiles);
+        pthread_mutex_destroy(&queue.mutex);
+        return -1;
+    }
+    mkdir(queue.szOutDir, 0755);
+    dStart = TimeMs();
+    pThreads = (pthread_t *)malloc(iThreads * sizeof(pthread_t));
+    for (i=0; i<iThreads; i++) {
+        pthread_create(&pThreads[i], NULL, BatchThread, &queue);
+    }
+    for (i=0; i<iThreads; i++) {
+        pthread_join(pThreads[i], NULL);
+    }
+    dStart = TimeMs() - dStart;
+    printf("%d images in %.0f ms on %d threads (%.1f images/s), %d failed\n", queue.iCount - queue.iErrors, dStart, iThreads,
+           (queue.iCount - queue.iErrors) * 1000.0 / dStart, queue.iErrors);
+    printf("Raw planes: %lld bytes, outputs: %lld bytes\n", queue.llIn, queue.llOut);
+    for (i=0; i<FMT_COUNT; i++) {
+        if (queue.iChosen[i]) printf("  %s: %d\n", szFormats[i], queue.iChosen[i]);
+    }
+    for (i=0; i<queue.iCount; i++) {
+        free((void *)queue.pFiles[i]);
+    }
+    free(queue.pFiles);
+    free(pThreads);
+    pthread_mutex_destroy(&queue.mutex);
+    return queue.iErrors ? -1 : 0;
+} /* BatchConvert() */
 
 int main(int argc, const char * argv[]) {
     uint8_t *s, *pBMP, *pOut;
@@ -193,16 +926,53 @@ int main(int argc, const char * argv[]) {
     BB_BITMAP bbbm;
     uint8_t palette[1024];
     int bHFile; // flag indicating if the output will be a .H file of hex data
+    int bRLE; // flag indicating if the output will be a TRLE run-length image
+    int bPlanes; // flag indicating if the output will be 4-gray G5 planes
 
     printf("Group5 image conversion tool\n");
+    if (argc >= 4 && strcmp(argv[1], "-b") == 0) {
+        return BatchConvert(argc, argv);
+    }
+    if (argc >= 3 && strcmp(argv[1], "-t") == 0) {
+        return TestG5(argc, argv);
+    }
     if (argc != 3) {
-        printf("Usage: ./imgconvert <WinBMP image> <g5 compressed image>\n");
+        printf("Usage: ./imgconvert <WinBMP or PNG image> <g5 compressed image>\n");
+        printf("       ./imgconvert <WinBMP or PNG image> <TRLE image>.rle\n");
+        printf("       ./imgconvert <WinBMP or PNG image> <4-gray G5 image>.g5p\n");
+        printf("       ./imgconvert -b <output dir> [-j <threads>] <images or directories>...\n");
+        printf("       ./imgconvert -t <images or directories>...\n");
+        printf("A .h at the end of the output name writes it as a C array\n");
+        printf("-b converts each image to the smallest of G5, PNG, TRLE and 4-gray G5 that keeps\n");
+        printf("its pixels, and writes it both as a binary and as a .h file\n");
+        printf("-t round-trips each image through the G5 encoder and decoder and times the encoder\n");
         return -1;
     }
     pOut = (uint8_t *)argv[2] + strlen(argv[2]) - 1;
     bHFile = (pOut[0] == 'H' || pOut[0] == 'h'); // output an H file?
+    bRLE = HasExtension(argv[2], ".rle");
+    bPlanes = HasExtension(argv[2], ".g5p") || HasExtension(argv[2], ".g5p.h");
     
-    pBMP = ReadBMP(argv[1], &w, &h, &bpp, palette);
+    if (HasExtension(argv[1], ".png")) {
+        pBMP = ReadPNG(argv[1], &w, &h, &bpp, palette);
+    } else {
+        pBMP = ReadBMP(argv[1], &w, &h, &bpp, palette);
+    }
+    if (pBMP == NULL) {
+        return -1;
+    }
+    if (bRLE) { // 1-bit or 4-gray run-length planes instead of G5
+        printf("Bitmap size: %d x %d\n", w, h);
+        rc = WriteRLE(argv[2], pBMP, w, h, bpp, palette);
+        free(pBMP);
+        return rc ? 0 : -1;
+    }
+    if (bPlanes) { // 4 grays, one G5 stream per EPD plane
+        printf("Bitmap size: %d x %d x 4 grays\n", w, h);
+        rc = WriteG5Planes(argv[2], bHFile, pBMP, w, h, bpp, palette);
+        free(pBMP);
+        return rc ? 0 : -1;
+    }
     if (bpp != 1) { // need to convert it to 1-bpp
         printf("Converting from %d-bpp to 1-bpp\n", bpp);
         ConvertTo1Bpp(pBMP, w, h, bpp, palette);
@@ -230,9 +1000,10 @@ int main(int argc, const char * argv[]) {
             printf("Error opening: %s\n", argv[2]);
         } else {
             if (bHFile) { // generate HEX file to include in a project
+                int iCount = 0;
                 StartHexFile(f, iOutSize+sizeof(BB_BITMAP), w, h, argv[2]);
-                AddHexBytes(f, &bbbm, sizeof(BB_BITMAP), 0);
-                AddHexBytes(f, pOut, iOutSize, 1);
+                AddHexBytes(f, &bbbm, sizeof(BB_BITMAP), 0, &iCount);
+                AddHexBytes(f, pOut, iOutSize, 1, &iCount);
                 printf(".H file created successfully!\n");
             } else { // generate a binary file
                 fwrite(&bbbm, 1, sizeof(BB_BITMAP), f);
@@ -30,6 +30,28 @@ int bbepSetPixel3Clr(void *pb, int x, int y, unsigned char ucColor);
 int bbepSetPixel2Clr(void *pb, int x, int y, unsigned char ucColor);
 int bbepSetPixel16Clr(void *pb, int x, int y, unsigned char ucColor);
 
+//
+// Display list command, recorded in place of a drawing call and replayed
+// once per band by bbepRenderDisplayList(). Commands start on 4-byte
+// boundaries; G5 images and text carry their pointers/characters after it.
+//
+enum {
+    BBEP_LIST_FILL = 1,
+    BBEP_LIST_PIXEL,
+    BBEP_LIST_LINE,
+    BBEP_LIST_RECT,
+    BBEP_LIST_ELLIPSE,
+    BBEP_LIST_G5,
+    BBEP_LIST_TEXT
+};
+typedef struct bbep_list_cmd {
+    uint8_t u8Op, u8Flags, u8Param, u8Len; // filled flag, plane/quadrants, text length
+    int16_t top, bottom; // display rows the command can touch (bottom is exclusive)
+    int16_t x1, y1, x2, y2; // coordinates, radii or (text) where the cursor ends up
+    int16_t iColor, iBG;
+} BBEP_LIST_CMD;
+static BBEP_LIST_CMD *bbepListAdd(BBEPDISP *pBBEP, int iOp, int iDataLen, int top, int bottom);
+
 // Color mapping tables for each type of display
 // the 7 basic colors (and 9 unsupported) are translated into the correct colors
 // for each display type
@@ -2278,12 +2300,47 @@ void bbepWakeUp(BBEPDISP *pBBEP)
     bbepWaitBusy(pBBEP);
 } /* bbepWakeUp() */
 //
+// Set the UC81xx partial window (byte aligned in x)
+// ucScan = 1 refreshes the whole screen, 0 only the window
+//
+static void bbepPartialWindow(BBEPDISP *pBBEP, int x, int y, int cx, int cy, uint8_t ucScan)
+{
+    uint8_t uc[12];
+    int i = 0, tx, ty;
+
+    tx = x & 0xfff8; // round down to next lower byte
+    ty = y;
+    cx = (cx + 7) & 0xfff8; // make width an even number of bytes
+    bbepWriteCmd(pBBEP, UC8151_PTIN); // partial in
+    bbepWriteCmd(pBBEP, UC8151_PTL); // partial window
+    if (pBBEP->native_width >= 256) { // need 2 bytes per x
+        uc[i++] = (uint8_t)(tx>>8); // start x
+        uc[i++] = (uint8_t)tx;
+        uc[i++] = (uint8_t)((tx+cx-1)>>8); // end x
+        uc[i++] = (uint8_t)((tx+cx-1) | 7);
+    } else {
+        uc[i++] = tx; // start x
+        uc[i++] = (tx+cx-1) | 7; // end x
+    }
+    if (pBBEP->native_height >= 250) {
+        uc[i++] = (uint8_t)(ty>>8); // start y
+        uc[i++] = (uint8_t)ty;
+        uc[i++] = (uint8_t)((ty+cy-1)>>8); // end y
+        uc[i++] = (uint8_t)(ty+cy-1);
+    } else {
+        uc[i++] = (uint8_t)ty;
+        uc[i++] = (uint8_t)(ty+cy-1);
+    }
+    uc[i++] = ucScan;
+    bbepWriteData(pBBEP, uc, i);
+} /* bbepPartialWindow() */
+//
 // Set the memory window for future writes into panel memory
 //
 void bbepSetAddrWindow(BBEPDISP *pBBEP, int x, int y, int cx, int cy)
 {
     uint8_t uc[12];
-    int i, tx, ty;
+    int tx, ty;
     
     if (!pBBEP) return;
     if (pBBEP->iFlags & (BBEP_4COLOR | BBEP_7COLOR)) return;
@@ -2304,30 +2361,7 @@ void bbepSetAddrWindow(BBEPDISP *pBBEP, int x, int y, int cx, int cy)
     ty = y;
     cx = (cx + 7) & 0xfff8; // make width an even number of bytes
     if (pBBEP->chip_type == BBEP_CHIP_UC81xx) {
-        bbepWriteCmd(pBBEP, UC8151_PTIN); // partial in
-        bbepWriteCmd(pBBEP, UC8151_PTL); // partial window
-        i = 0;
-        tx *= 8;
-        if (pBBEP->native_width >= 256) { // need 2 bytes per x
-            uc[i++] = (uint8_t)(tx>>8); // start x
-            uc[i++] = (uint8_t)tx;
-            uc[i++] = (uint8_t)((tx+cx-1)>>8); // end x
-            uc[i++] = (uint8_t)((tx+cx-1) | 7);
-        } else {
-            uc[i++] = tx; // start x
-            uc[i++] = (tx+cx-1) | 7; // end x
-        }
-        if (pBBEP->native_height >= 250) {
-            uc[i++] = (uint8_t)(ty>>8); // start y
-            uc[i++] = (uint8_t)ty;
-            uc[i++] = (uint8_t)((ty+cy-1)>>8); // end y
-            uc[i++] = (uint8_t)(ty+cy-1);
-        } else {
-            uc[i++] = (uint8_t)ty;
-            uc[i++] = (uint8_t)(ty+cy-1);
-        }
-        uc[i++] = 1; // refresh whole screen (0=refresh partial window only)
-        bbepWriteData(pBBEP, uc, i);
+        bbepPartialWindow(pBBEP, x, y, cx, cy, 1); // refresh whole screen
         //       EPDWriteCmd(UC8151_PTOU); // partial out
     } else { // SSD16xx
         //        bbepCMD2(pBBEP, SSD1608_DATA_MODE, 0x3);
@@ -2487,6 +2521,15 @@ void bbepFill(BBEPDISP *pBBEP, unsigned char ucColor, int iPlane)
     uint8_t ucCMD1, ucCMD2;
     
     if (pBBEP == NULL) return;
+    if (pBBEP->pDisplayList) { // record it for banded rendering
+        BBEP_LIST_CMD *pCmd = bbepListAdd(pBBEP, BBEP_LIST_FILL, 0, 0, pBBEP->native_height);
+        if (pCmd) {
+            pCmd->iColor = ucColor;
+            pCmd->u8Param = (uint8_t)iPlane;
+        }
+        pBBEP->iCursorX = pBBEP->iCursorY = 0;
+        return;
+    }
     ucColor = pBBEP->pColorLookup[ucColor & 0xf]; // translate the color for this display type
     pBBEP->iCursorX = pBBEP->iCursorY = 0;
     iPitch = ((pBBEP->native_width+7)/8);
@@ -2520,6 +2563,10 @@ void bbepFill(BBEPDISP *pBBEP, unsigned char ucColor, int iPlane)
         }
     }
     if (pBBEP->ucScreen) { // there's a local framebuffer, use it
+        if (pBBEP->iBandH) { // only the rows of the current band (1-bpp plane 0)
+            memset(pBBEP->ucScreen, uc1, iPitch * pBBEP->iBandH);
+            return;
+        }
         if (pBBEP->iFlags & BBEP_7COLOR) {
             memset(pBBEP->ucScreen, uc1, iSize);
             return;
@@ -2648,6 +2695,24 @@ int bbepRefresh(BBEPDISP *pBBEP, int iMode)
     }
     return BBEP_SUCCESS;
 } /* bbepRefresh() */
+//
+// Partial refresh of one rectangle (byte aligned in x)
+// UC81xx panels only drive the window; the others change just the pixels
+// that differ from the previous image, so they do a normal partial refresh
+//
+int bbepRefreshRect(BBEPDISP *pBBEP, int x, int y, int cx, int cy)
+{
+    if (pBBEP->chip_type != BBEP_CHIP_UC81xx || (pBBEP->iFlags & (BBEP_4GRAY | BBEP_3COLOR | BBEP_4COLOR | BBEP_7COLOR))) {
+        return bbepRefresh(pBBEP, REFRESH_PARTIAL);
+    }
+    if (!pBBEP->pInitPart)
+        return BBEP_ERROR_BAD_PARAMETER;
+    bbepSendCMDSequence(pBBEP, pBBEP->pInitPart);
+    cx += (x & 7);
+    bbepPartialWindow(pBBEP, x, y, cx, cy, 0); // scan the window only
+    bbepWriteCmd(pBBEP, UC8151_DRF); // the next bbepRefresh() sends PTOU first
+    return BBEP_SUCCESS;
+} /* bbepRefreshRect() */
 
 void bbepSetRotation(BBEPDISP *pBBEP, int iRotation)
 {
@@ -26,6 +26,70 @@ static G5DECIMAGE g5dec;
 // forward declarations
 void InvertBytes(uint8_t *pData, uint8_t bLen);
 void bbepUnicodeString(const char *szMsg, uint8_t *szExtMsg);
+
+//
+// Text screens draw the same few characters over and over. Decoded glyph
+// bitmaps are kept in a small LRU cache keyed by (font, character) and the
+// per-character metrics of the last few fonts are unpacked into flat tables
+// so that measuring a string doesn't touch the glyph structures at all.
+// The defaults take about 4.8K of RAM (16 x 208 bytes of glyphs plus one
+// 1.5K metrics table; unpacking a font's table again costs one pass over its
+// glyph headers). Define BBEP_GLYPH_CACHE_SLOTS as 0 to save the glyph RAM,
+// or raise the slots for screens with more distinct characters.
+//
+#ifndef BBEP_GLYPH_CACHE_SLOTS
+#define BBEP_GLYPH_CACHE_SLOTS 16
+#endif
+#ifndef BBEP_GLYPH_CACHE_BYTES
+#define BBEP_GLYPH_CACHE_BYTES 192 // largest decoded glyph kept (e.g. 40x38 pixels)
+#endif
+#ifndef BBEP_FONT_METRICS_SLOTS
+#define BBEP_FONT_METRICS_SLOTS 1
+#endif
+#define BBEP_NO_GLYPH_TOP 0x7fff // top/bottom of undefined characters never widen a box
+#define BBEP_NO_GLYPH_BOTTOM -0x7fff
+
+typedef struct bbep_font_metrics {
+    const void *pFont;
+    uint32_t u32LastUse;
+    int16_t advance[256];
+    int16_t top[256];    // yOffset
+    int16_t bottom[256]; // yOffset + height
+} BBEP_FONT_METRICS;
+
+static BBEP_FONT_METRICS fontMetrics[BBEP_FONT_METRICS_SLOTS];
+static uint32_t u32MetricsClock;
+
+// True for display rows that are not in the band being rendered (never without banding)
+#define BBEP_ROW_OUTSIDE_BAND(p, y) ((p)->iBandH && ((int)(y) < (p)->iBandY || (int)(y) >= (p)->iBandY + (p)->iBandH))
+static void bbepListAddText(BBEPDISP *pBBEP, const void *pFont, int x, int y, int xEnd, int yEnd, const char *szMsg, int iColor, int iPlane);
+static int bbepListNotSupported(BBEPDISP *pBBEP);
+//
+// A G5 image that spans several bands keeps its own decoder between them,
+// so each band only decodes its own rows instead of starting from row 0.
+// Allocated by bbepRenderDisplayList() for the tallest G5 command only.
+//
+typedef struct bbep_g5_resume {
+    const void *pCmd; // the BBEP_LIST_G5 command the decoder belongs to
+    int iNextRow; // display row to continue at, -1 before its first band
+    uint32_t u32YAcc;
+    G5DECIMAGE g5;
+    uint8_t u8Line[sizeof(u8Cache)]; // last decoded line, scaled images draw it again in the next band
+} BBEP_G5_RESUME;
+static BBEP_G5_RESUME *pG5Resume;
+static int bbepDrawG5(BBEPDISP *pBBEP, const uint8_t *pG5, int x, int y, int iFG, int iBG, float fScale, BBEP_G5_RESUME *pResume);
+
+#if BBEP_GLYPH_CACHE_SLOTS > 0
+typedef struct bbep_glyph_slot {
+    const void *pFont;
+    uint32_t u32LastUse;
+    uint16_t u16Char, u16Width, u16Height;
+    uint8_t u8Bits[BBEP_GLYPH_CACHE_BYTES];
+} BBEP_GLYPH_SLOT;
+
+static BBEP_GLYPH_SLOT glyphCache[BBEP_GLYPH_CACHE_SLOTS];
+static uint32_t u32GlyphClock;
+#endif // BBEP_GLYPH_CACHE_SLOTS
 const uint8_t ucFont[]PROGMEM = {
     0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x06,0x5f,0x5f,0x06,0x00,
     0x00,0x07,0x07,0x00,0x07,0x07,0x00,0x14,0x7f,0x7f,0x14,0x7f,0x7f,0x14,
@@ -175,16 +239,111 @@ const uint8_t ucSmallFont[] PROGMEM = {
     0x02,0x01,0x02,0x01,0x00,
     0x3c,0x26,0x23,0x26,0x3c};
 //
+// Forget all cached glyphs and metrics
+// Needed when a font at the same address is replaced (e.g. loaded into RAM from a file)
+//
+void bbepFlushGlyphCache(void)
+{
+    memset(fontMetrics, 0, sizeof(fontMetrics));
+#if BBEP_GLYPH_CACHE_SLOTS > 0
+    memset(glyphCache, 0, sizeof(glyphCache));
+#endif
+} /* bbepFlushGlyphCache() */
+//
+// Return the metrics table of a BB_FONT or BB_FONT_SMALL, built on first use
+//
+static BBEP_FONT_METRICS *bbepGetFontMetrics(const void *pFont)
+{
+    BBEP_FONT_METRICS *pM = &fontMetrics[0];
+    BB_FONT *pBBF = NULL;
+    BB_FONT_SMALL *pBBFS = NULL;
+    int i, c, first, last;
+
+    u32MetricsClock++;
+    for (i=0; i<BBEP_FONT_METRICS_SLOTS; i++) {
+        if (fontMetrics[i].pFont == pFont) {
+            fontMetrics[i].u32LastUse = u32MetricsClock;
+            return &fontMetrics[i];
+        }
+        if (fontMetrics[i].u32LastUse < pM->u32LastUse) pM = &fontMetrics[i]; // least recently used
+    }
+    if (pgm_read_word(pFont) == BB_FONT_MARKER) {
+        pBBF = (BB_FONT *)pFont;
+        first = pgm_read_word(&pBBF->first);
+        last = pgm_read_word(&pBBF->last);
+    } else {
+        pBBFS = (BB_FONT_SMALL *)pFont;
+        first = pgm_read_word(&pBBFS->first);
+        last = pgm_read_word(&pBBFS->last);
+    }
+    for (c=0; c<256; c++) {
+        pM->advance[c] = 0;
+        pM->top[c] = BBEP_NO_GLYPH_TOP;
+        pM->bottom[c] = BBEP_NO_GLYPH_BOTTOM;
+        if (c < first || c > last) continue; // undefined character
+        if (pBBF) {
+            BB_GLYPH *pGlyph = &pBBF->glyphs[c - first];
+            pM->advance[c] = pgm_read_word(&pGlyph->xAdvance);
+            pM->top[c] = (int16_t)pgm_read_word(&pGlyph->yOffset);
+            pM->bottom[c] = pM->top[c] + pgm_read_word(&pGlyph->height);
+        } else {
+            BB_GLYPH_SMALL *pSmallGlyph = &pBBFS->glyphs[c - first];
+            pM->advance[c] = pgm_read_byte(&pSmallGlyph->xAdvance);
+            pM->top[c] = (int8_t)pgm_read_byte(&pSmallGlyph->yOffset);
+            pM->bottom[c] = pM->top[c] + pgm_read_byte(&pSmallGlyph->height);
+        }
+    }
+    pM->pFont = pFont;
+    pM->u32LastUse = u32MetricsClock;
+    return pM;
+} /* bbepGetFontMetrics() */
+//
+// Return the decoded bitmap (rows of (w+7)/8 bytes) of a glyph from the cache,
+// decoding it into the least recently used slot if needed.
+// Returns NULL if the glyph is too big to cache or can't be decoded; the caller
+// then decodes it line by line as before.
+//
+static const uint8_t *bbepGetCachedGlyph(const void *pFont, unsigned int c, uint8_t *pCompressed, int iSize, int w, int h)
+{
+#if BBEP_GLYPH_CACHE_SLOTS > 0
+    BBEP_GLYPH_SLOT *pSlot = &glyphCache[0];
+    int i, y, iPitch = (w+7)/8;
+
+    u32GlyphClock++;
+    for (i=0; i<BBEP_GLYPH_CACHE_SLOTS; i++) {
+        if (glyphCache[i].pFont == pFont && glyphCache[i].u16Char == c &&
+            glyphCache[i].u16Width == w && glyphCache[i].u16Height == h) {
+            glyphCache[i].u32LastUse = u32GlyphClock;
+            return glyphCache[i].u8Bits;
+        }
+        if (glyphCache[i].u32LastUse < pSlot->u32LastUse) pSlot = &glyphCache[i];
+    }
+    if (iPitch * h > BBEP_GLYPH_CACHE_BYTES) return NULL;
+    if (g5_decode_init(&g5dec, w, h, pCompressed, iSize) != G5_SUCCESS) return NULL;
+    pSlot->pFont = NULL; // invalid until completely decoded
+    for (y=0; y<h; y++) {
+        i = g5_decode_line(&g5dec, u8Cache);
+        if (i != G5_SUCCESS && i != G5_DECODE_COMPLETE) return NULL; // the last line reports COMPLETE
+        memcpy(&pSlot->u8Bits[y * iPitch], u8Cache, iPitch);
+    }
+    pSlot->pFont = pFont;
+    pSlot->u16Char = c;
+    pSlot->u16Width = w;
+    pSlot->u16Height = h;
+    pSlot->u32LastUse = u32GlyphClock;
+    return pSlot->u8Bits;
+#else
+    return NULL;
+#endif // BBEP_GLYPH_CACHE_SLOTS
+} /* bbepGetCachedGlyph() */
+//
 // Get the size of text in a custom font area
 //
 void bbepGetStringBox(BBEPDISP *pBBEP, const char *szMsg, BB_RECT *pRect)
 {
 int cx = 0;
 unsigned int c, i = 0;
-BB_FONT *pBBF;
-BB_FONT_SMALL *pBBFS;
-BB_GLYPH *pGlyph;
-BB_GLYPH_SMALL *pSmallGlyph;
+BBEP_FONT_METRICS *pM;
 int miny, maxy;
 uint8_t szExtMsg[80];
 
@@ -214,30 +373,12 @@ uint8_t szExtMsg[80];
         cx *= strlen(szMsg);
    } else { // proportional fonts
        bbepUnicodeString(szMsg, szExtMsg); // convert to extended ASCII
-       if (pgm_read_word(pBBEP->pFont) == BB_FONT_MARKER) {
-           pBBF = (BB_FONT *)pBBEP->pFont; pBBFS = NULL;
-       } else { // small font
-           pBBFS = (BB_FONT_SMALL *)pBBEP->pFont; pBBF = NULL;
-       }
+       pM = bbepGetFontMetrics(pBBEP->pFont);
        while (szExtMsg[i]) {
            c = szExtMsg[i++];
-           if (pBBF) { // big font
-               if (c < pgm_read_byte(&pBBF->first) || c > pgm_read_byte(&pBBF->last)) // undefined character
-                   continue; // skip it
-               c -= pgm_read_byte(&pBBF->first); // first char of font defined
-               pGlyph = &pBBF->glyphs[c];
-               cx += pgm_read_word(&pGlyph->xAdvance);
-               if ((int16_t)pgm_read_word(&pGlyph->yOffset) < miny) miny = pgm_read_word(&pGlyph->yOffset);
-               if (pgm_read_word(&pGlyph->height)+(int16_t)pgm_read_word(&pGlyph->yOffset) > maxy) maxy = pgm_read_word(&pGlyph->height)+(int16_t)pgm_read_word(&pGlyph->yOffset);
-           } else {  // small font
-               if (c < pgm_read_byte(&pBBFS->first) || c > pgm_read_byte(&pBBFS->last)) // undefined character
-                   continue; // skip it
-               c -= pgm_read_byte(&pBBFS->first); // first char of font defined
-               pSmallGlyph = &pBBFS->glyphs[c];
-               cx += pgm_read_byte(&pSmallGlyph->xAdvance);
-               if ((int8_t)pgm_read_byte(&pSmallGlyph->yOffset) < miny) miny = (int8_t)pgm_read_byte(&pSmallGlyph->yOffset);
-               if (pgm_read_byte(&pSmallGlyph->height)+(int8_t)pgm_read_byte(&pSmallGlyph->yOffset) > maxy) maxy = pgm_read_byte(&pSmallGlyph->height)+(int8_t)pgm_read_byte(&pSmallGlyph->yOffset);
-           } // small
+           cx += pM->advance[c]; // undefined characters are 0 wide
+           if (pM->top[c] < miny) miny = pM->top[c];
+           if (pM->bottom[c] > maxy) maxy = pM->bottom[c];
        }
    } // prop fonts
    pRect->w = cx;
@@ -259,7 +400,7 @@ void bbepDrawSprite(BBEPDISP *pBBEP, const uint8_t *pSprite, int cx, int cy, int
     int tx, ty, dx, dy, iStartX;
     uint8_t *s, pix, ucSrcMask;
     
-    if (pBBEP == NULL) return;
+    if (pBBEP == NULL || bbepListNotSupported(pBBEP)) return;
     if (x+cx < 0 || y+cy < 0 || x >= pBBEP->native_width || y >= pBBEP->native_height) {
         pBBEP->last_error = BBEP_ERROR_BAD_PARAMETER;
         return; // out of bounds
@@ -560,6 +701,38 @@ void bbepSetPixelFast2Clr(void *pb, int x, int y, unsigned char ucColor)
     }
     pBBEP->ucScreen[i] = u8;
 } /* bbepSetPixelFast2Clr() */
+//
+// Banded rendering: ucScreen only holds display rows iBandY to
+// iBandY+iBandH-1 of plane 0, pixels on other rows are dropped
+//
+void bbepSetPixelFastBand2Clr(void *pb, int x, int y, unsigned char ucColor)
+{
+    uint8_t *d;
+    BBEPDISP *pBBEP = (BBEPDISP *)pb;
+
+    y -= pBBEP->iBandY;
+    if ((unsigned int)y >= (unsigned int)pBBEP->iBandH || (unsigned int)x >= (unsigned int)pBBEP->width) {
+        return; // not in this band
+    }
+    d = &pBBEP->ucScreen[(x >> 3) + (y * ((pBBEP->width+7)>>3))];
+    if (ucColor == BBEP_WHITE) {
+        d[0] |= (0x80 >> (x & 7));
+    } else { // must be black
+        d[0] &= ~(0x80 >> (x & 7));
+    }
+} /* bbepSetPixelFastBand2Clr() */
+
+int bbepSetPixelBand2Clr(void *pb, int x, int y, unsigned char ucColor)
+{
+    BBEPDISP *pBBEP = (BBEPDISP *)pb;
+
+    if (x < 0 || x >= pBBEP->width || y < 0 || y >= pBBEP->height) { // off the screen
+        pBBEP->last_error = BBEP_ERROR_BAD_PARAMETER;
+        return BBEP_ERROR_BAD_PARAMETER;
+    }
+    bbepSetPixelFastBand2Clr(pb, x, y, pBBEP->pColorLookup[ucColor & 0xf]);
+    return BBEP_SUCCESS;
+} /* bbepSetPixelBand2Clr() */
 
 int bbepSetPixel16Clr(void *pb, int x, int y, unsigned char ucColor)
 {
@@ -611,6 +784,106 @@ void bbepSetPixelFast16Clr(void *pb, int x, int y, unsigned char ucColor)
     }
     pBBEP->ucScreen[i] = u8;
 } /* bbepSetPixelFast16Clr() */
+//
+// Horizontal spans
+// Filled shapes are made of horizontal runs of one color. Instead of a
+// function call and a read-modify-write per pixel, a run sets the partial
+// bytes at both ends through a mask and memsets the bytes in between.
+// Define BBEP_NO_SPANS to draw them one pixel at a time (smaller code).
+//
+// Fill pixels x1..x2 of a row of packed pixels (1, 2 or 4 bits each, given
+// as iShift = log2(bpp)) with ucPattern, the color repeated across a byte
+static void bbepFillSpan(uint8_t *pRow, int x1, int x2, int iShift, uint8_t ucPattern)
+{
+    const int iMask = (8 >> iShift) - 1; // pixels per byte - 1
+    uint8_t ucFirst = (uint8_t)(0xff >> ((x1 & iMask) << iShift));
+    uint8_t ucLast = (uint8_t)(0xff << ((iMask - (x2 & iMask)) << iShift));
+    uint8_t *d = &pRow[x1 >> (3 - iShift)];
+    uint8_t *pEnd = &pRow[x2 >> (3 - iShift)];
+
+    if (d == pEnd) { // starts and ends in the same byte
+        ucFirst &= ucLast;
+        *d = (*d & ~ucFirst) | (ucPattern & ucFirst);
+        return;
+    }
+    *d = (*d & ~ucFirst) | (ucPattern & ucFirst);
+    d++;
+    if (pEnd > d) {
+        memset(d, ucPattern, pEnd - d);
+    }
+    *pEnd = (*pEnd & ~ucLast) | (ucPattern & ucLast);
+} /* bbepFillSpan() */
+//
+// Draw pixels x1..x2 (clipped to the screen) of row y in an already
+// translated color; the same pixels as calling pfnSetPixelFast for each
+//
+static void bbepDrawSpan(BBEPDISP *pBBEP, int x1, int x2, int y, uint8_t ucColor)
+{
+    uint8_t *d;
+    int iPitch, iSize;
+
+    if (x1 < 0) x1 = 0;
+    if (x2 >= pBBEP->width) x2 = pBBEP->width - 1;
+    if (x1 > x2) return;
+#ifndef BBEP_NO_SPANS
+    if (pBBEP->pfnSetPixelFast == bbepSetPixelFastBand2Clr) {
+        y -= pBBEP->iBandY;
+        if ((unsigned int)y >= (unsigned int)pBBEP->iBandH) return; // not in this band
+        d = &pBBEP->ucScreen[y * ((pBBEP->width + 7) >> 3)];
+        bbepFillSpan(d, x1, x2, 0, (ucColor == BBEP_WHITE) ? 0xff : 0x00);
+        return;
+    }
+    if (y < 0 || y >= pBBEP->height) return;
+    if (pBBEP->pfnSetPixelFast == bbepSetPixelFast2Clr) {
+        iPitch = (pBBEP->width + 7) >> 3;
+        d = &pBBEP->ucScreen[y * iPitch];
+        if (pBBEP->iPlane == PLANE_1) {
+            d += ((pBBEP->native_width + 7) >> 3) * pBBEP->native_height;
+        }
+        bbepFillSpan(d, x1, x2, 0, (ucColor == BBEP_WHITE) ? 0xff : 0x00);
+        return;
+    }
+    if (pBBEP->pfnSetPixelFast == bbepSetPixelFast4Gray) { // one bit of the gray level per plane
+        iPitch = (pBBEP->width + 7) >> 3;
+        iSize = ((pBBEP->native_width + 7) >> 3) * pBBEP->native_height;
+        d = &pBBEP->ucScreen[y * iPitch];
+        bbepFillSpan(d, x1, x2, 0, (ucColor & 1) ? 0xff : 0x00);
+        bbepFillSpan(&d[iSize], x1, x2, 0, (ucColor & 2) ? 0xff : 0x00);
+        return;
+    }
+    if (pBBEP->pfnSetPixelFast == bbepSetPixelFast3Clr) {
+        iPitch = (pBBEP->width + 7) >> 3;
+        iSize = ((pBBEP->native_width + 7) >> 3) * pBBEP->native_height;
+        d = &pBBEP->ucScreen[y * iPitch];
+        if (ucColor >= BBEP_YELLOW) { // yellow/red has priority, the B/W plane is left alone
+            bbepFillSpan(&d[iSize], x1, x2, 0, 0xff);
+        } else {
+            bbepFillSpan(&d[iSize], x1, x2, 0, 0x00);
+            bbepFillSpan(d, x1, x2, 0, (ucColor == BBEP_WHITE) ? 0xff : 0x00);
+        }
+        return;
+    }
+    if (pBBEP->pfnSetPixelFast == bbepSetPixelFast4Clr) { // 2 bits per pixel
+        ucColor &= 3;
+        ucColor |= (ucColor << 2);
+        d = &pBBEP->ucScreen[y * ((pBBEP->width + 3) >> 2)];
+        bbepFillSpan(d, x1, x2, 1, ucColor | (ucColor << 4));
+        return;
+    }
+    if (pBBEP->pfnSetPixelFast == bbepSetPixelFast16Clr) { // 4 bits per pixel
+        ucColor &= 0xf;
+        d = &pBBEP->ucScreen[y * (pBBEP->width >> 1)];
+        bbepFillSpan(d, x1, x2, 2, ucColor | (ucColor << 4));
+        return;
+    }
+#else
+    (void)d; (void)iPitch; (void)iSize;
+#endif // !BBEP_NO_SPANS
+    // any other pixel function
+    for (; x1 <= x2; x1++) {
+        (*pBBEP->pfnSetPixelFast)(pBBEP, x1, y, ucColor);
+    }
+} /* bbepDrawSpan() */
 
 //
 // Invert font data
@@ -632,13 +905,38 @@ void InvertBytes(uint8_t *pData, uint8_t bLen)
 // the background (0 pixels) unchanged - aka transparent.
 //
 int bbepLoadG5(BBEPDISP *pBBEP, const uint8_t *pG5, int x, int y, int iFG, int iBG, float fScale)
+{
+    uint16_t dy;
+    BB_BITMAP *pbbb;
+
+    if (pBBEP == NULL || pG5 == NULL || fScale < 0.01) return BBEP_ERROR_BAD_PARAMETER;
+    if (pBBEP->pDisplayList) { // record it for banded rendering
+        BBEP_LIST_CMD *pCmd;
+        pbbb = (BB_BITMAP *)pG5;
+        if (pgm_read_word(&pbbb->u16Marker) != BB_BITMAP_MARKER) return BBEP_ERROR_BAD_DATA;
+        dy = (int)(fScale * (float)pgm_read_word(&pbbb->height));
+        pCmd = bbepListAdd(pBBEP, BBEP_LIST_G5, sizeof(pG5) + sizeof(fScale), y, y + dy);
+        if (!pCmd) return pBBEP->iListError;
+        pCmd->x1 = x; pCmd->y1 = y;
+        pCmd->iColor = iFG; pCmd->iBG = iBG;
+        memcpy(&pCmd[1], &pG5, sizeof(pG5));
+        memcpy((uint8_t *)&pCmd[1] + sizeof(pG5), &fScale, sizeof(fScale));
+        return BBEP_SUCCESS;
+    }
+    return bbepDrawG5(pBBEP, pG5, x, y, iFG, iBG, fScale, NULL);
+} /* bbepLoadG5() */
+//
+// Draw a G5 image; with pResume, continue where the last band stopped
+//
+static int bbepDrawG5(BBEPDISP *pBBEP, const uint8_t *pG5, int x, int y, int iFG, int iBG, float fScale, BBEP_G5_RESUME *pResume)
 {
     uint16_t rc, tx, ty, cx, cy, dx, dy, size;
     int width, height;
     BB_BITMAP *pbbb;
+    G5DECIMAGE *pDec = (pResume) ? &pResume->g5 : &g5dec;
+    uint8_t *pLine = (pResume) ? pResume->u8Line : u8Cache;
     uint32_t u32Frac, u32XAcc, u32YAcc; // integer fraction vars
 
-    if (pBBEP == NULL || pG5 == NULL || fScale < 0.01) return BBEP_ERROR_BAD_PARAMETER;
     if (iFG != BBEP_TRANSPARENT) {
         iFG = pBBEP->pColorLookup[iFG & 0xf]; // translate the color for this display type
     }
@@ -658,22 +956,37 @@ int bbepLoadG5(BBEPDISP *pBBEP, const uint8_t *pG5, int x, int y, int iFG, int i
     size = pgm_read_word(&pbbb->size);
     if (iFG == -1) iFG = BBEP_WHITE;
     if (iBG == -1) iBG = BBEP_BLACK;
-    rc = g5_decode_init(&g5dec, cx, cy, (uint8_t *)&pbbb[1], size);
-    if (rc != G5_SUCCESS) return BBEP_ERROR_BAD_DATA; // corrupt data?
+    u32YAcc = 65536; // force first line to get decoded
+    ty = y;
+    if (pResume && pResume->iNextRow >= 0) { // the rows above this band are done
+        ty = pResume->iNextRow;
+        u32YAcc = pResume->u32YAcc;
+    } else {
+        rc = g5_decode_init(pDec, cx, cy, (uint8_t *)&pbbb[1], size);
+        if (rc != G5_SUCCESS) return BBEP_ERROR_BAD_DATA; // corrupt data?
+    }
     if (!pBBEP->ucScreen) { // no back buffer
         bbepSetAddrWindow(pBBEP, x, y, cx+(x&7), cy);
         bbepStartWrite(pBBEP, pBBEP->iPlane); // get ready to write
         dy = cy; // scaling is only supported on internal framebuffers
         u32Frac = 65536; // force to 1.0 scale
     }
-    u32YAcc = 65536; // force first line to get decoded
-    for (ty=y; ty<y+dy && ty < height; ty++) {
+    for (; ty<y+dy && ty < height; ty++) {
         uint8_t u8, *s, src_mask;
+        if (pBBEP->iBandH && (int)ty >= pBBEP->iBandY + pBBEP->iBandH) { // the rest is below this band
+            if (pResume) {
+                pResume->iNextRow = ty;
+                pResume->u32YAcc = u32YAcc;
+            }
+            break;
+        }
         while (u32YAcc >= 65536) { // advance to next source line
-            g5_decode_line(&g5dec, u8Cache);
+            g5_decode_line(pDec, pLine);
             u32YAcc -= 65536;
         }
-        if (!pBBEP->ucScreen) {
+        if (BBEP_ROW_OUTSIDE_BAND(pBBEP, ty)) {
+            // above this band, only the decoder has to move on
+        } else if (!pBBEP->ucScreen) {
             if (x & 7) { // need to shift it over by 1-7 bits
                 uint8_t *d = s = u8Cache, uc1, uc0; // last shifted byte
                 if (iFG == BBEP_WHITE) {
@@ -697,7 +1010,7 @@ int bbepLoadG5(BBEPDISP *pBBEP, const uint8_t *pG5, int x, int y, int iFG, int i
             bbepWriteData(pBBEP, u8Cache, (cx+(x&7)+7)>>3);
         } else { // use the setPixel function for more features
 #ifndef NO_RAM
-            s = u8Cache;
+            s = pLine;
             u32XAcc = 0;
             u8 = *s++; // grab first source byte (8 pixels)
             src_mask = 0x80;
@@ -724,7 +1037,7 @@ int bbepLoadG5(BBEPDISP *pBBEP, const uint8_t *pG5, int x, int y, int iFG, int i
         u32YAcc += u32Frac;
     } // for y
     return BBEP_SUCCESS;
-} /* bbepLoadG5() */
+} /* bbepDrawG5() */
 //
 // Load a 1-bpp Windows bitmap
 // Pass the pointer to the beginning of the BMP file
@@ -742,6 +1055,7 @@ int bbepLoadBMP(BBEPDISP *pBBEP, const uint8_t *pBMP, int dx, int dy, int iFG, i
     uint8_t bFlipped = 0;
     
     if (pBBEP == NULL || pBMP == NULL) return BBEP_ERROR_BAD_PARAMETER;
+    if (bbepListNotSupported(pBBEP)) return BBEP_ERROR_NOT_SUPPORTED;
     iFG = pBBEP->pColorLookup[iFG & 0xf]; // translate the color for this display type
     iBG = pBBEP->pColorLookup[iBG & 0xf];
     // Don't use pgm_read_word because it can cause an unaligned
@@ -850,6 +1164,7 @@ int bbepLoadBMP3(BBEPDISP *pBBEP, const uint8_t *pBMP, int dx, int dy)
     uint8_t ucColorMap[16];
     
     if (pBBEP == NULL || pBMP == NULL) return BBEP_ERROR_BAD_PARAMETER;
+    if (bbepListNotSupported(pBBEP)) return BBEP_ERROR_NOT_SUPPORTED;
     if (!(pBBEP->iFlags & BBEP_3COLOR) || pBBEP->ucScreen == 0) {
         pBBEP->last_error = BBEP_ERROR_NOT_SUPPORTED;
         return BBEP_ERROR_NOT_SUPPORTED; // if not 3-color EPD or no back buffer
@@ -1082,12 +1397,43 @@ uint16_t u16CP; // 16-bit codepoint encoded by the multi-byte sequence
     } // while szMsg[i]
     szExtMsg[j++] = 0; // zero terminate it
 } /* bbepUnicodeString() */
+#ifndef NO_RAM
+//
+// Draw one row of a 1-bpp glyph into a 2-color back buffer (or band), 8 pixels
+// at a time (same result as calling bbepSetPixelFast2Clr() for each pixel)
+//
+static void bbepDrawGlyphRow2Clr(BBEPDISP *pBBEP, const uint8_t *s, int x, int y, int w, int iColor, int iBG)
+{
+    int j, iShift = x & 7;
+    uint8_t *d, u8Src, u8Mask, u8FG, u8BG;
+
+    d = &pBBEP->ucScreen[(x >> 3) + (y - pBBEP->iBandY) * ((pBBEP->width+7)>>3)];
+    if (pBBEP->iPlane == PLANE_1 && !pBBEP->iBandH) {
+        d += ((pBBEP->native_width+7)>>3) * pBBEP->native_height;
+    }
+    for (j=0; j<w; j+=8, d++) {
+        u8Src = *s++;
+        u8Mask = (w - j >= 8) ? 0xff : (uint8_t)(0xff << (8 - (w - j))); // pixels of this glyph
+        u8FG = (iColor == BBEP_TRANSPARENT) ? 0 : (u8Src & u8Mask);
+        u8BG = (iBG == BBEP_TRANSPARENT) ? 0 : (~u8Src & u8Mask);
+        // white sets bits, any other color clears them
+        if (iColor == BBEP_WHITE) { d[0] |= (u8FG >> iShift); } else { d[0] &= ~(u8FG >> iShift); }
+        if (iBG == BBEP_WHITE) { d[0] |= (u8BG >> iShift); } else { d[0] &= ~(u8BG >> iShift); }
+        if (iShift && (uint8_t)((u8FG | u8BG) << (8 - iShift))) { // the rest goes into the next byte
+            uint8_t u8FG1 = (uint8_t)(u8FG << (8 - iShift)), u8BG1 = (uint8_t)(u8BG << (8 - iShift));
+            if (iColor == BBEP_WHITE) { d[1] |= u8FG1; } else { d[1] &= ~u8FG1; }
+            if (iBG == BBEP_WHITE) { d[1] |= u8BG1; } else { d[1] &= ~u8BG1; }
+        }
+    }
+} /* bbepDrawGlyphRow2Clr() */
+#endif // NO_RAM
 //
 // Draw a string of BB_FONT characters directly into the EPD framebuffer
 //
 int bbepWriteStringCustom(BBEPDISP *pBBEP, void *pFont, int x, int y, char *szMsg, int iColor, uint8_t iPlane)
 {
     int rc, i, h, w, j, end_y, dx, dy, tx, ty, tw, iSrcPitch, iPitch, iBG;
+    int x0, y0, iColorIn = iColor, bRecord;
     signed int n;
     unsigned int c, bInvert = 0;
     uint8_t *s, uc0, uc1;
@@ -1096,6 +1442,7 @@ int bbepWriteStringCustom(BBEPDISP *pBBEP, void *pFont, int x, int y, char *szMs
     BB_GLYPH *pGlyph;
     BB_GLYPH_SMALL *pSmallGlyph;
     uint8_t *pBits, u8CMD1, u8CMD2, u8CMD, u8EndMask;
+    const uint8_t *pGlyphBits; // decoded glyph from the cache, NULL = decode line by line
     uint8_t szExtMsg[256]; // translated extended ASCII message text
     uint8_t first, last;
     
@@ -1138,23 +1485,16 @@ int bbepWriteStringCustom(BBEPDISP *pBBEP, void *pFont, int x, int y, char *szMs
         last = pgm_read_byte(&pBBFS->last);
     }
     if (x == CENTER_X) { // center the string on the e-paper
+        BBEP_FONT_METRICS *pM = bbepGetFontMetrics(pFont);
         dx = i = 0;
         while (szExtMsg[i]) {
-            c = szExtMsg[i++];
-            if (c < first || c > last) // undefined character
-                continue; // skip it
-            c -= first; // first char of font defined
-            if (pBBF) {
-                pGlyph = &pBBF->glyphs[c]; // glyph info for this character
-                dx += pgm_read_word(&pGlyph->xAdvance);
-            } else { // small font
-                pSmallGlyph = &pBBFS->glyphs[c]; // glyph info for this character
-                dx += pgm_read_byte(&pSmallGlyph->xAdvance);
-            }
+            dx += pM->advance[szExtMsg[i++]]; // undefined characters are 0 wide
         }
         x = (pBBEP->width - dx)/2;
         if (x < 0) x = 0;
     }
+    bRecord = (pBBEP->pDisplayList != NULL); // only move the cursor, the text goes into the display list
+    x0 = x; y0 = y;
     // Point to the start of the compressed data
     if (pBBF) {
         pBits = (uint8_t *)pBBF;
@@ -1192,8 +1532,14 @@ int bbepWriteStringCustom(BBEPDISP *pBBEP, void *pFont, int x, int y, char *szMs
             xOffset = (int8_t)pgm_read_byte(&pSmallGlyph->xOffset);
             yOffset = (int8_t)pgm_read_byte(&pSmallGlyph->yOffset);
         }
-        if (w > 1) { // skip this if drawing a space
+        if (w > 1 && !bRecord) { // skip this if drawing a space
             s = pBits + u32Offset; // start of compressed bitmap data
+            if (pBBF) {
+                ty = (pgm_read_word(&pGlyph[1].bitmapOffset) - (intptr_t)(s - pBits)); // compressed size
+            } else {
+                ty = (pgm_read_word(&pSmallGlyph[1].bitmapOffset) - (intptr_t)(s - pBits)); // compressed size
+            }
+            if (ty < 0 || ty > 4096) ty = 4096; // DEBUG
             if (u32Rot == 0 || u32Rot == 180) {
                 dx = x + xOffset; // offset from character UL to start drawing
                 dy = y + yOffset;
@@ -1206,6 +1552,9 @@ int bbepWriteStringCustom(BBEPDISP *pBBEP, void *pFont, int x, int y, char *szMs
                 if (-n < w) dx -= (w+n); // since we draw from the baseline
                 dy = y + xOffset;
             }
+            // the whole glyph is cached, even if only part of it is on the display
+            pGlyphBits = bbepGetCachedGlyph(pFont, c, s, ty, w, h);
+            iSrcPitch = (w+7)/8;
             if ((dy + h) > pBBEP->height) { // trim it
                 h = pBBEP->height - dy;
             }
@@ -1214,16 +1563,13 @@ int bbepWriteStringCustom(BBEPDISP *pBBEP, void *pFont, int x, int y, char *szMs
                 u8EndMask <<= (8-(w & 7));
             }
             end_y = dy + h;
-            if (pBBF) {
-                ty = (pgm_read_word(&pGlyph[1].bitmapOffset) - (intptr_t)(s - pBits)); // compressed size
-            } else {
-                ty = (pgm_read_word(&pSmallGlyph[1].bitmapOffset) - (intptr_t)(s - pBits)); // compressed size
-            }
-            if (ty < 0 || ty > 4096) ty = 4096; // DEBUG
-            rc = g5_decode_init(&g5dec, w, h, s, ty);
-            if (rc != G5_SUCCESS) {
-                pBBEP->last_error = BBEP_ERROR_BAD_DATA;
-                 return BBEP_ERROR_BAD_DATA; // corrupt data?
+            rc = G5_SUCCESS;
+            if (pGlyphBits == NULL) {
+                rc = g5_decode_init(&g5dec, w, h, s, ty);
+                if (rc != G5_SUCCESS) {
+                    pBBEP->last_error = BBEP_ERROR_BAD_DATA;
+                     return BBEP_ERROR_BAD_DATA; // corrupt data?
+                }
             }
             if (pBBEP->ucScreen) { // backbuffer, draw pixels
 #ifndef NO_RAM
@@ -1231,8 +1577,18 @@ int bbepWriteStringCustom(BBEPDISP *pBBEP, void *pFont, int x, int y, char *szMs
                 if (x+tw > pBBEP->width) tw = pBBEP->width - x; // clip to right edge
                 for (ty=dy; ty<end_y && ty < pBBEP->height; ty++) {
                     uint8_t u8, u8Count;
-                    g5_decode_line(&g5dec, u8Cache);
-                    s = u8Cache;
+                    if (pGlyphBits) {
+                        s = (uint8_t *)pGlyphBits;
+                        pGlyphBits += iSrcPitch;
+                    } else {
+                        g5_decode_line(&g5dec, u8Cache);
+                        s = u8Cache;
+                    }
+                    if (BBEP_ROW_OUTSIDE_BAND(pBBEP, ty)) continue;
+                    if (ty >= 0 && x >= 0 && (pBBEP->pfnSetPixelFast == bbepSetPixelFast2Clr || pBBEP->pfnSetPixelFast == bbepSetPixelFastBand2Clr)) {
+                        bbepDrawGlyphRow2Clr(pBBEP, s, x, ty, tw, iColor, iBG);
+                        continue;
+                    }
                     u8 = *s++;
                     u8Count = 8;
                     if (ty >= 0) {
@@ -1256,7 +1612,6 @@ int bbepWriteStringCustom(BBEPDISP *pBBEP, void *pFont, int x, int y, char *szMs
 #endif // NO_RAM
             } else { // draw directly into EPD memory
                 // set the memory window for this character
-                iSrcPitch = (w+7)/8;
                 w += (dx & 7); // add parital byte
                 bbepSetAddrWindow(pBBEP, dx, dy, w, h);
                 iPitch = (w+7)/8;
@@ -1283,7 +1638,12 @@ int bbepWriteStringCustom(BBEPDISP *pBBEP, void *pFont, int x, int y, char *szMs
                 }
                 bbepWriteCmd(pBBEP, u8CMD); // memory write command
                 for (ty=dy; ty<end_y && rc == G5_SUCCESS && ty < pBBEP->native_height; ty++) {
-                    rc = g5_decode_line(&g5dec, u8Cache);
+                    if (pGlyphBits) {
+                        memcpy(u8Cache, pGlyphBits, iSrcPitch);
+                        pGlyphBits += iSrcPitch;
+                    } else {
+                        rc = g5_decode_line(&g5dec, u8Cache);
+                    }
                     u8Cache[iSrcPitch-1] &= u8EndMask; // clean pixels beyond character width
                     u8Cache[iSrcPitch] = 0;
                     if (dx & 7) { // need to shift it over by 1-7 bits
@@ -1310,6 +1670,9 @@ int bbepWriteStringCustom(BBEPDISP *pBBEP, void *pFont, int x, int y, char *szMs
             y += xAdvance;
         }
     } // while drawing characters
+    if (bRecord) {
+        bbepListAddText(pBBEP, pFont, x0, y0, x, y, szMsg, iColorIn, iPlane);
+    }
     pBBEP->iCursorX = x;
     pBBEP->iCursorY = y;
     return BBEP_SUCCESS;
@@ -1418,6 +1781,7 @@ int bbepWriteString(BBEPDISP *pBBEP, int x, int y, char *szMsg, int iSize, int i
     if (pBBEP == NULL) {
         return BBEP_ERROR_BAD_PARAMETER;
     }
+    if (bbepListNotSupported(pBBEP)) return BBEP_ERROR_NOT_SUPPORTED; // built-in fonts can't be recorded
     if (iColor != BBEP_TRANSPARENT) {
         iColor = pBBEP->pColorLookup[iColor & 0xf];
     }
@@ -1766,7 +2130,7 @@ void bbepGetStringBox(BBEPDISP *pBBEP, BB_FONT *pFont, const char *szMsg, int *w
 {
     int cx = 0;
     unsigned int c, i = 0;
-    BB_GLYPH *pBBG;
+    BBEP_FONT_METRICS *pM;
     int miny, maxy;
     
     if (!pBBEP) return;
@@ -1776,15 +2140,14 @@ void bbepGetStringBox(BBEPDISP *pBBEP, BB_FONT *pFont, const char *szMsg, int *w
         return; // bad pointers
     }
     miny = 1000; maxy = 0;
+    pM = bbepGetFontMetrics(pFont);
     while (szMsg[i]) {
         c = szMsg[i++];
-        if (c < pFont->first || c > pFont->last) // undefined character
+        if (c > 255) // not in the font
             continue; // skip it
-        c -= pFont->first; // first char of font defined
-        pBBG = &pFont->glyphs[c];
-        cx += pBBG->xAdvance;
-        if (pBBG->yOffset < miny) miny = pBBG->yOffset;
-        if (pBBG->height+pBBG->yOffset > maxy) maxy = pBBG->height+pBBG->yOffset;
+        cx += pM->advance[c];
+        if (pM->top[c] < miny) miny = pM->top[c];
+        if (pM->bottom[c] > maxy) maxy = pM->bottom[c];
     }
     *width = cx;
     *top = miny;
@@ -1839,11 +2202,23 @@ void bbepDrawLine(BBEPDISP *pBBEP, int x1, int y1, int x2, int y2, uint8_t ucCol
     if (pBBEP == NULL) {
         return;
     }
+    if (pBBEP->pDisplayList) { // record it for banded rendering
+        BBEP_LIST_CMD *pCmd = bbepListAdd(pBBEP, BBEP_LIST_LINE, 0, (y1 < y2) ? y1 : y2, ((y1 > y2) ? y1 : y2) + 1);
+        if (pCmd) {
+            pCmd->x1 = x1; pCmd->y1 = y1; pCmd->x2 = x2; pCmd->y2 = y2;
+            pCmd->iColor = ucColor;
+        }
+        return;
+    }
     if (x1 < 0 || x2 < 0 || y1 < 0 || y2 < 0 || x1 >= pBBEP->width || x2 >= pBBEP->width || y1 >= pBBEP->height || y2 >= pBBEP->height) {
         pBBEP->last_error = BBEP_ERROR_BAD_PARAMETER;
         return;
     }
     ucColor = pBBEP->pColorLookup[ucColor & 0xf];
+    if (dy == 0 && pBBEP->ucScreen) { // horizontal
+        bbepDrawSpan(pBBEP, (x1 < x2) ? x1 : x2, (x1 < x2) ? x2 : x1, y1, ucColor);
+        return;
+    }
     if(abs(dx) > abs(dy)) {
         // X major case
         if(x2 < x1) {
@@ -1934,7 +2309,12 @@ static void DrawScaledLine(BBEPDISP *pBBEP, int iCX, int iCY, int x, int y, int3
     }
     if (x < 0) x = 0;
     if (x2 >= pBBEP->width) x2 = pBBEP->width-1;
-    bbepDrawLine(pBBEP, x, y, x2, y, ucColor);
+    if (pBBEP->ucScreen) {
+        // the color is translated once more, as bbepDrawLine() did before
+        bbepDrawSpan(pBBEP, x, x2, y, pBBEP->pColorLookup[ucColor & 0xf]);
+    } else {
+        bbepDrawLine(pBBEP, x, y, x2, y, ucColor);
+    }
 } /* DrawScaledLine() */
 //
 // Draw the 8 pixels around the Bresenham circle
@@ -1980,6 +2360,16 @@ void bbepEllipse(BBEPDISP *pBBEP, int iCenterX, int iCenterY, int32_t iRadiusX,
     int iRadius, iDelta, x, y;
     
     if (pBBEP == NULL) return;
+    if (pBBEP->pDisplayList) { // record it for banded rendering
+        BBEP_LIST_CMD *pCmd = bbepListAdd(pBBEP, BBEP_LIST_ELLIPSE, 0, iCenterY - iRadiusY - 1, iCenterY + iRadiusY + 2);
+        if (pCmd) {
+            pCmd->x1 = iCenterX; pCmd->y1 = iCenterY; pCmd->x2 = iRadiusX; pCmd->y2 = iRadiusY;
+            pCmd->iColor = ucColor;
+            pCmd->u8Flags = bFilled;
+            pCmd->u8Param = u8Parts;
+        }
+        return;
+    }
     if (pBBEP->ucScreen == NULL && !bFilled) {
         pBBEP->last_error = BBEP_ERROR_BAD_PARAMETER;
         return; // must have back buffer defined for outline mode
@@ -2022,6 +2412,15 @@ void bbepRectangle(BBEPDISP *pBBEP, int x1, int y1, int x2, int y2, uint8_t ucCo
     if (pBBEP == NULL) {
         return; // invalid - must have BBEPDISP structure
     }
+    if (pBBEP->pDisplayList) { // record it for banded rendering
+        BBEP_LIST_CMD *pCmd = bbepListAdd(pBBEP, BBEP_LIST_RECT, 0, (y1 < y2) ? y1 : y2, ((y1 > y2) ? y1 : y2) + 1);
+        if (pCmd) {
+            pCmd->x1 = x1; pCmd->y1 = y1; pCmd->x2 = x2; pCmd->y2 = y2;
+            pCmd->iColor = ucColor;
+            pCmd->u8Flags = bFilled;
+        }
+        return;
+    }
     ucColor = pBBEP->pColorLookup[ucColor & 0xf];
 
     if (x1 < 0 || y1 < 0 || x2 < 0 || y2 < 0 ||
@@ -2047,11 +2446,13 @@ void bbepRectangle(BBEPDISP *pBBEP, int x1, int y1, int x2, int y2, uint8_t ucCo
     {
 #ifndef NO_RAM
         if (pBBEP->ucScreen) { // has a buffer to fill
-            int tx, ty;
+            int ty;
+            if (pBBEP->iBandH) { // only the rows of the current band
+                if (y1 < pBBEP->iBandY) y1 = pBBEP->iBandY;
+                if (y2 >= pBBEP->iBandY + pBBEP->iBandH) y2 = pBBEP->iBandY + pBBEP->iBandH - 1;
+            }
             for (ty = y1; ty <= y2; ty++) {
-                for (tx = x1; tx <= x2; tx++) {
-                    (*pBBEP->pfnSetPixelFast)(pBBEP, tx, ty, ucColor);
-                }
+                bbepDrawSpan(pBBEP, x1, x2, ty, ucColor);
             }
         } else
 #endif // NO_RAM
@@ -2071,15 +2472,13 @@ void bbepRectangle(BBEPDISP *pBBEP, int x1, int y1, int x2, int y2, uint8_t ucCo
     {
 #ifndef NO_RAM
         if (pBBEP->ucScreen) { // has a buffer to fill
-            int tx, ty;
+            int ty;
             for (ty = y1; ty <= y2; ty++) {
                 (*pBBEP->pfnSetPixelFast)(pBBEP, x1, ty, ucColor);
                 (*pBBEP->pfnSetPixelFast)(pBBEP, x2, ty, ucColor);
             }
-            for (tx = x1; tx <= x2; tx++) {
-                (*pBBEP->pfnSetPixelFast)(pBBEP, tx, y1, ucColor);
-                (*pBBEP->pfnSetPixelFast)(pBBEP, tx, y2, ucColor);
-            }
+            bbepDrawSpan(pBBEP, x1, x2, y1, ucColor);
+            bbepDrawSpan(pBBEP, x1, x2, y2, ucColor);
         }
 #endif
     } // outline
@@ -2109,5 +2508,273 @@ void bbepRoundRect(BBEPDISP *pBBEP, int x, int y, int w, int h, int r, uint8_t i
     }
 } /* bbepRoundRect() */
 
+//
+// Display list (banded rendering)
+//
+// Between bbepBeginDisplayList() and bbepRenderDisplayList() the drawing
+// functions record what they were asked to do instead of drawing it. The
+// list is then replayed once per band into a strip of a few display rows
+// which is sent to the EPD before the next band is drawn. Only B/W panels
+// in their native orientation can be rendered this way.
+//
+static BBEP_LIST_CMD *bbepListAdd(BBEPDISP *pBBEP, int iOp, int iDataLen, int top, int bottom)
+{
+    BBEP_LIST_CMD *pCmd;
+    int iLen = (sizeof(BBEP_LIST_CMD) + iDataLen + 3) & ~3; // keep the next command aligned
+
+    if (pBBEP->iListError != BBEP_SUCCESS) return NULL; // already failed
+    if (pBBEP->iListLen + iLen > pBBEP->iListSize) {
+        pBBEP->iListError = pBBEP->last_error = BBEP_ERROR_NO_MEMORY;
+        return NULL;
+    }
+    if (top < -0x7fff) top = -0x7fff;
+    if (bottom > 0x7fff) bottom = 0x7fff;
+    pCmd = (BBEP_LIST_CMD *)&pBBEP->pDisplayList[pBBEP->iListLen];
+    memset(pCmd, 0, sizeof(BBEP_LIST_CMD));
+    pCmd->u8Op = (uint8_t)iOp;
+    pCmd->top = (int16_t)top;
+    pCmd->bottom = (int16_t)bottom;
+    pBBEP->iListLast = pBBEP->iListLen;
+    pBBEP->iListLen += iLen;
+    return pCmd;
+} /* bbepListAdd() */
+//
+// Text is stored as the font pointer followed by the (unconverted) characters;
+// a string that continues where the previous one ended is appended to it
+//
+static void bbepListAddText(BBEPDISP *pBBEP, const void *pFont, int x, int y, int xEnd, int yEnd, const char *szMsg, int iColor, int iPlane)
+{
+    BBEP_LIST_CMD *pCmd;
+    BBEP_FONT_METRICS *pM;
+    const void *pCmdFont;
+    int i, iLen, top, bottom, iRot, bAscii = 1;
+    uint8_t *d;
+
+    iLen = (int)strlen(szMsg);
+    if (iLen == 0 || iLen > 255) {
+        if (iLen) pBBEP->iListError = pBBEP->last_error = BBEP_ERROR_BAD_PARAMETER;
+        return;
+    }
+    if (pgm_read_word(pFont) == BB_FONT_MARKER) {
+        iRot = pgm_read_dword(&((BB_FONT *)pFont)->rotation);
+    } else {
+        iRot = pgm_read_dword(&((BB_FONT_SMALL *)pFont)->rotation);
+    }
+    pM = bbepGetFontMetrics(pFont);
+    top = BBEP_NO_GLYPH_TOP; bottom = BBEP_NO_GLYPH_BOTTOM;
+    for (i=0; i<iLen; i++) {
+        uint8_t c = (uint8_t)szMsg[i];
+        if (c & 0x80) bAscii = 0; // UTF-8 / extended ASCII, the glyph row range isn't known here
+        if (pM->top[c] < top) top = pM->top[c];
+        if (pM->bottom[c] > bottom) bottom = pM->bottom[c];
+    }
+    if ((iRot != 0 && iRot != 180) || !bAscii || top > bottom) { // any row could be touched
+        top = 0; bottom = pBBEP->height;
+    } else {
+        top += y; bottom += y;
+    }
+    if (pBBEP->iListLen != 0 && pBBEP->iListError == BBEP_SUCCESS) { // continue the previous run?
+        pCmd = (BBEP_LIST_CMD *)&pBBEP->pDisplayList[pBBEP->iListLast];
+        memcpy(&pCmdFont, &pCmd[1], sizeof(pCmdFont));
+        if (pCmd->u8Op == BBEP_LIST_TEXT && pCmdFont == pFont && pCmd->x2 == x && pCmd->y2 == y &&
+            pCmd->iColor == iColor && pCmd->iBG == pBBEP->iBG && pCmd->u8Param == iPlane &&
+            bAscii && !(pCmd->u8Flags & 1) && pCmd->u8Len + iLen <= 255) {
+            int iOld = (sizeof(BBEP_LIST_CMD) + sizeof(pFont) + pCmd->u8Len + 3) & ~3;
+            int iNew = (sizeof(BBEP_LIST_CMD) + sizeof(pFont) + pCmd->u8Len + iLen + 3) & ~3;
+            if (pBBEP->iListLast + iNew <= pBBEP->iListSize) {
+                d = (uint8_t *)&pCmd[1] + sizeof(pFont) + pCmd->u8Len;
+                memcpy(d, szMsg, iLen);
+                pCmd->u8Len += iLen;
+                pBBEP->iListLen += iNew - iOld;
+                if (top < pCmd->top) pCmd->top = top;
+                if (bottom > pCmd->bottom) pCmd->bottom = bottom;
+                pCmd->x2 = xEnd; pCmd->y2 = yEnd;
+                return;
+            }
+        }
+    }
+    pCmd = bbepListAdd(pBBEP, BBEP_LIST_TEXT, sizeof(pFont) + iLen, top, bottom);
+    if (!pCmd) return;
+    pCmd->x1 = x; pCmd->y1 = y;
+    pCmd->x2 = xEnd; pCmd->y2 = yEnd;
+    pCmd->iColor = iColor; pCmd->iBG = pBBEP->iBG;
+    pCmd->u8Param = (uint8_t)iPlane;
+    pCmd->u8Flags = bAscii ? 0 : 1; // non-ASCII text is never merged
+    pCmd->u8Len = (uint8_t)iLen;
+    memcpy(&pCmd[1], &pFont, sizeof(pFont));
+    memcpy((uint8_t *)&pCmd[1] + sizeof(pFont), szMsg, iLen);
+} /* bbepListAddText() */
+//
+// Drawing calls that can't be recorded make the list fail instead of
+// drawing outside of it
+//
+static int bbepListNotSupported(BBEPDISP *pBBEP)
+{
+    if (!pBBEP->pDisplayList) return 0;
+    pBBEP->iListError = pBBEP->last_error = BBEP_ERROR_NOT_SUPPORTED;
+    return 1;
+} /* bbepListNotSupported() */
+
+static int bbepListSetPixel(void *pb, int x, int y, unsigned char ucColor)
+{
+    BBEPDISP *pBBEP = (BBEPDISP *)pb;
+    BBEP_LIST_CMD *pCmd = bbepListAdd(pBBEP, BBEP_LIST_PIXEL, 0, y, y+1);
+    if (!pCmd) return pBBEP->iListError;
+    pCmd->x1 = x; pCmd->y1 = y;
+    pCmd->iColor = ucColor;
+    return BBEP_SUCCESS;
+} /* bbepListSetPixel() */
+//
+// Draw the commands which touch the current band into the strip
+//
+static void bbepReplayList(BBEPDISP *pBBEP, uint8_t *pList, int iLen)
+{
+    BBEP_LIST_CMD *pCmd;
+    const uint8_t *pG5;
+    const void *pFont;
+    float fScale;
+    char szMsg[256];
+    int i, iCmdLen;
+
+    for (i=0; i<iLen; i += iCmdLen) {
+        pCmd = (BBEP_LIST_CMD *)&pList[i];
+        iCmdLen = sizeof(BBEP_LIST_CMD);
+        if (pCmd->u8Op == BBEP_LIST_G5) {
+            iCmdLen += sizeof(pG5) + sizeof(fScale);
+        } else if (pCmd->u8Op == BBEP_LIST_TEXT) {
+            iCmdLen += sizeof(pFont) + pCmd->u8Len;
+        }
+        iCmdLen = (iCmdLen + 3) & ~3;
+        if (pCmd->bottom <= pBBEP->iBandY || pCmd->top >= pBBEP->iBandY + pBBEP->iBandH) {
+            continue; // nothing to draw in this band
+        }
+        switch (pCmd->u8Op) {
+            case BBEP_LIST_FILL:
+                if (pCmd->u8Param != PLANE_1) { // only plane 0 is rendered
+                    bbepFill(pBBEP, (uint8_t)pCmd->iColor, pCmd->u8Param);
+                }
+                break;
+            case BBEP_LIST_PIXEL:
+                (*pBBEP->pfnSetPixel)(pBBEP, pCmd->x1, pCmd->y1, (uint8_t)pCmd->iColor);
+                break;
+            case BBEP_LIST_LINE:
+                bbepDrawLine(pBBEP, pCmd->x1, pCmd->y1, pCmd->x2, pCmd->y2, (uint8_t)pCmd->iColor);
+                break;
+            case BBEP_LIST_RECT:
+                bbepRectangle(pBBEP, pCmd->x1, pCmd->y1, pCmd->x2, pCmd->y2, (uint8_t)pCmd->iColor, pCmd->u8Flags);
+                break;
+            case BBEP_LIST_ELLIPSE:
+                bbepEllipse(pBBEP, pCmd->x1, pCmd->y1, pCmd->x2, pCmd->y2, pCmd->u8Param, (uint8_t)pCmd->iColor, pCmd->u8Flags);
+                break;
+            case BBEP_LIST_G5:
+                memcpy(&pG5, &pCmd[1], sizeof(pG5));
+                memcpy(&fScale, (uint8_t *)&pCmd[1] + sizeof(pG5), sizeof(fScale));
+                bbepDrawG5(pBBEP, pG5, pCmd->x1, pCmd->y1, pCmd->iColor, pCmd->iBG, fScale,
+                           (pG5Resume && pG5Resume->pCmd == pCmd) ? pG5Resume : NULL);
+                break;
+            case BBEP_LIST_TEXT:
+                memcpy(&pFont, &pCmd[1], sizeof(pFont));
+                memcpy(szMsg, (uint8_t *)&pCmd[1] + sizeof(pFont), pCmd->u8Len);
+                szMsg[pCmd->u8Len] = 0;
+                pBBEP->iBG = pCmd->iBG;
+                bbepWriteStringCustom(pBBEP, (void *)pFont, pCmd->x1, pCmd->y1, szMsg, pCmd->iColor, pCmd->u8Param);
+                break;
+        }
+    }
+} /* bbepReplayList() */
+//
+// Start recording drawing commands into pList (4-byte aligned)
+//
+int bbepBeginDisplayList(BBEPDISP *pBBEP, uint8_t *pList, int iSize)
+{
+    if (pBBEP == NULL || pList == NULL || iSize < (int)sizeof(BBEP_LIST_CMD) || ((intptr_t)pList & 3)) {
+        return BBEP_ERROR_BAD_PARAMETER;
+    }
+    if (pBBEP->iFlags & (BBEP_3COLOR | BBEP_4COLOR | BBEP_4GRAY | BBEP_7COLOR | BBEP_4BPP_DATA) || pBBEP->iOrientation != 0) {
+        return BBEP_ERROR_NOT_SUPPORTED;
+    }
+    pBBEP->pDisplayList = pList;
+    pBBEP->iListSize = iSize;
+    pBBEP->iListLen = pBBEP->iListLast = 0;
+    pBBEP->iListError = BBEP_SUCCESS;
+    pBBEP->pfnSetPixel = bbepListSetPixel;
+    return BBEP_SUCCESS;
+} /* bbepBeginDisplayList() */
+//
+// Stop recording and send the recorded image to plane 0 of the EPD, the same
+// way bbepWritePlane(PLANE_0) would. pStrip holds as many rows as fit in
+// iStripSize; pfnBand (optional) sees each band after it was sent.
+//
+int bbepRenderDisplayList(BBEPDISP *pBBEP, uint8_t *pStrip, int iStripSize, BB_BAND_CALLBACK *pfnBand, void *pUser)
+{
+    uint8_t *pList, *pOldScreen;
+    BBEP_LIST_CMD *pCmd, *pTallest = NULL;
+    int i, y, ty, iPitch, iRows, iPlane, iBG, iCursorX, iCursorY, iCmdLen;
+
+    if (pBBEP == NULL || pBBEP->pDisplayList == NULL) return BBEP_ERROR_BAD_PARAMETER;
+    pList = pBBEP->pDisplayList;
+    pBBEP->pDisplayList = NULL; // from here on the drawing functions draw
+    pBBEP->pfnSetPixel = bbepSetPixel2Clr;
+    pBBEP->pfnSetPixelFast = bbepSetPixelFast2Clr;
+    if (pBBEP->iListError != BBEP_SUCCESS) return pBBEP->iListError;
+    iPitch = (pBBEP->native_width + 7) >> 3;
+    iRows = (pStrip) ? iStripSize / iPitch : 0;
+    if (iRows < 1 || iPitch > (int)sizeof(u8Cache)) return BBEP_ERROR_BAD_PARAMETER;
+    if (iRows > pBBEP->native_height) iRows = pBBEP->native_height;
+    // the tallest G5 image that spans bands gets a decoder of its own (optional, it's only faster)
+    for (i=0; i<pBBEP->iListLen; i += iCmdLen) {
+        pCmd = (BBEP_LIST_CMD *)&pList[i];
+        iCmdLen = sizeof(BBEP_LIST_CMD);
+        if (pCmd->u8Op == BBEP_LIST_G5) {
+            iCmdLen += sizeof(const uint8_t *) + sizeof(float);
+            if (pCmd->bottom - pCmd->top > iRows &&
+                (!pTallest || pCmd->bottom - pCmd->top > pTallest->bottom - pTallest->top)) {
+                pTallest = pCmd;
+            }
+        } else if (pCmd->u8Op == BBEP_LIST_TEXT) {
+            iCmdLen += sizeof(const void *) + pCmd->u8Len;
+        }
+        iCmdLen = (iCmdLen + 3) & ~3;
+    }
+    if (pTallest) {
+        pG5Resume = (BBEP_G5_RESUME *)malloc(sizeof(BBEP_G5_RESUME));
+        if (pG5Resume) {
+            pG5Resume->pCmd = pTallest;
+            pG5Resume->iNextRow = -1;
+        }
+    }
+    // the replay changes these, the caller shouldn't notice
+    pOldScreen = pBBEP->ucScreen;
+    iPlane = pBBEP->iPlane; iBG = pBBEP->iBG;
+    iCursorX = pBBEP->iCursorX; iCursorY = pBBEP->iCursorY;
+    pBBEP->ucScreen = pStrip;
+    pBBEP->iPlane = PLANE_0;
+    pBBEP->pfnSetPixel = bbepSetPixelBand2Clr;
+    pBBEP->pfnSetPixelFast = bbepSetPixelFastBand2Clr;
+
+    bbepSetAddrWindow(pBBEP, 0, 0, pBBEP->native_width, pBBEP->native_height);
+    bbepStartWrite(pBBEP, PLANE_0);
+    for (y=0; y<pBBEP->native_height; y += iRows) {
+        pBBEP->iBandY = y;
+        pBBEP->iBandH = (y + iRows > pBBEP->native_height) ? pBBEP->native_height - y : iRows;
+        memset(pStrip, 0xff, iPitch * pBBEP->iBandH); // the back buffer starts out white
+        bbepReplayList(pBBEP, pList, pBBEP->iListLen);
+        for (ty=0; ty<pBBEP->iBandH; ty++) {
+            memcpy(u8Cache, &pStrip[ty * iPitch], iPitch); // the data is overwritten after each write
+            bbepWriteData(pBBEP, u8Cache, iPitch);
+        }
+        if (pfnBand) (*pfnBand)(pUser, y, pBBEP->iBandH, pStrip);
+    }
+    pBBEP->iBandY = pBBEP->iBandH = 0;
+    free(pG5Resume);
+    pG5Resume = NULL;
+    pBBEP->ucScreen = pOldScreen;
+    pBBEP->iPlane = iPlane; pBBEP->iBG = iBG;
+    pBBEP->iCursorX = iCursorX; pBBEP->iCursorY = iCursorY;
+    pBBEP->pfnSetPixel = bbepSetPixel2Clr;
+    pBBEP->pfnSetPixelFast = bbepSetPixelFast2Clr;
+    return BBEP_SUCCESS;
+} /* bbepRenderDisplayList() */
+
 #endif // __BB_EP_GFX__
 
@@ -112,6 +112,18 @@ int BBEPAPER::refresh(int iMode, bool bWait)
     return rc;
 } /* refresh() */
 
+int BBEPAPER::refreshRect(int x, int y, int w, int h, bool bWait)
+{
+    int rc;
+    long l = millis();
+    rc = bbepRefreshRect(&_bbep, x, y, w, h);
+    if (rc == BBEP_SUCCESS && bWait) {
+        bbepWaitBusy(&_bbep);
+    }
+    _bbep.iOpTime = (int)(millis() - l);
+    return rc;
+} /* refreshRect() */
+
 //int BBEPAPER::getFlags(void)
 //{
 //    return _bbep.iFlags;
@@ -486,6 +498,10 @@ void BBEPAPER::getStringBox(const char *string, BB_RECT *pRect)
 {
     bbepGetStringBox(&_bbep, (char *)string, pRect);
 }
+void BBEPAPER::flushGlyphCache(void)
+{
+    bbepFlushGlyphCache();
+}
 #ifdef ARDUINO
 void BBEPAPER::getStringBox(const String &str, BB_RECT *pRect)
 {
@@ -583,6 +599,19 @@ void BBEPAPER::drawSprite(const uint8_t *pSprite, int cx, int cy, int iPitch, in
 {
     bbepDrawSprite(&_bbep, pSprite, cx, cy, iPitch, x, y, iColor);
 }
+int BBEPAPER::beginDisplayList(uint8_t *pList, int iSize)
+{
+    return bbepBeginDisplayList(&_bbep, pList, iSize);
+} /* beginDisplayList() */
+
+int BBEPAPER::renderDisplayList(uint8_t *pStrip, int iStripSize, BB_BAND_CALLBACK *pfnBand, void *pUser)
+{
+    long l = millis();
+    int rc;
+    rc = bbepRenderDisplayList(&_bbep, pStrip, iStripSize, pfnBand, pUser);
+    _bbep.iDataTime = (int)(millis() - l);
+    return rc;
+} /* renderDisplayList() */
 void BBEPAPER::startWrite(int iPlane)
 {
     bbepStartWrite(&_bbep, iPlane);
@@ -385,6 +385,9 @@ enum {
 typedef int (BB_SET_PIXEL)(void *pBBEP, int x, int y, unsigned char color);
 // Fast pixel drawing function pointer (no boundary checking)
 typedef void (BB_SET_PIXEL_FAST)(void *pBBEP, int x, int y, unsigned char color);
+// Called after each band of a display list has been sent to the EPD
+// (y = first display row, iHeight rows of 1-bpp pixels in pRows)
+typedef void (BB_BAND_CALLBACK)(void *pUser, int y, int iHeight, uint8_t *pRows);
 
 typedef struct bbepstruct
 {
@@ -409,6 +412,9 @@ const uint8_t *pInitFast; // fast update init sequence
 const uint8_t *pInitPart; // partial update init sequence
 BB_SET_PIXEL *pfnSetPixel;
 BB_SET_PIXEL_FAST *pfnSetPixelFast;
+uint8_t *pDisplayList; // drawing commands are recorded here instead of drawn (NULL = draw immediately)
+int iListSize, iListLen, iListLast, iListError; // size, bytes used, offset of the last command, first error
+int iBandY, iBandH; // display rows held in ucScreen while rendering a band (iBandH == 0 = whole display)
 } BBEPDISP;
 
 #ifdef __cplusplus
@@ -450,6 +456,7 @@ class BBEPAPER
     void writeData(uint8_t *pData, int iLen);
     void writeCmd(uint8_t u8Cmd);
     int refresh(int iMode, bool bWait = true);
+    int refreshRect(int x, int y, int w, int h, bool bWait = true);
     void setBuffer(uint8_t *pBuffer);
     int allocBuffer(bool bSecondPlane = true);
     void * getBuffer(void);
@@ -481,6 +488,7 @@ class BBEPAPER
     int16_t getCursorY(void);
     int testPanelType(void);
     void getStringBox(const char *string, BB_RECT *pRect);
+    void flushGlyphCache(void); // after replacing font data at the same address
 #ifdef ARDUINO
     void getStringBox(const String &str, BB_RECT *pRect);
 #endif
@@ -502,6 +510,8 @@ class BBEPAPER
     int getPlane(void);
     int getChip(void);
     void drawSprite(const uint8_t *pSprite, int cx, int cy, int iPitch, int x, int y, uint8_t iColor);    
+    int beginDisplayList(uint8_t *pList, int iSize);
+    int renderDisplayList(uint8_t *pStrip, int iStripSize, BB_BAND_CALLBACK *pfnBand = NULL, void *pUser = NULL);
 #if !defined (ARDUINO)
     void print(const char *pString);
     void println(const char *pString);
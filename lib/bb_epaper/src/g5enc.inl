@@ -19,25 +19,6 @@
 
 #include "Group5.h"
 
-/* Number of consecutive 1 bits in a byte from MSB to LSB */
-static uint8_t bitcount[256] =
-        {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  /* 0-15 */
-         0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  /* 16-31 */
-         0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  /* 32-47 */
-         0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  /* 48-63 */
-         0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  /* 64-79 */
-         0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  /* 80-95 */
-         0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  /* 96-111 */
-         0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,  /* 112-127 */
-         1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  /* 128-143 */
-         1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  /* 144-159 */
-         1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  /* 160-175 */
-         1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,  /* 176-191 */
-         2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,  /* 192-207 */
-         2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,2,  /* 208-223 */
-         3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,3,  /* 224-239 */
-         4,4,4,4,4,4,4,4,5,5,5,5,6,6,7,8}; /* 240-255 */
-
 /* Table of vertical codes for G5 encoding */
 /* code followed by length, starting with v(-3) */
 static const uint8_t vtable[14] =
@@ -109,79 +90,58 @@ int g5_encode_init(G5ENCIMAGE *pImage, int iWidth, int iHeight, uint8_t *pOut, i
     return iError;
 } /* g5_encode_init() */
 //
+// Read 32 pixels starting at pixel iBit (a multiple of 32) as a big-endian
+// word, MSB = leftmost pixel. Pixels past the end of the line read as 0
+//
+static BIGUINT G5ENCLoadWord(const uint8_t *buf, int iBit, int iLineBits)
+{
+BIGUINT ulWord;
+int i, iBytes;
+
+   buf += iBit >> 3;
+   iBytes = (iLineBits - iBit) >> 3;
+   if (iBytes >= 4) {
+      memcpy(&ulWord, buf, sizeof(ulWord)); // the rows don't have to be aligned
+      return __builtin_bswap32(ulWord);
+   }
+   ulWord = 0;
+   for (i=0; i<iBytes; i++) {
+      ulWord |= (BIGUINT)buf[i] << (24 - 8*i);
+   }
+   return ulWord;
+} /* G5ENCLoadWord() */
+//
 // Internal function to convert uncompressed 1-bit per pixel data
 // into the run-end data needed to feed the G5 encoder
+// The line is read 32 pixels at a time; the pixels that differ from the
+// current color are the set bits of (word ^ color), so __builtin_clz() gives
+// the next color change and a word without one costs a single test
 //
 static int G5ENCEncodeLine(unsigned char *buf, int xsize, int16_t *pDest)
 {
-int iCount, xborder;
-uint8_t i, c;
-int8_t cBits;
-int iLen;
-int16_t x;
+int iLineBits, iEnd, iWord, iPos;
+BIGUINT ulWord, ulDiff, ulMask, ulColor;
 int16_t *pLimit = pDest + (MAX_IMAGE_FLIPS-4);
 
-   xborder = xsize;
-   iCount = (xsize + 7) >> 3; /* Number of bytes per line */
-   cBits = 8;
-   iLen = 0; /* Current run length */
-   x = 0;
-
-   c = *buf++;  /* Get the first byte to start */
-   iCount--;
-   while (iCount >=0) {
-      if (pDest >= pLimit) return G5_MAX_FLIPS_EXCEEDED;
-      i = bitcount[c]; /* Get the number of consecutive bits */
-      iLen += i; /* Add this length to total run length */
-      c <<= i;
-      cBits -= i; /* Minus the number in a byte */
-      if (cBits <= 0)
-         {
-         iLen += cBits; /* Adjust length */
-         cBits = 8;
-         c = *buf++;  /* Get another data byte */
-         iCount--;
-         continue; /* Keep doing white until color change */
-         }
-      c = ~c; /* flip color to count black pixels */
-   /* Store the white run length */
-      xborder -= iLen;
-      if (xborder < 0)
-         {
-         iLen += xborder; /* Make sure run length is not past end */
-         break;
-         }
-      x += iLen;
-      *pDest++ = x;
-      iLen = 0;
-doblack:
-      i = bitcount[c]; /* Get consecutive bits */
-      iLen += i; /* Add to total run length */
-      c <<= i;
-      cBits -= i;
-      if (cBits <= 0)
-         {
-         iLen += cBits; /* Adjust length */
-         cBits = 8;
-         c = *buf++;  /* Get another data byte */
-         c = ~c;   /* Flip color to find black */
-         iCount--;
-         if (iCount < 0)
+   iLineBits = ((xsize + 7) >> 3) << 3; /* whole bytes of pixels */
+   // a change in the padding bits right after the last pixel is stored too,
+   // one at the very end of the data isn't
+   iEnd = (xsize < iLineBits) ? xsize + 1 : iLineBits;
+   ulColor = (BIGUINT)~0; /* the line starts with white (1 bits) */
+   ulMask = (BIGUINT)~0; /* pixels of the word not looked at yet */
+   for (iWord = 0; iWord < iEnd; iWord += 32) {
+      ulWord = G5ENCLoadWord(buf, iWord, iLineBits);
+      while ((ulDiff = (ulWord ^ ulColor) & ulMask) != 0) {
+         iPos = iWord + __builtin_clz(ulDiff);
+         if (iPos >= iEnd)
             break;
-         goto doblack;
-         }
-   /* Store the black run length */
-      c = ~c;       /* Flip color again to find white pixels */
-      xborder -= iLen;
-      if (xborder < 0)
-         {
-         iLen += xborder; /* Make sure run length is not past end */
-         break;
-         }
-      x += iLen;
-      *pDest++ = x;
-      iLen = 0;
-      } /* while */
+         if (pDest >= pLimit) return G5_MAX_FLIPS_EXCEEDED;
+         *pDest++ = (int16_t)iPos; /* store the end of the run */
+         ulColor = ~ulColor;
+         ulMask = (BIGUINT)~0 >> (iPos & 31);
+      }
+      ulMask = (BIGUINT)~0;
+   }
 
    if (pDest >= pLimit) return G5_MAX_FLIPS_EXCEEDED;
    *pDest++ = xsize;
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "api_types.h"
+#include "ota_stream.h"
+
+/**
+ * Incremental (push) parser for the /api/display JSON body.
+ *
+ * Bytes can be fed in chunks of any size, straight from the HTTP stream,
+ * and are decoded into the fixed-size fields of ApiDisplayResponse without
+ * any heap allocation. Unknown keys are skipped, including nested objects
+ * and arrays (those are only checked for balanced brackets).
+ * As an OtaSink it can be fed by a SinkStream from HTTPClient::writeToStream.
+ */
+class ApiDisplayParser : public OtaSink
+{
+public:
+  explicit ApiDisplayParser(ApiDisplayResponse &response);
+
+  /** feed() for SinkStream; always true, so the connection is drained even after a parse error */
+  bool write(const uint8_t *data, size_t length) override
+  {
+    feed((const char *)data, length);
+    return true;
+  }
+
+  /** Consume the next chunk of the body; returns false once the input is known to be invalid */
+  bool feed(const char *data, size_t length);
+
+  /** Validate the end of input, fill the derived fields and return the outcome */
+  ApiDisplayOutcome finish();
+
+  /** True if a string value did not fit its field and was cut short */
+  bool truncated() const { return wasTruncated; }
+
+private:
+  enum State : uint8_t
+  {
+    EXPECT_ROOT,
+    EXPECT_KEY_OR_END,
+    EXPECT_KEY,
+    EXPECT_COLON,
+    EXPECT_VALUE,
+    EXPECT_COMMA_OR_END,
+    IN_STRING,
+    IN_STRING_ESCAPE,
+    IN_STRING_UNICODE,
+    IN_NUMBER,
+    IN_LITERAL,
+    IN_NESTED,
+    DONE,
+    FAILED
+  };
+
+  bool step(char c);
+  bool fail(const char *reason);
+  void beginString(bool isKey);
+  void endString();
+  void appendChar(char c);
+  void appendCodepoint(uint16_t codepoint);
+  void appendBase64(char c);
+  void endNumber();
+  void endLiteral();
+
+  ApiDisplayResponse &response;
+  State state;
+  uint8_t field;
+  bool readingKey;
+
+  char key[24];
+  char *dest;
+  size_t destSize;
+  size_t destLength;
+  bool wasTruncated;
+
+  uint64_t number;
+  bool numberNegative;
+  bool numberFraction;
+  bool numberOverflow;
+
+  const char *literal;
+  uint8_t literalPos;
+
+  uint16_t unicode;
+  uint8_t unicodeDigits;
+
+  uint16_t nestedDepth;
+  bool nestedString;
+  bool nestedEscape;
+
+  char temperatureProfile[16];
+  char specialFunction[24];
+  char firmwareEncoding[24];
+
+  // display_list is decoded from base64 as it arrives
+  bool base64;
+  bool base64Invalid;
+  uint32_t base64Bits;
+  uint8_t base64BitCount;
+};
@@ -1,4 +1,5 @@
 #include "api_types.h"
 
 ApiSetupResponse parseResponse_apiSetup(String &payload);
-ApiDisplayResponse parseResponse_apiDisplay(String &payload);
+/** Parse into a caller-owned response (it is several KB, too big to return on the stack) */
+ApiDisplayOutcome parseResponse_apiDisplay(String &payload, ApiDisplayResponse &response);
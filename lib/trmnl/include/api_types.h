@@ -3,6 +3,9 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include "special_function.h"
+#include "fixed_string.h"
+#include "ota_decoder.h"
+#include "capabilities.h"
 
 enum class ApiSetupOutcome
 {
@@ -11,14 +14,19 @@ enum class ApiSetupOutcome
   StatusError
 };
 
+#define API_KEY_SIZE 64
+#define API_FRIENDLY_ID_SIZE 16
+#define API_BASE_URL_SIZE 128
+#define API_MESSAGE_SIZE 128
+
 struct ApiSetupResponse
 {
   ApiSetupOutcome outcome;
   uint16_t status;
-  String api_key;
-  String friendly_id;
-  String image_url;
-  String message;
+  FixedString<API_KEY_SIZE> api_key;
+  FixedString<API_FRIENDLY_ID_SIZE> friendly_id;
+  FixedString<1024> image_url;
+  FixedString<API_MESSAGE_SIZE> message;
 };
 
 enum class ApiDisplayOutcome
@@ -27,38 +35,55 @@ enum class ApiDisplayOutcome
   DeserializationError,
 };
 
+#define API_DISPLAY_ERROR_DETAIL_SIZE 32
+#define API_DISPLAY_URL_SIZE 1024
+#define API_DISPLAY_FILENAME_SIZE 128
+#define API_DISPLAY_ACTION_SIZE 32
+#define API_DISPLAY_LIST_SIZE 2048
+#define API_DISPLAY_OVERLAY_SIZE 192
+
+/** Parsed /api/display response; fixed-size so that parsing never touches the heap */
 struct ApiDisplayResponse
 {
   ApiDisplayOutcome outcome;
-  String error_detail;
+  FixedString<API_DISPLAY_ERROR_DETAIL_SIZE> error_detail;
   uint64_t status;
-  String image_url;
+  FixedString<API_DISPLAY_URL_SIZE> image_url;
   uint32_t image_url_timeout;
-  String filename;
+  FixedString<API_DISPLAY_FILENAME_SIZE> filename;
   bool update_firmware;
   bool maximum_compatibility;
-  String firmware_url;
+  FixedString<API_DISPLAY_URL_SIZE> firmware_url;
+  OtaEncoding firmware_encoding;
   uint64_t refresh_rate;
   uint32_t temp_profile;
   bool reset_firmware;
   SPECIAL_FUNCTION special_function;
-  String action;
+  FixedString<API_DISPLAY_ACTION_SIZE> action;
+  FixedString<API_DISPLAY_URL_SIZE> bundle_url;
+  uint32_t bundle_valid_for;
+  uint8_t display_list[API_DISPLAY_LIST_SIZE]; // decoded from base64; see display_list.h
+  uint16_t display_list_size;                  // 0 if there was none or it did not fit
+  FixedString<API_DISPLAY_OVERLAY_SIZE> overlay; // widgets drawn by the device; see overlay_widgets.h
+  FixedString<API_DISPLAY_URL_SIZE> delta_url;   // tiles that patch the frame on screen; image_url is the fallback
 };
 
 struct ApiDisplayInputs
 {
-  String baseUrl;
-  String apiKey;
-  String friendlyId;
+  FixedString<API_BASE_URL_SIZE> baseUrl;
+  FixedString<API_KEY_SIZE> apiKey;
+  FixedString<API_FRIENDLY_ID_SIZE> friendlyId;
   uint32_t refreshRate;
-  String macAddress;
+  FixedString<18> macAddress;
   float batteryVoltage;
-  String firmwareVersion;
-  String model;
+  FixedString<32> firmwareVersion;
+  FixedString<32> model;
   int rssi;
   int displayWidth;
   int displayHeight;
   SPECIAL_FUNCTION specialFunction;
+  uint32_t frameCrc; // frameCrc() of the image on screen, 0 if it can't be the base of a delta
+  DeviceCapabilities capabilities;
 };
 
 typedef struct
@@ -92,8 +117,8 @@ struct LogWithDetails
   const char *sourceFile;
   const char *logMessage;
   uint32_t logId;
-  String filenameCurrent;
-  String filenameNew;
+  const char *filenameCurrent;
+  const char *filenameNew;
   bool logRetry;
   int retryAttempt;
 };
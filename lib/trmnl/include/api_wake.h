@@ -0,0 +1,24 @@
+#pragma once
+
+#include "api_types.h"
+
+/**
+ * The string handling of every online wake, from the stored API URL to the
+ * filename of the new image. Everything is built in FixedStrings, so a wake
+ * makes no heap allocations for it.
+ */
+
+#define API_DISPLAY_URL_SIZE (API_BASE_URL_SIZE + 16)
+
+/** Host name in a base URL like "https://host:port/", for the DNS lookup */
+void apiHostname(const char *baseUrl, FixedString<API_BASE_URL_SIZE> &hostname);
+
+/** URL of the /api/display endpoint of a base URL */
+void apiDisplayUrl(const char *baseUrl, FixedString<API_DISPLAY_URL_SIZE> &url);
+
+/**
+ * Copy the filename of the image the response points at into filename;
+ * false (and filename unchanged) when the response is the empty_state
+ * screen of a device without a playlist.
+ */
+bool apiResponseFilename(const ApiDisplayResponse &response, FixedString<API_DISPLAY_FILENAME_SIZE> &filename);
@@ -1,3 +1,6 @@
+#pragma once
+
+#include <cstddef>
 #include <cstdint>
 
 enum bmp_err_e
@@ -9,4 +12,26 @@ enum bmp_err_e
   BMP_INVALID_OFFSET,
 };
 
+/** Layout of an uncompressed 1 or 2 bpp BMP, as read from its header */
+struct BmpInfo
+{
+  int width, height; // height is positive for both row orders
+  uint8_t bpp;       // 1 or 2
+  bool bottomUp;     // the usual row order; a negative height in the header means top-down
+  bool reversed;     // palette goes from white to black instead of black to white
+  uint32_t offset;   // of the pixel data
+  uint32_t pitch;    // bytes per row, padded to 4
+};
+
+/**
+ * Check the header of a BMP file of size bytes and fill info. The palette
+ * must be gray levels from black to white or white to black, so the pixel
+ * bits can go to the EPD as they are (or inverted).
+ */
+bmp_err_e parseBMPInfo(const uint8_t *data, size_t size, BmpInfo &info);
+
+/** Row y of the image counted from the top, whatever the row order of the file */
+const uint8_t *bmpRow(const uint8_t *data, const BmpInfo &info, int y);
+
+/** parseBMPHeader() for a buffer that holds the whole file */
 bmp_err_e parseBMPHeader(uint8_t *data, bool &reserved);
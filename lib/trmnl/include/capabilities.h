@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CAPABILITIES_HEADER "Capabilities"
+#define CAPABILITIES_VERSION 1
+#define CAPABILITIES_SIZE 192 // room for the header value with every flag set
+
+enum CapabilityFlags : uint16_t
+{
+  // image formats the decoders take
+  CAP_PNG = 1 << 0,
+  CAP_JPEG = 1 << 1,
+  CAP_BMP = 1 << 2,
+  CAP_G5 = 1 << 3,
+  CAP_RLE = 1 << 9,        // TRLE, see frame_rle.h
+  CAP_G5_PLANES = 1 << 10, // 4-gray G5, see g5_planes.h
+  // what else the firmware can do with a response
+  CAP_PARTIAL = 1 << 4,      // partial refresh
+  CAP_FRAME_DELTA = 1 << 5,  // delta_url
+  CAP_DISPLAY_LIST = 1 << 6, // display_list
+  CAP_BUNDLE = 1 << 7,       // bundle_url
+  CAP_OVERLAY = 1 << 8,      // overlay
+};
+
+enum CapabilityCache : uint8_t
+{
+  CAP_CACHE_CURRENT = 1 << 0,
+  CAP_CACHE_LAST = 1 << 1,
+};
+
+/** What the device can decode and show, sent with /api/display */
+struct DeviceCapabilities
+{
+  uint16_t flags;         // CapabilityFlags
+  uint8_t planes;         // bits per pixel the panel shows: 1 = black and white, 2 = 4 grays
+  uint8_t cache;          // CapabilityCache: images kept on flash
+  uint8_t history;        // older frames kept for a local rewind
+  uint32_t maxImageBytes; // largest image the firmware accepts
+  uint32_t freeHeap;
+  uint32_t maxAlloc;      // largest block that can be allocated right now
+  uint32_t bundleBytes;   // room for the frames of a bundle, with CAP_BUNDLE
+};
+
+/** Largest image that can be downloaded now: the firmware limit or the largest free block */
+uint32_t capabilityImageBytes(const DeviceCapabilities &caps);
+
+/**
+ * Write the value of the Capabilities header, e.g.
+ *
+ *   v=1;fmt=png,jpeg,bmp,g5,rle,g5gray;bytes=90000;heap=151000;alloc=110580;planes=2;feat=partial,delta,list,bundle,overlay;cache=current,last;history=4;bundle_bytes=120000
+ *
+ * Items are separated by ';', lists by ','. Empty lists are left out and
+ * unknown keys are to be ignored, so new ones can be added. Returns the
+ * length, or 0 if it doesn't fit in size.
+ */
+size_t capabilitiesHeader(const DeviceCapabilities &caps, char *out, size_t size);
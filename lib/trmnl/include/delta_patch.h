@@ -0,0 +1,78 @@
+#pragma once
+
+#include "ota_stream.h"
+
+#define DELTA_PATCH_MAGIC "TRD1"
+#define DELTA_PATCH_HEADER_SIZE 20
+
+/**
+ * Streaming applier for bsdiff-style firmware patches against the running image.
+ *
+ * Patch layout (integers little-endian, varints LEB128):
+ *
+ *   "TRD1" | old_size u32 | old_crc32 u32 | new_size u32 | new_crc32 u32
+ *   records until new_size bytes were produced:
+ *     varint diff_len  | diff_len bytes, added (mod 256) to old[old_pos..]
+ *     varint extra_len | extra_len bytes, copied as-is
+ *     zigzag varint seek, added to old_pos
+ *
+ * The base image is checked against old_size/old_crc32 before anything is
+ * written and the result against new_crc32 in finish(). Old bytes are read
+ * from the source in small blocks, so memory use does not depend on the
+ * image size.
+ */
+class DeltaPatch : public OtaSink
+{
+public:
+  DeltaPatch(OtaSource &oldImage, OtaSink &output);
+
+  void reset();
+  bool write(const uint8_t *data, size_t length) override;
+
+  /** True when the patch was complete and the output matches new_crc32 */
+  bool finish();
+
+  const char *error() const { return errorMessage; }
+  uint32_t bytesOut() const { return produced; }
+  uint32_t newSize() const { return newImageSize; }
+
+private:
+  enum State : uint8_t
+  {
+    HEADER,
+    DIFF_LENGTH,
+    DIFF_DATA,
+    EXTRA_LENGTH,
+    EXTRA_DATA,
+    SEEK,
+    DONE
+  };
+
+  bool fail(const char *message);
+  bool parseHeader();
+  bool readVarint(uint8_t byte);
+  bool applyDiff(const uint8_t *data, size_t length);
+  bool emit(const uint8_t *data, size_t length);
+  void nextRecordOrDone();
+
+  OtaSource &oldImage;
+  OtaSink &output;
+
+  State state;
+  uint8_t header[DELTA_PATCH_HEADER_SIZE];
+  uint8_t headerLength;
+
+  uint32_t oldImageSize;
+  uint32_t newImageSize;
+  uint32_t expectedCrc;
+  uint32_t crc;
+
+  uint64_t varint;
+  uint8_t varintShift;
+  uint32_t remaining;
+  uint32_t oldPos;
+  uint32_t produced;
+
+  const char *errorMessage;
+  uint8_t oldBlock[256];
+};
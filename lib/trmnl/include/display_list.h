@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DISPLAY_LIST_MAGIC "TRDL"
+#define DISPLAY_LIST_VERSION 1
+#define DISPLAY_LIST_HEADER_SIZE 12
+#define DISPLAY_LIST_CENTER 0x7FFF // text x: centered horizontally
+#define DISPLAY_LIST_SPRITE_HEADER_SIZE 8 // BB_BITMAP header in front of the G5 data
+#define DISPLAY_LIST_SPRITE_MARKER 0xBBBF // BB_BITMAP_MARKER
+
+enum DisplayListOp : uint8_t
+{
+  DL_OP_CLEAR = 1,      // color
+  DL_OP_TEXT = 2,       // font u8 | fg u8 | bg u8 | x i16 | y i16 | string u8
+  DL_OP_RECT = 3,       // x i16 | y i16 | w i16 | h i16 | color u8 | filled u8
+  DL_OP_ROUND_RECT = 4, // x i16 | y i16 | w i16 | h i16 | r i16 | color u8 | filled u8
+  DL_OP_ELLIPSE = 5,    // cx i16 | cy i16 | rx i16 | ry i16 | color u8 | filled u8
+  DL_OP_LINE = 6,       // x1 i16 | y1 i16 | x2 i16 | y2 i16 | color u8
+  DL_OP_SPRITE = 7,     // sprite u8 | x i16 | y i16 | scale u8 (1..4)
+};
+
+enum DisplayListColor : uint8_t
+{
+  DL_BLACK = 0,
+  DL_WHITE = 1,
+  DL_TRANSPARENT = 2, // text background only
+};
+
+/** The fonts built into the firmware, by id */
+enum DisplayListFont : uint8_t
+{
+  DL_FONT_SMALL = 0,  // nicoclean_8
+  DL_FONT_MEDIUM = 1, // Inter_18
+  DL_FONT_LARGE = 2,  // Roboto_Black_24
+  DL_FONT_COUNT
+};
+
+/** What a display list is drawn onto (bb_epaper on the device) */
+class DisplayListCanvas
+{
+public:
+  virtual ~DisplayListCanvas() {}
+
+  virtual void clear(DisplayListColor color) = 0;
+  /** y is the baseline; x == DISPLAY_LIST_CENTER centers the text */
+  virtual void text(DisplayListFont font, int x, int y, const char *text, DisplayListColor fg, DisplayListColor bg) = 0;
+  /** r == 0 for square corners */
+  virtual void rect(int x, int y, int w, int h, int r, DisplayListColor color, bool filled) = 0;
+  virtual void ellipse(int cx, int cy, int rx, int ry, DisplayListColor color, bool filled) = 0;
+  virtual void line(int x1, int y1, int x2, int y2, DisplayListColor color) = 0;
+  /** data is a Group5 image with its BB_BITMAP header */
+  virtual void sprite(const uint8_t *data, size_t size, int x, int y, int scale) = 0;
+};
+
+/**
+ * Check a display list from /api/display before anything is drawn: the
+ * header, every table entry and every op have to be complete and in range
+ * and the list has to be made for a width x height screen.
+ *
+ * Format (integers little-endian):
+ *
+ *   "TRDL" | version u8 | string_count u8 | sprite_count u8 | reserved u8 | width u16 | height u16
+ *   string_count times: length u8 | bytes (UTF-8, no terminator)
+ *   sprite_count times: size u16 | Group5 image
+ *     (BB_BITMAP header: marker u16 | width u16 | height u16 | data size u16, then the G5 data;
+ *      the data has to fit the entry and the width the screen)
+ *   ops up to the end of the data, each an opcode byte and its operands (see DisplayListOp)
+ *
+ * Returns nullptr if the list can be drawn, otherwise what is wrong with it.
+ */
+const char *displayListCheck(const uint8_t *data, size_t size, int width, int height);
+
+/** Draw a list that passed displayListCheck() */
+void displayListDraw(const uint8_t *data, size_t size, DisplayListCanvas &canvas);
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Fixed-capacity, null-terminated string with a String-like API.
+ *
+ * The characters live inline (N bytes including the terminator, like a char
+ * array), so a FixedString never touches the heap and can be copied with the
+ * struct that holds it. Operations that would not fit keep as much as fits
+ * and return false.
+ */
+template <size_t N>
+class FixedString
+{
+public:
+  FixedString() { buffer[0] = '\0'; }
+  FixedString(const char *value) { assign(value); }
+  FixedString(const String &value) { assign(value.c_str()); }
+
+  template <size_t M>
+  FixedString(const FixedString<M> &value) { assign(value.c_str()); }
+
+  FixedString &operator=(const char *value)
+  {
+    assign(value);
+    return *this;
+  }
+
+  FixedString &operator=(const String &value)
+  {
+    assign(value.c_str());
+    return *this;
+  }
+
+  template <size_t M>
+  FixedString &operator=(const FixedString<M> &value)
+  {
+    assign(value.c_str());
+    return *this;
+  }
+
+  /** Maximum number of characters (without the terminator) */
+  static constexpr size_t capacity() { return N - 1; }
+
+  const char *c_str() const { return buffer; }
+  char *data() { return buffer; }
+  size_t length() const { return strlen(buffer); }
+  bool isEmpty() const { return buffer[0] == '\0'; }
+  void clear() { buffer[0] = '\0'; }
+
+  char operator[](size_t index) const { return index < N ? buffer[index] : '\0'; }
+
+  bool assign(const char *value)
+  {
+    buffer[0] = '\0';
+    return concat(value);
+  }
+
+  bool assign(const char *value, size_t count)
+  {
+    buffer[0] = '\0';
+    return concat(value, count);
+  }
+
+  bool concat(const char *value)
+  {
+    return value ? concat(value, strlen(value)) : true;
+  }
+
+  bool concat(const char *value, size_t count)
+  {
+    size_t len = length();
+    bool fits = len + count <= capacity();
+    if (!fits)
+      count = capacity() - len;
+    memcpy(buffer + len, value, count);
+    buffer[len + count] = '\0';
+    return fits;
+  }
+
+  bool concat(char c) { return concat(&c, 1); }
+  bool concat(const String &value) { return concat(value.c_str(), value.length()); }
+
+  bool concat(long value)
+  {
+    char digits[24];
+    return concat(digits, snprintf(digits, sizeof(digits), "%ld", value));
+  }
+
+  bool concat(unsigned long value)
+  {
+    char digits[24];
+    return concat(digits, snprintf(digits, sizeof(digits), "%lu", value));
+  }
+
+  bool concat(int value) { return concat((long)value); }
+  bool concat(unsigned int value) { return concat((unsigned long)value); }
+
+  template <typename T>
+  FixedString &operator+=(const T &value)
+  {
+    concat(value);
+    return *this;
+  }
+
+  FixedString &operator+=(const char *value)
+  {
+    concat(value);
+    return *this;
+  }
+
+  bool equals(const char *value) const { return strcmp(buffer, value ? value : "") == 0; }
+  bool operator==(const char *value) const { return equals(value); }
+  bool operator!=(const char *value) const { return !equals(value); }
+  bool operator==(const String &value) const { return equals(value.c_str()); }
+  bool operator!=(const String &value) const { return !equals(value.c_str()); }
+
+  template <size_t M>
+  bool operator==(const FixedString<M> &other) const { return equals(other.c_str()); }
+  template <size_t M>
+  bool operator!=(const FixedString<M> &other) const { return !equals(other.c_str()); }
+
+  bool startsWith(const char *prefix) const { return strncmp(buffer, prefix, strlen(prefix)) == 0; }
+
+  bool endsWith(const char *suffix) const
+  {
+    size_t len = length();
+    size_t suffixLen = strlen(suffix);
+    return suffixLen <= len && strcmp(buffer + len - suffixLen, suffix) == 0;
+  }
+
+  int indexOf(char c, size_t from = 0) const
+  {
+    if (from >= length())
+      return -1;
+    const char *found = strchr(buffer + from, c);
+    return found ? (int)(found - buffer) : -1;
+  }
+
+  int indexOf(const char *value, size_t from = 0) const
+  {
+    if (from > length())
+      return -1;
+    const char *found = strstr(buffer + from, value);
+    return found ? (int)(found - buffer) : -1;
+  }
+
+  /** Cut the string at index (like String::remove(index)) */
+  void remove(size_t index)
+  {
+    if (index < N)
+      buffer[index] = '\0';
+  }
+
+  /** Remove count characters starting at index */
+  void remove(size_t index, size_t count)
+  {
+    size_t len = length();
+    if (index >= len)
+      return;
+    if (count > len - index)
+      count = len - index;
+    memmove(buffer + index, buffer + index + count, len - index - count + 1);
+  }
+
+  /** Replace every occurrence of find, in place; returns false if the result had to be cut short */
+  bool replace(const char *find, const char *with)
+  {
+    size_t findLen = strlen(find);
+    if (findLen == 0)
+      return true;
+
+    size_t withLen = strlen(with);
+    bool fits = true;
+    int index = indexOf(find);
+    while (index >= 0)
+    {
+      size_t len = length();
+      size_t tail = len - index - findLen;
+      if (len - findLen + withLen > capacity())
+      {
+        fits = false;
+        break;
+      }
+      memmove(buffer + index + withLen, buffer + index + findLen, tail + 1);
+      memcpy(buffer + index, with, withLen);
+      index = indexOf(find, index + withLen);
+    }
+    return fits;
+  }
+
+private:
+  char buffer[N];
+};
+
+template <size_t N>
+bool operator==(const char *a, const FixedString<N> &b) { return b.equals(a); }
+template <size_t N>
+bool operator!=(const char *a, const FixedString<N> &b) { return !b.equals(a); }
+template <size_t N>
+bool operator==(const String &a, const FixedString<N> &b) { return b.equals(a.c_str()); }
+template <size_t N>
+bool operator!=(const String &a, const FixedString<N> &b) { return !b.equals(a.c_str()); }
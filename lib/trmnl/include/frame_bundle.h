@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ota_stream.h"
+
+#define BUNDLE_MAGIC "TRB1"
+#define BUNDLE_HEADER_SIZE 8
+#define BUNDLE_FRAME_HEADER_SIZE 9
+#define BUNDLE_MAX_FRAMES 8
+#define BUNDLE_NAME_SIZE 64
+#define BUNDLE_INDEX_FILE "/bundle.idx"
+#define BUNDLE_INDEX_MAGIC 0x42444e31 // "BDN1"
+
+/** Minimal file access the frame store needs (SPIFFS on the device) */
+class FrameStorage
+{
+public:
+  virtual ~FrameStorage() {}
+
+  /** Create (or truncate) a file and make it the target of append() */
+  virtual bool create(const char *name) = 0;
+  virtual bool append(const uint8_t *data, size_t length) = 0;
+  virtual void close() = 0;
+
+  /** Read up to size bytes from the start of a file; returns the number read */
+  virtual size_t read(const char *name, uint8_t *buffer, size_t size) = 0;
+  virtual bool remove(const char *name) = 0;
+};
+
+struct BundleFrame
+{
+  uint32_t size;
+  uint32_t duration; // seconds to show this frame (the sleep time after it)
+  char name[BUNDLE_NAME_SIZE];
+};
+
+/** Stored next to the frames; describes a complete bundle */
+struct BundleIndex
+{
+  uint32_t magic;
+  uint8_t count;
+  BundleFrame frames[BUNDLE_MAX_FRAMES];
+};
+
+/** File name of frame i in the store */
+void bundleFrameFile(uint8_t index, char *name, size_t size);
+
+/**
+ * Streaming writer for a frame bundle: the frames of the container go to
+ * their own files as they arrive, the index is only written once all of
+ * them are complete.
+ *
+ * Container (integers little-endian):
+ *
+ *   "TRB1" | count u8 | 3 reserved bytes
+ *   count times: size u32 | duration u32 | name_length u8 | name | size bytes of PNG/JPEG/BMP
+ */
+class BundleWriter : public OtaSink
+{
+public:
+  BundleWriter(FrameStorage &storage, uint32_t maxFrameSize);
+
+  bool write(const uint8_t *data, size_t length) override;
+
+  /** Write the index; on any error the partial frames are removed and false is returned */
+  bool finish();
+
+  const char *error() const { return errorMessage; }
+  const BundleIndex &index() const { return bundle; }
+
+private:
+  enum State : uint8_t
+  {
+    HEADER,
+    FRAME_HEADER,
+    FRAME_NAME,
+    FRAME_DATA,
+    DONE
+  };
+
+  bool fail(const char *message);
+  bool beginFrame();
+  void removeFrames();
+
+  FrameStorage &storage;
+  uint32_t maxFrameSize;
+  State state;
+  uint8_t header[BUNDLE_FRAME_HEADER_SIZE];
+  uint8_t headerLength; // bytes of the current header or name received
+  uint8_t nameLength;
+  uint32_t remaining;
+  uint8_t frame;
+  bool fileOpen;
+  const char *errorMessage;
+  BundleIndex bundle;
+};
+
+/** Read the index of the stored bundle; false if there is none */
+bool loadBundleIndex(FrameStorage &storage, BundleIndex &index);
+
+/**
+ * Position in the stored bundle, kept in RTC memory. The playlist runs out
+ * after the last frame or once validUntil has passed, whichever is first.
+ */
+struct PlaylistCursor
+{
+  uint32_t magic;
+  uint8_t next;
+  uint8_t count;
+  uint32_t validUntil; // 0 = no time limit (e.g. the clock was not synced)
+};
+
+void playlistStart(PlaylistCursor &cursor, uint8_t count, uint32_t now, uint32_t validFor);
+void playlistStop(PlaylistCursor &cursor);
+
+/** Index of the frame to show now and advance, or -1 when it is time to go online */
+int playlistNextFrame(PlaylistCursor &cursor, uint32_t now);
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ota_stream.h"
+
+#define DELTA_MAGIC "TRFD"
+#define DELTA_VERSION 1
+#define DELTA_HEADER_SIZE 20
+#define DELTA_TILE_HEADER_SIZE 16
+#define DELTA_MAX_TILES 8
+#define FRAME_BMP_HEADER_SIZE 62
+
+enum DeltaTileEncoding : uint8_t
+{
+  DELTA_TILE_G5,  // bb_epaper Group5 image of exactly w x h
+  DELTA_TILE_PNG, // 1-bit (or 2-bit with 2 colors) PNG of exactly w x h
+};
+
+struct DeltaTile
+{
+  uint16_t x, y, w, h; // x and w are multiples of 8
+  uint8_t encoding;    // DeltaTileEncoding
+  uint32_t size;
+  const uint8_t *data; // points into the parsed delta
+};
+
+/**
+ * Tiles that turn the frame on screen (the base) into the next one.
+ *
+ * Container (integers little-endian):
+ *
+ *   "TRFD" | version u8 | count u8 | 2 reserved bytes | width u16 | height u16 | base_crc u32 | result_crc u32
+ *   count times: x u16 | y u16 | w u16 | h u16 | size u32 | encoding u8 | 3 reserved bytes | size bytes of G5/PNG
+ *
+ * base_crc and result_crc are frameCrc() of the whole 1-bit frame before
+ * and after the tiles are applied, so a delta is only used on the frame it
+ * was made for and a damaged one is never shown.
+ */
+struct FrameDelta
+{
+  uint16_t width, height;
+  uint32_t baseCrc, resultCrc;
+  uint8_t count;
+  DeltaTile tiles[DELTA_MAX_TILES];
+};
+
+/** Check a delta for a width x height screen and fill delta; returns nullptr or what is wrong with it */
+const char *frameDeltaParse(const uint8_t *data, size_t size, int width, int height, FrameDelta &delta);
+
+/** Number of pixels the tiles cover */
+uint32_t frameDeltaArea(const FrameDelta &delta);
+
+/**
+ * CRC32 of a 1-bpp frame as it is sent to the EPD (1 = white): rows from
+ * top to bottom, width / 8 bytes each. frame points to the top row and
+ * pitch is the distance to the next one, negative for bottom-up BMP data.
+ */
+uint32_t frameCrc(const uint8_t *frame, int pitch, int width, int height);
+
+/** Copy the box of a tile out of a 1-bpp frame (same frame/pitch as frameCrc); box holds w / 8 * h bytes */
+void frameGetBox(const uint8_t *frame, int pitch, const DeltaTile &tile, uint8_t *box);
+
+/** Copy a box of w / 8 * h bytes into the tile position of a 1-bpp frame */
+void framePutBox(uint8_t *frame, int pitch, const DeltaTile &tile, const uint8_t *box);
+
+/** Header of a 1-bpp bottom-up BMP (palette black, white), the format frames are stored in */
+void frameBmpHeader(uint8_t *header, int width, int height);
+
+/** Collects a delta in memory while it is downloaded */
+class FrameDeltaBuffer : public OtaSink
+{
+public:
+  explicit FrameDeltaBuffer(size_t maxSize);
+  ~FrameDeltaBuffer();
+
+  bool write(const uint8_t *data, size_t length) override;
+
+  const uint8_t *data() const { return buffer; }
+  size_t size() const { return length; }
+  bool tooBig() const { return overflow; }
+
+private:
+  FrameDeltaBuffer(const FrameDeltaBuffer &);
+  FrameDeltaBuffer &operator=(const FrameDeltaBuffer &);
+
+  uint8_t *buffer;
+  size_t length;
+  size_t capacity;
+  size_t maxSize;
+  bool overflow;
+};
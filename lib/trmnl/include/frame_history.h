@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HISTORY_SLOTS 4 // frames kept before the last image
+#define HISTORY_INDEX_FILE "/history.idx"
+#define HISTORY_INDEX_MAGIC 0x31545348 // "HST1"
+
+/**
+ * Ring of the frames that were on screen before the last image. When a new
+ * image comes in, the last one is renamed into the slot of the oldest frame,
+ * so keeping them costs no copy. The index is stored next to the slots.
+ */
+struct HistoryIndex
+{
+  uint32_t magic;
+  uint8_t count; // slots in use
+  uint8_t next;  // slot the next frame goes to
+  uint8_t reserved[2];
+};
+
+/** File name of history slot i */
+void historyFrameFile(uint8_t slot, char *name, size_t size);
+
+/** Empty the index, e.g. when the stored one is missing or damaged */
+void historyClear(HistoryIndex &index);
+
+bool historyIndexValid(const HistoryIndex &index);
+
+/** Slot a frame that leaves the last image goes to; the frame that was in it is dropped */
+uint8_t historyPush(HistoryIndex &index);
+
+/**
+ * Slot of the frame back steps before the last image (1 = the newest slot),
+ * -1 if it isn't kept
+ */
+int historySlot(const HistoryIndex &index, uint8_t back);
+
+/**
+ * Position of a rewind, kept in RTC memory: how many frames before the
+ * current image is on screen. 0 once a new image is shown.
+ */
+struct HistoryCursor
+{
+  uint32_t magic;
+  uint8_t back;
+};
+
+void historyReset(HistoryCursor &cursor);
+
+bool historyRewound(const HistoryCursor &cursor);
+
+/**
+ * Step one frame further back and return how many frames before the
+ * current image that is (1 = the last image, 2 = the newest slot and so
+ * on), or -1 when all available frames have been shown.
+ */
+int historyRewind(HistoryCursor &cursor, uint8_t available);
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Run-length frames for 1- and 2-bit panels ("TRLE").
+ *
+ * The pixels are stored in EPD plane layout: every row of plane 0 (bit 0 of
+ * the pixel value), then every row of plane 1 for 4-gray images. A row is
+ * (width + 7) / 8 bytes and is coded as byte aligned ops, each starting with
+ * a byte of 2 bits type and 6 bits length:
+ *
+ *   00 LLLLLL  literal: the bytes follow
+ *   01 LLLLLL  run: the next byte, repeated
+ *   10 LLLLLL  copy: the same bytes as the row above
+ *   11 000000  the whole row is the row above
+ *
+ * A length of 0..62 means 1..63 bytes; 63 means 64 plus the next byte. The
+ * ops of a row add up to exactly one row. The first row of a plane has no
+ * row above it and can't use copies.
+ *
+ * Every op is a memcpy(), a memset() or nothing at all, so rows decode about
+ * as fast as they can be copied. The header is C so the encoder can be used
+ * by the server side tools (lib/bb_epaper/imageconvert).
+ */
+
+#define FRAME_RLE_MAGIC "TRLE"
+#define FRAME_RLE_VERSION 1
+#define FRAME_RLE_PALETTE 0xe4 // pixel value i is gray level i
+#define FRAME_RLE_LITERAL 0x00
+#define FRAME_RLE_RUN 0x40
+#define FRAME_RLE_COPY 0x80
+#define FRAME_RLE_SAME_ROW 0xc0
+#define FRAME_RLE_MAX_OP 319
+// worst case size of one coded row
+#define FRAME_RLE_ROW_BOUND(pitch) ((pitch) + ((pitch) / 64 + 1) * 2)
+
+typedef struct FrameRleHeader
+{
+  char magic[4]; // FRAME_RLE_MAGIC
+  uint8_t version;
+  uint8_t planes; // 1 = black and white, 2 = 4 grays
+  /*
+   * Gray level (0 = black, 3 = white) of each pixel value, 2 bits per value
+   * starting with value 0. The pixels of a 1-bit image are values 0 and 3.
+   * The decoder takes the palettes that invert whole planes, the others
+   * would need a lookup per pixel.
+   */
+  uint8_t palette;
+  uint8_t reserved;
+  uint16_t width;
+  uint16_t height;
+} FrameRleHeader;
+
+#ifdef __cplusplus
+static_assert(sizeof(FrameRleHeader) == 12, "the header is 12 bytes on every platform");
+
+/** Reads a TRLE image row by row, one plane after the other */
+struct FrameRleDecoder
+{
+  FrameRleHeader header;
+  const uint8_t *data;
+  const uint8_t *end;
+  uint8_t *row; // the row being decoded, it keeps the row above between calls
+  int pitch;
+  int plane; // plane of the next row
+  int y;     // row of the next row within the plane
+};
+
+/** true if data starts like a TRLE image */
+bool frameRleMatch(const uint8_t *data, size_t size);
+
+/**
+ * Check the header and get ready to decode into row, which must hold
+ * (width + 7) / 8 bytes and must not be changed between the rows of a plane.
+ * Returns false for a damaged header or a palette that can't be decoded.
+ */
+bool frameRleBegin(FrameRleDecoder &decoder, const uint8_t *data, size_t size, uint8_t *row);
+
+/**
+ * Decode the next row, which is bit plane decoder.plane of row decoder.y,
+ * into the row buffer and return it; nullptr after the last row or when the
+ * data is damaged.
+ */
+const uint8_t *frameRleRow(FrameRleDecoder &decoder);
+
+/**
+ * What to XOR the rows of a plane with so a set bit is the bit of a lighter
+ * gray: for a 1-bit image, 1 = white.
+ */
+uint8_t frameRleInvert(const FrameRleHeader &header, int plane);
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Two G5 bitstreams in one file, for 4-gray frames.
+ *
+ * Each stream is a 1-bit G5 image (lib/bb_epaper/src/Group5.h) of the whole
+ * frame that already holds what the panel wants in one of its planes, so
+ * the device decodes them a row at a time straight into PLANE_0 and
+ * PLANE_1. The G5 data of plane 0 follows the header, then that of plane 1.
+ * The header is C so the tools (lib/bb_epaper/imageconvert) can write it.
+ */
+
+// next to BB_BITMAP_MARKER (0xBBBF), which is a single G5 image
+#define G5_PLANES_MARKER 0xBBC2
+
+/** What the planes are made for */
+enum
+{
+  // the 4-gray mode of the panel: plane 0 holds bit 0 of each gray level
+  // (0 = black, 3 = white) and plane 1 bit 1, both inverted
+  G5_PLANES_GRAY4 = 1,
+};
+
+typedef struct G5PlanesHeader
+{
+  uint16_t u16Marker; // G5_PLANES_MARKER
+  uint16_t width;
+  uint16_t height;
+  uint8_t mode;      // G5_PLANES_GRAY4
+  uint8_t reserved;
+  uint32_t size[2];  // bytes of G5 data of plane 0 and plane 1
+} G5PlanesHeader;
+
+#ifdef __cplusplus
+static_assert(sizeof(G5PlanesHeader) == 16, "the header is 16 bytes on every platform");
+
+/** true if data starts with G5_PLANES_MARKER */
+bool g5PlanesMatch(const uint8_t *data, size_t size);
+
+/**
+ * Check the header and find the G5 data of both planes. Returns false if
+ * the file is damaged or its mode isn't known.
+ */
+bool g5PlanesParse(const uint8_t *data, size_t size, G5PlanesHeader &header, const uint8_t *planes[2]);
+#endif
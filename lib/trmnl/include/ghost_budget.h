@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define GHOST_MAGIC 0x47485354 // "GHST"
+#define GHOST_COLS 10
+#define GHOST_ROWS 6
+#define GHOST_TILES (GHOST_COLS * GHOST_ROWS)
+
+// Wear is counted in the same units for every tile; a partial update that
+// changes a tile costs GHOST_PARTIAL_COST plus up to GHOST_DRIFT_COST for
+// the share of its pixels that went from white to black or back.
+#define GHOST_PARTIAL_COST 6
+#define GHOST_DRIFT_COST 12
+#define GHOST_UNKNOWN_COST 12          // change of a tile whose pixels were not scanned
+#define GHOST_IDLE_SECONDS (30 * 60)   // changes after the screen stayed this long cost twice as much
+#define GHOST_TILE_BUDGET 96           // about 8 partial updates of unknown images, like the old 1-in-8 rule
+#define GHOST_FAST_WEAR 24             // what a fast refresh leaves behind
+#define GHOST_FASTS_PER_FULL 4         // every 4th cleaning of the whole screen is a full refresh
+#define GHOST_CLEANUP_SHARE 4          // a windowed cleanup covers at most 1/4 of the screen
+
+enum GhostAction : uint8_t
+{
+  GHOST_PARTIAL, // every tile is within its budget
+  GHOST_CLEANUP, // partial update, then a windowed refresh that drives every pixel of the worn tiles
+  GHOST_FAST,
+  GHOST_FULL,
+};
+
+/** Tile checksums and ink of the 1-bit image that is about to be shown */
+struct GhostFrame
+{
+  uint16_t width, height;
+  uint16_t tileW, tileH; // tileW is a multiple of 8
+  uint16_t rows;         // rows scanned so far
+  uint32_t hash[GHOST_TILES];
+  uint16_t ink[GHOST_TILES]; // black pixels
+};
+
+struct GhostTile
+{
+  uint16_t hash; // of the pixels on screen, 0 = not known
+  uint16_t ink;
+  uint8_t wear;
+};
+
+/**
+ * How worn each tile of the screen is, kept in RTC memory. Partial updates
+ * add wear to the tiles they change; a tile over GHOST_TILE_BUDGET is
+ * cleaned with a windowed refresh when the worn tiles are a small part of
+ * the screen, otherwise the whole screen gets a fast (or full) refresh.
+ *
+ * Only tile checksums and black pixel counts are kept, so the drift of a
+ * tile is estimated from how much its ink changed.
+ */
+struct GhostBudget
+{
+  uint32_t magic;
+  uint16_t width, height;
+  uint32_t refreshedAt; // UTC seconds of the last refresh, 0 = not known
+  uint8_t fasts;        // fast refreshes since the last full one
+  GhostTile tiles[GHOST_TILES];
+};
+
+struct GhostDecision
+{
+  GhostAction action;
+  uint8_t changed;     // tiles this update changes
+  uint8_t over;        // tiles that would be over budget after a partial update
+  uint16_t maxWear;    // highest wear after a partial update
+  uint16_t x, y, w, h; // box of the worn tiles for GHOST_CLEANUP; x and w are multiples of 8
+  const char *reason;
+};
+
+/** Start scanning a width x height image */
+void ghostScanBegin(GhostFrame &frame, int width, int height);
+
+/** Add row y of the image, 1 bit per pixel with 1 = white; rows must come from top to bottom */
+void ghostScanRow(GhostFrame &frame, int y, const uint8_t *row);
+
+/** true once every row was scanned */
+bool ghostScanComplete(const GhostFrame &frame);
+
+/**
+ * Decide how to refresh a width x height screen for the next image.
+ * frame is nullptr (or incomplete) if the image could not be scanned;
+ * then every tile counts as changed. canClean tells whether the caller
+ * can crop the worn tiles out of the image for a windowed cleanup.
+ */
+GhostDecision ghostDecide(const GhostBudget &budget, const GhostFrame *frame, int width, int height, uint32_t now, bool canClean);
+
+/** Record the refresh that was done for decision (its action may have been overridden) */
+void ghostApply(GhostBudget &budget, const GhostFrame *frame, const GhostDecision &decision, int width, int height, uint32_t now);
+
+/** Record a full or fast refresh of an image that was not scanned, e.g. a message screen */
+void ghostRefreshed(GhostBudget &budget, int width, int height, bool full, uint32_t now);
+
+/** Record a windowed partial update of the box x, y, w, h (overlay widgets, frame deltas) */
+void ghostTouch(GhostBudget &budget, int x, int y, int w, int h);
+
+/** Name of an action for the logs */
+const char *ghostActionName(GhostAction action);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ota_stream.h"
+
+// Must match the encoder: heatshrink -e -w 11 -l 4
+#define HEATSHRINK_WINDOW_BITS 11
+#define HEATSHRINK_LOOKAHEAD_BITS 4
+
+/**
+ * Streaming decoder for heatshrink (LZSS) compressed data.
+ *
+ * Input can be pushed in chunks of any size; decoded bytes are passed to the
+ * sink in small batches. Memory use is fixed: the 2^WINDOW_BITS history
+ * window plus a small output buffer.
+ */
+class HeatshrinkDecoder : public OtaSink
+{
+public:
+  explicit HeatshrinkDecoder(OtaSink &output);
+
+  void reset();
+  bool write(const uint8_t *data, size_t length) override;
+
+  /** Flush pending output; returns false if the stream ended in the middle of a token */
+  bool finish();
+
+  uint32_t bytesOut() const { return produced; }
+
+private:
+  enum State : uint8_t
+  {
+    TAG,
+    LITERAL,
+    BACKREF_INDEX,
+    BACKREF_COUNT
+  };
+
+  bool emit(uint8_t c);
+  bool flush();
+
+  OtaSink &output;
+  State state;
+  uint32_t bits;
+  uint8_t bitCount;
+  uint16_t backrefIndex;
+  uint16_t head;
+  uint32_t produced;
+  bool failed;
+
+  uint8_t window[1 << HEATSHRINK_WINDOW_BITS];
+  uint8_t pending[256];
+  uint16_t pendingLength;
+};
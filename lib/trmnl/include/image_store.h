@@ -0,0 +1,137 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define IMAGE_STORE_PARTITION "images"
+#define IMAGE_STORE_SUBTYPE 0x40 // custom data partition subtype
+#define IMAGE_STORE_MAGIC 0x474d4954 // "TIMG"
+#define IMAGE_STORE_NAME_SIZE 32
+#define IMAGE_STORE_ALIGN 16
+#define IMAGE_STORE_INDEX_SIZE 16 // names whose newest record is kept in RAM
+
+/** Flash the image store lives in: memory mapped for reading, NOR semantics for writing */
+class ImageFlash
+{
+public:
+  virtual ~ImageFlash() {}
+
+  /** The whole area, mapped into the address space */
+  virtual const uint8_t *data() const = 0;
+  virtual size_t size() const = 0;
+  /** Erase unit, e.g. 4096 */
+  virtual size_t sectorSize() const = 0;
+
+  /** Set whole sectors to 0xff */
+  virtual bool erase(size_t offset, size_t length) = 0;
+  /** Program erased bytes */
+  virtual bool write(size_t offset, const uint8_t *data, size_t length) = 0;
+};
+
+enum ImageRecordKind : uint8_t
+{
+  IMAGE_RECORD_DATA,    // the image follows the header
+  IMAGE_RECORD_LINK,    // the name now refers to the data of another record (a rename)
+  IMAGE_RECORD_DELETED, // the name no longer exists
+};
+
+/** Header in front of every record, at an IMAGE_STORE_ALIGN boundary */
+struct ImageRecord
+{
+  uint32_t magic;
+  uint32_t seq;       // higher is newer
+  uint32_t size;      // bytes of image data after the header
+  uint32_t crc;       // ota_crc32() of the image data
+  uint32_t target;    // LINK: offset of the data record
+  uint32_t targetSeq; // LINK: its seq, in case it was overwritten since
+  uint8_t kind;       // ImageRecordKind
+  uint8_t reserved[3];
+  char name[IMAGE_STORE_NAME_SIZE];
+  uint32_t headerCrc; // of the fields above
+};
+
+/**
+ * Images kept in a raw flash partition that is memory mapped, so a stored
+ * frame is decoded straight from flash without a heap copy.
+ *
+ * The partition is a log: every write, rename or removal appends a record
+ * at the head and a name means its newest record. When the head reaches
+ * the end it starts over at the beginning and erases the oldest records a
+ * sector at a time, so the store keeps the most recent images and forgets
+ * old ones by itself. A record's data is programmed before its header, so
+ * a write that is cut short leaves the previous version in place.
+ *
+ * mount() reads the log once and keeps the newest record of each name in
+ * a small index, so lookups don't read the partition again. Only with
+ * more names than the index holds is the log searched for the others.
+ */
+class ImageStore
+{
+public:
+  explicit ImageStore(ImageFlash &flash);
+
+  /** Find the head of the log; false if the flash is too small to use */
+  bool mount();
+
+  /** Pointer to the newest version of name in flash, nullptr if there is none or it is damaged */
+  const uint8_t *find(const char *name, size_t &size) const;
+
+  bool exists(const char *name) const;
+
+  bool write(const char *name, const uint8_t *data, size_t size);
+
+  /** Write an image of up to maxSize bytes in pieces; nothing changes until commit() */
+  bool begin(const char *name, size_t maxSize);
+  bool append(const uint8_t *data, size_t length);
+  bool commit();
+  void abort();
+
+  /** Give the image of from the name to (a small record, the image is not copied) */
+  bool rename(const char *from, const char *to);
+
+  bool remove(const char *name);
+
+  /** Largest image that can be stored */
+  size_t capacity() const;
+
+private:
+  struct Found
+  {
+    const ImageRecord *record; // newest record of the name, nullptr if none
+    const ImageRecord *data;   // the data it refers to, nullptr if deleted or overwritten
+    int slot;                  // of the index, -1 if the name isn't in it
+  };
+
+  struct IndexEntry
+  {
+    uint32_t offset;       // of the newest record of a name
+    uint32_t seq;          // the record's, it is gone when they differ
+    mutable bool verified; // the crc of the data has been checked since mount()
+  };
+
+  Found lookup(const char *name) const;
+  int indexOf(const char *name) const;
+  int indexSlot();
+  void remember(size_t offset, bool evict);
+  const ImageRecord *recordAt(size_t offset) const;
+  const ImageRecord *next(size_t &offset) const;
+  bool reserve(size_t length);
+  bool program(size_t offset, const uint8_t *data, size_t length);
+  bool putHeader(size_t offset, ImageRecordKind kind, const char *name, uint32_t size, uint32_t crc, const ImageRecord *target);
+  bool appendRecord(ImageRecordKind kind, const char *name, const ImageRecord *target);
+  void skip(size_t end);
+
+  ImageFlash &flash;
+  bool mounted;
+  size_t head;       // where the next record goes
+  size_t erasedEnd;  // [head, erasedEnd) is erased; a multiple of the sector size
+  uint32_t nextSeq;
+  IndexEntry index[IMAGE_STORE_INDEX_SIZE];
+  int indexUsed;
+  bool indexComplete; // a name that isn't in the index has no records
+  // image being written with begin()/append()
+  bool pending;
+  size_t pendingMax, pendingSize;
+  uint32_t pendingCrc;
+  char pendingName[IMAGE_STORE_NAME_SIZE];
+};
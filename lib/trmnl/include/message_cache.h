@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MESSAGE_CACHE_PREFIX "/msg_"
+#define MESSAGE_CACHE_MAX_FILES 6       // the whole cache is dropped when it would grow past this
+#define MESSAGE_CACHE_MAX_SIZE 16384    // screens that don't compress below this are not cached
+#define MESSAGE_CACHE_HEADER_SIZE 8     // BB_BITMAP header in front of the G5 data
+#define MESSAGE_CACHE_MARKER 0xBBBF     // BB_BITMAP_MARKER
+
+/**
+ * Identifies a rendered message screen: the message type plus everything
+ * that changes its pixels (firmware version, dynamic text, the logo). Texts
+ * are hashed with their terminator so that ("ab", "c") and ("a", "bc") differ.
+ */
+class MessageCacheKey
+{
+public:
+  explicit MessageCacheKey(uint8_t type);
+
+  MessageCacheKey &add(const char *text);
+  MessageCacheKey &add(const uint8_t *data, size_t length);
+
+  uint32_t value() const { return crc; }
+
+  /** SPIFFS file name of the screen, e.g. "/msg_1a2b3c4d.g5" */
+  void fileName(char *name, size_t size) const;
+
+private:
+  uint32_t crc;
+};
+
+/** Fill in the BB_BITMAP header for a screen of G5 data (little-endian, as on the device) */
+void messageCacheHeader(uint8_t *header, uint16_t width, uint16_t height, uint16_t dataSize);
+
+/** True if the file is a complete cached screen of the given size */
+bool messageCacheValid(const uint8_t *data, size_t size, uint16_t width, uint16_t height);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "ota_stream.h"
+#include "heatshrink_decoder.h"
+#include "delta_patch.h"
+
+/** How the firmware at firmware_url is encoded, as advertised by /api/display */
+enum class OtaEncoding : uint8_t
+{
+  RAW,              // plain .bin
+  HEATSHRINK,       // .bin compressed with heatshrink
+  DELTA,            // delta patch against the running firmware
+  DELTA_HEATSHRINK, // delta patch compressed with heatshrink
+};
+
+OtaEncoding parseOtaEncoding(const char *value);
+const char *otaEncodingToString(OtaEncoding encoding);
+
+/** Header value telling the server which encodings this firmware can apply */
+#define OTA_SUPPORTED_ENCODINGS "heatshrink,delta,delta+heatshrink"
+
+/**
+ * Decodes a firmware download of the given encoding into the output sink as
+ * it arrives. Delta patches read their base from oldImage.
+ */
+class OtaDecoder : public OtaSink
+{
+public:
+  OtaDecoder(OtaEncoding encoding, OtaSource &oldImage, OtaSink &output);
+
+  bool write(const uint8_t *data, size_t length) override;
+
+  /** Call after the last byte; false if the image is incomplete or corrupt */
+  bool finish();
+
+  const char *error() const { return errorMessage; }
+  uint32_t bytesIn() const { return consumed; }
+  uint32_t bytesOut() const;
+
+private:
+  OtaEncoding encoding;
+  OtaSink &output;
+  DeltaPatch delta;
+  HeatshrinkDecoder heatshrink;
+  OtaSink *input;
+  uint32_t consumed;
+  const char *errorMessage;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Receives decoded firmware bytes (e.g. the Update writer) */
+class OtaSink
+{
+public:
+  virtual ~OtaSink() {}
+  virtual bool write(const uint8_t *data, size_t length) = 0;
+};
+
+/** Random access to the currently running firmware image, used as the base of delta updates */
+class OtaSource
+{
+public:
+  virtual ~OtaSource() {}
+  virtual bool read(uint32_t offset, uint8_t *data, size_t length) = 0;
+};
+
+/** Standard CRC-32 (as used by zlib); pass 0 to start and the previous result to continue */
+uint32_t ota_crc32(uint32_t crc, const uint8_t *data, size_t length);
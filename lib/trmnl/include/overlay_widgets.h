@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "display_list.h"
+
+#define OVERLAY_MAGIC 0x4f564c31 // "OVL1"
+#define OVERLAY_MAX_WIDGETS 4
+#define OVERLAY_TEXT_SIZE 12
+#define OVERLAY_DEFAULT_INTERVAL 60 // seconds between local updates
+#define OVERLAY_WAKE_SLACK 1        // wake this long after a minute starts, the sleep timer may run fast
+
+enum OverlaySource : uint8_t
+{
+  OVERLAY_TIME,    // "14:05"
+  OVERLAY_TIME12,  // "2:05 PM"
+  OVERLAY_BATTERY, // "87%"
+  OVERLAY_RSSI,    // "-67 dBm", as measured on the last online wake
+  OVERLAY_OFFLINE, // "offline" when the server could not be reached, otherwise empty
+  OVERLAY_SOURCE_COUNT
+};
+
+/** A box of the current image that the device redraws itself */
+struct OverlayWidget
+{
+  uint8_t source; // OverlaySource
+  uint8_t font;   // DisplayListFont
+  uint8_t color;  // DL_BLACK or DL_WHITE text, centered in the box over the image
+  int16_t x, y, w, h;
+  char text[OVERLAY_TEXT_SIZE]; // what the box shows now; empty = the image as the server sent it
+};
+
+/**
+ * Widgets of the current image, kept in RTC memory. Timer wakes before
+ * onlineAt only redraw the widgets whose text changed; after that the
+ * device asks the server for a new image as usual.
+ */
+struct OverlayPlan
+{
+  uint32_t magic;
+  uint8_t count;
+  int16_t utcOffset; // minutes, for the time widgets
+  uint16_t interval; // seconds
+  uint32_t onlineAt;
+  OverlayWidget widgets[OVERLAY_MAX_WIDGETS];
+};
+
+/** What the widgets show on this wake */
+struct OverlayInputs
+{
+  uint32_t now; // UTC seconds
+  float batteryVoltage;
+  int rssi;
+  bool offline;
+};
+
+/**
+ * Parse the overlay field of /api/display into plan (not started yet).
+ *
+ * Items are separated by ';':
+ *
+ *   utc=<minutes>        offset of the local time from UTC (default 0)
+ *   every=<seconds>      time between local updates, 60..86400 (default 60)
+ *   <source>,<x>,<y>,<w>,<h>[,<font>[,<color>]]
+ *
+ * with source one of time, time12, battery, rssi, offline; font a
+ * DisplayListFont (default small) and color 0 = black, 1 = white text.
+ * Every box has to be on a width x height screen.
+ *
+ * Returns nullptr if the spec can be used, otherwise what is wrong with it.
+ */
+const char *overlayParse(const char *spec, int width, int height, OverlayPlan &plan);
+
+/**
+ * Make a parsed plan the active one until now + refreshRate. If the image
+ * did not change and the previous plan had the same boxes, their texts are
+ * kept since they are still on screen.
+ */
+void overlayStart(OverlayPlan &plan, const OverlayPlan &previous, bool newImage, uint32_t now, uint32_t refreshRate);
+void overlayStop(OverlayPlan &plan);
+
+/** True if a timer wake at now should only update the widgets */
+bool overlayDue(const OverlayPlan &plan, uint32_t now);
+
+/** Seconds to sleep until the next widget update, 0 when the next wake has to go online */
+uint32_t overlaySleepTime(const OverlayPlan &plan, uint32_t now);
+
+/** Text of one widget for these inputs */
+void overlayText(const OverlayPlan &plan, const OverlayWidget &widget, const OverlayInputs &inputs, char *text, size_t size);
+
+/** Fill texts for all widgets; returns a bit mask of the widgets whose text changed */
+uint8_t overlayRender(const OverlayPlan &plan, const OverlayInputs &inputs, char texts[][OVERLAY_TEXT_SIZE]);
+
+/** Battery charge estimate for a Li-ion cell, 0..100 */
+int overlayBatteryPercent(float voltage);
@@ -15,6 +15,10 @@ public:
 
   virtual size_t writeUint(const char *key, const uint32_t value) = 0;
 
+  virtual int32_t readInt(const char *key, const int32_t defaultValue) = 0;
+
+  virtual size_t writeInt(const char *key, const int32_t value) = 0;
+
   virtual size_t writeString(const char *key, const char *value) = 0;
 
   virtual uint8_t readUChar(const char *key, const uint8_t defaultValue) = 0;
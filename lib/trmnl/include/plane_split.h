@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+/** Which bit of each 2-bpp pixel goes to the 1-bpp output */
+enum TwoBitPlane : uint8_t
+{
+  TWO_BIT_LOW,  // bit 0 of the pixel (EPD plane 0 of a 4-gray image)
+  TWO_BIT_HIGH, // bit 1 (plane 1)
+  TWO_BIT_ANY,  // 1 unless the pixel is 0, for 2-color images shown as 1-bit
+};
+
+/**
+ * Gather one bit of every 2-bpp pixel of a row into width / 8 bytes of
+ * 1-bpp output, 4 pixels per table lookup. Every source byte is XORed with
+ * invert first, except the first one which is XORed with firstInvert
+ * (png_draw() has always treated the first byte of a row that way).
+ *
+ * A partial last output byte (width not a multiple of 8) is not written.
+ * dst may be src: rows are split in place.
+ */
+void twoBitGather(const uint8_t *src, uint8_t *dst, int width, TwoBitPlane plane, uint8_t invert, uint8_t firstInvert);
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ota_stream.h"
+
+#define DOWNLOAD_CHECKPOINT_MAGIC 0x52444c31 // "RDL1"
+#define DOWNLOAD_ETAG_SIZE 72
+
+/**
+ * Progress of an interrupted download. Plain data so that it can live in
+ * RTC memory (or NVS) between wakes; it only describes bytes that the
+ * target already holds.
+ */
+struct DownloadCheckpoint
+{
+  uint32_t magic;
+  uint32_t keyHash;       // crc32 of the resource key (e.g. firmware URL or image filename)
+  char etag[DOWNLOAD_ETAG_SIZE];
+  uint32_t total;         // full size from Content-Length / Content-Range
+  uint32_t received;      // bytes committed to the target, a multiple of the granularity
+  uint32_t crc;           // crc32 of the committed bytes
+  uint32_t expectedCrc;   // from X-Checksum-CRC32, if the server sent one
+  bool hasExpectedCrc;
+};
+
+void clearDownloadCheckpoint(DownloadCheckpoint &checkpoint);
+
+/** The headers of a (range) response that matter for resuming */
+struct RangeResponse
+{
+  int status;
+  uint32_t start; // first byte of the body within the resource
+  uint32_t total; // size of the whole resource, 0 if unknown
+  const char *etag;
+  bool hasCrc;
+  uint32_t crc;
+};
+
+/** Receives the response of one request: headers first, then the body */
+class RangeHandler : public OtaSink
+{
+public:
+  /** Return false to skip the body */
+  virtual bool onResponse(const RangeResponse &response) = 0;
+};
+
+/** One HTTP GET of the resource, optionally for the range starting at from */
+class RangeTransport
+{
+public:
+  virtual ~RangeTransport() {}
+
+  /**
+   * Sends "Range: bytes=<from>-" (and If-Range when given) if from > 0.
+   * Returns false if the connection failed or broke before the body ended.
+   */
+  virtual bool get(uint32_t from, const char *ifRange, RangeHandler &handler) = 0;
+};
+
+/** Where the downloaded bytes go; must be able to continue at a committed offset */
+class ResumableSink : public OtaSink
+{
+public:
+  /** Prepare to receive the byte at offset next (0 = start over); total is 0 if unknown */
+  virtual bool resumeAt(uint32_t offset, uint32_t total) = 0;
+};
+
+/** Parse "bytes <start>-<end>/<total>"; total is 0 for "*" */
+bool parseContentRange(const char *value, uint32_t &start, uint32_t &end, uint32_t &total);
+
+enum class DownloadOutcome
+{
+  Complete,
+  Interrupted, // progress is in the checkpoint; try again (now or on the next wake)
+  Failed       // checkpoint was cleared; the next attempt starts from byte 0
+};
+
+/**
+ * Download that continues where the last attempt stopped, using HTTP Range
+ * requests validated with If-Range/ETag and the total length.
+ *
+ * Progress is committed every `granularity` bytes (e.g. a flash sector) so
+ * that a resumed download never has to rewrite part of a block. Once all
+ * bytes are in, the length and (if known) the CRC-32 are verified before
+ * Complete is returned; the caller commits the result only then.
+ */
+class ResumableDownload : private RangeHandler
+{
+public:
+  ResumableDownload(DownloadCheckpoint &checkpoint, const char *key, ResumableSink &target, uint32_t granularity);
+
+  /** True if the checkpoint holds progress for this resource */
+  bool canResume() const;
+
+  /** One request; continues from the checkpoint when possible */
+  DownloadOutcome attempt(RangeTransport &transport);
+
+  /** Up to maxAttempts requests, stopping when complete or failed */
+  DownloadOutcome run(RangeTransport &transport, uint8_t maxAttempts);
+
+  const char *error() const { return errorMessage; }
+  uint32_t received() const { return position; }
+  uint32_t resumedFrom() const { return startOffset; }
+
+private:
+  bool onResponse(const RangeResponse &response) override;
+  bool write(const uint8_t *data, size_t length) override;
+  bool restart(const RangeResponse &response);
+  DownloadOutcome fail(const char *message);
+
+  DownloadCheckpoint &checkpoint;
+  uint32_t keyHash;
+  ResumableSink &target;
+  uint32_t granularity;
+
+  uint32_t position; // bytes handed to the target, including the uncommitted tail
+  uint32_t crc;      // crc32 of those bytes
+  uint32_t startOffset;
+  bool accepted;
+  bool changed; // a 206 for a different version of the resource
+  const char *errorMessage;
+};
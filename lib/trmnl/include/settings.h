@@ -0,0 +1,122 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <persistence_interface.h>
+
+#define SETTINGS_API_KEY_SIZE 64
+#define SETTINGS_API_URL_SIZE 128
+#define SETTINGS_FRIENDLY_ID_SIZE 16
+#define SETTINGS_FILENAME_SIZE 128
+
+enum SettingsField : uint8_t
+{
+  SETTING_API_KEY,
+  SETTING_API_URL,
+  SETTING_FRIENDLY_ID,
+  SETTING_REFRESH_RATE,
+  SETTING_TEMP_PROFILE,
+  SETTING_DEVICE_REGISTERED,
+  SETTING_SPECIAL_FUNCTION,
+  SETTING_FILENAME,
+  SETTING_LAST_SLEEP_TIME,
+  SETTING_API_RETRY_COUNT,
+  SETTING_WIFI_RETRY_COUNT,
+  SETTING_LOG_ID,
+  SETTING_COUNT
+};
+
+/** Values of all device settings, as they were last loaded or set (ordered to avoid padding) */
+struct SettingsData
+{
+  char api_key[SETTINGS_API_KEY_SIZE];
+  char api_url[SETTINGS_API_URL_SIZE];
+  char friendly_id[SETTINGS_FRIENDLY_ID_SIZE];
+  char filename[SETTINGS_FILENAME_SIZE];
+  uint32_t refresh_rate;
+  uint32_t temp_profile;
+  uint32_t special_function;
+  uint32_t last_sleep_time;
+  uint32_t log_id;
+  int32_t api_retry_count;
+  int32_t wifi_retry_count;
+  bool device_registered;
+};
+
+/**
+ * In-RAM snapshot of the device settings stored in persistence.
+ *
+ * All keys are read once by load(); getters are served from RAM and setters
+ * only mark a field dirty when its value actually changes. flush() writes
+ * the dirty fields back in one batch (normally right before deep sleep).
+ * A missing key reads as its default, so setting a field to its default
+ * doesn't write it and exists() is false for a field holding its default.
+ */
+class Settings
+{
+public:
+  Settings(Persistence &persistence);
+
+  /** Read every setting from persistence (one read per key), discarding unsaved changes */
+  void load();
+
+  /** Re-read a single setting that was changed behind our back (e.g. by the captive portal) */
+  void reload(SettingsField field);
+
+  /** Write all dirty settings; returns the number of fields written */
+  uint8_t flush();
+
+  /** Forget all values (use after the underlying persistence was cleared) */
+  void reset();
+
+  bool exists(SettingsField field) const;
+  bool isDirty(SettingsField field) const;
+  bool isDirty() const;
+
+  const char *apiKey() const { return data.api_key; }
+  void setApiKey(const char *value);
+
+  const char *apiUrl() const { return data.api_url; }
+
+  const char *friendlyId() const { return data.friendly_id; }
+  void setFriendlyId(const char *value);
+
+  const char *filename() const { return data.filename; }
+  void setFilename(const char *value);
+
+  uint32_t refreshRate() const { return data.refresh_rate; }
+  void setRefreshRate(uint32_t value);
+
+  uint32_t tempProfile() const { return data.temp_profile; }
+  void setTempProfile(uint32_t value);
+
+  uint32_t specialFunction() const { return data.special_function; }
+  void setSpecialFunction(uint32_t value);
+
+  uint32_t lastSleepTime() const { return data.last_sleep_time; }
+  void setLastSleepTime(uint32_t value);
+
+  uint32_t logId() const { return data.log_id; }
+  void setLogId(uint32_t value);
+
+  int32_t apiRetryCount() const { return data.api_retry_count; }
+  void setApiRetryCount(int32_t value);
+
+  int32_t wifiRetryCount() const { return data.wifi_retry_count; }
+  void setWifiRetryCount(int32_t value);
+
+  bool deviceRegistered() const { return data.device_registered; }
+  void setDeviceRegistered(bool value);
+
+private:
+  void loadField(SettingsField field);
+  bool writeField(SettingsField field);
+  void setString(SettingsField field, char *dest, size_t size, const char *value);
+  void setUint(SettingsField field, uint32_t &dest, uint32_t value);
+  void setInt(SettingsField field, int32_t &dest, int32_t value);
+
+  Persistence &persistence;
+  SettingsData data;
+  uint16_t present;
+  uint16_t dirty;
+};
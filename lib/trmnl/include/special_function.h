@@ -15,4 +15,5 @@ enum SPECIAL_FUNCTION
 };
 
 SPECIAL_FUNCTION parseSpecialFunction(String &special_function_str);
+SPECIAL_FUNCTION parseSpecialFunction(const char *special_function_str);
 bool parseSpecialFunctionToStr(char *buffer, size_t buffer_size, SPECIAL_FUNCTION special_function);
@@ -0,0 +1,27 @@
+#include <api_wake.h>
+
+void apiHostname(const char *baseUrl, FixedString<API_BASE_URL_SIZE> &hostname)
+{
+  hostname = baseUrl;
+  hostname.replace("https://", "");
+  hostname.replace("http://", "");
+  hostname.replace("/", "");
+
+  int colon = hostname.indexOf(':');
+  if (colon != -1)
+    hostname.remove(colon);
+}
+
+void apiDisplayUrl(const char *baseUrl, FixedString<API_DISPLAY_URL_SIZE> &url)
+{
+  url = baseUrl;
+  url += "/api/display";
+}
+
+bool apiResponseFilename(const ApiDisplayResponse &response, FixedString<API_DISPLAY_FILENAME_SIZE> &filename)
+{
+  if (response.filename.equals("empty_state"))
+    return false;
+  filename = response.filename;
+  return true;
+}
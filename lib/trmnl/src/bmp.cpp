@@ -1,71 +1,119 @@
 #include <bmp.h>
 #include <trmnl_log.h>
+#include <stdint.h>
+
+static uint16_t le16(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t le32(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
 
 /**
- * @brief Function to parse .bmp file header
- * @param data pointer to the buffer
- * @param reserved variable address to store parsed color schematic
+ * @brief Function to parse the header of an uncompressed 1 or 2 bpp .bmp file
+ * @param data pointer to the file
+ * @param size length of the file
+ * @param info layout of the pixel data
  * @return bmp_err_e error code
  */
-bmp_err_e parseBMPHeader(uint8_t *data, bool &reversed)
+bmp_err_e parseBMPInfo(const uint8_t *data, size_t size, BmpInfo &info)
 {
-
   // Check if the file is a BMP image
-  if (data[0] != 'B' || data[1] != 'M')
+  if (size < 2 || data[0] != 'B' || data[1] != 'M')
   {
     Log_fatal("It is not a BMP file");
     return BMP_NOT_BMP;
   }
-  // Get width and height from the header
-  uint32_t width = *(uint32_t *)&data[18];
-  uint32_t height = *(uint32_t *)&data[22];
-  uint16_t bitsPerPixel = *(uint16_t *)&data[28];
-  uint32_t compressionMethod = *(uint32_t *)&data[30];
-  uint32_t imageDataSize = *(uint32_t *)&data[34];
-  uint32_t colorTableEntries = *(uint32_t *)&data[46];
- 
-  if (colorTableEntries == 0) colorTableEntries = (1 << bitsPerPixel);
+  if (size < 54)
+    return BMP_BAD_SIZE;
+  uint32_t headerSize = le32(&data[14]);
+  int32_t width = (int32_t)le32(&data[18]);
+  int32_t height = (int32_t)le32(&data[22]); // negative for top-down bitmaps
+  uint16_t bitsPerPixel = le16(&data[28]);
+  uint32_t compressionMethod = le32(&data[30]);
+  uint32_t imageDataSize = le32(&data[34]);
+  uint32_t colorTableEntries = le32(&data[46]);
+  uint32_t dataOffset = le32(&data[10]);
 
-  if (width != 800 || height != 480 || bitsPerPixel != 1 || imageDataSize != 48000 || colorTableEntries != 2)
+  if (headerSize < 40 || (bitsPerPixel != 1 && bitsPerPixel != 2) || compressionMethod != 0)
+    return BMP_BAD_SIZE;
+  if (colorTableEntries == 0)
+    colorTableEntries = 1 << bitsPerPixel;
+  if (colorTableEntries != (1u << bitsPerPixel) || width <= 0 || height == 0 || height == INT32_MIN)
+    return BMP_BAD_SIZE;
+
+  info.width = width;
+  info.height = height > 0 ? height : -height;
+  info.bpp = bitsPerPixel;
+  info.bottomUp = height > 0;
+  info.offset = dataOffset;
+  info.pitch = (((uint32_t)width * bitsPerPixel + 31) / 32) * 4;
+  uint64_t pixelBytes = (uint64_t)info.pitch * info.height;
+  if (imageDataSize != 0 && imageDataSize < pixelBytes)
     return BMP_BAD_SIZE;
-  // Get the offset of the pixel data
-  uint32_t dataOffset = *(uint32_t *)&data[10];
 
   // Display BMP information
   Log_info("BMP Header Information:\r\nWidth: %d\r\nHeight: %d\r\nBits per Pixel: %d\r\nCompression Method: %d\r\nImage Data Size: %d\r\nColor Table Entries: %d\r\nData offset: %d", width, height, bitsPerPixel, compressionMethod, imageDataSize, colorTableEntries, dataOffset);
 
-  // Check if there's a color table
-  if (dataOffset > 54)
-  {
-    // Read color table entries
-    uint32_t colorTableSize = colorTableEntries * 4; // Each color entry is 4 bytes
-
-    // Display color table
-    Log_info("Color table");
-    for (uint32_t i = 0; i < colorTableSize; i += 4)
-    {
-      Log_info("Color %d: B-%d, R-%d, G-%d, A-%d", i / 4 + 1, data[54 + i], data[55 + i], data[56 + i], data[57 + i]);
-    }
+  // the color table follows the info header, the pixels come after it
+  uint32_t colorTable = 14 + headerSize;
+  if (dataOffset < colorTable + colorTableEntries * 4)
+    return BMP_INVALID_OFFSET;
+  if ((uint64_t)dataOffset + pixelBytes > size)
+    return BMP_BAD_SIZE;
 
-    if (data[54] == 0 && data[55] == 0 && data[56] == 0 && data[57] == 0 && data[58] == 255 && data[59] == 255 && data[60] == 255 && data[61] == 0)
-    {
-      Log_info("Color scheme standart");
-      reversed = false;
-    }
-    else if (data[54] == 255 && data[55] == 255 && data[56] == 255 && data[57] == 0 && data[58] == 0 && data[59] == 0 && data[60] == 0 && data[61] == 0)
-    {
-      Log_info("Color scheme reversed");
-      reversed = true;
-    }
-    else
+  Log_info("Color table");
+  bool darker = true, lighter = true;
+  for (uint32_t i = 0; i < colorTableEntries; i++)
+  {
+    const uint8_t *color = &data[colorTable + i * 4];
+    Log_info("Color %d: B-%d, R-%d, G-%d, A-%d", i + 1, color[0], color[1], color[2], color[3]);
+    if (color[0] != color[1] || color[0] != color[2])
+      darker = lighter = false; // not a gray level
+    else if (i > 0)
     {
-      Log_info("Color scheme demaged");
-      return BMP_COLOR_SCHEME_FAILED;
+      lighter = lighter && color[0] > color[-4];
+      darker = darker && color[0] < color[-4];
     }
-    return BMP_NO_ERR;
+  }
+  if (lighter)
+  {
+    Log_info("Color scheme standart");
+    info.reversed = false;
+  }
+  else if (darker)
+  {
+    Log_info("Color scheme reversed");
+    info.reversed = true;
   }
   else
   {
-    return BMP_INVALID_OFFSET;
+    Log_info("Color scheme demaged");
+    return BMP_COLOR_SCHEME_FAILED;
   }
-}
\ No newline at end of file
+  return BMP_NO_ERR;
+}
+
+const uint8_t *bmpRow(const uint8_t *data, const BmpInfo &info, int y)
+{
+  int row = info.bottomUp ? info.height - 1 - y : y;
+  return data + info.offset + (size_t)row * info.pitch;
+}
+
+/**
+ * @brief Function to parse .bmp file header
+ * @param data pointer to the buffer
+ * @param reserved variable address to store parsed color schematic
+ * @return bmp_err_e error code
+ */
+bmp_err_e parseBMPHeader(uint8_t *data, bool &reversed)
+{
+  BmpInfo info;
+  bmp_err_e result = parseBMPInfo(data, SIZE_MAX, info);
+  if (result == BMP_NO_ERR)
+    reversed = info.reversed;
+  return result;
+}
@@ -0,0 +1,95 @@
+#include <capabilities.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+struct CapabilityName
+{
+  uint16_t bit;
+  const char *name;
+};
+
+static const CapabilityName formatNames[] = {
+    {CAP_PNG, "png"},
+    {CAP_JPEG, "jpeg"},
+    {CAP_BMP, "bmp"},
+    {CAP_G5, "g5"},
+    {CAP_RLE, "rle"},
+    {CAP_G5_PLANES, "g5gray"},
+};
+
+static const CapabilityName featureNames[] = {
+    {CAP_PARTIAL, "partial"},
+    {CAP_FRAME_DELTA, "delta"},
+    {CAP_DISPLAY_LIST, "list"},
+    {CAP_BUNDLE, "bundle"},
+    {CAP_OVERLAY, "overlay"},
+};
+
+static const CapabilityName cacheNames[] = {
+    {CAP_CACHE_CURRENT, "current"},
+    {CAP_CACHE_LAST, "last"},
+};
+
+/** Appends to a fixed buffer and remembers if anything didn't fit */
+class HeaderWriter
+{
+public:
+  HeaderWriter(char *out, size_t size) : out(out), size(size), length(0), full(size == 0) {}
+
+  void add(const char *format, ...)
+  {
+    if (full)
+      return;
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(out + length, size - length, format, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= size - length)
+      full = true;
+    else
+      length += n;
+  }
+
+  void list(const char *key, uint16_t bits, const CapabilityName *names, size_t count)
+  {
+    const char *separator = "=";
+    for (size_t i = 0; i < count; i++)
+    {
+      if (!(bits & names[i].bit))
+        continue;
+      if (*separator == '=')
+        add(";%s", key);
+      add("%s%s", separator, names[i].name);
+      separator = ",";
+    }
+  }
+
+  size_t result() const { return full ? 0 : length; }
+
+private:
+  char *out;
+  size_t size;
+  size_t length;
+  bool full;
+};
+
+uint32_t capabilityImageBytes(const DeviceCapabilities &caps)
+{
+  return caps.maxAlloc < caps.maxImageBytes ? caps.maxAlloc : caps.maxImageBytes;
+}
+
+size_t capabilitiesHeader(const DeviceCapabilities &caps, char *out, size_t size)
+{
+  HeaderWriter writer(out, size);
+  writer.add("v=%d", CAPABILITIES_VERSION);
+  writer.list("fmt", caps.flags, formatNames, sizeof(formatNames) / sizeof(formatNames[0]));
+  writer.add(";bytes=%u;heap=%u;alloc=%u;planes=%u", (unsigned)capabilityImageBytes(caps), (unsigned)caps.freeHeap,
+             (unsigned)caps.maxAlloc, caps.planes);
+  writer.list("feat", caps.flags, featureNames, sizeof(featureNames) / sizeof(featureNames[0]));
+  writer.list("cache", caps.cache, cacheNames, sizeof(cacheNames) / sizeof(cacheNames[0]));
+  if (caps.history)
+    writer.add(";history=%u", caps.history);
+  if (caps.flags & CAP_BUNDLE)
+    writer.add(";bundle_bytes=%u", (unsigned)caps.bundleBytes);
+  return writer.result();
+}
@@ -0,0 +1,195 @@
+#include <delta_patch.h>
+#include <string.h>
+
+static uint32_t readLe32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+DeltaPatch::DeltaPatch(OtaSource &oldImage, OtaSink &output) : oldImage(oldImage), output(output)
+{
+  reset();
+}
+
+void DeltaPatch::reset()
+{
+  state = HEADER;
+  headerLength = 0;
+  oldImageSize = 0;
+  newImageSize = 0;
+  expectedCrc = 0;
+  crc = 0;
+  varint = 0;
+  varintShift = 0;
+  remaining = 0;
+  oldPos = 0;
+  produced = 0;
+  errorMessage = nullptr;
+}
+
+bool DeltaPatch::fail(const char *message)
+{
+  if (!errorMessage)
+    errorMessage = message;
+  return false;
+}
+
+bool DeltaPatch::parseHeader()
+{
+  if (memcmp(header, DELTA_PATCH_MAGIC, 4) != 0)
+    return fail("Not a delta patch");
+
+  oldImageSize = readLe32(header + 4);
+  uint32_t oldCrc = readLe32(header + 8);
+  newImageSize = readLe32(header + 12);
+  expectedCrc = readLe32(header + 16);
+
+  // make sure the patch was made for the firmware we are running
+  uint32_t check = 0;
+  for (uint32_t offset = 0; offset < oldImageSize; offset += sizeof(oldBlock))
+  {
+    uint32_t n = oldImageSize - offset;
+    if (n > sizeof(oldBlock))
+      n = sizeof(oldBlock);
+    if (!oldImage.read(offset, oldBlock, n))
+      return fail("Failed to read running image");
+    check = ota_crc32(check, oldBlock, n);
+  }
+  if (check != oldCrc)
+    return fail("Patch does not match running image");
+
+  nextRecordOrDone();
+  return true;
+}
+
+bool DeltaPatch::readVarint(uint8_t byte)
+{
+  if (varintShift >= 64)
+    return fail("Malformed varint");
+  varint |= (uint64_t)(byte & 0x7f) << varintShift;
+  varintShift += 7;
+  return (byte & 0x80) == 0;
+}
+
+bool DeltaPatch::emit(const uint8_t *data, size_t length)
+{
+  crc = ota_crc32(crc, data, length);
+  produced += length;
+  if (!output.write(data, length))
+    return fail("Write failed");
+  return true;
+}
+
+bool DeltaPatch::applyDiff(const uint8_t *data, size_t length)
+{
+  while (length > 0)
+  {
+    size_t n = length < sizeof(oldBlock) ? length : sizeof(oldBlock);
+    if (!oldImage.read(oldPos, oldBlock, n))
+      return fail("Failed to read running image");
+    for (size_t i = 0; i < n; i++)
+      oldBlock[i] += data[i];
+    if (!emit(oldBlock, n))
+      return false;
+    oldPos += n;
+    data += n;
+    length -= n;
+  }
+  return true;
+}
+
+void DeltaPatch::nextRecordOrDone()
+{
+  state = produced == newImageSize ? DONE : DIFF_LENGTH;
+}
+
+bool DeltaPatch::write(const uint8_t *data, size_t length)
+{
+  size_t i = 0;
+  while (i < length)
+  {
+    if (errorMessage)
+      return false;
+
+    switch (state)
+    {
+    case HEADER:
+    {
+      size_t n = DELTA_PATCH_HEADER_SIZE - headerLength;
+      if (n > length - i)
+        n = length - i;
+      memcpy(header + headerLength, data + i, n);
+      headerLength += n;
+      i += n;
+      if (headerLength == DELTA_PATCH_HEADER_SIZE && !parseHeader())
+        return false;
+      break;
+    }
+
+    case DIFF_LENGTH:
+    case EXTRA_LENGTH:
+    case SEEK:
+    {
+      if (!readVarint(data[i++]))
+        break;
+
+      uint64_t value = varint;
+      varint = 0;
+      varintShift = 0;
+
+      if (state == SEEK)
+      {
+        int64_t seek = (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+        int64_t position = (int64_t)oldPos + seek;
+        if (position < 0 || position > oldImageSize)
+          return fail("Seek outside running image");
+        oldPos = position;
+        nextRecordOrDone();
+        break;
+      }
+
+      if (value > newImageSize - produced)
+        return fail("Record exceeds new image size");
+      if (state == DIFF_LENGTH && oldPos + value > oldImageSize)
+        return fail("Diff exceeds running image");
+
+      remaining = value;
+      if (state == DIFF_LENGTH)
+        state = remaining ? DIFF_DATA : EXTRA_LENGTH;
+      else
+        state = remaining ? EXTRA_DATA : SEEK;
+      break;
+    }
+
+    case DIFF_DATA:
+    case EXTRA_DATA:
+    {
+      size_t n = remaining < length - i ? remaining : length - i;
+      bool ok = state == DIFF_DATA ? applyDiff(data + i, n) : emit(data + i, n);
+      if (!ok)
+        return false;
+      i += n;
+      remaining -= n;
+      if (remaining == 0)
+        state = state == DIFF_DATA ? EXTRA_LENGTH : SEEK;
+      break;
+    }
+
+    case DONE:
+      return fail("Trailing data after patch");
+    }
+  }
+
+  return errorMessage == nullptr;
+}
+
+bool DeltaPatch::finish()
+{
+  if (errorMessage)
+    return false;
+  if (state != DONE)
+    return fail("Patch is incomplete");
+  if (crc != expectedCrc)
+    return fail("New image CRC mismatch");
+  return true;
+}
@@ -0,0 +1,258 @@
+#include <display_list.h>
+#include <string.h>
+
+/** Bounds-checked little-endian reader; reads past the end return 0 and set overrun */
+struct DisplayListReader
+{
+  const uint8_t *data;
+  size_t size;
+  size_t pos;
+  bool overrun;
+
+  DisplayListReader(const uint8_t *data, size_t size) : data(data), size(size), pos(0), overrun(false) {}
+
+  bool has(size_t n) const { return !overrun && n <= size - pos; }
+
+  uint8_t u8()
+  {
+    if (!has(1))
+    {
+      overrun = true;
+      return 0;
+    }
+    return data[pos++];
+  }
+
+  uint16_t u16()
+  {
+    uint16_t lo = u8();
+    return lo | ((uint16_t)u8() << 8);
+  }
+
+  int16_t i16() { return (int16_t)u16(); }
+
+  bool skip(size_t n)
+  {
+    if (!has(n))
+      overrun = true;
+    else
+      pos += n;
+    return !overrun;
+  }
+};
+
+struct DisplayListTable
+{
+  size_t start; // offset of the first entry
+  uint8_t count;
+};
+
+/** Offset and length of entry index of a string (1-byte length) or sprite (2-byte size) table */
+static void tableEntry(const uint8_t *data, const DisplayListTable &table, bool wide, uint8_t index, size_t &offset, size_t &length)
+{
+  size_t pos = table.start;
+  for (uint8_t i = 0;; i++)
+  {
+    length = wide ? (data[pos] | (data[pos + 1] << 8)) : data[pos];
+    offset = pos + (wide ? 2 : 1);
+    if (i == index)
+      return;
+    pos = offset + length;
+  }
+}
+
+static bool readTable(DisplayListReader &reader, DisplayListTable &table, bool wide)
+{
+  table.start = reader.pos;
+  for (uint8_t i = 0; i < table.count; i++)
+  {
+    size_t length = wide ? reader.u16() : reader.u8();
+    if (!reader.skip(length))
+      return false;
+  }
+  return true;
+}
+
+/** A sprite table entry has to hold a whole G5 image no wider than the screen (the decoder's line buffer) */
+static const char *checkSprites(const uint8_t *data, const DisplayListTable &sprites, int width)
+{
+  size_t offset, length;
+  for (uint8_t i = 0; i < sprites.count; i++)
+  {
+    tableEntry(data, sprites, true, i, offset, length);
+    DisplayListReader header(data + offset, length);
+    if (length < DISPLAY_LIST_SPRITE_HEADER_SIZE || header.u16() != DISPLAY_LIST_SPRITE_MARKER)
+      return "Sprite is not a G5 image";
+    int spriteWidth = header.u16();
+    int spriteHeight = header.u16();
+    size_t spriteSize = header.u16();
+    if (spriteSize > length - DISPLAY_LIST_SPRITE_HEADER_SIZE)
+      return "Sprite data is cut short";
+    if (spriteWidth < 1 || spriteWidth > width || spriteHeight < 1)
+      return "Bad sprite size";
+  }
+  return nullptr;
+}
+
+static bool validColor(uint8_t color) { return color == DL_BLACK || color == DL_WHITE; }
+
+/** One pass over the ops; with no canvas the ops are only checked */
+static const char *walk(const uint8_t *data, size_t size, int width, int height, DisplayListCanvas *canvas)
+{
+  DisplayListReader reader(data, size);
+  if (size < DISPLAY_LIST_HEADER_SIZE || memcmp(data, DISPLAY_LIST_MAGIC, 4) != 0)
+    return "Not a display list";
+  reader.skip(4);
+  if (reader.u8() != DISPLAY_LIST_VERSION)
+    return "Unsupported display list version";
+
+  DisplayListTable strings, sprites;
+  strings.count = reader.u8();
+  sprites.count = reader.u8();
+  reader.u8(); // reserved
+  int listWidth = reader.u16();
+  int listHeight = reader.u16();
+  if (!canvas && (listWidth != width || listHeight != height))
+    return "Display list is for another screen size";
+
+  if (!readTable(reader, strings, false))
+    return "String table is cut short";
+  if (!readTable(reader, sprites, true))
+    return "Sprite table is cut short";
+  if (!canvas)
+  {
+    const char *error = checkSprites(data, sprites, width);
+    if (error)
+      return error;
+  }
+
+  char text[256];
+  size_t offset, length;
+  while (reader.pos < size)
+  {
+    uint8_t op = reader.u8();
+    switch (op)
+    {
+    case DL_OP_CLEAR:
+    {
+      uint8_t color = reader.u8();
+      if (!canvas && !validColor(color))
+        return "Bad color";
+      if (canvas)
+        canvas->clear((DisplayListColor)color);
+      break;
+    }
+
+    case DL_OP_TEXT:
+    {
+      uint8_t font = reader.u8();
+      uint8_t fg = reader.u8();
+      uint8_t bg = reader.u8();
+      int x = reader.i16();
+      int y = reader.i16();
+      uint8_t index = reader.u8();
+      if (reader.overrun)
+        break;
+      if (!canvas)
+      {
+        if (font >= DL_FONT_COUNT)
+          return "Unknown font";
+        if (!validColor(fg) || (!validColor(bg) && bg != DL_TRANSPARENT))
+          return "Bad color";
+        if (index >= strings.count)
+          return "String index out of range";
+        break;
+      }
+      tableEntry(data, strings, false, index, offset, length);
+      memcpy(text, data + offset, length);
+      text[length] = '\0';
+      canvas->text((DisplayListFont)font, x, y, text, (DisplayListColor)fg, (DisplayListColor)bg);
+      break;
+    }
+
+    case DL_OP_RECT:
+    case DL_OP_ROUND_RECT:
+    {
+      int x = reader.i16();
+      int y = reader.i16();
+      int w = reader.i16();
+      int h = reader.i16();
+      int r = op == DL_OP_ROUND_RECT ? reader.i16() : 0;
+      uint8_t color = reader.u8();
+      bool filled = reader.u8() != 0;
+      if (!canvas && (!validColor(color) || w < 0 || h < 0 || r < 0))
+        return "Bad rectangle";
+      if (canvas)
+        canvas->rect(x, y, w, h, r, (DisplayListColor)color, filled);
+      break;
+    }
+
+    case DL_OP_ELLIPSE:
+    {
+      int cx = reader.i16();
+      int cy = reader.i16();
+      int rx = reader.i16();
+      int ry = reader.i16();
+      uint8_t color = reader.u8();
+      bool filled = reader.u8() != 0;
+      if (!canvas && (!validColor(color) || rx < 0 || ry < 0))
+        return "Bad ellipse";
+      if (canvas)
+        canvas->ellipse(cx, cy, rx, ry, (DisplayListColor)color, filled);
+      break;
+    }
+
+    case DL_OP_LINE:
+    {
+      int x1 = reader.i16();
+      int y1 = reader.i16();
+      int x2 = reader.i16();
+      int y2 = reader.i16();
+      uint8_t color = reader.u8();
+      if (!canvas && !validColor(color))
+        return "Bad color";
+      if (canvas)
+        canvas->line(x1, y1, x2, y2, (DisplayListColor)color);
+      break;
+    }
+
+    case DL_OP_SPRITE:
+    {
+      uint8_t index = reader.u8();
+      int x = reader.i16();
+      int y = reader.i16();
+      uint8_t scale = reader.u8();
+      if (reader.overrun)
+        break;
+      if (!canvas)
+      {
+        if (index >= sprites.count)
+          return "Sprite index out of range";
+        if (scale < 1 || scale > 4)
+          return "Bad sprite scale";
+        break;
+      }
+      tableEntry(data, sprites, true, index, offset, length);
+      canvas->sprite(data + offset, length, x, y, scale);
+      break;
+    }
+
+    default:
+      return "Unknown display list op";
+    }
+
+    if (reader.overrun)
+      return "Display list op is cut short";
+  }
+  return nullptr;
+}
+
+const char *displayListCheck(const uint8_t *data, size_t size, int width, int height)
+{
+  return walk(data, size, width, height, nullptr);
+}
+
+void displayListDraw(const uint8_t *data, size_t size, DisplayListCanvas &canvas)
+{
+  walk(data, size, 0, 0, &canvas);
+}
@@ -0,0 +1,217 @@
+#include <frame_bundle.h>
+#include <stdio.h>
+#include <string.h>
+
+static uint32_t readLe32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void bundleFrameFile(uint8_t index, char *name, size_t size)
+{
+  snprintf(name, size, "/frame%u", index);
+}
+
+BundleWriter::BundleWriter(FrameStorage &storage, uint32_t maxFrameSize)
+    : storage(storage),
+      maxFrameSize(maxFrameSize),
+      state(HEADER),
+      headerLength(0),
+      nameLength(0),
+      remaining(0),
+      frame(0),
+      fileOpen(false),
+      errorMessage(nullptr)
+{
+  memset(&bundle, 0, sizeof(bundle));
+}
+
+bool BundleWriter::fail(const char *message)
+{
+  if (!errorMessage)
+    errorMessage = message;
+  return false;
+}
+
+bool BundleWriter::beginFrame()
+{
+  BundleFrame &current = bundle.frames[frame];
+  current.size = readLe32(header);
+  current.duration = readLe32(header + 4);
+  nameLength = header[8];
+  headerLength = 0;
+
+  if (current.size == 0 || current.size > maxFrameSize)
+    return fail("Frame size out of range");
+  if (nameLength >= BUNDLE_NAME_SIZE)
+    return fail("Frame name too long");
+
+  // the old index would point at frames that are about to be overwritten
+  if (frame == 0)
+    storage.remove(BUNDLE_INDEX_FILE);
+
+  char file[16];
+  bundleFrameFile(frame, file, sizeof(file));
+  if (!storage.create(file))
+    return fail("Failed to create frame file");
+  fileOpen = true;
+  remaining = current.size;
+  state = nameLength ? FRAME_NAME : FRAME_DATA;
+  return true;
+}
+
+bool BundleWriter::write(const uint8_t *data, size_t length)
+{
+  size_t i = 0;
+  while (i < length)
+  {
+    if (errorMessage)
+      return false;
+
+    switch (state)
+    {
+    case HEADER:
+    {
+      size_t n = BUNDLE_HEADER_SIZE - headerLength;
+      if (n > length - i)
+        n = length - i;
+      memcpy(header + headerLength, data + i, n);
+      headerLength += n;
+      i += n;
+      if (headerLength < BUNDLE_HEADER_SIZE)
+        break;
+
+      if (memcmp(header, BUNDLE_MAGIC, 4) != 0)
+        return fail("Not a frame bundle");
+      bundle.count = header[4];
+      if (bundle.count == 0 || bundle.count > BUNDLE_MAX_FRAMES)
+        return fail("Frame count out of range");
+      headerLength = 0;
+      state = FRAME_HEADER;
+      break;
+    }
+
+    case FRAME_HEADER:
+    {
+      size_t n = BUNDLE_FRAME_HEADER_SIZE - headerLength;
+      if (n > length - i)
+        n = length - i;
+      memcpy(header + headerLength, data + i, n);
+      headerLength += n;
+      i += n;
+      if (headerLength == BUNDLE_FRAME_HEADER_SIZE && !beginFrame())
+        return false;
+      break;
+    }
+
+    case FRAME_NAME:
+    {
+      size_t n = nameLength - headerLength;
+      if (n > length - i)
+        n = length - i;
+      memcpy(bundle.frames[frame].name + headerLength, data + i, n);
+      headerLength += n;
+      i += n;
+      if (headerLength == nameLength)
+        state = FRAME_DATA;
+      break;
+    }
+
+    case FRAME_DATA:
+    {
+      size_t n = remaining < length - i ? remaining : length - i;
+      if (!storage.append(data + i, n))
+        return fail("Failed to write frame file");
+      i += n;
+      remaining -= n;
+      if (remaining > 0)
+        break;
+
+      storage.close();
+      fileOpen = false;
+      headerLength = 0;
+      frame++;
+      state = frame == bundle.count ? DONE : FRAME_HEADER;
+      break;
+    }
+
+    case DONE:
+      return fail("Trailing data after bundle");
+    }
+  }
+
+  return errorMessage == nullptr;
+}
+
+void BundleWriter::removeFrames()
+{
+  if (fileOpen)
+  {
+    storage.close();
+    fileOpen = false;
+  }
+
+  // the frames written so far plus the one that was cut short
+  char file[16];
+  for (uint8_t i = 0; i <= frame && i < BUNDLE_MAX_FRAMES; i++)
+  {
+    bundleFrameFile(i, file, sizeof(file));
+    storage.remove(file);
+  }
+}
+
+bool BundleWriter::finish()
+{
+  if (!errorMessage && state != DONE)
+    fail("Bundle is incomplete");
+
+  if (errorMessage)
+  {
+    removeFrames();
+    return false;
+  }
+
+  bundle.magic = BUNDLE_INDEX_MAGIC;
+  if (!storage.create(BUNDLE_INDEX_FILE) || !storage.append((const uint8_t *)&bundle, sizeof(bundle)))
+  {
+    fail("Failed to write bundle index");
+    storage.close();
+    storage.remove(BUNDLE_INDEX_FILE);
+    removeFrames();
+    return false;
+  }
+  storage.close();
+  return true;
+}
+
+bool loadBundleIndex(FrameStorage &storage, BundleIndex &index)
+{
+  if (storage.read(BUNDLE_INDEX_FILE, (uint8_t *)&index, sizeof(index)) != sizeof(index))
+    return false;
+  return index.magic == BUNDLE_INDEX_MAGIC && index.count > 0 && index.count <= BUNDLE_MAX_FRAMES;
+}
+
+void playlistStart(PlaylistCursor &cursor, uint8_t count, uint32_t now, uint32_t validFor)
+{
+  cursor.magic = BUNDLE_INDEX_MAGIC;
+  cursor.next = 0;
+  cursor.count = count;
+  cursor.validUntil = now > 0 && validFor > 0 ? now + validFor : 0;
+}
+
+void playlistStop(PlaylistCursor &cursor)
+{
+  memset(&cursor, 0, sizeof(cursor));
+}
+
+int playlistNextFrame(PlaylistCursor &cursor, uint32_t now)
+{
+  if (cursor.magic != BUNDLE_INDEX_MAGIC || cursor.next >= cursor.count)
+    return -1;
+  if (cursor.validUntil != 0 && now >= cursor.validUntil)
+  {
+    playlistStop(cursor);
+    return -1;
+  }
+  return cursor.next++;
+}
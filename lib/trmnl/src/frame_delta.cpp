@@ -0,0 +1,157 @@
+#include <frame_delta.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint16_t readLe16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t readLe32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void writeLe16(uint8_t *p, uint16_t value)
+{
+  p[0] = value & 0xff;
+  p[1] = value >> 8;
+}
+
+static void writeLe32(uint8_t *p, uint32_t value)
+{
+  writeLe16(p, value & 0xffff);
+  writeLe16(p + 2, value >> 16);
+}
+
+const char *frameDeltaParse(const uint8_t *data, size_t size, int width, int height, FrameDelta &delta)
+{
+  memset(&delta, 0, sizeof(delta));
+  if (size < DELTA_HEADER_SIZE || memcmp(data, DELTA_MAGIC, 4) != 0)
+    return "Not a frame delta";
+  if (data[4] != DELTA_VERSION)
+    return "Unsupported frame delta version";
+  delta.count = data[5];
+  delta.width = readLe16(data + 8);
+  delta.height = readLe16(data + 10);
+  delta.baseCrc = readLe32(data + 12);
+  delta.resultCrc = readLe32(data + 16);
+  if (delta.width != width || delta.height != height)
+    return "Frame delta is for another screen size";
+  if (delta.count == 0 || delta.count > DELTA_MAX_TILES)
+    return "Bad number of tiles";
+
+  size_t offset = DELTA_HEADER_SIZE;
+  for (uint8_t i = 0; i < delta.count; i++)
+  {
+    if (size - offset < DELTA_TILE_HEADER_SIZE)
+      return "Frame delta is truncated";
+    const uint8_t *p = data + offset;
+    DeltaTile &tile = delta.tiles[i];
+    tile.x = readLe16(p);
+    tile.y = readLe16(p + 2);
+    tile.w = readLe16(p + 4);
+    tile.h = readLe16(p + 6);
+    tile.size = readLe32(p + 8);
+    tile.encoding = p[12];
+    offset += DELTA_TILE_HEADER_SIZE;
+
+    // whole bytes of the 1-bit frame, the EPD RAM window has the same granularity
+    if ((tile.x & 7) || (tile.w & 7))
+      return "Tile is not byte aligned";
+    if (tile.w == 0 || tile.h == 0 || tile.x + tile.w > width || tile.y + tile.h > height)
+      return "Tile is off the screen";
+    if (tile.encoding != DELTA_TILE_G5 && tile.encoding != DELTA_TILE_PNG)
+      return "Unknown tile encoding";
+    if (tile.size == 0 || tile.size > size - offset)
+      return "Frame delta is truncated";
+    tile.data = data + offset;
+    offset += tile.size;
+  }
+  if (offset != size)
+    return "Frame delta has extra data";
+  return nullptr;
+}
+
+uint32_t frameDeltaArea(const FrameDelta &delta)
+{
+  uint32_t area = 0;
+  for (uint8_t i = 0; i < delta.count; i++)
+    area += (uint32_t)delta.tiles[i].w * delta.tiles[i].h;
+  return area;
+}
+
+uint32_t frameCrc(const uint8_t *frame, int pitch, int width, int height)
+{
+  uint32_t crc = 0;
+  for (int y = 0; y < height; y++)
+    crc = ota_crc32(crc, frame + (long)y * pitch, width / 8);
+  return crc;
+}
+
+void frameGetBox(const uint8_t *frame, int pitch, const DeltaTile &tile, uint8_t *box)
+{
+  for (int y = 0; y < tile.h; y++)
+    memcpy(box + y * (tile.w / 8), frame + (long)(tile.y + y) * pitch + tile.x / 8, tile.w / 8);
+}
+
+void framePutBox(uint8_t *frame, int pitch, const DeltaTile &tile, const uint8_t *box)
+{
+  for (int y = 0; y < tile.h; y++)
+    memcpy(frame + (long)(tile.y + y) * pitch + tile.x / 8, box + y * (tile.w / 8), tile.w / 8);
+}
+
+void frameBmpHeader(uint8_t *header, int width, int height)
+{
+  uint32_t imageSize = (uint32_t)(width / 8) * height;
+  memset(header, 0, FRAME_BMP_HEADER_SIZE);
+  header[0] = 'B';
+  header[1] = 'M';
+  writeLe32(header + 2, FRAME_BMP_HEADER_SIZE + imageSize);
+  writeLe32(header + 10, FRAME_BMP_HEADER_SIZE); // pixel data offset
+  writeLe32(header + 14, 40);                     // BITMAPINFOHEADER
+  writeLe32(header + 18, width);
+  writeLe32(header + 22, height); // positive = bottom-up
+  writeLe16(header + 26, 1);      // planes
+  writeLe16(header + 28, 1);      // bits per pixel
+  writeLe32(header + 34, imageSize);
+  writeLe32(header + 38, 2835); // 72 dpi
+  writeLe32(header + 42, 2835);
+  writeLe32(header + 46, 2); // colors in the palette: black, white
+  memset(header + 58, 0xff, 3);
+}
+
+FrameDeltaBuffer::FrameDeltaBuffer(size_t maxSize)
+    : buffer(nullptr), length(0), capacity(0), maxSize(maxSize), overflow(false)
+{
+}
+
+FrameDeltaBuffer::~FrameDeltaBuffer()
+{
+  free(buffer);
+}
+
+bool FrameDeltaBuffer::write(const uint8_t *data, size_t size)
+{
+  if (size > maxSize - length)
+  {
+    overflow = true;
+    return false;
+  }
+  if (length + size > capacity)
+  {
+    size_t grown = capacity ? capacity * 2 : 4096;
+    while (grown < length + size)
+      grown *= 2;
+    if (grown > maxSize)
+      grown = maxSize;
+    uint8_t *larger = (uint8_t *)realloc(buffer, grown);
+    if (!larger)
+      return false;
+    buffer = larger;
+    capacity = grown;
+  }
+  memcpy(buffer + length, data, size);
+  length += size;
+  return true;
+}
@@ -0,0 +1,55 @@
+#include <frame_history.h>
+#include <stdio.h>
+#include <string.h>
+
+void historyFrameFile(uint8_t slot, char *name, size_t size)
+{
+  snprintf(name, size, "/hist%u", slot);
+}
+
+void historyClear(HistoryIndex &index)
+{
+  memset(&index, 0, sizeof(index));
+  index.magic = HISTORY_INDEX_MAGIC;
+}
+
+bool historyIndexValid(const HistoryIndex &index)
+{
+  return index.magic == HISTORY_INDEX_MAGIC && index.count <= HISTORY_SLOTS && index.next < HISTORY_SLOTS;
+}
+
+uint8_t historyPush(HistoryIndex &index)
+{
+  uint8_t slot = index.next;
+  index.next = (index.next + 1) % HISTORY_SLOTS;
+  if (index.count < HISTORY_SLOTS)
+    index.count++;
+  return slot;
+}
+
+int historySlot(const HistoryIndex &index, uint8_t back)
+{
+  if (back == 0 || back > index.count)
+    return -1;
+  return (index.next + HISTORY_SLOTS - back) % HISTORY_SLOTS;
+}
+
+void historyReset(HistoryCursor &cursor)
+{
+  memset(&cursor, 0, sizeof(cursor));
+}
+
+bool historyRewound(const HistoryCursor &cursor)
+{
+  return cursor.magic == HISTORY_INDEX_MAGIC && cursor.back > 0;
+}
+
+int historyRewind(HistoryCursor &cursor, uint8_t available)
+{
+  if (cursor.magic != HISTORY_INDEX_MAGIC)
+    historyReset(cursor);
+  if (cursor.back >= available)
+    return -1;
+  cursor.magic = HISTORY_INDEX_MAGIC;
+  return ++cursor.back;
+}
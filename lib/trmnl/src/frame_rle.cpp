@@ -0,0 +1,114 @@
+#include <frame_rle.h>
+#include <string.h>
+
+bool frameRleMatch(const uint8_t *data, size_t size)
+{
+  return size >= sizeof(FrameRleHeader) && memcmp(data, FRAME_RLE_MAGIC, 4) == 0;
+}
+
+// gray level of pixel value i
+static uint8_t paletteGray(uint8_t palette, int i)
+{
+  return (palette >> (2 * i)) & 3;
+}
+
+static bool paletteDecodable(const FrameRleHeader &header)
+{
+  uint8_t black = paletteGray(header.palette, 0), white = paletteGray(header.palette, 3);
+  if (header.planes == 1)
+    return (black ^ white) == 3;
+  // the palette must be a value XORed with the same mask
+  for (int i = 1; i < 4; i++)
+  {
+    if (paletteGray(header.palette, i) != (i ^ black))
+      return false;
+  }
+  return true;
+}
+
+bool frameRleBegin(FrameRleDecoder &decoder, const uint8_t *data, size_t size, uint8_t *row)
+{
+  if (!frameRleMatch(data, size))
+    return false;
+  memcpy(&decoder.header, data, sizeof(decoder.header));
+  const FrameRleHeader &header = decoder.header;
+  if (header.version != FRAME_RLE_VERSION || header.planes < 1 || header.planes > 2 ||
+      !header.width || !header.height || !paletteDecodable(header))
+    return false;
+  decoder.data = data + sizeof(FrameRleHeader);
+  decoder.end = data + size;
+  decoder.row = row;
+  decoder.pitch = (header.width + 7) / 8;
+  decoder.plane = 0;
+  decoder.y = 0;
+  return true;
+}
+
+const uint8_t *frameRleRow(FrameRleDecoder &decoder)
+{
+  if (decoder.plane >= decoder.header.planes)
+    return nullptr;
+  const uint8_t *s = decoder.data, *end = decoder.end;
+  uint8_t *d = decoder.row;
+  bool first = decoder.y == 0; // no row above to copy from
+  int x = 0;
+
+  if (s < end && *s == FRAME_RLE_SAME_ROW)
+  {
+    if (first)
+      return nullptr;
+    s++;
+    x = decoder.pitch;
+  }
+  while (x < decoder.pitch)
+  {
+    if (s >= end)
+      return nullptr;
+    uint8_t op = *s++;
+    int length = (op & 0x3f) + 1;
+    if (length == 64)
+    {
+      if (s >= end)
+        return nullptr;
+      length += *s++;
+    }
+    if (length > decoder.pitch - x)
+      return nullptr;
+    switch (op & 0xc0)
+    {
+    case FRAME_RLE_LITERAL:
+      if (length > end - s)
+        return nullptr;
+      memcpy(d + x, s, length);
+      s += length;
+      break;
+    case FRAME_RLE_RUN:
+      if (s >= end)
+        return nullptr;
+      memset(d + x, *s++, length);
+      break;
+    case FRAME_RLE_COPY: // the bytes of the row above are still there
+      if (first)
+        return nullptr;
+      break;
+    default: // a whole row op in the middle of a row
+      return nullptr;
+    }
+    x += length;
+  }
+  decoder.data = s;
+  if (++decoder.y == decoder.header.height)
+  {
+    decoder.y = 0;
+    decoder.plane++;
+  }
+  return d;
+}
+
+uint8_t frameRleInvert(const FrameRleHeader &header, int plane)
+{
+  uint8_t black = paletteGray(header.palette, 0); // the mask every value is XORed with
+  if (header.planes == 1)
+    return black ? 0xff : 0;
+  return (black >> plane) & 1 ? 0xff : 0;
+}
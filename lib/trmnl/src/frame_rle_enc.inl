@@ -0,0 +1,116 @@
+//
+// TRLE encoder, see frame_rle.h for the format
+// Plain C: it is built into the device tests and the server side tools,
+// the firmware only decodes.
+//
+
+#include <string.h>
+#include "../include/frame_rle.h"
+
+static uint8_t *frameRleOp(uint8_t *out, uint8_t type, int length)
+{
+  if (length < 64)
+  {
+    *out++ = type | (uint8_t)(length - 1);
+  }
+  else
+  {
+    *out++ = type | 63;
+    *out++ = (uint8_t)(length - 64);
+  }
+  return out;
+}
+
+static uint8_t *frameRleLiteral(uint8_t *out, const uint8_t *data, int length)
+{
+  if (length)
+  {
+    out = frameRleOp(out, FRAME_RLE_LITERAL, length);
+    memcpy(out, data, length);
+    out += length;
+  }
+  return out;
+}
+
+void frameRleHeaderInit(FrameRleHeader *header, int width, int height, int planes, uint8_t palette)
+{
+  memset(header, 0, sizeof(*header));
+  memcpy(header->magic, FRAME_RLE_MAGIC, sizeof(header->magic));
+  header->version = FRAME_RLE_VERSION;
+  header->planes = (uint8_t)planes;
+  header->palette = palette;
+  header->width = (uint16_t)width;
+  header->height = (uint16_t)height;
+}
+
+//
+// Code one row of pitch bytes into out, which must hold
+// FRAME_RLE_ROW_BOUND(pitch) bytes. prev is the row above, NULL for the
+// first row of a plane. Returns the coded length.
+//
+int frameRleEncodeRow(const uint8_t *row, const uint8_t *prev, int pitch, uint8_t *out)
+{
+  uint8_t *d = out;
+  int x = 0, literal = 0; // the literal bytes not written yet end at x
+
+  if (prev && memcmp(row, prev, pitch) == 0)
+  {
+    *d++ = FRAME_RLE_SAME_ROW;
+    return 1;
+  }
+  while (x < pitch)
+  {
+    int copy = 0, run = 1;
+    if (prev)
+    {
+      while (x + copy < pitch && copy < FRAME_RLE_MAX_OP && row[x + copy] == prev[x + copy])
+        copy++;
+    }
+    while (x + run < pitch && run < FRAME_RLE_MAX_OP && row[x + run] == row[x])
+      run++;
+    // shorter copies and runs cost as much as leaving them in a literal
+    if (copy >= 2 || run >= 3)
+    {
+      d = frameRleLiteral(d, row + x - literal, literal);
+      literal = 0;
+      if (copy >= run)
+      {
+        d = frameRleOp(d, FRAME_RLE_COPY, copy);
+        x += copy;
+      }
+      else
+      {
+        d = frameRleOp(d, FRAME_RLE_RUN, run);
+        *d++ = row[x];
+        x += run;
+      }
+    }
+    else
+    {
+      x++;
+      if (++literal == FRAME_RLE_MAX_OP)
+      {
+        d = frameRleLiteral(d, row + x - literal, literal);
+        literal = 0;
+      }
+    }
+  }
+  d = frameRleLiteral(d, row + x - literal, literal);
+  return (int)(d - out);
+}
+
+//
+// Code height rows of pitch bytes that follow each other, one plane of an
+// image. out must hold height * FRAME_RLE_ROW_BOUND(pitch) bytes.
+// Returns the coded length.
+//
+int frameRleEncodePlane(const uint8_t *plane, int pitch, int height, uint8_t *out)
+{
+  int size = 0;
+  for (int y = 0; y < height; y++)
+  {
+    const uint8_t *row = plane + y * pitch;
+    size += frameRleEncodeRow(row, y ? row - pitch : NULL, pitch, out + size);
+  }
+  return size;
+}
@@ -0,0 +1,22 @@
+#include <g5_planes.h>
+#include <string.h>
+
+bool g5PlanesMatch(const uint8_t *data, size_t size)
+{
+  return size >= sizeof(G5PlanesHeader) && (data[0] | data[1] << 8) == G5_PLANES_MARKER;
+}
+
+bool g5PlanesParse(const uint8_t *data, size_t size, G5PlanesHeader &header, const uint8_t *planes[2])
+{
+  if (!g5PlanesMatch(data, size))
+    return false;
+  memcpy(&header, data, sizeof(header));
+  if (header.mode != G5_PLANES_GRAY4 || !header.width || !header.height || !header.size[0] || !header.size[1])
+    return false;
+  size_t left = size - sizeof(header);
+  if (header.size[0] > left || header.size[1] > left - header.size[0])
+    return false;
+  planes[0] = data + sizeof(header);
+  planes[1] = planes[0] + header.size[0];
+  return true;
+}
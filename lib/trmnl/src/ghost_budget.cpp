@@ -0,0 +1,237 @@
+#include <ghost_budget.h>
+#include <string.h>
+
+static int tileWidth(int width)
+{
+  return ((width + GHOST_COLS - 1) / GHOST_COLS + 7) & ~7;
+}
+
+static int tileHeight(int height)
+{
+  return (height + GHOST_ROWS - 1) / GHOST_ROWS;
+}
+
+void ghostScanBegin(GhostFrame &frame, int width, int height)
+{
+  memset(&frame, 0, sizeof(frame));
+  frame.width = width;
+  frame.height = height;
+  frame.tileW = tileWidth(width);
+  frame.tileH = tileHeight(height);
+  for (int i = 0; i < GHOST_TILES; i++)
+    frame.hash[i] = 2166136261u; // FNV-1a
+}
+
+void ghostScanRow(GhostFrame &frame, int y, const uint8_t *row)
+{
+  if (y != frame.rows || y >= frame.height)
+    return; // out of order, the scan stays incomplete
+  int tile = (y / frame.tileH) * GHOST_COLS;
+  int bytes = frame.width / 8;
+  int tileBytes = frame.tileW / 8;
+  for (int x = 0; x < bytes; x += tileBytes, tile++)
+  {
+    int end = x + tileBytes < bytes ? x + tileBytes : bytes;
+    uint32_t hash = frame.hash[tile];
+    int white = 0;
+    for (int i = x; i < end; i++)
+    {
+      hash = (hash ^ row[i]) * 16777619u;
+      white += __builtin_popcount(row[i]);
+    }
+    frame.hash[tile] = hash;
+    frame.ink[tile] += (end - x) * 8 - white;
+  }
+  frame.rows++;
+}
+
+bool ghostScanComplete(const GhostFrame &frame)
+{
+  return frame.height && frame.rows == frame.height;
+}
+
+static uint16_t tileHash(const GhostFrame &frame, int tile)
+{
+  uint16_t hash = (uint16_t)(frame.hash[tile] ^ (frame.hash[tile] >> 16));
+  return hash ? hash : 1; // 0 means not known
+}
+
+// wear a partial update adds to a tile, 0 if it doesn't change it
+static int tileCost(const GhostBudget &budget, const GhostFrame *frame, int tile, int tilePixels)
+{
+  const GhostTile &old = budget.tiles[tile];
+  if (!frame)
+    return GHOST_UNKNOWN_COST;
+  if (old.hash == tileHash(*frame, tile))
+    return 0;
+  if (!old.hash)
+    return GHOST_UNKNOWN_COST;
+  int drift = frame->ink[tile] > old.ink ? frame->ink[tile] - old.ink : old.ink - frame->ink[tile];
+  return GHOST_PARTIAL_COST + (drift * GHOST_DRIFT_COST + tilePixels - 1) / tilePixels;
+}
+
+static bool knownBudget(const GhostBudget &budget, int width, int height)
+{
+  return budget.magic == GHOST_MAGIC && budget.width == width && budget.height == height;
+}
+
+static const GhostFrame *scanned(const GhostFrame *frame, int width, int height)
+{
+  if (frame && ghostScanComplete(*frame) && frame->width == width && frame->height == height)
+    return frame;
+  return nullptr;
+}
+
+GhostDecision ghostDecide(const GhostBudget &budget, const GhostFrame *frame, int width, int height, uint32_t now, bool canClean)
+{
+  GhostDecision decision;
+  memset(&decision, 0, sizeof(decision));
+  if (!knownBudget(budget, width, height))
+  {
+    decision.action = GHOST_FULL;
+    decision.changed = GHOST_TILES;
+    decision.reason = "nothing known about the screen";
+    return decision;
+  }
+  frame = scanned(frame, width, height);
+  if (!frame)
+    canClean = false; // the worn tiles can't be cropped out of an image that wasn't scanned
+
+  int tileW = tileWidth(width), tileH = tileHeight(height);
+  bool idle = budget.refreshedAt && now >= budget.refreshedAt + GHOST_IDLE_SECONDS;
+  int left = GHOST_COLS, top = GHOST_ROWS, right = -1, bottom = -1;
+  for (int i = 0; i < GHOST_TILES; i++)
+  {
+    int cost = tileCost(budget, frame, i, tileW * tileH);
+    if (cost)
+      decision.changed++;
+    if (idle)
+      cost *= 2;
+    int wear = budget.tiles[i].wear + cost;
+    if (wear > decision.maxWear)
+      decision.maxWear = wear;
+    if (wear <= GHOST_TILE_BUDGET)
+      continue;
+    decision.over++;
+    int col = i % GHOST_COLS, row = i / GHOST_COLS;
+    if (col < left)
+      left = col;
+    if (col > right)
+      right = col;
+    if (row < top)
+      top = row;
+    if (row > bottom)
+      bottom = row;
+  }
+
+  if (!decision.over)
+  {
+    decision.action = GHOST_PARTIAL;
+    decision.reason = idle ? "within budget after a long idle time" : "within budget";
+    return decision;
+  }
+  decision.x = left * tileW;
+  decision.y = top * tileH;
+  decision.w = ((right + 1) * tileW < width ? (right + 1) * tileW : width) - decision.x;
+  decision.h = ((bottom + 1) * tileH < height ? (bottom + 1) * tileH : height) - decision.y;
+  if (canClean && (uint32_t)decision.w * decision.h * GHOST_CLEANUP_SHARE <= (uint32_t)width * height)
+  {
+    decision.action = GHOST_CLEANUP;
+    decision.reason = "worn tiles are a small part of the screen";
+  }
+  else if (budget.fasts + 1 >= GHOST_FASTS_PER_FULL)
+  {
+    decision.action = GHOST_FULL;
+    decision.reason = "worn tiles, due for a full refresh";
+  }
+  else
+  {
+    decision.action = GHOST_FAST;
+    decision.reason = canClean ? "worn tiles cover too much of the screen" : "worn tiles, no cleanup possible";
+  }
+  return decision;
+}
+
+void ghostApply(GhostBudget &budget, const GhostFrame *frame, const GhostDecision &decision, int width, int height, uint32_t now)
+{
+  int tileW = tileWidth(width), tileH = tileHeight(height);
+  bool known = knownBudget(budget, width, height);
+  bool idle = budget.refreshedAt && now >= budget.refreshedAt + GHOST_IDLE_SECONDS;
+
+  frame = scanned(frame, width, height);
+  for (int i = 0; i < GHOST_TILES; i++)
+  {
+    GhostTile &tile = budget.tiles[i];
+    int wear = 0;
+    if (!known && (decision.action == GHOST_PARTIAL || decision.action == GHOST_CLEANUP))
+    {
+      wear = GHOST_TILE_BUDGET; // partial update over an unknown screen, e.g. the loading screen after a reset
+    }
+    else if (decision.action == GHOST_PARTIAL || decision.action == GHOST_CLEANUP)
+    {
+      wear = tile.wear + tileCost(budget, frame, i, tileW * tileH) * (idle ? 2 : 1);
+      int x = (i % GHOST_COLS) * tileW, y = (i / GHOST_COLS) * tileH;
+      if (decision.action == GHOST_CLEANUP && x >= decision.x && x < decision.x + decision.w &&
+          y >= decision.y && y < decision.y + decision.h)
+        wear = 0;
+    }
+    else if (decision.action == GHOST_FAST)
+    {
+      wear = GHOST_FAST_WEAR;
+    }
+    tile.wear = wear > 255 ? 255 : wear;
+    tile.hash = frame ? tileHash(*frame, i) : 0;
+    tile.ink = frame ? frame->ink[i] : 0;
+  }
+  if (decision.action == GHOST_FULL)
+    budget.fasts = 0;
+  else if (decision.action == GHOST_FAST)
+    budget.fasts++;
+  else if (!known)
+    budget.fasts = GHOST_FASTS_PER_FULL; // the next cleaning of the whole screen is a full one
+  budget.magic = GHOST_MAGIC;
+  budget.width = width;
+  budget.height = height;
+  budget.refreshedAt = now;
+}
+
+void ghostRefreshed(GhostBudget &budget, int width, int height, bool full, uint32_t now)
+{
+  GhostDecision decision;
+  memset(&decision, 0, sizeof(decision));
+  decision.action = full ? GHOST_FULL : GHOST_FAST;
+  ghostApply(budget, nullptr, decision, width, height, now);
+}
+
+void ghostTouch(GhostBudget &budget, int x, int y, int w, int h)
+{
+  if (budget.magic != GHOST_MAGIC || w <= 0 || h <= 0)
+    return;
+  int tileW = tileWidth(budget.width), tileH = tileHeight(budget.height);
+  for (int row = y / tileH; row <= (y + h - 1) / tileH && row < GHOST_ROWS; row++)
+  {
+    for (int col = x / tileW; col <= (x + w - 1) / tileW && col < GHOST_COLS; col++)
+    {
+      GhostTile &tile = budget.tiles[row * GHOST_COLS + col];
+      int wear = tile.wear + GHOST_UNKNOWN_COST;
+      tile.wear = wear > 255 ? 255 : wear;
+      tile.hash = 0; // the server's next image differs from what is on screen now
+    }
+  }
+}
+
+const char *ghostActionName(GhostAction action)
+{
+  switch (action)
+  {
+  case GHOST_PARTIAL:
+    return "partial";
+  case GHOST_CLEANUP:
+    return "partial + cleanup";
+  case GHOST_FAST:
+    return "fast";
+  case GHOST_FULL:
+    return "full";
+  }
+  return "?";
+}
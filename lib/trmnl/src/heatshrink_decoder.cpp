@@ -0,0 +1,116 @@
+#include <heatshrink_decoder.h>
+#include <string.h>
+
+#define WINDOW_MASK ((1 << HEATSHRINK_WINDOW_BITS) - 1)
+
+HeatshrinkDecoder::HeatshrinkDecoder(OtaSink &output) : output(output)
+{
+  reset();
+}
+
+void HeatshrinkDecoder::reset()
+{
+  state = TAG;
+  bits = 0;
+  bitCount = 0;
+  backrefIndex = 0;
+  head = 0;
+  produced = 0;
+  failed = false;
+  pendingLength = 0;
+  // the encoder treats the history before the first byte as zeros
+  memset(window, 0, sizeof(window));
+}
+
+bool HeatshrinkDecoder::flush()
+{
+  if (pendingLength > 0 && !output.write(pending, pendingLength))
+    failed = true;
+  pendingLength = 0;
+  return !failed;
+}
+
+bool HeatshrinkDecoder::emit(uint8_t c)
+{
+  window[head & WINDOW_MASK] = c;
+  head++;
+  produced++;
+  pending[pendingLength++] = c;
+  if (pendingLength == sizeof(pending))
+    return flush();
+  return true;
+}
+
+bool HeatshrinkDecoder::write(const uint8_t *data, size_t length)
+{
+  if (failed)
+    return false;
+
+  for (size_t i = 0; i < length; i++)
+  {
+    bits = (bits << 8) | data[i];
+    bitCount += 8;
+
+    while (true)
+    {
+      uint8_t need;
+      switch (state)
+      {
+      case TAG:
+        need = 1;
+        break;
+      case LITERAL:
+        need = 8;
+        break;
+      case BACKREF_INDEX:
+        need = HEATSHRINK_WINDOW_BITS;
+        break;
+      default:
+        need = HEATSHRINK_LOOKAHEAD_BITS;
+        break;
+      }
+      if (bitCount < need)
+        break;
+
+      bitCount -= need;
+      uint16_t value = (bits >> bitCount) & ((1 << need) - 1);
+
+      switch (state)
+      {
+      case TAG:
+        state = value ? LITERAL : BACKREF_INDEX;
+        break;
+      case LITERAL:
+        if (!emit(value))
+          return false;
+        state = TAG;
+        break;
+      case BACKREF_INDEX:
+        backrefIndex = value + 1;
+        state = BACKREF_COUNT;
+        break;
+      case BACKREF_COUNT:
+        for (uint16_t n = 0; n <= value; n++)
+        {
+          if (!emit(window[(head - backrefIndex) & WINDOW_MASK]))
+            return false;
+        }
+        state = TAG;
+        break;
+      }
+    }
+  }
+
+  return flush();
+}
+
+bool HeatshrinkDecoder::finish()
+{
+  if (!flush())
+    return false;
+
+  // the encoder pads the last byte with zero bits, which read as the start of a back-reference
+  bool padding = state == TAG || state == BACKREF_INDEX;
+  bool zeros = (bits & ((1 << bitCount) - 1)) == 0;
+  return padding && zeros;
+}
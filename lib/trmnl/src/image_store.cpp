@@ -0,0 +1,378 @@
+#include <image_store.h>
+#include <ota_stream.h>
+#include <string.h>
+
+static_assert(sizeof(ImageRecord) == 64, "records are 64 bytes on every platform");
+
+static size_t alignUp(size_t value, size_t align)
+{
+  return (value + align - 1) / align * align;
+}
+
+static uint32_t headerCrc(const ImageRecord &record)
+{
+  return ota_crc32(0, (const uint8_t *)&record, offsetof(ImageRecord, headerCrc));
+}
+
+static bool validName(const char *name)
+{
+  return name && name[0] && strlen(name) < IMAGE_STORE_NAME_SIZE;
+}
+
+ImageStore::ImageStore(ImageFlash &flash)
+    : flash(flash), mounted(false), head(0), erasedEnd(0), nextSeq(1), indexUsed(0), indexComplete(true),
+      pending(false), pendingMax(0), pendingSize(0), pendingCrc(0)
+{
+  pendingName[0] = 0;
+}
+
+const ImageRecord *ImageStore::recordAt(size_t offset) const
+{
+  if (offset % IMAGE_STORE_ALIGN || offset + sizeof(ImageRecord) > flash.size())
+    return nullptr;
+  const ImageRecord *record = (const ImageRecord *)(flash.data() + offset);
+  if (record->magic != IMAGE_STORE_MAGIC || record->headerCrc != headerCrc(*record))
+    return nullptr;
+  if (record->kind > IMAGE_RECORD_DELETED || record->size > flash.size() - offset - sizeof(ImageRecord))
+    return nullptr;
+  return record;
+}
+
+// the record at or after offset; offset moves past it
+const ImageRecord *ImageStore::next(size_t &offset) const
+{
+  for (; offset + sizeof(ImageRecord) <= flash.size(); offset += IMAGE_STORE_ALIGN)
+  {
+    const ImageRecord *record = recordAt(offset);
+    if (record)
+    {
+      offset = alignUp(offset + sizeof(ImageRecord) + record->size, IMAGE_STORE_ALIGN);
+      return record;
+    }
+  }
+  return nullptr;
+}
+
+bool ImageStore::mount()
+{
+  size_t sector = flash.sectorSize();
+  mounted = false;
+  pending = false;
+  if (!flash.data() || !sector || flash.size() < 2 * sector || flash.size() % sector)
+    return false;
+
+  const ImageRecord *newest = nullptr;
+  size_t offset = 0, newestEnd = 0;
+  indexUsed = 0;
+  indexComplete = true;
+  while (const ImageRecord *record = next(offset))
+  {
+    remember((const uint8_t *)record - flash.data(), false);
+    if (!newest || record->seq > newest->seq)
+    {
+      newest = record;
+      newestEnd = offset;
+    }
+  }
+  nextSeq = newest ? newest->seq + 1 : 1;
+  head = newestEnd;
+
+  // the rest of the head's sector can only be used if a write that was cut short left nothing there
+  size_t sectorEnd = alignUp(head, sector);
+  bool clean = true;
+  for (size_t i = head; i < sectorEnd && clean; i++)
+    clean = flash.data()[i] == 0xff;
+  if (!clean)
+    head = sectorEnd;
+  erasedEnd = clean ? sectorEnd : head;
+  mounted = true;
+  return true;
+}
+
+// slot of the index holding the newest record of name, -1 if none does
+int ImageStore::indexOf(const char *name) const
+{
+  for (int i = 0; i < indexUsed; i++)
+  {
+    const ImageRecord *record = recordAt(index[i].offset);
+    if (record && record->seq == index[i].seq && strncmp(record->name, name, IMAGE_STORE_NAME_SIZE) == 0)
+      return i;
+  }
+  return -1;
+}
+
+// a slot for another name, -1 when the index is full
+int ImageStore::indexSlot()
+{
+  if (indexUsed < IMAGE_STORE_INDEX_SIZE)
+    return indexUsed++;
+  // names that are gone: their record was erased, or says they were removed
+  for (int i = 0; i < indexUsed; i++)
+  {
+    const ImageRecord *record = recordAt(index[i].offset);
+    if (!record || record->seq != index[i].seq || record->kind == IMAGE_RECORD_DELETED)
+      return i;
+  }
+  return -1;
+}
+
+// put the record at offset in the index if it is the newest of its name
+void ImageStore::remember(size_t offset, bool evict)
+{
+  const ImageRecord *record = recordAt(offset);
+  if (!record)
+    return;
+  int slot = indexOf(record->name);
+  if (slot >= 0 && index[slot].seq > record->seq)
+    return; // mount() reads the log in flash order, not in age
+  if (slot < 0)
+  {
+    slot = indexSlot();
+    if (slot < 0 && record->kind == IMAGE_RECORD_DELETED)
+      return; // a name that isn't there has nothing to hide
+    if (slot < 0)
+    {
+      indexComplete = false;
+      // while mounting a name that was left out may still show up with an older record
+      if (!evict)
+        return;
+      slot = 0;
+      for (int i = 1; i < indexUsed; i++)
+        if (index[i].seq < index[slot].seq)
+          slot = i;
+    }
+  }
+  index[slot].offset = (uint32_t)offset;
+  index[slot].seq = record->seq;
+  index[slot].verified = false;
+}
+
+ImageStore::Found ImageStore::lookup(const char *name) const
+{
+  Found found = {nullptr, nullptr, -1};
+  if (!mounted || !validName(name))
+    return found;
+  found.slot = indexOf(name);
+  if (found.slot >= 0)
+  {
+    found.record = recordAt(index[found.slot].offset);
+  }
+  else if (!indexComplete)
+  {
+    size_t offset = 0;
+    while (const ImageRecord *record = next(offset))
+    {
+      if (strncmp(record->name, name, IMAGE_STORE_NAME_SIZE) == 0 && (!found.record || record->seq > found.record->seq))
+        found.record = record;
+    }
+  }
+  if (!found.record)
+    return found;
+  if (found.record->kind == IMAGE_RECORD_DATA)
+  {
+    found.data = found.record;
+  }
+  else if (found.record->kind == IMAGE_RECORD_LINK)
+  {
+    const ImageRecord *target = recordAt(found.record->target);
+    if (target && target->kind == IMAGE_RECORD_DATA && target->seq == found.record->targetSeq)
+      found.data = target;
+  }
+  return found;
+}
+
+const uint8_t *ImageStore::find(const char *name, size_t &size) const
+{
+  Found found = lookup(name);
+  if (!found.data)
+    return nullptr;
+  const uint8_t *data = (const uint8_t *)(found.data + 1);
+  // the data doesn't change once written, it only needs checking once
+  if (found.slot < 0 || !index[found.slot].verified)
+  {
+    if (ota_crc32(0, data, found.data->size) != found.data->crc)
+      return nullptr;
+    if (found.slot >= 0)
+      index[found.slot].verified = true;
+  }
+  size = found.data->size;
+  return data;
+}
+
+bool ImageStore::exists(const char *name) const
+{
+  return lookup(name).data != nullptr;
+}
+
+bool ImageStore::reserve(size_t length)
+{
+  if (!mounted || length > flash.size())
+    return false;
+  if (head + length > flash.size())
+  {
+    head = 0; // start over, the oldest records are erased as the head passes them
+    erasedEnd = 0;
+  }
+  return true;
+}
+
+bool ImageStore::program(size_t offset, const uint8_t *data, size_t length)
+{
+  size_t end = offset + length;
+  if (end > erasedEnd)
+  {
+    size_t to = alignUp(end, flash.sectorSize());
+    if (!flash.erase(erasedEnd, to - erasedEnd))
+      return false;
+    erasedEnd = to;
+  }
+  return flash.write(offset, data, length);
+}
+
+// after a failed write: nothing is known to be erased past what was programmed
+void ImageStore::skip(size_t end)
+{
+  head = alignUp(end, flash.sectorSize());
+  erasedEnd = head;
+}
+
+bool ImageStore::putHeader(size_t offset, ImageRecordKind kind, const char *name, uint32_t size, uint32_t crc, const ImageRecord *target)
+{
+  ImageRecord record;
+  memset(&record, 0, sizeof(record));
+  record.magic = IMAGE_STORE_MAGIC;
+  record.seq = nextSeq++;
+  record.size = size;
+  record.crc = crc;
+  if (target)
+  {
+    record.target = (uint32_t)((const uint8_t *)target - flash.data());
+    record.targetSeq = target->seq;
+  }
+  record.kind = kind;
+  strncpy(record.name, name, IMAGE_STORE_NAME_SIZE - 1);
+  record.headerCrc = headerCrc(record);
+  if (!program(offset, (const uint8_t *)&record, sizeof(record)))
+    return false;
+  remember(offset, true);
+  return true;
+}
+
+bool ImageStore::write(const char *name, const uint8_t *data, size_t size)
+{
+  if (pending || !validName(name) || !reserve(alignUp(sizeof(ImageRecord) + size, IMAGE_STORE_ALIGN)))
+    return false;
+  size_t at = head;
+  // the data first: without its header a record that was cut short doesn't exist
+  if (!program(at + sizeof(ImageRecord), data, size) ||
+      !putHeader(at, IMAGE_RECORD_DATA, name, size, ota_crc32(0, data, size), nullptr))
+  {
+    skip(at + sizeof(ImageRecord) + size);
+    return false;
+  }
+  head = alignUp(at + sizeof(ImageRecord) + size, IMAGE_STORE_ALIGN);
+  return true;
+}
+
+bool ImageStore::begin(const char *name, size_t maxSize)
+{
+  if (pending || !validName(name) || !reserve(alignUp(sizeof(ImageRecord) + maxSize, IMAGE_STORE_ALIGN)))
+    return false;
+  pending = true;
+  pendingMax = maxSize;
+  pendingSize = 0;
+  pendingCrc = 0;
+  strncpy(pendingName, name, IMAGE_STORE_NAME_SIZE);
+  return true;
+}
+
+bool ImageStore::append(const uint8_t *data, size_t length)
+{
+  if (!pending)
+    return false;
+  if (length > pendingMax - pendingSize || !program(head + sizeof(ImageRecord) + pendingSize, data, length))
+  {
+    abort();
+    return false;
+  }
+  pendingSize += length;
+  pendingCrc = ota_crc32(pendingCrc, data, length);
+  return true;
+}
+
+bool ImageStore::commit()
+{
+  if (!pending)
+    return false;
+  pending = false;
+  if (!putHeader(head, IMAGE_RECORD_DATA, pendingName, pendingSize, pendingCrc, nullptr))
+  {
+    skip(head + sizeof(ImageRecord) + pendingSize);
+    return false;
+  }
+  head = alignUp(head + sizeof(ImageRecord) + pendingSize, IMAGE_STORE_ALIGN);
+  return true;
+}
+
+void ImageStore::abort()
+{
+  if (!pending)
+    return;
+  pending = false;
+  if (pendingSize)
+    skip(head + sizeof(ImageRecord) + pendingSize);
+}
+
+bool ImageStore::appendRecord(ImageRecordKind kind, const char *name, const ImageRecord *target)
+{
+  if (!reserve(sizeof(ImageRecord)))
+    return false;
+  if (!putHeader(head, kind, name, 0, 0, target))
+  {
+    skip(head + sizeof(ImageRecord));
+    return false;
+  }
+  head += sizeof(ImageRecord);
+  return true;
+}
+
+bool ImageStore::rename(const char *from, const char *to)
+{
+  if (pending || !validName(to))
+    return false;
+  Found found = lookup(from);
+  const ImageRecord *target = found.data;
+  if (!target)
+    return false;
+  if (strcmp(from, to) == 0)
+    return true;
+  if (!reserve(2 * sizeof(ImageRecord)))
+    return false;
+  // the link must not erase the image it points to
+  size_t start = (const uint8_t *)target - flash.data();
+  size_t eraseTo = alignUp(head + 2 * sizeof(ImageRecord), flash.sectorSize());
+  if (eraseTo > erasedEnd && start < eraseTo && start + sizeof(ImageRecord) + target->size > erasedEnd)
+    return false;
+  bool verified = found.slot >= 0 && index[found.slot].verified;
+  if (!appendRecord(IMAGE_RECORD_LINK, to, target))
+    return false;
+  int slot = indexOf(to);
+  if (slot >= 0)
+    index[slot].verified = verified;
+  return appendRecord(IMAGE_RECORD_DELETED, from, nullptr);
+}
+
+bool ImageStore::remove(const char *name)
+{
+  if (pending)
+    return false;
+  const ImageRecord *record = lookup(name).record;
+  if (!record || record->kind == IMAGE_RECORD_DELETED)
+    return false;
+  return appendRecord(IMAGE_RECORD_DELETED, name, nullptr);
+}
+
+size_t ImageStore::capacity() const
+{
+  return flash.size() > sizeof(ImageRecord) ? flash.size() - sizeof(ImageRecord) : 0;
+}
@@ -0,0 +1,54 @@
+#include <message_cache.h>
+#include <ota_stream.h>
+#include <stdio.h>
+#include <string.h>
+
+static uint16_t readLe16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void writeLe16(uint8_t *p, uint16_t value)
+{
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+}
+
+MessageCacheKey::MessageCacheKey(uint8_t type) : crc(ota_crc32(0, &type, 1)) {}
+
+MessageCacheKey &MessageCacheKey::add(const char *text)
+{
+  if (!text)
+    text = "";
+  crc = ota_crc32(crc, (const uint8_t *)text, strlen(text) + 1);
+  return *this;
+}
+
+MessageCacheKey &MessageCacheKey::add(const uint8_t *data, size_t length)
+{
+  crc = ota_crc32(crc, data, length);
+  return *this;
+}
+
+void MessageCacheKey::fileName(char *name, size_t size) const
+{
+  snprintf(name, size, MESSAGE_CACHE_PREFIX "%08x.g5", (unsigned int)crc);
+}
+
+void messageCacheHeader(uint8_t *header, uint16_t width, uint16_t height, uint16_t dataSize)
+{
+  writeLe16(header, MESSAGE_CACHE_MARKER);
+  writeLe16(header + 2, width);
+  writeLe16(header + 4, height);
+  writeLe16(header + 6, dataSize);
+}
+
+bool messageCacheValid(const uint8_t *data, size_t size, uint16_t width, uint16_t height)
+{
+  if (!data || size <= MESSAGE_CACHE_HEADER_SIZE)
+    return false;
+  return readLe16(data) == MESSAGE_CACHE_MARKER &&
+         readLe16(data + 2) == width &&
+         readLe16(data + 4) == height &&
+         readLe16(data + 6) == size - MESSAGE_CACHE_HEADER_SIZE;
+}
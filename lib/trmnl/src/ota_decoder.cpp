@@ -0,0 +1,109 @@
+#include <ota_decoder.h>
+#include <string.h>
+
+uint32_t ota_crc32(uint32_t crc, const uint8_t *data, size_t length)
+{
+  static const uint32_t table[16] = {
+      0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+      0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c};
+
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++)
+  {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ table[crc & 0x0f];
+    crc = (crc >> 4) ^ table[crc & 0x0f];
+  }
+  return ~crc;
+}
+
+OtaEncoding parseOtaEncoding(const char *value)
+{
+  if (!value)
+    return OtaEncoding::RAW;
+  if (strcmp(value, "heatshrink") == 0)
+    return OtaEncoding::HEATSHRINK;
+  if (strcmp(value, "delta") == 0)
+    return OtaEncoding::DELTA;
+  if (strcmp(value, "delta+heatshrink") == 0)
+    return OtaEncoding::DELTA_HEATSHRINK;
+  return OtaEncoding::RAW;
+}
+
+const char *otaEncodingToString(OtaEncoding encoding)
+{
+  switch (encoding)
+  {
+  case OtaEncoding::HEATSHRINK:
+    return "heatshrink";
+  case OtaEncoding::DELTA:
+    return "delta";
+  case OtaEncoding::DELTA_HEATSHRINK:
+    return "delta+heatshrink";
+  default:
+    return "raw";
+  }
+}
+
+OtaDecoder::OtaDecoder(OtaEncoding encoding, OtaSource &oldImage, OtaSink &output)
+    : encoding(encoding),
+      output(output),
+      delta(oldImage, output),
+      heatshrink(encoding == OtaEncoding::DELTA_HEATSHRINK ? (OtaSink &)delta : output),
+      consumed(0),
+      errorMessage(nullptr)
+{
+  switch (encoding)
+  {
+  case OtaEncoding::HEATSHRINK:
+  case OtaEncoding::DELTA_HEATSHRINK:
+    input = &heatshrink;
+    break;
+  case OtaEncoding::DELTA:
+    input = &delta;
+    break;
+  default:
+    input = &output;
+    break;
+  }
+}
+
+bool OtaDecoder::write(const uint8_t *data, size_t length)
+{
+  if (errorMessage)
+    return false;
+
+  consumed += length;
+  if (input->write(data, length))
+    return true;
+
+  errorMessage = delta.error() ? delta.error() : "Decoding failed";
+  return false;
+}
+
+bool OtaDecoder::finish()
+{
+  if (errorMessage)
+    return false;
+
+  if (input == &heatshrink && !heatshrink.finish())
+    errorMessage = delta.error() ? delta.error() : "Compressed stream is truncated";
+  else if ((encoding == OtaEncoding::DELTA || encoding == OtaEncoding::DELTA_HEATSHRINK) && !delta.finish())
+    errorMessage = delta.error();
+
+  return errorMessage == nullptr;
+}
+
+uint32_t OtaDecoder::bytesOut() const
+{
+  switch (encoding)
+  {
+  case OtaEncoding::HEATSHRINK:
+    return heatshrink.bytesOut();
+  case OtaEncoding::DELTA:
+  case OtaEncoding::DELTA_HEATSHRINK:
+    return delta.bytesOut();
+  default:
+    return consumed;
+  }
+}
@@ -0,0 +1,217 @@
+#include <overlay_widgets.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct OverlaySourceName
+{
+  const char *name;
+  OverlaySource source;
+};
+
+static const OverlaySourceName overlaySources[] = {
+    {"time", OVERLAY_TIME},
+    {"time12", OVERLAY_TIME12},
+    {"battery", OVERLAY_BATTERY},
+    {"rssi", OVERLAY_RSSI},
+    {"offline", OVERLAY_OFFLINE},
+};
+
+/** Read a decimal number that ends at ',', ';' or the end of the spec */
+static bool readNumber(const char *&p, long &value)
+{
+  char *end;
+  value = strtol(p, &end, 10);
+  if (end == p || (*end != ',' && *end != ';' && *end != '\0'))
+    return false;
+  p = end;
+  return true;
+}
+
+static bool readField(const char *&p, long &value)
+{
+  if (*p != ',')
+    return false;
+  p++;
+  return readNumber(p, value);
+}
+
+static const char *parseWidget(const char *&p, int width, int height, OverlayWidget &widget)
+{
+  size_t length = strcspn(p, ",;");
+  int source = -1;
+  for (const auto &entry : overlaySources)
+  {
+    if (strlen(entry.name) == length && strncmp(p, entry.name, length) == 0)
+      source = entry.source;
+  }
+  if (source < 0)
+    return "Unknown overlay source";
+  p += length;
+
+  long x, y, w, h, font = DL_FONT_SMALL, color = DL_BLACK;
+  if (!readField(p, x) || !readField(p, y) || !readField(p, w) || !readField(p, h))
+    return "Overlay widget needs x,y,w,h";
+  if (*p == ',' && !readField(p, font))
+    return "Bad overlay font";
+  if (*p == ',' && !readField(p, color))
+    return "Bad overlay color";
+  if (*p != ';' && *p != '\0')
+    return "Overlay widget has extra fields";
+  if (x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > width || y + h > height)
+    return "Overlay widget is off the screen";
+  if (font < 0 || font >= DL_FONT_COUNT)
+    return "Bad overlay font";
+  if (color != DL_BLACK && color != DL_WHITE)
+    return "Bad overlay color";
+
+  memset(&widget, 0, sizeof(widget));
+  widget.source = source;
+  widget.font = font;
+  widget.color = color;
+  widget.x = x;
+  widget.y = y;
+  widget.w = w;
+  widget.h = h;
+  return nullptr;
+}
+
+const char *overlayParse(const char *spec, int width, int height, OverlayPlan &plan)
+{
+  memset(&plan, 0, sizeof(plan));
+  plan.interval = OVERLAY_DEFAULT_INTERVAL;
+
+  const char *p = spec;
+  while (*p)
+  {
+    long value;
+    if (strncmp(p, "utc=", 4) == 0)
+    {
+      p += 4;
+      if (!readNumber(p, value) || value < -12 * 60 || value > 14 * 60)
+        return "Bad overlay utc offset";
+      plan.utcOffset = value;
+    }
+    else if (strncmp(p, "every=", 6) == 0)
+    {
+      p += 6;
+      if (!readNumber(p, value) || value < 60 || value > 86400)
+        return "Bad overlay interval";
+      plan.interval = value;
+    }
+    else
+    {
+      if (plan.count == OVERLAY_MAX_WIDGETS)
+        return "Too many overlay widgets";
+      const char *error = parseWidget(p, width, height, plan.widgets[plan.count]);
+      if (error)
+        return error;
+      plan.count++;
+    }
+    if (*p == ';')
+      p++;
+  }
+  if (plan.count == 0)
+    return "No overlay widgets";
+  return nullptr;
+}
+
+static bool sameBox(const OverlayWidget &a, const OverlayWidget &b)
+{
+  return a.source == b.source && a.font == b.font && a.color == b.color &&
+         a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+}
+
+void overlayStart(OverlayPlan &plan, const OverlayPlan &previous, bool newImage, uint32_t now, uint32_t refreshRate)
+{
+  bool keepTexts = !newImage && previous.magic == OVERLAY_MAGIC;
+  for (uint8_t i = 0; i < plan.count; i++)
+  {
+    if (keepTexts && i < previous.count && sameBox(plan.widgets[i], previous.widgets[i]))
+      memcpy(plan.widgets[i].text, previous.widgets[i].text, OVERLAY_TEXT_SIZE);
+    else
+      plan.widgets[i].text[0] = '\0';
+  }
+  plan.magic = OVERLAY_MAGIC;
+  plan.onlineAt = now + refreshRate;
+}
+
+void overlayStop(OverlayPlan &plan)
+{
+  memset(&plan, 0, sizeof(plan));
+}
+
+bool overlayDue(const OverlayPlan &plan, uint32_t now)
+{
+  // without a synced clock the time widgets would be wrong and onlineAt meaningless
+  return plan.magic == OVERLAY_MAGIC && plan.count > 0 && now > 0 && now < plan.onlineAt;
+}
+
+uint32_t overlaySleepTime(const OverlayPlan &plan, uint32_t now)
+{
+  if (!overlayDue(plan, now))
+    return 0;
+  // updates are aligned to the local clock, e.g. at the start of every minute
+  int64_t local = (int64_t)now + plan.utcOffset * 60;
+  uint32_t next = plan.interval - (uint32_t)(local % plan.interval) + OVERLAY_WAKE_SLACK;
+  uint32_t left = plan.onlineAt - now;
+  return next < left ? next : left;
+}
+
+int overlayBatteryPercent(float voltage)
+{
+  // typical resting discharge curve of a single Li-ion cell
+  static const float volts[] = {3.00f, 3.45f, 3.68f, 3.74f, 3.77f, 3.79f, 3.82f, 3.87f, 3.92f, 3.98f, 4.06f, 4.20f};
+  static const uint8_t percent[] = {0, 5, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100};
+  const int count = sizeof(volts) / sizeof(volts[0]);
+
+  if (voltage <= volts[0])
+    return 0;
+  for (int i = 1; i < count; i++)
+  {
+    if (voltage < volts[i])
+      return percent[i - 1] + (int)((voltage - volts[i - 1]) * (percent[i] - percent[i - 1]) / (volts[i] - volts[i - 1]));
+  }
+  return 100;
+}
+
+void overlayText(const OverlayPlan &plan, const OverlayWidget &widget, const OverlayInputs &inputs, char *text, size_t size)
+{
+  int64_t local = (int64_t)inputs.now + plan.utcOffset * 60;
+  int minutes = (int)(((local % 86400) + 86400) % 86400 / 60);
+  int hour = minutes / 60;
+
+  switch (widget.source)
+  {
+  case OVERLAY_TIME:
+    snprintf(text, size, "%02d:%02d", hour, minutes % 60);
+    break;
+  case OVERLAY_TIME12:
+    snprintf(text, size, "%d:%02d %s", hour % 12 == 0 ? 12 : hour % 12, minutes % 60, hour < 12 ? "AM" : "PM");
+    break;
+  case OVERLAY_BATTERY:
+    snprintf(text, size, "%d%%", overlayBatteryPercent(inputs.batteryVoltage));
+    break;
+  case OVERLAY_RSSI:
+    snprintf(text, size, "%d dBm", inputs.rssi);
+    break;
+  case OVERLAY_OFFLINE:
+    snprintf(text, size, "%s", inputs.offline ? "offline" : "");
+    break;
+  default:
+    text[0] = '\0';
+    break;
+  }
+}
+
+uint8_t overlayRender(const OverlayPlan &plan, const OverlayInputs &inputs, char texts[][OVERLAY_TEXT_SIZE])
+{
+  uint8_t changed = 0;
+  for (uint8_t i = 0; i < plan.count; i++)
+  {
+    overlayText(plan, plan.widgets[i], inputs, texts[i], OVERLAY_TEXT_SIZE);
+    if (strcmp(texts[i], plan.widgets[i].text) != 0)
+      changed |= 1 << i;
+  }
+  return changed;
+}
@@ -1,44 +1,625 @@
-
-#include <ArduinoJson.h>
 #include "api_response_parsing.h"
+#include "api_display_parser.h"
 #include <trmnl_log.h>
 #include <special_function.h>
+#include <string.h>
+
+enum ApiDisplayField : uint8_t
+{
+  FIELD_UNKNOWN,
+  FIELD_STATUS,
+  FIELD_IMAGE_URL,
+  FIELD_IMAGE_URL_TIMEOUT,
+  FIELD_FILENAME,
+  FIELD_UPDATE_FIRMWARE,
+  FIELD_MAXIMUM_COMPATIBILITY,
+  FIELD_FIRMWARE_URL,
+  FIELD_REFRESH_RATE,
+  FIELD_TEMPERATURE_PROFILE,
+  FIELD_RESET_FIRMWARE,
+  FIELD_SPECIAL_FUNCTION,
+  FIELD_ACTION,
+  FIELD_FIRMWARE_ENCODING,
+  FIELD_BUNDLE_URL,
+  FIELD_BUNDLE_VALID_FOR,
+  FIELD_DISPLAY_LIST,
+  FIELD_OVERLAY,
+  FIELD_DELTA_URL,
+};
+
+struct ApiDisplayKey
+{
+  const char *name;
+  ApiDisplayField field;
+};
+
+static const ApiDisplayKey apiDisplayKeys[] = {
+    {"status", FIELD_STATUS},
+    {"image_url", FIELD_IMAGE_URL},
+    {"image_url_timeout", FIELD_IMAGE_URL_TIMEOUT},
+    {"filename", FIELD_FILENAME},
+    {"update_firmware", FIELD_UPDATE_FIRMWARE},
+    {"maximum_compatibility", FIELD_MAXIMUM_COMPATIBILITY},
+    {"firmware_url", FIELD_FIRMWARE_URL},
+    {"refresh_rate", FIELD_REFRESH_RATE},
+    {"temperature_profile", FIELD_TEMPERATURE_PROFILE},
+    {"reset_firmware", FIELD_RESET_FIRMWARE},
+    {"special_function", FIELD_SPECIAL_FUNCTION},
+    {"action", FIELD_ACTION},
+    {"firmware_encoding", FIELD_FIRMWARE_ENCODING},
+    {"bundle_url", FIELD_BUNDLE_URL},
+    {"bundle_valid_for", FIELD_BUNDLE_VALID_FOR},
+    {"display_list", FIELD_DISPLAY_LIST},
+    {"overlay", FIELD_OVERLAY},
+    {"delta_url", FIELD_DELTA_URL},
+};
+
+static bool isWhitespace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static int base64Value(char c)
+{
+  if (c >= 'A' && c <= 'Z')
+    return c - 'A';
+  if (c >= 'a' && c <= 'z')
+    return c - 'a' + 26;
+  if (c >= '0' && c <= '9')
+    return c - '0' + 52;
+  if (c == '+')
+    return 62;
+  if (c == '/')
+    return 63;
+  return -1;
+}
+
+static int hexValue(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
 
-ApiDisplayResponse parseResponse_apiDisplay(String &payload)
+ApiDisplayParser::ApiDisplayParser(ApiDisplayResponse &response)
+    : response(response), state(EXPECT_ROOT), field(FIELD_UNKNOWN), readingKey(false),
+      dest(nullptr), destSize(0), destLength(0), wasTruncated(false),
+      number(0), numberNegative(false), numberFraction(false), numberOverflow(false),
+      literal(nullptr), literalPos(0), unicode(0), unicodeDigits(0),
+      nestedDepth(0), nestedString(false), nestedEscape(false),
+      base64(false), base64Invalid(false), base64Bits(0), base64BitCount(0)
 {
-  JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, payload);
+  response.outcome = ApiDisplayOutcome::DeserializationError;
+  response.error_detail.clear();
+  response.status = 0;
+  response.image_url.clear();
+  response.image_url_timeout = 0;
+  response.filename.clear();
+  response.update_firmware = false;
+  response.maximum_compatibility = false;
+  response.firmware_url.clear();
+  response.firmware_encoding = OtaEncoding::RAW;
+  response.refresh_rate = 0;
+  response.temp_profile = 0;
+  response.reset_firmware = false;
+  response.special_function = SF_NONE;
+  response.action.clear();
+  response.bundle_url.clear();
+  response.bundle_valid_for = 0;
+  response.display_list_size = 0;
+  response.overlay.clear();
+  response.delta_url.clear();
+  key[0] = '\0';
+  temperatureProfile[0] = '\0';
+  specialFunction[0] = '\0';
+  firmwareEncoding[0] = '\0';
+}
+
+bool ApiDisplayParser::feed(const char *data, size_t length)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    if (!step(data[i]))
+      return false;
+  }
+  return state != FAILED;
+}
 
-  if (error)
+bool ApiDisplayParser::fail(const char *reason)
+{
+  if (state != FAILED)
+  {
+    response.error_detail = reason;
+    state = FAILED;
+  }
+  return false;
+}
+
+void ApiDisplayParser::beginString(bool isKey)
+{
+  readingKey = isKey;
+  destLength = 0;
+  base64 = false;
+  if (isKey)
+  {
+    dest = key;
+    destSize = sizeof(key);
+  }
+  else
+  {
+    switch (field)
+    {
+    case FIELD_IMAGE_URL:
+      dest = response.image_url.data();
+      destSize = response.image_url.capacity() + 1;
+      break;
+    case FIELD_FILENAME:
+      dest = response.filename.data();
+      destSize = response.filename.capacity() + 1;
+      break;
+    case FIELD_FIRMWARE_URL:
+      dest = response.firmware_url.data();
+      destSize = response.firmware_url.capacity() + 1;
+      break;
+    case FIELD_ACTION:
+      dest = response.action.data();
+      destSize = response.action.capacity() + 1;
+      break;
+    case FIELD_BUNDLE_URL:
+      dest = response.bundle_url.data();
+      destSize = response.bundle_url.capacity() + 1;
+      break;
+    case FIELD_OVERLAY:
+      dest = response.overlay.data();
+      destSize = response.overlay.capacity() + 1;
+      break;
+    case FIELD_DELTA_URL:
+      dest = response.delta_url.data();
+      destSize = response.delta_url.capacity() + 1;
+      break;
+    case FIELD_TEMPERATURE_PROFILE:
+      dest = temperatureProfile;
+      destSize = sizeof(temperatureProfile);
+      break;
+    case FIELD_SPECIAL_FUNCTION:
+      dest = specialFunction;
+      destSize = sizeof(specialFunction);
+      break;
+    case FIELD_FIRMWARE_ENCODING:
+      dest = firmwareEncoding;
+      destSize = sizeof(firmwareEncoding);
+      break;
+    case FIELD_DISPLAY_LIST:
+      dest = nullptr; // bytes go straight to response.display_list
+      destSize = 0;
+      base64 = true;
+      base64Invalid = false;
+      base64Bits = 0;
+      base64BitCount = 0;
+      response.display_list_size = 0;
+      break;
+    default:
+      dest = nullptr; // value of a non-string or unknown field is discarded
+      destSize = 0;
+      break;
+    }
+  }
+  state = IN_STRING;
+}
+
+void ApiDisplayParser::appendChar(char c)
+{
+  if (base64)
+    appendBase64(c);
+  if (!dest)
+    return;
+
+  if (destLength + 1 < destSize)
+  {
+    dest[destLength++] = c;
+  }
+  else if (readingKey)
+  {
+    // longer than any known key; make sure it can't match one
+    key[0] = '\0';
+    dest = nullptr;
+  }
+  else
+  {
+    wasTruncated = true;
+  }
+}
+
+void ApiDisplayParser::appendBase64(char c)
+{
+  if (base64Invalid || c == '=' || isWhitespace(c))
+    return;
+
+  int value = base64Value(c);
+  if (value < 0)
+  {
+    base64Invalid = true;
+    return;
+  }
+  base64Bits = (base64Bits << 6) | value;
+  base64BitCount += 6;
+  if (base64BitCount < 8)
+    return;
+
+  base64BitCount -= 8;
+  if (response.display_list_size < API_DISPLAY_LIST_SIZE)
+  {
+    response.display_list[response.display_list_size++] = (uint8_t)(base64Bits >> base64BitCount);
+  }
+  else
+  {
+    // a partial list is of no use; the image_url is shown instead
+    wasTruncated = true;
+    base64Invalid = true;
+  }
+}
+
+void ApiDisplayParser::appendCodepoint(uint16_t codepoint)
+{
+  // surrogate halves are encoded separately; none of the fields we keep need them
+  if (codepoint < 0x80)
+  {
+    appendChar((char)codepoint);
+  }
+  else if (codepoint < 0x800)
+  {
+    appendChar((char)(0xC0 | (codepoint >> 6)));
+    appendChar((char)(0x80 | (codepoint & 0x3F)));
+  }
+  else
+  {
+    appendChar((char)(0xE0 | (codepoint >> 12)));
+    appendChar((char)(0x80 | ((codepoint >> 6) & 0x3F)));
+    appendChar((char)(0x80 | (codepoint & 0x3F)));
+  }
+}
+
+void ApiDisplayParser::endString()
+{
+  if (dest)
+    dest[destLength] = '\0';
+
+  if (base64)
+  {
+    if (base64Invalid)
+    {
+      Log_error("display_list dropped: not base64 or larger than %d bytes", API_DISPLAY_LIST_SIZE);
+      response.display_list_size = 0;
+    }
+    base64 = false;
+  }
+
+  if (readingKey)
+  {
+    field = FIELD_UNKNOWN;
+    if (dest)
+    {
+      for (const auto &entry : apiDisplayKeys)
+      {
+        if (strcmp(key, entry.name) == 0)
+        {
+          field = entry.field;
+          break;
+        }
+      }
+    }
+    state = EXPECT_COLON;
+  }
+  else
+  {
+    state = EXPECT_COMMA_OR_END;
+  }
+  dest = nullptr;
+}
+
+void ApiDisplayParser::endNumber()
+{
+  // same conversions as ArduinoJson: out-of-range values become 0, fractions are truncated
+  uint64_t value = (numberNegative || numberOverflow) ? 0 : number;
+  switch (field)
+  {
+  case FIELD_STATUS:
+    response.status = value;
+    break;
+  case FIELD_REFRESH_RATE:
+    response.refresh_rate = value;
+    break;
+  case FIELD_IMAGE_URL_TIMEOUT:
+    response.image_url_timeout = value > UINT32_MAX ? 0 : (uint32_t)value;
+    break;
+  case FIELD_BUNDLE_VALID_FOR:
+    response.bundle_valid_for = value > UINT32_MAX ? 0 : (uint32_t)value;
+    break;
+  case FIELD_UPDATE_FIRMWARE:
+    response.update_firmware = number != 0;
+    break;
+  case FIELD_MAXIMUM_COMPATIBILITY:
+    response.maximum_compatibility = number != 0;
+    break;
+  case FIELD_RESET_FIRMWARE:
+    response.reset_firmware = number != 0;
+    break;
+  default:
+    break;
+  }
+  state = EXPECT_COMMA_OR_END;
+}
+
+void ApiDisplayParser::endLiteral()
+{
+  bool value = literal[0] == 't';
+  switch (field)
+  {
+  case FIELD_UPDATE_FIRMWARE:
+    response.update_firmware = value;
+    break;
+  case FIELD_MAXIMUM_COMPATIBILITY:
+    response.maximum_compatibility = value;
+    break;
+  case FIELD_RESET_FIRMWARE:
+    response.reset_firmware = value;
+    break;
+  default:
+    break;
+  }
+  state = EXPECT_COMMA_OR_END;
+}
+
+bool ApiDisplayParser::step(char c)
+{
+  switch (state)
+  {
+  case EXPECT_ROOT:
+    if (isWhitespace(c))
+      return true;
+    if (c != '{')
+      return fail("InvalidInput");
+    state = EXPECT_KEY_OR_END;
+    return true;
+
+  case EXPECT_KEY_OR_END:
+  case EXPECT_KEY:
+    if (isWhitespace(c))
+      return true;
+    if (c == '"')
+    {
+      beginString(true);
+      return true;
+    }
+    if (c == '}' && state == EXPECT_KEY_OR_END)
+    {
+      state = DONE;
+      return true;
+    }
+    return fail("InvalidInput");
+
+  case EXPECT_COLON:
+    if (isWhitespace(c))
+      return true;
+    if (c != ':')
+      return fail("InvalidInput");
+    state = EXPECT_VALUE;
+    return true;
+
+  case EXPECT_VALUE:
+    if (isWhitespace(c))
+      return true;
+    if (c == '"')
+    {
+      beginString(false);
+    }
+    else if (c == '-' || (c >= '0' && c <= '9'))
+    {
+      number = 0;
+      numberNegative = c == '-';
+      numberFraction = false;
+      numberOverflow = false;
+      if (!numberNegative)
+        number = c - '0';
+      state = IN_NUMBER;
+    }
+    else if (c == 't' || c == 'f' || c == 'n')
+    {
+      literal = c == 't' ? "true" : (c == 'f' ? "false" : "null");
+      literalPos = 1;
+      state = IN_LITERAL;
+    }
+    else if (c == '{' || c == '[')
+    {
+      nestedDepth = 1;
+      nestedString = false;
+      nestedEscape = false;
+      state = IN_NESTED;
+    }
+    else
+    {
+      return fail("InvalidInput");
+    }
+    return true;
+
+  case EXPECT_COMMA_OR_END:
+    if (isWhitespace(c))
+      return true;
+    if (c == ',')
+    {
+      state = EXPECT_KEY;
+      return true;
+    }
+    if (c == '}')
+    {
+      state = DONE;
+      return true;
+    }
+    return fail("InvalidInput");
+
+  case IN_STRING:
+    if (c == '"')
+      endString();
+    else if (c == '\\')
+      state = IN_STRING_ESCAPE;
+    else
+      appendChar(c);
+    return true;
+
+  case IN_STRING_ESCAPE:
+    state = IN_STRING;
+    switch (c)
+    {
+    case '"':
+    case '\\':
+    case '/':
+      appendChar(c);
+      return true;
+    case 'b':
+      appendChar('\b');
+      return true;
+    case 'f':
+      appendChar('\f');
+      return true;
+    case 'n':
+      appendChar('\n');
+      return true;
+    case 'r':
+      appendChar('\r');
+      return true;
+    case 't':
+      appendChar('\t');
+      return true;
+    case 'u':
+      unicode = 0;
+      unicodeDigits = 0;
+      state = IN_STRING_UNICODE;
+      return true;
+    default:
+      return fail("InvalidInput");
+    }
+
+  case IN_STRING_UNICODE:
+  {
+    int digit = hexValue(c);
+    if (digit < 0)
+      return fail("InvalidInput");
+    unicode = (unicode << 4) | digit;
+    if (++unicodeDigits == 4)
+    {
+      appendCodepoint(unicode);
+      state = IN_STRING;
+    }
+    return true;
+  }
+
+  case IN_NUMBER:
+    if (c >= '0' && c <= '9')
+    {
+      if (!numberFraction && !numberOverflow)
+      {
+        if (number > (UINT64_MAX - 9) / 10)
+          numberOverflow = true;
+        else
+          number = number * 10 + (c - '0');
+      }
+      return true;
+    }
+    if (c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-')
+    {
+      numberFraction = true; // keep the integer part only
+      return true;
+    }
+    endNumber();
+    return step(c);
+
+  case IN_LITERAL:
+    if (c != literal[literalPos])
+      return fail("InvalidInput");
+    if (literal[++literalPos] == '\0')
+      endLiteral();
+    return true;
+
+  case IN_NESTED:
+    if (nestedString)
+    {
+      if (nestedEscape)
+        nestedEscape = false;
+      else if (c == '\\')
+        nestedEscape = true;
+      else if (c == '"')
+        nestedString = false;
+    }
+    else if (c == '"')
+    {
+      nestedString = true;
+    }
+    else if (c == '{' || c == '[')
+    {
+      nestedDepth++;
+    }
+    else if (c == '}' || c == ']')
+    {
+      if (--nestedDepth == 0)
+        state = EXPECT_COMMA_OR_END;
+    }
+    return true;
+
+  case DONE:
+    return true; // trailing bytes after the root object are ignored
+
+  case FAILED:
+  default:
+    return false;
+  }
+}
+
+ApiDisplayOutcome ApiDisplayParser::finish()
+{
+  if (state == EXPECT_ROOT)
+  {
+    fail("EmptyInput");
+  }
+  else if (state != DONE && state != FAILED)
+  {
+    fail("IncompleteInput");
+  }
+
+  if (state == FAILED)
   {
     Log_error("JSON deserialization error.");
-    return ApiDisplayResponse{
-        .outcome = ApiDisplayOutcome::DeserializationError,
-        .error_detail = error.c_str()};
+    response.outcome = ApiDisplayOutcome::DeserializationError;
+    return response.outcome;
+  }
+
+  if (wasTruncated)
+  {
+    Log_error("Some /api/display fields were truncated");
   }
-  String special_function_str = doc["special_function"];
+
   // Convert the temperature profile ("default", "a", "b", "c")
   // into an integer value (0,1,2,3)
-  String tp = doc["temperature_profile"];
   uint32_t u32TP = 0; // default
-     if (tp == "a") u32TP = 1;
-     else if (tp == "b") u32TP = 2;
-//     else if (tp == "c") u32TP = 3;
-
-  return ApiDisplayResponse{
-      .outcome = ApiDisplayOutcome::Ok,
-      .error_detail = "",
-      .status = doc["status"],
-      .image_url = doc["image_url"] | "",
-      .image_url_timeout = doc["image_url_timeout"],
-      .filename = doc["filename"] | "",
-      .update_firmware = doc["update_firmware"],
-      .maximum_compatibility = doc["maximum_compatibility"] | false, // server doesn't return this flag if device.firmware_version <= 1.6.2
-      .firmware_url = doc["firmware_url"] | "",
-      .refresh_rate = doc["refresh_rate"],
-      .temp_profile = u32TP,
-      .reset_firmware = doc["reset_firmware"],
-      .special_function = parseSpecialFunction(special_function_str),
-      .action = doc["action"] | "",
-  };
+  if (strcmp(temperatureProfile, "a") == 0)
+    u32TP = 1;
+  else if (strcmp(temperatureProfile, "b") == 0)
+    u32TP = 2;
+  //     else if (strcmp(temperatureProfile, "c") == 0) u32TP = 3;
+
+  response.temp_profile = u32TP;
+  response.special_function = parseSpecialFunction(specialFunction);
+  response.firmware_encoding = parseOtaEncoding(firmwareEncoding);
+  response.outcome = ApiDisplayOutcome::Ok;
+  return response.outcome;
+}
+
+ApiDisplayOutcome parseResponse_apiDisplay(String &payload, ApiDisplayResponse &response)
+{
+  ApiDisplayParser parser(response);
+  parser.feed(payload.c_str(), payload.length());
+  return parser.finish();
 }
@@ -0,0 +1,61 @@
+#include <plane_split.h>
+
+// bits 6, 4, 2 and 0 of a byte packed into a nibble (the low bits of 4 pixels)
+static const uint8_t evenBits[256] = {
+    0x0, 0x1, 0x0, 0x1, 0x2, 0x3, 0x2, 0x3, 0x0, 0x1, 0x0, 0x1, 0x2, 0x3, 0x2, 0x3,
+    0x4, 0x5, 0x4, 0x5, 0x6, 0x7, 0x6, 0x7, 0x4, 0x5, 0x4, 0x5, 0x6, 0x7, 0x6, 0x7,
+    0x0, 0x1, 0x0, 0x1, 0x2, 0x3, 0x2, 0x3, 0x0, 0x1, 0x0, 0x1, 0x2, 0x3, 0x2, 0x3,
+    0x4, 0x5, 0x4, 0x5, 0x6, 0x7, 0x6, 0x7, 0x4, 0x5, 0x4, 0x5, 0x6, 0x7, 0x6, 0x7,
+    0x8, 0x9, 0x8, 0x9, 0xa, 0xb, 0xa, 0xb, 0x8, 0x9, 0x8, 0x9, 0xa, 0xb, 0xa, 0xb,
+    0xc, 0xd, 0xc, 0xd, 0xe, 0xf, 0xe, 0xf, 0xc, 0xd, 0xc, 0xd, 0xe, 0xf, 0xe, 0xf,
+    0x8, 0x9, 0x8, 0x9, 0xa, 0xb, 0xa, 0xb, 0x8, 0x9, 0x8, 0x9, 0xa, 0xb, 0xa, 0xb,
+    0xc, 0xd, 0xc, 0xd, 0xe, 0xf, 0xe, 0xf, 0xc, 0xd, 0xc, 0xd, 0xe, 0xf, 0xe, 0xf,
+    0x0, 0x1, 0x0, 0x1, 0x2, 0x3, 0x2, 0x3, 0x0, 0x1, 0x0, 0x1, 0x2, 0x3, 0x2, 0x3,
+    0x4, 0x5, 0x4, 0x5, 0x6, 0x7, 0x6, 0x7, 0x4, 0x5, 0x4, 0x5, 0x6, 0x7, 0x6, 0x7,
+    0x0, 0x1, 0x0, 0x1, 0x2, 0x3, 0x2, 0x3, 0x0, 0x1, 0x0, 0x1, 0x2, 0x3, 0x2, 0x3,
+    0x4, 0x5, 0x4, 0x5, 0x6, 0x7, 0x6, 0x7, 0x4, 0x5, 0x4, 0x5, 0x6, 0x7, 0x6, 0x7,
+    0x8, 0x9, 0x8, 0x9, 0xa, 0xb, 0xa, 0xb, 0x8, 0x9, 0x8, 0x9, 0xa, 0xb, 0xa, 0xb,
+    0xc, 0xd, 0xc, 0xd, 0xe, 0xf, 0xe, 0xf, 0xc, 0xd, 0xc, 0xd, 0xe, 0xf, 0xe, 0xf,
+    0x8, 0x9, 0x8, 0x9, 0xa, 0xb, 0xa, 0xb, 0x8, 0x9, 0x8, 0x9, 0xa, 0xb, 0xa, 0xb,
+    0xc, 0xd, 0xc, 0xd, 0xe, 0xf, 0xe, 0xf, 0xc, 0xd, 0xc, 0xd, 0xe, 0xf, 0xe, 0xf,
+};
+
+void twoBitGather(const uint8_t *src, uint8_t *dst, int width, TwoBitPlane plane, uint8_t invert, uint8_t firstInvert)
+{
+  int bytes = width / 8;
+  if (bytes <= 0)
+    return;
+  // the first output byte on its own, it is the only one that uses firstInvert
+  uint8_t a = src[0] ^ firstInvert, b = src[1] ^ invert;
+  int i = 1;
+  switch (plane)
+  {
+  case TWO_BIT_LOW:
+    dst[0] = (evenBits[a] << 4) | evenBits[b];
+    for (; i < bytes; i++)
+    {
+      a = src[2 * i] ^ invert;
+      b = src[2 * i + 1] ^ invert;
+      dst[i] = (evenBits[a] << 4) | evenBits[b];
+    }
+    break;
+  case TWO_BIT_HIGH:
+    dst[0] = (evenBits[a >> 1] << 4) | evenBits[b >> 1];
+    for (; i < bytes; i++)
+    {
+      a = src[2 * i] ^ invert;
+      b = src[2 * i + 1] ^ invert;
+      dst[i] = (evenBits[a >> 1] << 4) | evenBits[b >> 1];
+    }
+    break;
+  case TWO_BIT_ANY:
+    dst[0] = (evenBits[a | (a >> 1)] << 4) | evenBits[b | (b >> 1)];
+    for (; i < bytes; i++)
+    {
+      a = src[2 * i] ^ invert;
+      b = src[2 * i + 1] ^ invert;
+      dst[i] = (evenBits[a | (a >> 1)] << 4) | evenBits[b | (b >> 1)];
+    }
+    break;
+  }
+}
@@ -0,0 +1,193 @@
+#include <resumable_download.h>
+#include <stdlib.h>
+#include <string.h>
+
+void clearDownloadCheckpoint(DownloadCheckpoint &checkpoint)
+{
+  memset(&checkpoint, 0, sizeof(checkpoint));
+}
+
+bool parseContentRange(const char *value, uint32_t &start, uint32_t &end, uint32_t &total)
+{
+  if (!value || strncmp(value, "bytes ", 6) != 0)
+    return false;
+
+  char *p;
+  start = strtoul(value + 6, &p, 10);
+  if (*p != '-')
+    return false;
+  end = strtoul(p + 1, &p, 10);
+  if (*p != '/' || end < start)
+    return false;
+
+  if (p[1] == '*')
+  {
+    total = 0;
+    return true;
+  }
+  total = strtoul(p + 1, &p, 10);
+  return *p == '\0' && end < total;
+}
+
+ResumableDownload::ResumableDownload(DownloadCheckpoint &checkpoint, const char *key, ResumableSink &target, uint32_t granularity)
+    : checkpoint(checkpoint),
+      keyHash(ota_crc32(0, (const uint8_t *)key, strlen(key))),
+      target(target),
+      granularity(granularity ? granularity : 1),
+      position(0),
+      crc(0),
+      startOffset(0),
+      accepted(false),
+      changed(false),
+      errorMessage(nullptr)
+{
+}
+
+bool ResumableDownload::canResume() const
+{
+  // without a validator we could splice two different versions of the resource
+  return checkpoint.magic == DOWNLOAD_CHECKPOINT_MAGIC && checkpoint.keyHash == keyHash &&
+         checkpoint.etag[0] != '\0' && checkpoint.total > 0 &&
+         checkpoint.received > 0 && checkpoint.received < checkpoint.total;
+}
+
+DownloadOutcome ResumableDownload::fail(const char *message)
+{
+  errorMessage = message;
+  clearDownloadCheckpoint(checkpoint);
+  return DownloadOutcome::Failed;
+}
+
+bool ResumableDownload::restart(const RangeResponse &response)
+{
+  clearDownloadCheckpoint(checkpoint);
+  checkpoint.magic = DOWNLOAD_CHECKPOINT_MAGIC;
+  checkpoint.keyHash = keyHash;
+  if (response.etag && strlen(response.etag) < sizeof(checkpoint.etag))
+    strcpy(checkpoint.etag, response.etag);
+  checkpoint.total = response.total;
+  checkpoint.expectedCrc = response.crc;
+  checkpoint.hasExpectedCrc = response.hasCrc;
+
+  position = 0;
+  crc = 0;
+  startOffset = 0;
+  if (!target.resumeAt(0, response.total))
+  {
+    fail("Target cannot start over");
+    return false;
+  }
+  return true;
+}
+
+bool ResumableDownload::onResponse(const RangeResponse &response)
+{
+  accepted = true;
+
+  if (response.status == 206 && startOffset > 0 && response.start == startOffset)
+  {
+    bool sameResource = (response.total == 0 || response.total == checkpoint.total) &&
+                        (!response.etag || response.etag[0] == '\0' || strcmp(response.etag, checkpoint.etag) == 0);
+    if (!sameResource)
+    {
+      // If-Range should have turned this into a 200; start over on the next attempt
+      clearDownloadCheckpoint(checkpoint);
+      changed = true;
+      return false;
+    }
+    if (!target.resumeAt(startOffset, checkpoint.total))
+    {
+      fail("Target cannot resume");
+      return false;
+    }
+    return true;
+  }
+
+  if (response.status == 200 || (response.status == 206 && response.start == 0))
+    return restart(response);
+
+  fail("Unexpected HTTP status");
+  return false;
+}
+
+bool ResumableDownload::write(const uint8_t *data, size_t length)
+{
+  if (errorMessage)
+    return false;
+
+  if (checkpoint.total > 0 && position + length > checkpoint.total)
+  {
+    fail("More data than announced");
+    return false;
+  }
+
+  while (length > 0)
+  {
+    // split at block boundaries so that every commit point is block aligned
+    size_t n = granularity - position % granularity;
+    if (n > length)
+      n = length;
+
+    if (!target.write(data, n))
+    {
+      fail("Write failed");
+      return false;
+    }
+    crc = ota_crc32(crc, data, n);
+    position += n;
+    data += n;
+    length -= n;
+
+    if (position % granularity == 0 || position == checkpoint.total)
+    {
+      checkpoint.received = position;
+      checkpoint.crc = crc;
+    }
+  }
+  return true;
+}
+
+DownloadOutcome ResumableDownload::attempt(RangeTransport &transport)
+{
+  errorMessage = nullptr;
+  accepted = false;
+  changed = false;
+
+  startOffset = canResume() ? checkpoint.received : 0;
+  position = startOffset;
+  crc = startOffset ? checkpoint.crc : 0;
+
+  bool finished = transport.get(startOffset, startOffset ? checkpoint.etag : nullptr, *this);
+
+  if (errorMessage)
+    return DownloadOutcome::Failed;
+  if (changed)
+  {
+    errorMessage = "Resource changed";
+    return DownloadOutcome::Interrupted;
+  }
+  if (!accepted)
+  {
+    errorMessage = "Connection failed";
+    return DownloadOutcome::Interrupted;
+  }
+  if (!finished || (checkpoint.total > 0 && position < checkpoint.total))
+  {
+    errorMessage = "Connection dropped";
+    return DownloadOutcome::Interrupted;
+  }
+
+  if (checkpoint.hasExpectedCrc && crc != checkpoint.expectedCrc)
+    return fail("Checksum mismatch");
+
+  clearDownloadCheckpoint(checkpoint);
+  return DownloadOutcome::Complete;
+}
+
+DownloadOutcome ResumableDownload::run(RangeTransport &transport, uint8_t maxAttempts)
+{
+  DownloadOutcome outcome = DownloadOutcome::Interrupted;
+  for (uint8_t i = 0; i < maxAttempts && outcome == DownloadOutcome::Interrupted; i++)
+    outcome = attempt(transport);
+  return outcome;
+}
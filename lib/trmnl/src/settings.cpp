@@ -0,0 +1,288 @@
+#include <settings.h>
+#include <config.h>
+#include <trmnl_log.h>
+#include <string.h>
+
+// persistence keys, indexed by SettingsField
+static const char *const settingsKeys[SETTING_COUNT] = {
+    PREFERENCES_API_KEY,
+    PREFERENCES_API_URL,
+    PREFERENCES_FRIENDLY_ID,
+    PREFERENCES_SLEEP_TIME_KEY,
+    PREFERENCES_TEMP_PROFILE,
+    PREFERENCES_DEVICE_REGISTERED_KEY,
+    PREFERENCES_SF_KEY,
+    PREFERENCES_FILENAME_KEY,
+    PREFERENCES_LAST_SLEEP_TIME,
+    PREFERENCES_CONNECT_API_RETRY_COUNT,
+    PREFERENCES_CONNECT_WIFI_RETRY_COUNT,
+    PREFERENCES_LOG_ID_KEY,
+};
+
+static void copyString(char *dest, size_t size, const char *value)
+{
+  strncpy(dest, value, size - 1);
+  dest[size - 1] = '\0';
+}
+
+Settings::Settings(Persistence &persistence) : persistence(persistence), present(0), dirty(0)
+{
+  reset();
+}
+
+void Settings::reset()
+{
+  memset(&data, 0, sizeof(data));
+  copyString(data.api_url, sizeof(data.api_url), API_BASE_URL);
+  data.refresh_rate = SLEEP_TIME_TO_SLEEP;
+  data.temp_profile = TEMP_PROFILE_DEFAULT;
+  data.log_id = 1;
+  present = 0;
+  dirty = 0;
+}
+
+void Settings::load()
+{
+  reset();
+  for (uint8_t i = 0; i < SETTING_COUNT; i++)
+  {
+    loadField((SettingsField)i);
+  }
+}
+
+void Settings::reload(SettingsField field)
+{
+  dirty &= ~(1 << field);
+  loadField(field);
+}
+
+void Settings::loadField(SettingsField field)
+{
+  // one read per key: a missing key reads as its default, so a key is only
+  // known to be stored when it holds something else
+  const char *key = settingsKeys[field];
+  bool stored;
+
+  switch (field)
+  {
+  case SETTING_API_KEY:
+    copyString(data.api_key, sizeof(data.api_key), persistence.readString(key, PREFERENCES_API_KEY_DEFAULT).c_str());
+    stored = strcmp(data.api_key, PREFERENCES_API_KEY_DEFAULT) != 0;
+    break;
+  case SETTING_API_URL:
+    copyString(data.api_url, sizeof(data.api_url), persistence.readString(key, API_BASE_URL).c_str());
+    stored = strcmp(data.api_url, API_BASE_URL) != 0;
+    break;
+  case SETTING_FRIENDLY_ID:
+    copyString(data.friendly_id, sizeof(data.friendly_id), persistence.readString(key, PREFERENCES_FRIENDLY_ID_DEFAULT).c_str());
+    stored = strcmp(data.friendly_id, PREFERENCES_FRIENDLY_ID_DEFAULT) != 0;
+    break;
+  case SETTING_FILENAME:
+    copyString(data.filename, sizeof(data.filename), persistence.readString(key, "").c_str());
+    stored = data.filename[0] != '\0';
+    break;
+  case SETTING_REFRESH_RATE:
+    data.refresh_rate = persistence.readUint(key, SLEEP_TIME_TO_SLEEP);
+    stored = data.refresh_rate != SLEEP_TIME_TO_SLEEP;
+    break;
+  case SETTING_TEMP_PROFILE:
+    data.temp_profile = persistence.readUint(key, TEMP_PROFILE_DEFAULT);
+    stored = data.temp_profile != TEMP_PROFILE_DEFAULT;
+    break;
+  case SETTING_SPECIAL_FUNCTION:
+    data.special_function = persistence.readUint(key, 0);
+    stored = data.special_function != 0;
+    break;
+  case SETTING_LAST_SLEEP_TIME:
+    data.last_sleep_time = persistence.readUint(key, 0);
+    stored = data.last_sleep_time != 0;
+    break;
+  case SETTING_LOG_ID:
+    data.log_id = persistence.readUint(key, 1);
+    stored = data.log_id != 1;
+    break;
+  case SETTING_API_RETRY_COUNT:
+    data.api_retry_count = persistence.readInt(key, 0);
+    stored = data.api_retry_count != 0;
+    break;
+  case SETTING_WIFI_RETRY_COUNT:
+    data.wifi_retry_count = persistence.readInt(key, 0);
+    stored = data.wifi_retry_count != 0;
+    break;
+  case SETTING_DEVICE_REGISTERED:
+    data.device_registered = persistence.readBool(key, false);
+    stored = data.device_registered;
+    break;
+  default:
+    stored = false;
+    break;
+  }
+
+  if (stored)
+    present |= (1 << field);
+  else
+    present &= ~(1 << field);
+}
+
+bool Settings::writeField(SettingsField field)
+{
+  const char *key = settingsKeys[field];
+
+  switch (field)
+  {
+  case SETTING_API_KEY:
+    return persistence.writeString(key, data.api_key) > 0;
+  case SETTING_API_URL:
+    return persistence.writeString(key, data.api_url) > 0;
+  case SETTING_FRIENDLY_ID:
+    return persistence.writeString(key, data.friendly_id) > 0;
+  case SETTING_FILENAME:
+    // an empty filename is a legitimate value, and putString() returns 0 for it
+    persistence.writeString(key, data.filename);
+    return true;
+  case SETTING_REFRESH_RATE:
+    return persistence.writeUint(key, data.refresh_rate) > 0;
+  case SETTING_TEMP_PROFILE:
+    return persistence.writeUint(key, data.temp_profile) > 0;
+  case SETTING_SPECIAL_FUNCTION:
+    return persistence.writeUint(key, data.special_function) > 0;
+  case SETTING_LAST_SLEEP_TIME:
+    return persistence.writeUint(key, data.last_sleep_time) > 0;
+  case SETTING_LOG_ID:
+    return persistence.writeUint(key, data.log_id) > 0;
+  case SETTING_API_RETRY_COUNT:
+    return persistence.writeInt(key, data.api_retry_count) > 0;
+  case SETTING_WIFI_RETRY_COUNT:
+    return persistence.writeInt(key, data.wifi_retry_count) > 0;
+  case SETTING_DEVICE_REGISTERED:
+    return persistence.writeBool(key, data.device_registered) > 0;
+  default:
+    return false;
+  }
+}
+
+uint8_t Settings::flush()
+{
+  uint8_t written = 0;
+  for (uint8_t i = 0; i < SETTING_COUNT; i++)
+  {
+    if (!(dirty & (1 << i)))
+      continue;
+
+    if (writeField((SettingsField)i))
+    {
+      dirty &= ~(1 << i);
+      written++;
+    }
+    else
+    {
+      Log_error("Failed to write setting %s", settingsKeys[i]);
+    }
+  }
+  return written;
+}
+
+bool Settings::exists(SettingsField field) const
+{
+  return (present & (1 << field)) != 0;
+}
+
+bool Settings::isDirty(SettingsField field) const
+{
+  return (dirty & (1 << field)) != 0;
+}
+
+bool Settings::isDirty() const
+{
+  return dirty != 0;
+}
+
+void Settings::setString(SettingsField field, char *dest, size_t size, const char *value)
+{
+  if (strncmp(dest, value, size - 1) == 0)
+    return;
+
+  copyString(dest, size, value);
+  present |= (1 << field);
+  dirty |= (1 << field);
+}
+
+void Settings::setUint(SettingsField field, uint32_t &dest, uint32_t value)
+{
+  if (dest == value)
+    return;
+
+  dest = value;
+  present |= (1 << field);
+  dirty |= (1 << field);
+}
+
+void Settings::setInt(SettingsField field, int32_t &dest, int32_t value)
+{
+  if (dest == value)
+    return;
+
+  dest = value;
+  present |= (1 << field);
+  dirty |= (1 << field);
+}
+
+void Settings::setApiKey(const char *value)
+{
+  setString(SETTING_API_KEY, data.api_key, sizeof(data.api_key), value);
+}
+
+void Settings::setFriendlyId(const char *value)
+{
+  setString(SETTING_FRIENDLY_ID, data.friendly_id, sizeof(data.friendly_id), value);
+}
+
+void Settings::setFilename(const char *value)
+{
+  setString(SETTING_FILENAME, data.filename, sizeof(data.filename), value);
+}
+
+void Settings::setRefreshRate(uint32_t value)
+{
+  setUint(SETTING_REFRESH_RATE, data.refresh_rate, value);
+}
+
+void Settings::setTempProfile(uint32_t value)
+{
+  setUint(SETTING_TEMP_PROFILE, data.temp_profile, value);
+}
+
+void Settings::setSpecialFunction(uint32_t value)
+{
+  setUint(SETTING_SPECIAL_FUNCTION, data.special_function, value);
+}
+
+void Settings::setLastSleepTime(uint32_t value)
+{
+  setUint(SETTING_LAST_SLEEP_TIME, data.last_sleep_time, value);
+}
+
+void Settings::setLogId(uint32_t value)
+{
+  setUint(SETTING_LOG_ID, data.log_id, value);
+}
+
+void Settings::setApiRetryCount(int32_t value)
+{
+  setInt(SETTING_API_RETRY_COUNT, data.api_retry_count, value);
+}
+
+void Settings::setWifiRetryCount(int32_t value)
+{
+  setInt(SETTING_WIFI_RETRY_COUNT, data.wifi_retry_count, value);
+}
+
+void Settings::setDeviceRegistered(bool value)
+{
+  if (data.device_registered == value)
+    return;
+
+  data.device_registered = value;
+  present |= (1 << SETTING_DEVICE_REGISTERED);
+  dirty |= (1 << SETTING_DEVICE_REGISTERED);
+}
@@ -19,10 +19,15 @@ static const SpecialFunctionMap specialFunctionMap[] = {
 };
 
 SPECIAL_FUNCTION parseSpecialFunction(String &special_function_str)
+{
+  return parseSpecialFunction(special_function_str.c_str());
+}
+
+SPECIAL_FUNCTION parseSpecialFunction(const char *special_function_str)
 {
   for (const auto &entry : specialFunctionMap)
   {
-    if (special_function_str.equals(entry.name))
+    if (strcmp(special_function_str, entry.name) == 0)
     {
       Log_info("New special function - %s", entry.name);
       return entry.value;
@@ -59,8 +59,8 @@ bool WifiCaptive::startPortal()
             } },
         .setConnectionCredentials = [this](const WifiCredentials credentials, const String api_server)
         {
-            _ssid = credentials.ssid;
-            _password = credentials.pswd;
+            _ssid = credentials.ssid.c_str();
+            _password = credentials.pswd.c_str();
             _api_server = api_server;
             _enterprise_credentials = credentials; },
         .getAnnotatedNetworks = [this](bool runScan)
@@ -220,6 +220,16 @@ bool WifiCaptive::isSaved()
     return _savedWifis[0].ssid != "";
 }
 
+template <size_t N>
+static void readFixedString(Preferences &preferences, const char *key, FixedString<N> &value)
+{
+    value.clear();
+    if (preferences.isKey(key))
+    {
+        preferences.getString(key, value.data(), N);
+    }
+}
+
 void WifiCaptive::readWifiCredentials()
 {
     Preferences preferences;
@@ -227,11 +237,11 @@ void WifiCaptive::readWifiCredentials()
 
     for (int i = 0; i < WIFI_MAX_SAVED_CREDS; i++)
     {
-        _savedWifis[i].ssid = preferences.getString(WIFI_SSID_KEY(i), "");
-        _savedWifis[i].pswd = preferences.getString(WIFI_PSWD_KEY(i), "");
+        readFixedString(preferences, WIFI_SSID_KEY(i), _savedWifis[i].ssid);
+        readFixedString(preferences, WIFI_PSWD_KEY(i), _savedWifis[i].pswd);
         _savedWifis[i].isEnterprise = preferences.getBool(WIFI_ENT_KEY(i), false);
-        _savedWifis[i].username = preferences.getString(WIFI_USERNAME_KEY(i), "");
-        _savedWifis[i].identity = preferences.getString(WIFI_IDENTITY_KEY(i), "");
+        readFixedString(preferences, WIFI_USERNAME_KEY(i), _savedWifis[i].username);
+        readFixedString(preferences, WIFI_IDENTITY_KEY(i), _savedWifis[i].identity);
     }
 
     preferences.end();
@@ -278,11 +288,11 @@ void WifiCaptive::saveWifiCredentials(const WifiCredentials credentials)
     preferences.begin("wificaptive", false);
     for (int i = 0; i < WIFI_MAX_SAVED_CREDS; i++)
     {
-        preferences.putString(WIFI_SSID_KEY(i), _savedWifis[i].ssid);
-        preferences.putString(WIFI_PSWD_KEY(i), _savedWifis[i].pswd);
+        preferences.putString(WIFI_SSID_KEY(i), _savedWifis[i].ssid.c_str());
+        preferences.putString(WIFI_PSWD_KEY(i), _savedWifis[i].pswd.c_str());
         preferences.putBool(WIFI_ENT_KEY(i), _savedWifis[i].isEnterprise);
-        preferences.putString(WIFI_USERNAME_KEY(i), _savedWifis[i].username);
-        preferences.putString(WIFI_IDENTITY_KEY(i), _savedWifis[i].identity);
+        preferences.putString(WIFI_USERNAME_KEY(i), _savedWifis[i].username.c_str());
+        preferences.putString(WIFI_IDENTITY_KEY(i), _savedWifis[i].identity.c_str());
     }
     preferences.putInt(WIFI_LAST_INDEX, 0);
     preferences.end();
@@ -489,7 +499,7 @@ std::vector<Network> WifiCaptive::combineNetworks(
         if (!found && savedWifis[i].ssid != "")
         {
             // Use the saved enterprise flag from credentials
-            combinedNetworks.push_back({savedWifis[i].ssid, -200, false, true, savedWifis[i].isEnterprise});
+            combinedNetworks.push_back({savedWifis[i].ssid.c_str(), -200, false, true, savedWifis[i].isEnterprise});
         }
     }
 
@@ -27,11 +27,21 @@
 // Define max connection timeout
 #define CONNECTION_TIMEOUT 15000
 
-#define WIFI_SSID_KEY(i) ("wifi_" + String(i) + "_ssid").c_str()
-#define WIFI_PSWD_KEY(i) ("wifi_" + String(i) + "_pswd").c_str()
-#define WIFI_ENT_KEY(i) ("wifi_" + String(i) + "_ent").c_str()
-#define WIFI_USERNAME_KEY(i) ("wifi_" + String(i) + "_username").c_str()
-#define WIFI_IDENTITY_KEY(i) ("wifi_" + String(i) + "_identity").c_str()
+/// @brief Builds the preferences key "wifi_<i>_<suffix>" without touching the heap
+inline FixedString<16> wifiCredentialKey(int i, const char *suffix)
+{
+    FixedString<16> key = "wifi_";
+    key += i;
+    key += '_';
+    key += suffix;
+    return key;
+}
+
+#define WIFI_SSID_KEY(i) wifiCredentialKey(i, "ssid").c_str()
+#define WIFI_PSWD_KEY(i) wifiCredentialKey(i, "pswd").c_str()
+#define WIFI_ENT_KEY(i) wifiCredentialKey(i, "ent").c_str()
+#define WIFI_USERNAME_KEY(i) wifiCredentialKey(i, "username").c_str()
+#define WIFI_IDENTITY_KEY(i) wifiCredentialKey(i, "identity").c_str()
 
 #define WIFI_LAST_INDEX "wifi_last_index"
 
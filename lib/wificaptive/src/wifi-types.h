@@ -4,15 +4,16 @@
 #include <WiFiGeneric.h>
 #include <WiFiType.h>
 #include <WiFi.h>
+#include <fixed_string.h>
 
 struct WifiCredentials
 {
-    String ssid;
-    String pswd;
+    FixedString<33> ssid; // 802.11 allows up to 32 bytes
+    FixedString<128> pswd;
     // WPA2 Enterprise fields
     bool isEnterprise = false;
-    String username;
-    String identity;
+    FixedString<64> username;
+    FixedString<64> identity;
 };
 
 struct Network
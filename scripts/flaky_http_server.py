@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+"""
+Flaky HTTP file server
+
+Serves files from a directory with ETag, Range/If-Range and X-Checksum-CRC32
+support, and cuts the connection at a random offset for a share of the
+requests. Point firmware_url / image_url at it to exercise resumable OTA
+and image downloads on a device.
+
+  python3 scripts/flaky_http_server.py --dir .pio/build/esp32-c3-devkitc-02 --drop 0.7
+"""
+import argparse
+import hashlib
+import os
+import random
+import re
+import zlib
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+def make_handler(root, drop_chance):
+    class Handler(BaseHTTPRequestHandler):
+        def do_GET(self):
+            path = os.path.join(root, os.path.basename(self.path.split("?")[0]))
+            if not os.path.isfile(path):
+                self.send_error(404)
+                return
+
+            with open(path, "rb") as f:
+                content = f.read()
+            etag = '"%s"' % hashlib.md5(content).hexdigest()
+            total = len(content)
+
+            start = 0
+            match = re.match(r"bytes=(\d+)-$", self.headers.get("Range", ""))
+            if_range = self.headers.get("If-Range")
+            if match and (if_range is None or if_range == etag):
+                start = int(match.group(1))
+                if start >= total:
+                    self.send_response(416)
+                    self.send_header("Content-Range", "bytes */%d" % total)
+                    self.end_headers()
+                    return
+                self.send_response(206)
+                self.send_header("Content-Range", "bytes %d-%d/%d" % (start, total - 1, total))
+            else:
+                self.send_response(200)
+
+            self.send_header("Content-Length", str(total - start))
+            self.send_header("ETag", etag)
+            self.send_header("X-Checksum-CRC32", "%08x" % (zlib.crc32(content) & 0xFFFFFFFF))
+            self.send_header("Content-Type", "application/octet-stream")
+            self.end_headers()
+
+            end = total
+            if random.random() < drop_chance:
+                end = random.randint(start, total - 1)
+                self.log_message("dropping connection at %d of %d", end, total)
+            self.wfile.write(content[start:end])
+            if end < total:
+                self.close_connection = True
+                self.connection.shutdown(2)
+
+    return Handler
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--dir", default=".", help="directory with the files to serve")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--drop", type=float, default=0.5, help="share of requests that get cut short (0..1)")
+    parser.add_argument("--seed", type=int, help="seed for reproducible drops")
+    args = parser.parse_args()
+
+    if args.seed is not None:
+        random.seed(args.seed)
+
+    server = ThreadingHTTPServer(("", args.port), make_handler(args.dir, args.drop))
+    print("Serving %s on port %d, dropping %d%% of transfers" % (args.dir, args.port, args.drop * 100))
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -4,7 +4,10 @@
 #include <WiFiClientSecure.h>
 #include <config.h>
 #include <api_response_parsing.h>
+#include <api_display_parser.h>
 #include <http_client.h>
+#include <sink_stream.h>
+#include <api_wake.h>
 
 void addHeaders(HTTPClient &https, ApiDisplayInputs &inputs)
 {
@@ -12,32 +15,49 @@ void addHeaders(HTTPClient &https, ApiDisplayInputs &inputs)
            "ID: %s\n\r"
            "Special function: %d\n\r"
            "Access-Token: %s\n\r"
-           "Refresh_Rate: %s\n\r"
-           "Battery-Voltage: %s\n\r"
+           "Refresh_Rate: %u\n\r"
+           "Battery-Voltage: %.2f\n\r"
            "FW-Version: %s\r\n"
            "Model: %s\r\n"
-           "RSSI: %s\r\n"
+           "RSSI: %d\r\n"
            "temperature-profile:true\r\n",
            inputs.macAddress.c_str(),
            inputs.specialFunction,
            inputs.apiKey.c_str(),
-           String(inputs.refreshRate).c_str(),
-           String(inputs.batteryVoltage).c_str(),
+           inputs.refreshRate,
+           inputs.batteryVoltage,
            inputs.firmwareVersion.c_str(),
            inputs.model.c_str(),
-           String(inputs.rssi));
+           inputs.rssi);
 
-  https.addHeader("ID", inputs.macAddress);
+  https.addHeader("ID", inputs.macAddress.c_str());
   https.addHeader("Content-Type", "application/json");
-  https.addHeader("Access-Token", inputs.apiKey);
+  https.addHeader("Access-Token", inputs.apiKey.c_str());
   https.addHeader("Refresh-Rate", String(inputs.refreshRate));
   https.addHeader("Battery-Voltage", String(inputs.batteryVoltage));
-  https.addHeader("FW-Version", inputs.firmwareVersion);
-  https.addHeader("Model", String(inputs.model));
+  https.addHeader("FW-Version", inputs.firmwareVersion.c_str());
+  https.addHeader("Model", inputs.model.c_str());
   https.addHeader("RSSI", String(inputs.rssi));
   https.addHeader("temperature-profile", "true");
   https.addHeader("Width", String(inputs.displayWidth));
   https.addHeader("Height", String(inputs.displayHeight));
+  https.addHeader("OTA-Encoding", OTA_SUPPORTED_ENCODINGS);
+
+  char capabilities[CAPABILITIES_SIZE];
+  if (capabilitiesHeader(inputs.capabilities, capabilities, sizeof(capabilities)))
+  {
+    // the server picks the format and size of the image from it
+    Log_info("Capabilities: %s", capabilities);
+    https.addHeader(CAPABILITIES_HEADER, capabilities);
+  }
+
+  if (inputs.frameCrc != 0)
+  {
+    // the server may then send only the tiles that changed (delta_url)
+    char frameCrc[9];
+    snprintf(frameCrc, sizeof(frameCrc), "%08x", (unsigned int)inputs.frameCrc);
+    https.addHeader("Frame-CRC32", frameCrc);
+  }
 
   if (inputs.specialFunction != SF_NONE)
   {
@@ -46,30 +66,29 @@ void addHeaders(HTTPClient &https, ApiDisplayInputs &inputs)
   }
 }
 
-ApiDisplayResult fetchApiDisplay(ApiDisplayInputs &apiDisplayInputs)
+void fetchApiDisplay(ApiDisplayInputs &apiDisplayInputs, ApiDisplayResult &result)
 {
+  // resets the response, so it is empty on every error path too
+  ApiDisplayParser parser(result.response);
 
-  return withHttp(
-      apiDisplayInputs.baseUrl + "/api/display",
-      [&apiDisplayInputs](HTTPClient *https, HttpError error) -> ApiDisplayResult
+  FixedString<API_DISPLAY_URL_SIZE> url;
+  apiDisplayUrl(apiDisplayInputs.baseUrl.c_str(), url);
+
+  result.error = withHttp(
+      url.c_str(),
+      [&apiDisplayInputs, &result, &parser](HTTPClient *https, HttpError error) -> https_request_err_e
       {
         if (error == HttpError::HTTPCLIENT_WIFICLIENT_ERROR)
         {
           Log_error("Unable to create WiFiClient");
-          return ApiDisplayResult{
-              .error = https_request_err_e::HTTPS_UNABLE_TO_CONNECT,
-              .response = {},
-              .error_detail = "Unable to create WiFiClient",
-          };
+          result.error_detail = "Unable to create WiFiClient";
+          return https_request_err_e::HTTPS_UNABLE_TO_CONNECT;
         }
         if (error == HttpError::HTTPCLIENT_HTTPCLIENT_ERROR)
         {
           Log_error("Unable to create HTTPClient");
-          return ApiDisplayResult{
-              .error = https_request_err_e::HTTPS_UNABLE_TO_CONNECT,
-              .response = {},
-              .error_detail = "Unable to create HTTPClient",
-          };
+          result.error_detail = "Unable to create HTTPClient";
+          return https_request_err_e::HTTPS_UNABLE_TO_CONNECT;
         }
 
         https->setTimeout(15000);
@@ -98,38 +117,37 @@ ApiDisplayResult fetchApiDisplay(ApiDisplayInputs &apiDisplayInputs)
         {
           Log_error("[HTTPS] GET... failed, error: %s", https->errorToString(httpCode).c_str());
 
-          return ApiDisplayResult{
-              .error = https_request_err_e::HTTPS_RESPONSE_CODE_INVALID,
-              .response = {},
-              .error_detail = "HTTP Client failed with error: " + https->errorToString(httpCode) +
-                              "(" + String(httpCode) + ")"};
+          result.error_detail = "HTTP Client failed with error: " + https->errorToString(httpCode) +
+                                "(" + String(httpCode) + ")";
+          return https_request_err_e::HTTPS_RESPONSE_CODE_INVALID;
         }
 
         // HTTP header has been send and Server response header has been handled
         Log_info("GET... code: %d", httpCode);
 
-        String payload = https->getString();
         size_t size = https->getSize();
         Log_info("Content size: %d", size);
         Log_info("Free heap size: %d", ESP.getMaxAllocHeap());
-        Log_info("Payload - %s", payload.c_str());
-
-        auto apiResponse = parseResponse_apiDisplay(payload);
 
-        if (apiResponse.outcome == ApiDisplayOutcome::DeserializationError)
+        // parse straight into the result, without buffering the body
+        SinkStream sink(parser);
+        int received = https->writeToStream(&sink);
+        if (received < 0)
         {
-          return ApiDisplayResult{
-              .error = https_request_err_e::HTTPS_JSON_PARSING_ERR,
-              .response = {},
-              .error_detail = "JSON parse failed with error: " +
-                              apiResponse.error_detail};
+          Log_error("Reading the response failed: %s", https->errorToString(received).c_str());
         }
-        else
+
+        if (parser.finish() == ApiDisplayOutcome::DeserializationError)
         {
-          return ApiDisplayResult{
-              .error = https_request_err_e::HTTPS_NO_ERR,
-              .response = apiResponse,
-              .error_detail = ""};
+          result.error_detail = String("JSON parse failed with error: ") +
+                                result.response.error_detail.c_str();
+          return https_request_err_e::HTTPS_JSON_PARSING_ERR;
         }
+
+        Log_info("Payload - status: %llu, image_url: %s, filename: %s, refresh_rate: %llu, action: %s",
+                 result.response.status, result.response.image_url.c_str(), result.response.filename.c_str(),
+                 result.response.refresh_rate, result.response.action.c_str());
+        result.error_detail = "";
+        return https_request_err_e::HTTPS_NO_ERR;
       });
-}
\ No newline at end of file
+}
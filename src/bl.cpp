@@ -17,6 +17,8 @@
 #include <cstdint>
 #include "png.h"
 #include <bmp.h>
+#include <frame_rle.h>
+#include <g5_planes.h>
 #include <Update.h>
 #include <math.h>
 #include <filesystem.h>
@@ -34,6 +36,15 @@
 #include <nvs.h>
 #include <serialize_log.h>
 #include <preferences_persistence.h>
+#include <settings.h>
+#include <api_wake.h>
+#include <ota.h>
+#include <http_range.h>
+#include <image_download.h>
+#include <playlist.h>
+#include <overlay.h>
+#include <history.h>
+#include <tile_delta.h>
 #include "logo_small.h"
 #include "logo_medium.h"
 #include "loading.h"
@@ -41,11 +52,12 @@
 #include "driver/rtc_io.h"
 
 bool pref_clear = false;
-String new_filename = "";
+FixedString<API_DISPLAY_FILENAME_SIZE> new_filename;
 ApiDisplayResult apiDisplayResult;
 uint8_t *buffer = nullptr;
 char filename[1024];      // image URL
 char binUrl[1024];        // update URL
+OtaEncoding binEncoding = OtaEncoding::RAW; // how the file at binUrl is encoded
 char message_buffer[128]; // message to show on the screen
 uint32_t time_since_sleep;
 image_err_e png_res = PNG_DECODE_ERR;
@@ -61,9 +73,11 @@ esp_sleep_wakeup_cause_t wakeup_reason = ESP_SLEEP_WAKEUP_UNDEFINED; // wake-up
 MSG current_msg = NONE;
 SPECIAL_FUNCTION special_function = SF_NONE;
 RTC_DATA_ATTR uint8_t need_to_refresh_display = 1;
+static RTC_DATA_ATTR bool current_on_screen = false; // the panel shows /current.* (it keeps it while the device sleeps)
 
 Preferences preferences;
 PreferencesPersistence preferencesPersistence(preferences);
+Settings settings(preferencesPersistence);
 StoredLogs storedLogs(LOG_MAX_NOTES_NUMBER / 2, LOG_MAX_NOTES_NUMBER / 2, PREFERENCES_LOG_KEY, PREFERENCES_LOG_BUFFER_HEAD_KEY, preferencesPersistence);
 
 static https_request_err_e downloadAndShow(); // download and show the image
@@ -85,12 +99,21 @@ static void showMessageWithLogo(MSG message_type, String friendly_id, bool id, c
 static void showMessageWithLogo(MSG message_type, const ApiSetupResponse &apiResponse);
 static void wifiErrorDeepSleep();
 static uint8_t *storedLogoOrDefault(int iType);
-static bool saveCurrentFileName(String &name);
-static bool checkCurrentFileName(String &newName);
+static void saveCurrentFileName(const char *name);
+static bool checkCurrentFileName(const char *newName);
+static bool showPrefetchedFrame(void);
+static void downloadBundle(const ApiDisplayInputs &inputs);
+static bool showOverlays(void);
+static bool showOlderFrame(void);
+static bool showInstantOn(void);
+static bool showDisplayList(void);
+static bool showTileDelta(const ApiDisplayInputs &inputs);
+static bool keepCurrentImageAsLast(void);
 static DeviceStatusStamp getDeviceStatusStamp();
 void log_nvs_usage();
 
 static unsigned long startup_time = 0;
+static uint32_t frame_sleep_time = 0; // display time of a prefetched frame, overrides the refresh rate
 
 void wait_for_serial() {
 #ifdef WAIT_FOR_SERIAL
@@ -180,14 +203,15 @@ void bl_init(void)
     Log_fatal("preferences init failed");
     ESP.restart();
   }
+  settings.load();
   Log_info("preferences end");
 
   if (double_click)
   { // special function reading
-    if (preferences.isKey(PREFERENCES_SF_KEY))
+    if (settings.exists(SETTING_SPECIAL_FUNCTION))
     {
       Log.info("%s [%d]: SF saved. Reading...\r\n", __FILE__, __LINE__);
-      special_function = (SPECIAL_FUNCTION)preferences.getUInt(PREFERENCES_SF_KEY, 0);
+      special_function = (SPECIAL_FUNCTION)settings.specialFunction();
       Log.info("%s [%d]: Read special function - %d\r\n", __FILE__, __LINE__, special_function);
       switch (special_function)
       {
@@ -206,6 +230,7 @@ void bl_init(void)
       {
         Log.info("%s [%d]: Add WiFi function...\r\n", __FILE__, __LINE__);
         WifiCaptivePortal.startPortal();
+        settings.reload(SETTING_API_URL); // the portal may have saved a custom server
       }
       break;
       case SF_RESTART_PLAYLIST:
@@ -245,18 +270,31 @@ void bl_init(void)
   // Mount SPIFFS
   filesystem_init();
 
-  if (wakeup_reason != ESP_SLEEP_WAKEUP_TIMER)
+  // frames prefetched with a bundle and widgets drawn over the current image are shown without turning on the radio
+  if (wakeup_reason == ESP_SLEEP_WAKEUP_TIMER && (showPrefetchedFrame() || showOverlays()))
   {
-    Log.info("%s [%d]: Display TRMNL logo start\r\n", __FILE__, __LINE__);
-
-  
-    display_show_image(storedLogoOrDefault(1), DEFAULT_IMAGE_SIZE, false);
+    goToSleep();
+  }
 
+  // a rewind steps back through the frames kept on flash, also without the radio
+  if (double_click && special_function == SF_REWIND && showOlderFrame())
+  {
+    goToSleep();
+  }
 
+  if (wakeup_reason != ESP_SLEEP_WAKEUP_TIMER)
+  {
     need_to_refresh_display = 1;
-    preferences.putBool(PREFERENCES_DEVICE_REGISTERED_KEY, false);
-    Log.info("%s [%d]: Display TRMNL logo end\r\n", __FILE__, __LINE__);
-    preferences.putString(PREFERENCES_FILENAME_KEY, "");
+    // the image the device had stays up, so the server's image only has to be drawn if it changed
+    if (!showInstantOn())
+    {
+      Log.info("%s [%d]: Display TRMNL logo start\r\n", __FILE__, __LINE__);
+      display_show_image(storedLogoOrDefault(1), DEFAULT_IMAGE_SIZE, false);
+      current_on_screen = false;
+      settings.setDeviceRegistered(false);
+      Log.info("%s [%d]: Display TRMNL logo end\r\n", __FILE__, __LINE__);
+      settings.setFilename("");
+    }
   }
 
   Log_info("Firmware version %s", FW_VERSION_STRING);
@@ -295,7 +333,7 @@ void bl_init(void)
     {
       String ip = String(WiFi.localIP());
       Log.info("%s [%d]:wifi_connection [DEBUG]: Connected: %s\r\n", __FILE__, __LINE__, ip.c_str());
-      preferences.putInt(PREFERENCES_CONNECT_WIFI_RETRY_COUNT, 1);
+      settings.setWifiRetryCount(1);
     }
     else
     {
@@ -321,6 +359,7 @@ void bl_init(void)
     showMessageWithLogo(WIFI_CONNECT, "", false, FW_VERSION_STRING, "");
     WifiCaptivePortal.setResetSettingsCallback(resetDeviceCredentials);
     res = WifiCaptivePortal.startPortal();
+    settings.reload(SETTING_API_URL); // the portal may have saved a custom server
     if (!res)
     {
       WiFi.disconnect(true);
@@ -333,7 +372,7 @@ void bl_init(void)
       wifiErrorDeepSleep();
     }
     Log.info("%s [%d]: WiFi connected\r\n", __FILE__, __LINE__);
-    preferences.putInt(PREFERENCES_CONNECT_WIFI_RETRY_COUNT, 1);
+    settings.setWifiRetryCount(1);
   }
 
 #endif
@@ -341,7 +380,7 @@ void bl_init(void)
   // clock synchronization
   if (setClock())
   {
-    time_since_sleep = preferences.getUInt(PREFERENCES_LAST_SLEEP_TIME, 0);
+    time_since_sleep = settings.lastSleepTime();
     time_since_sleep = time_since_sleep ? getTime() - time_since_sleep : 0; // may be can be used even if no sync
   }
   else
@@ -352,7 +391,7 @@ void bl_init(void)
 
   Log.info("%s [%d]: Time since last sleep: %d\r\n", __FILE__, __LINE__, time_since_sleep);
 
-  if (!preferences.isKey(PREFERENCES_API_KEY) || !preferences.isKey(PREFERENCES_FRIENDLY_ID))
+  if (!settings.exists(SETTING_API_KEY) || !settings.exists(SETTING_FRIENDLY_ID))
   {
     Log.info("%s [%d]: API key or friendly ID not saved\r\n", __FILE__, __LINE__);
     // lets get the api key and friendly ID
@@ -371,50 +410,59 @@ void bl_init(void)
   https_request_err_e request_result = downloadAndShow();
   Log.info("%s [%d]: request result - %d\r\n", __FILE__, __LINE__, request_result);
 
+  // widgets the server wants drawn over this image until the next online wake
+  if ((request_result == HTTPS_SUCCESS || request_result == HTTPS_NO_ERR) &&
+      overlay_start(apiDisplayResult.response.overlay.c_str(), request_result == HTTPS_SUCCESS || wakeup_reason != ESP_SLEEP_WAKEUP_TIMER,
+                    WiFi.RSSI(), settings.refreshRate()))
+  {
+    overlay_update(vBatt);
+  }
+
   if (request_result == HTTPS_IMAGE_FILE_TOO_BIG)
   {
     showMessageWithLogo(MSG_TOO_BIG);
   }
 
-  if (!preferences.isKey(PREFERENCES_CONNECT_API_RETRY_COUNT))
+  if (!settings.exists(SETTING_API_RETRY_COUNT))
   {
-    preferences.putInt(PREFERENCES_CONNECT_API_RETRY_COUNT, 1);
+    settings.setApiRetryCount(1);
   }
 
   if (request_result != HTTPS_SUCCESS && request_result != HTTPS_NO_ERR && request_result != HTTPS_NO_REGISTER && request_result != HTTPS_RESET && request_result != HTTPS_PLUGIN_NOT_ATTACHED)
   {
-    uint8_t retries = preferences.getInt(PREFERENCES_CONNECT_API_RETRY_COUNT);
+    uint8_t retries = settings.apiRetryCount();
+    overlay_offline(vBatt); // the image stays on screen, tell the user it is getting old
 
     switch (retries)
     {
     case 1:
       Log.info("%s [%d]: retry: %d - time to sleep: %d\r\n", __FILE__, __LINE__, retries, API_CONNECT_RETRY_TIME::API_FIRST_RETRY);
-      res = preferences.putUInt(PREFERENCES_SLEEP_TIME_KEY, API_CONNECT_RETRY_TIME::API_FIRST_RETRY);
-      preferences.putInt(PREFERENCES_CONNECT_API_RETRY_COUNT, ++retries);
+      settings.setRefreshRate(API_CONNECT_RETRY_TIME::API_FIRST_RETRY);
+      settings.setApiRetryCount(++retries);
       display_sleep();
       goToSleep();
       break;
 
     case 2:
       Log.info("%s [%d]: retry:%d - time to sleep: %d\r\n", __FILE__, __LINE__, retries, API_CONNECT_RETRY_TIME::API_SECOND_RETRY);
-      res = preferences.putUInt(PREFERENCES_SLEEP_TIME_KEY, API_CONNECT_RETRY_TIME::API_SECOND_RETRY);
-      preferences.putInt(PREFERENCES_CONNECT_API_RETRY_COUNT, ++retries);
+      settings.setRefreshRate(API_CONNECT_RETRY_TIME::API_SECOND_RETRY);
+      settings.setApiRetryCount(++retries);
       display_sleep();
       goToSleep();
       break;
 
     case 3:
       Log.info("%s [%d]: retry:%d - time to sleep: %d\r\n", __FILE__, __LINE__, retries, API_CONNECT_RETRY_TIME::API_THIRD_RETRY);
-      res = preferences.putUInt(PREFERENCES_SLEEP_TIME_KEY, API_CONNECT_RETRY_TIME::API_THIRD_RETRY);
-      preferences.putInt(PREFERENCES_CONNECT_API_RETRY_COUNT, ++retries);
+      settings.setRefreshRate(API_CONNECT_RETRY_TIME::API_THIRD_RETRY);
+      settings.setApiRetryCount(++retries);
       display_sleep();
       goToSleep();
       break;
 
     default:
       Log.info("%s [%d]: Max retries done. Time to sleep: %d\r\n", __FILE__, __LINE__, SLEEP_TIME_TO_SLEEP);
-      preferences.putUInt(PREFERENCES_SLEEP_TIME_KEY, SLEEP_TIME_TO_SLEEP);
-      preferences.putInt(PREFERENCES_CONNECT_API_RETRY_COUNT, ++retries);
+      settings.setRefreshRate(SLEEP_TIME_TO_SLEEP);
+      settings.setApiRetryCount(++retries);
       break;
     }
   }
@@ -422,7 +470,7 @@ void bl_init(void)
   else
   {
     Log_info("Connection done successfully. Retries counter reset.");
-    preferences.putInt(PREFERENCES_CONNECT_API_RETRY_COUNT, 1);
+    settings.setApiRetryCount(1);
   }
 
   submitStoredLogs();
@@ -430,7 +478,7 @@ void bl_init(void)
   if (request_result == HTTPS_NO_REGISTER && need_to_refresh_display == 1)
   {
     // show the image
-    String friendly_id = preferences.getString(PREFERENCES_FRIENDLY_ID, PREFERENCES_FRIENDLY_ID_DEFAULT);
+    String friendly_id = settings.friendlyId();
     showMessageWithLogo(FRIENDLY_ID, friendly_id, true, "", String(message_buffer));
     need_to_refresh_display = 0;
   }
@@ -504,10 +552,10 @@ void bl_init(void)
   break;
   case HTTPS_PLUGIN_NOT_ATTACHED:
   {
-    if (preferences.getInt(PREFERENCES_SLEEP_TIME_KEY, 0) != SLEEP_TIME_WHILE_PLUGIN_NOT_ATTACHED)
+    if (settings.refreshRate() != SLEEP_TIME_WHILE_PLUGIN_NOT_ATTACHED)
     {
       Log.info("%s [%d]: write new refresh rate: %d\r\n", __FILE__, __LINE__, SLEEP_TIME_WHILE_PLUGIN_NOT_ATTACHED);
-      preferences.putUInt(PREFERENCES_SLEEP_TIME_KEY, SLEEP_TIME_WHILE_PLUGIN_NOT_ATTACHED);
+      settings.setRefreshRate(SLEEP_TIME_WHILE_PLUGIN_NOT_ATTACHED);
       Log.info("%s [%d]: written new refresh rate: %d\r\n", __FILE__, __LINE__, SLEEP_TIME_WHILE_PLUGIN_NOT_ATTACHED);
     }
   }
@@ -521,7 +569,10 @@ void bl_init(void)
   if (!update_firmware)
     goToSleep();
   else
+  {
+    settings.flush();
     ESP.restart();
+  }
 }
 
 /**
@@ -533,15 +584,15 @@ void bl_process(void)
 {
 }
 
-ApiDisplayInputs loadApiDisplayInputs(Preferences &preferences)
+ApiDisplayInputs loadApiDisplayInputs()
 {
   ApiDisplayInputs inputs;
 
-  inputs.baseUrl = preferences.getString(PREFERENCES_API_URL, API_BASE_URL);
+  inputs.baseUrl = settings.apiUrl();
 
-  if (preferences.isKey(PREFERENCES_API_KEY))
+  if (settings.exists(SETTING_API_KEY))
   {
-    inputs.apiKey = preferences.getString(PREFERENCES_API_KEY, PREFERENCES_API_KEY_DEFAULT);
+    inputs.apiKey = settings.apiKey();
     Log.info("%s [%d]: %s key exists. Value - %s\r\n", __FILE__, __LINE__, PREFERENCES_API_KEY, inputs.apiKey.c_str());
   }
   else
@@ -549,10 +600,10 @@ ApiDisplayInputs loadApiDisplayInputs(Preferences &preferences)
     Log.info("%s [%d]: %s key not exists.\r\n", __FILE__, __LINE__, PREFERENCES_API_KEY);
   }
 
-  if (preferences.isKey(PREFERENCES_FRIENDLY_ID))
+  if (settings.exists(SETTING_FRIENDLY_ID))
   {
-    inputs.friendlyId = preferences.getString(PREFERENCES_FRIENDLY_ID, PREFERENCES_FRIENDLY_ID_DEFAULT);
-    Log.info("%s [%d]: %s key exists. Value - %s\r\n", __FILE__, __LINE__, PREFERENCES_FRIENDLY_ID, inputs.friendlyId);
+    inputs.friendlyId = settings.friendlyId();
+    Log.info("%s [%d]: %s key exists. Value - %s\r\n", __FILE__, __LINE__, PREFERENCES_FRIENDLY_ID, inputs.friendlyId.c_str());
   }
   else
   {
@@ -561,9 +612,9 @@ ApiDisplayInputs loadApiDisplayInputs(Preferences &preferences)
 
   inputs.refreshRate = SLEEP_TIME_TO_SLEEP;
 
-  if (preferences.isKey(PREFERENCES_SLEEP_TIME_KEY))
+  if (settings.exists(SETTING_REFRESH_RATE))
   {
-    inputs.refreshRate = preferences.getUInt(PREFERENCES_SLEEP_TIME_KEY, SLEEP_TIME_TO_SLEEP);
+    inputs.refreshRate = settings.refreshRate();
     Log.info("%s [%d]: %s key exists. Value - %d\r\n", __FILE__, __LINE__, PREFERENCES_SLEEP_TIME_KEY, inputs.refreshRate);
   }
   else
@@ -575,17 +626,70 @@ ApiDisplayInputs loadApiDisplayInputs(Preferences &preferences)
 
   inputs.batteryVoltage = vBatt; //readBatteryVoltage();
 
-  inputs.firmwareVersion = String(FW_VERSION_STRING);
+  inputs.firmwareVersion = FW_VERSION_STRING;
 
   inputs.rssi = WiFi.RSSI();
   inputs.displayWidth = display_width();
   inputs.displayHeight = display_height();
   inputs.model = DEVICE_MODEL;
   inputs.specialFunction = special_function;
+  inputs.frameCrc = display_frame_crc();
+
+  DeviceCapabilities &caps = inputs.capabilities;
+  memset(&caps, 0, sizeof(caps));
+  display_capabilities(caps);
+  // no bundles where SPIFFS can't hold them next to the images
+  caps.bundleBytes = playlist_budget();
+  if (caps.bundleBytes > 0)
+    caps.flags |= CAP_BUNDLE;
+  if (filesystem_file_exists("/current.bmp") || filesystem_file_exists("/current.png"))
+    caps.cache |= CAP_CACHE_CURRENT;
+  if (filesystem_file_exists("/last.bmp") || filesystem_file_exists("/last.png"))
+    caps.cache |= CAP_CACHE_LAST;
+  caps.history = history_frames();
+  caps.maxImageBytes = MAX_IMAGE_SIZE;
+  // the image buffer may come from PSRAM, so all 8-bit capable memory counts
+  caps.freeHeap = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+  caps.maxAlloc = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
 
   return inputs;
 }
 
+/**
+ * @brief Function to download the frame bundle of the /api/display response and store it for the next wakes
+ * @param inputs the request the response came from, for the credentials
+ * @return none
+ */
+static void downloadBundle(const ApiDisplayInputs &inputs)
+{
+  // called once the image is on screen, so the frames never hold it up
+  if (apiDisplayResult.response.bundle_url.length() == 0 || update_firmware || reset_firmware)
+    return;
+  withHttp(
+      apiDisplayResult.response.bundle_url.c_str(),
+      [&](HTTPClient *https, HttpError error) -> bool
+      {
+        if (error != HttpError::HTTPCLIENT_SUCCESS)
+        {
+          Log_error("Bundle download failed: cannot connect");
+          return false;
+        }
+        https->addHeader("Accept-Encoding", "identity");
+        if (strncmp(apiDisplayResult.response.bundle_url.c_str(), inputs.baseUrl.c_str(), inputs.baseUrl.length()) == 0)
+        {
+          https->addHeader("ID", inputs.macAddress.c_str());
+          https->addHeader("Access-Token", inputs.apiKey.c_str());
+        }
+        int httpCode = https->GET();
+        if (httpCode != HTTP_CODE_OK)
+        {
+          Log_error("Bundle download failed: HTTP %d", httpCode);
+          return false;
+        }
+        return playlist_download(*https, apiDisplayResult.response.bundle_valid_for);
+      });
+}
+
 /**
  * @brief Function to ping server and download and show the image if all is OK
  * @param url Server URL address
@@ -594,19 +698,12 @@ ApiDisplayInputs loadApiDisplayInputs(Preferences &preferences)
 static https_request_err_e downloadAndShow()
 {
   IPAddress serverIP;
-  String apiHostname = preferences.getString(PREFERENCES_API_URL, API_BASE_URL);
-  apiHostname.replace("https://", "");
-  apiHostname.replace("http://", "");
-  apiHostname.replace("/", "");
-
-  int colon = apiHostname.indexOf(':');
-  if (colon != -1) {
-    apiHostname = apiHostname.substring(0, colon);
-  }
+  FixedString<API_BASE_URL_SIZE> hostname;
+  apiHostname(settings.apiUrl(), hostname);
 
   for (int attempt = 1; attempt <= 5; ++attempt)
   {
-    if (WiFi.hostByName(apiHostname.c_str(), serverIP) == 1)
+    if (WiFi.hostByName(hostname.c_str(), serverIP) == 1)
     {
       Log.info("%s [%d]: Hostname resolved to %s on attempt %d\r\n", __FILE__, __LINE__, serverIP.toString().c_str(), attempt);
       break;
@@ -618,9 +715,9 @@ static https_request_err_e downloadAndShow()
     }
   }
 
-  auto apiDisplayInputs = loadApiDisplayInputs(preferences);
+  auto apiDisplayInputs = loadApiDisplayInputs();
 
-  apiDisplayResult = fetchApiDisplay(apiDisplayInputs);
+  fetchApiDisplay(apiDisplayInputs, apiDisplayResult);
 
   if (apiDisplayResult.error != HTTPS_NO_ERR)
   {
@@ -630,6 +727,31 @@ static https_request_err_e downloadAndShow()
 
   https_request_err_e result = handleApiDisplayResponse(apiDisplayResult.response);
 
+  // any older bundle is dropped, the frames of a new one are fetched once this image is on screen
+  playlist_stop();
+
+  // a screen sent as a display list is drawn here; there is no image to download
+  if (status && !update_firmware && !reset_firmware && apiDisplayResult.response.display_list_size > 0 && showDisplayList())
+  {
+    downloadBundle(apiDisplayInputs);
+    status = false;
+    if (result != HTTPS_PLUGIN_NOT_ATTACHED)
+      result = HTTPS_SUCCESS;
+    Log_info("Returned result - %d", result);
+    return result;
+  }
+
+  // only the tiles that changed, applied to the image on screen; the full image is downloaded if that fails
+  if (status && !update_firmware && !reset_firmware && apiDisplayResult.response.delta_url.length() > 0 && showTileDelta(apiDisplayInputs))
+  {
+    downloadBundle(apiDisplayInputs);
+    status = false;
+    if (result != HTTPS_PLUGIN_NOT_ATTACHED)
+      result = HTTPS_SUCCESS;
+    Log_info("Returned result - %d", result);
+    return result;
+  }
+
   withHttp(
       filename,
       [&](HTTPClient *httpsp, HttpError error) -> https_request_err_e
@@ -650,8 +772,8 @@ static https_request_err_e downloadAndShow()
         // Include ID and Access Token if the image is hosted on the same server as the API
         if (strncmp(filename, apiDisplayInputs.baseUrl.c_str(), apiDisplayInputs.baseUrl.length()) == 0)
         {
-          https.addHeader("ID", apiDisplayInputs.macAddress);
-          https.addHeader("Access-Token", apiDisplayInputs.apiKey);
+          https.addHeader("ID", apiDisplayInputs.macAddress.c_str());
+          https.addHeader("Access-Token", apiDisplayInputs.apiKey.c_str());
         }
         
         if (status && !update_firmware && !reset_firmware)
@@ -679,23 +801,23 @@ static https_request_err_e downloadAndShow()
             }
           }
 
-          const char *headers[] = {"Content-Type"};
-          https.collectHeaders(headers, 1);
           Log_info("GET...");
           Log_info("RSSI: %d", WiFi.RSSI());
-          // start connection and send HTTP header
-          int httpCode = https.GET();
-          int content_size = https.getSize();
-          if(httpCode == HTTP_CODE_PERMANENT_REDIRECT ||
-            httpCode == HTTP_CODE_TEMPORARY_REDIRECT){
-              https.end();
-              https.begin(API_BASE_URL +https.getLocation());
-              Log_info("Redirected to: %s", https.getLocation().c_str());
-              https.setTimeout(15000);
-              https.setConnectTimeout(15000);
-              httpCode = https.GET();
-              content_size = https.getSize();
-            }
+          // an interrupted download is parked on SPIFFS and continued with a Range request on the next wake
+          HttpRangeRequest request(https, API_BASE_URL);
+          ImageBufferSink image(imageCheckpoint);
+          ResumableDownload download(imageCheckpoint, apiDisplayResult.response.filename.c_str(), image, 1);
+          if (download.canResume())
+          {
+            Log_info("Resuming image download at %u of %u bytes", imageCheckpoint.received, imageCheckpoint.total);
+          }
+
+          Log.info("%s [%d]: Starting a download at: %d\r\n", __FILE__, __LINE__, getTime());
+          heap_caps_check_integrity_all(true);
+
+          // start connection, send HTTP header and receive the body (chunked transfer encoding is handled too)
+          DownloadOutcome outcome = download.attempt(request);
+          int httpCode = request.status();
 //          uint8_t *buffer_old = nullptr; // Disable partial update for now
 //          int file_size_old = 0;
 
@@ -710,31 +832,27 @@ static https_request_err_e downloadAndShow()
           // HTTP header has been send and Server response header has been handled
           Log.error("%s [%d]: [HTTPS] GET... code: %d\r\n", __FILE__, __LINE__, httpCode);
           Log.info("%s [%d]: RSSI: %d\r\n", __FILE__, __LINE__, WiFi.RSSI());
-          // file found at server
-          if (httpCode != HTTP_CODE_OK && httpCode != HTTP_CODE_MOVED_PERMANENTLY)
+
+          if (outcome != DownloadOutcome::Complete)
           {
-            Log_error_submit("[HTTPS] GET... failed, code: %d (%s)", httpCode, https.errorToString(httpCode).c_str());
+            if (outcome == DownloadOutcome::Interrupted && !image.savePartial())
+              clearDownloadCheckpoint(imageCheckpoint); // nothing to continue from, the next wake starts over
+            Log_error_submit("Image download %s after %u bytes: %s (code %d)",
+                             outcome == DownloadOutcome::Interrupted ? "interrupted" : "failed", download.received(), download.error(), httpCode);
+            if (image.tooBig())
+              return HTTPS_IMAGE_FILE_TOO_BIG;
+            if (image.outOfMemory())
+              return HTTPS_OUT_OF_MEMORY;
             return HTTPS_REQUEST_FAILED;
           }
-          
-          Log.info("%s [%d]: Content size: %d\r\n", __FILE__, __LINE__, https.getSize());
-
-          uint32_t counter = 0;
-
-          if (content_size <= 0)
+          if (download.resumedFrom() > 0)
           {
-            Log.warning("%s [%d]: Content-Length not provided (size: %d)\r\n", __FILE__, __LINE__, content_size);
+            Log_info("Image download resumed at %u", download.resumedFrom());
+            filesystem_file_delete(IMAGE_PARTIAL_FILE);
           }
 
-          bool isPNG = https.header("Content-Type") == "image/png";
-          bool isJPEG = https.header("Content-Type") == "image/jpeg";
-
-          Log.info("%s [%d]: Starting a download at: %d\r\n", __FILE__, __LINE__, getTime());
-          heap_caps_check_integrity_all(true);
-
-          // getString() handles chunked transfer encoding automatically
-          String payload = https.getString();
-          counter = payload.length();
+          uint32_t counter = download.received();
+          Log.info("%s [%d]: Content size: %d\r\n", __FILE__, __LINE__, counter);
 
           if (counter == 0)
           {
@@ -742,41 +860,34 @@ static https_request_err_e downloadAndShow()
             return HTTPS_WRONG_IMAGE_SIZE;
           }
 
-          if (counter > MAX_IMAGE_SIZE)
-          {
-            Log_error_submit("Receiving failed; file size too big: %d", counter);
-            return HTTPS_IMAGE_FILE_TOO_BIG;
-          }
-
-          buffer = (uint8_t *)malloc(counter);
-
-          if (buffer == NULL)
-          {
-            Log_error_submit("Failed to allocate %d bytes for image buffer", counter);
-            return HTTPS_OUT_OF_MEMORY;
-          }
+          bool isPNG = request.contentType() == "image/png";
+          bool isJPEG = request.contentType() == "image/jpeg";
 
-          memcpy(buffer, payload.c_str(), counter);
-          content_size = counter;
+          buffer = image.release();
+          int content_size = counter;
 
           if (counter >= 2 && buffer[0] == 'B' && buffer[1] == 'M')
           {
             isPNG = false;
             Log.info("BMP file detected");
           }
+          bool isRLE = frameRleMatch(buffer, content_size);
+          bool isG5Planes = g5PlanesMatch(buffer, content_size);
+          if (isRLE || isG5Planes)
+          {
+            isPNG = false;
+            Log.info("%s file detected", isRLE ? "TRLE" : "4-gray G5");
+          }
 
           submitStoredLogs();
 
-          WiFi.disconnect(true); // no need for WiFi, save power starting here
+          if (apiDisplayResult.response.bundle_url.length() == 0)
+            WiFi.disconnect(true); // no need for WiFi, save power starting here
           Log.info("%s [%d]: Received successfully; WiFi off; WiFi off\r\n", __FILE__, __LINE__);
 
 
-          if (filesystem_file_exists("/current.bmp") || filesystem_file_exists("/current.png"))
+          if (keepCurrentImageAsLast())
           {
-            filesystem_file_delete("/last.bmp");
-            filesystem_file_delete("/last.png");
-            filesystem_file_rename("/current.png", "/last.png");
-            filesystem_file_rename("/current.bmp", "/last.bmp");
 // Disable partial update (for now)
 //            if (filesystem_file_exists("/last.png")) {
 //                buffer_old = display_read_file("/last.png", &file_size_old);
@@ -784,23 +895,24 @@ static https_request_err_e downloadAndShow()
 //            }
           }
 
-          bool image_reverse = false;
-          if (isPNG || isJPEG)
+          if (isPNG || isJPEG || isRLE || isG5Planes)
           {
             writeImageToFile("/current.png", buffer, content_size);
-            Log.info("%s [%d]: Decoding %s\r\n", __FILE__, __LINE__, (isPNG) ? "png" : "jpeg");
+            Log.info("%s [%d]: Decoding %s\r\n", __FILE__, __LINE__, isPNG ? "png" : (isJPEG ? "jpeg" : (isRLE ? "rle" : "g5 planes")));
             display_show_image(buffer, content_size, true);
+            current_on_screen = true;
             free(buffer);
             buffer = nullptr;
             png_res = PNG_NO_ERR; // DEBUG
           }
           else
           {
-            bmp_res = parseBMPHeader(buffer, image_reverse);
+            BmpInfo bmp_info;
+            bmp_res = parseBMPInfo(buffer, content_size, bmp_info);
             Log.info("%s [%d]: BMP Parsing result: %d\r\n", __FILE__, __LINE__, bmp_res);
           }
           Serial.println();
-          String error = "";
+          const char *error = "";
          // uint8_t *imagePointer = buffer;
 //          uint8_t *imagePointer = (decodedPng == nullptr) ? buffer : decodedPng;
         //  bool lastImageExists = filesystem_file_exists("/last.bmp") || filesystem_file_exists("/last.png");
@@ -819,11 +931,7 @@ static https_request_err_e downloadAndShow()
             // Print the extracted string
             Log.info("%s [%d]: New filename - %s\r\n", __FILE__, __LINE__, new_filename.c_str());
 
-            bool res = saveCurrentFileName(new_filename);
-            if (res)
-              Log.info("%s [%d]: New filename saved\r\n", __FILE__, __LINE__);
-            else
-              Log.error("%s [%d]: New image name saving error!", __FILE__, __LINE__);
+            saveCurrentFileName(new_filename.c_str());
 
             if (result != HTTPS_PLUGIN_NOT_ATTACHED)
               result = HTTPS_SUCCESS;
@@ -863,6 +971,7 @@ static https_request_err_e downloadAndShow()
             }
             Log.info("Free heap at before display - %d", ESP.getMaxAllocHeap());
             display_show_image(buffer, content_size, true);
+            current_on_screen = true;
             free(buffer);
             buffer = nullptr;
 
@@ -872,11 +981,7 @@ static https_request_err_e downloadAndShow()
             // Print the extracted string
             Log.info("%s [%d]: New filename - %s\r\n", __FILE__, __LINE__, new_filename.c_str());
 
-            bool res = saveCurrentFileName(new_filename);
-            if (res)
-              Log.info("%s [%d]: New filename saved\r\n", __FILE__, __LINE__);
-            else
-              Log.error("%s [%d]: New image name saving error!", __FILE__, __LINE__);
+            saveCurrentFileName(new_filename.c_str());
 
             if (result != HTTPS_PLUGIN_NOT_ATTACHED)
               result = HTTPS_SUCCESS;
@@ -909,7 +1014,7 @@ static https_request_err_e downloadAndShow()
           if (isPNG && png_res != PNG_NO_ERR)
           {
             filesystem_file_delete("/current.png");
-            Log_error_submit("error parsing image file - %s", error.c_str());
+            Log_error_submit("error parsing image file - %s", error);
 
             return HTTPS_WRONG_IMAGE_FORMAT;
           }
@@ -918,6 +1023,13 @@ static https_request_err_e downloadAndShow()
         return result;
       });
 
+  // WiFi was left on for the frames of the bundle
+  if (apiDisplayResult.response.bundle_url.length() > 0)
+  {
+    downloadBundle(apiDisplayInputs);
+    WiFi.disconnect(true);
+  }
+
   if (result == HTTPS_UNABLE_TO_CONNECT)
   {
     Log_error_submit("unable to connect");
@@ -975,9 +1087,9 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
     {
     case 0:
     {
-      String image_url = apiResponse.image_url;
+      const auto &image_url = apiResponse.image_url;
       update_firmware = apiResponse.update_firmware;
-      String firmware_url = apiResponse.firmware_url;
+      const auto &firmware_url = apiResponse.firmware_url;
       uint64_t rate = apiResponse.refresh_rate;
       reset_firmware = apiResponse.reset_firmware;
 
@@ -994,17 +1106,18 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
           update_firmware = false;
         }
       }
-      if (image_url.length() > 0)
+      // a display list can come without an image_url; downloadAndShow() draws it instead
+      if (image_url.length() > 0 || apiResponse.display_list_size > 0)
       {
         Log.info("%s [%d]: image_url: %s\r\n", __FILE__, __LINE__, image_url.c_str());
         Log.info("%s [%d]: image url end with: %d\r\n", __FILE__, __LINE__, image_url.endsWith("/setup-logo.bmp"));
 
-        image_url.toCharArray(filename, image_url.length() + 1);
+        strcpy(filename, image_url.c_str());
         // check if plugin is applied
-        bool flag = preferences.getBool(PREFERENCES_DEVICE_REGISTERED_KEY, false);
+        bool flag = settings.deviceRegistered();
         Log.info("%s [%d]: flag: %d\r\n", __FILE__, __LINE__, flag);
 
-        if (apiResponse.filename == "empty_state")
+        if (!apiResponseFilename(apiResponse, new_filename))
         {
           Log.info("%s [%d]: End with empty_state\r\n", __FILE__, __LINE__);
           if (!flag)
@@ -1012,14 +1125,7 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
             // draw received logo
             status = true;
             // set flag to true
-            if (preferences.getBool(PREFERENCES_DEVICE_REGISTERED_KEY, false) != true) // check the flag to avoid the re-writing
-            {
-              bool res = preferences.putBool(PREFERENCES_DEVICE_REGISTERED_KEY, true);
-              if (res)
-                Log.info("%s [%d]: Flag written true successfully\r\n", __FILE__, __LINE__);
-              else
-                Log.error("%s [%d]: FLag writing failed\r\n", __FILE__, __LINE__);
-            }
+            settings.setDeviceRegistered(true); // only written to flash if the flag changed
           }
           else
           {
@@ -1034,21 +1140,12 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
           Log.info("%s [%d]: End with NO empty_state\r\n", __FILE__, __LINE__);
           if (flag)
           {
-            if (preferences.getBool(PREFERENCES_DEVICE_REGISTERED_KEY, false) != false) // check the flag to avoid the re-writing
-            {
-              bool res = preferences.putBool(PREFERENCES_DEVICE_REGISTERED_KEY, false);
-              if (res)
-                Log.info("%s [%d]: Flag written false successfully\r\n", __FILE__, __LINE__);
-              else
-                Log.error("%s [%d]: FLag writing failed\r\n", __FILE__, __LINE__);
-            }
+            settings.setDeviceRegistered(false); // only written to flash if the flag changed
           }
-          // Using filename from API response
-          new_filename = apiResponse.filename;
 
           // Print the extracted string
           Log.info("%s [%d]: New filename - %s\r\n", __FILE__, __LINE__, new_filename.c_str());
-          if (!checkCurrentFileName(new_filename))
+          if (!checkCurrentFileName(new_filename.c_str()))
           {
             Log.info("%s [%d]: New image. Show it.\r\n", __FILE__, __LINE__);
             status = true;
@@ -1056,6 +1153,8 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
           else
           {
             Log.info("%s [%d]: Old image. No needed to show it.\r\n", __FILE__, __LINE__);
+            if (history_show_current()) // unless an older frame was rewound to
+              current_on_screen = true;
             status = false;
             result = HTTPS_SUCCESS;
           }
@@ -1065,13 +1164,15 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
       if (firmware_url.length() > 0)
       {
         Log.info("%s [%d]: firmware_url: %s\r\n", __FILE__, __LINE__, firmware_url.c_str());
-        firmware_url.toCharArray(binUrl, firmware_url.length() + 1);
+        strcpy(binUrl, firmware_url.c_str());
+        binEncoding = apiResponse.firmware_encoding;
+        Log.info("%s [%d]: firmware_encoding: %s\r\n", __FILE__, __LINE__, otaEncodingToString(binEncoding));
       }
       Log.info("%s [%d]: refresh_rate: %d\r\n", __FILE__, __LINE__, rate);
-      if (rate != preferences.getUInt(PREFERENCES_SLEEP_TIME_KEY, SLEEP_TIME_TO_SLEEP))
+      if (rate != settings.refreshRate())
       {
         Log.info("%s [%d]: write new refresh rate: %d\r\n", __FILE__, __LINE__, rate);
-        preferences.putUInt(PREFERENCES_SLEEP_TIME_KEY, rate);
+        settings.setRefreshRate(rate);
         Log.info("%s [%d]: written new refresh rate: %d\r\n", __FILE__, __LINE__, result);
       }
 
@@ -1093,7 +1194,7 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
     {
       result = HTTPS_NO_REGISTER;
       Log.info("%s [%d]: write new refresh rate: %d\r\n", __FILE__, __LINE__, SLEEP_TIME_WHILE_NOT_CONNECTED);
-      size_t result = preferences.putUInt(PREFERENCES_SLEEP_TIME_KEY, SLEEP_TIME_WHILE_NOT_CONNECTED);
+      settings.setRefreshRate(SLEEP_TIME_WHILE_NOT_CONNECTED);
       Log.info("%s [%d]: written new refresh rate: %d\r\n", __FILE__, __LINE__, result);
       status = false;
     }
@@ -1102,7 +1203,7 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
     {
       result = HTTPS_RESET;
       Log.info("%s [%d]: write new refresh rate: %d\r\n", __FILE__, __LINE__, SLEEP_TIME_WHILE_NOT_CONNECTED);
-      preferences.putUInt(PREFERENCES_SLEEP_TIME_KEY, SLEEP_TIME_WHILE_NOT_CONNECTED);
+      settings.setRefreshRate(SLEEP_TIME_WHILE_NOT_CONNECTED);
       Log.info("%s [%d]: written new refresh rate: %d\r\n", __FILE__, __LINE__, result);
       status = false;
     }
@@ -1124,22 +1225,22 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
       {
       case SF_IDENTIFY:
       {
-        String action = apiResponse.action;
+        const auto &action = apiResponse.action;
         if (action.equals("identify"))
         {
           Log.info("%s [%d]:Identify success\r\n", __FILE__, __LINE__);
-          String image_url = apiResponse.image_url;
+          const auto &image_url = apiResponse.image_url;
           if (image_url.length() > 0)
           {
             Log.info("%s [%d]: image_url: %s\r\n", __FILE__, __LINE__, image_url.c_str());
             Log.info("%s [%d]: image url end with: %d\r\n", __FILE__, __LINE__, image_url.endsWith("/setup-logo.bmp"));
 
-            image_url.toCharArray(filename, image_url.length() + 1);
+            strcpy(filename, image_url.c_str());
             // check if plugin is applied
-            bool flag = preferences.getBool(PREFERENCES_DEVICE_REGISTERED_KEY, false);
+            bool flag = settings.deviceRegistered();
             Log.info("%s [%d]: flag: %d\r\n", __FILE__, __LINE__, flag);
 
-            if (apiResponse.filename == "empty_state")
+            if (strcmp(apiResponse.filename, "empty_state") == 0)
             {
               Log.info("%s [%d]: End with empty_state\r\n", __FILE__, __LINE__);
               if (!flag)
@@ -1147,14 +1248,7 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
                 // draw received logo
                 status = true;
                 // set flag to true
-                if (preferences.getBool(PREFERENCES_DEVICE_REGISTERED_KEY, false) != true) // check the flag to avoid the re-writing
-                {
-                  bool res = preferences.putBool(PREFERENCES_DEVICE_REGISTERED_KEY, true);
-                  if (res)
-                    Log.info("%s [%d]: Flag written true successfully\r\n", __FILE__, __LINE__);
-                  else
-                    Log.error("%s [%d]: FLag writing failed\r\n", __FILE__, __LINE__);
-                }
+                settings.setDeviceRegistered(true); // only written to flash if the flag changed
               }
               else
               {
@@ -1166,14 +1260,7 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
               Log.info("%s [%d]: End with NO empty_state\r\n", __FILE__, __LINE__);
               if (flag)
               {
-                if (preferences.getBool(PREFERENCES_DEVICE_REGISTERED_KEY, false) != false) // check the flag to avoid the re-writing
-                {
-                  bool res = preferences.putBool(PREFERENCES_DEVICE_REGISTERED_KEY, false);
-                  if (res)
-                    Log.info("%s [%d]: Flag written false successfully\r\n", __FILE__, __LINE__);
-                  else
-                    Log.error("%s [%d]: FLag writing failed\r\n", __FILE__, __LINE__);
-                }
+                settings.setDeviceRegistered(false); // only written to flash if the flag changed
               }
               status = true;
             }
@@ -1187,15 +1274,15 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
       break;
       case SF_SLEEP:
       {
-        String action = apiResponse.action;
+        const auto &action = apiResponse.action;
         if (action.equals("sleep"))
         {
           uint64_t rate = apiResponse.refresh_rate;
           Log.info("%s [%d]: refresh_rate: %d\r\n", __FILE__, __LINE__, rate);
-          if (rate != preferences.getUInt(PREFERENCES_SLEEP_TIME_KEY, SLEEP_TIME_TO_SLEEP))
+          if (rate != settings.refreshRate())
           {
             Log.info("%s [%d]: write new refresh rate: %d\r\n", __FILE__, __LINE__, rate);
-            preferences.putUInt(PREFERENCES_SLEEP_TIME_KEY, rate);
+            settings.setRefreshRate(rate);
             Log.info("%s [%d]: written new refresh rate: %d\r\n", __FILE__, __LINE__, result);
           }
           status = false;
@@ -1211,7 +1298,7 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
       break;
       case SF_ADD_WIFI:
       {
-        String action = apiResponse.action;
+        const auto &action = apiResponse.action;
         if (action.equals("add_wifi"))
         {
           status = false;
@@ -1226,22 +1313,22 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
       break;
       case SF_RESTART_PLAYLIST:
       {
-        String action = apiResponse.action;
+        const auto &action = apiResponse.action;
         if (action.equals("restart_playlist"))
         {
           Log.info("%s [%d]:Restart playlist success\r\n", __FILE__, __LINE__);
-          String image_url = apiResponse.image_url;
+          const auto &image_url = apiResponse.image_url;
           if (image_url.length() > 0)
           {
             Log.info("%s [%d]: image_url: %s\r\n", __FILE__, __LINE__, image_url.c_str());
             Log.info("%s [%d]: image url end with: %d\r\n", __FILE__, __LINE__, image_url.endsWith("/setup-logo.bmp"));
 
-            image_url.toCharArray(filename, image_url.length() + 1);
+            strcpy(filename, image_url.c_str());
             // check if plugin is applied
-            bool flag = preferences.getBool(PREFERENCES_DEVICE_REGISTERED_KEY, false);
+            bool flag = settings.deviceRegistered();
             Log.info("%s [%d]: flag: %d\r\n", __FILE__, __LINE__, flag);
 
-            if (apiResponse.filename == "empty_state")
+            if (strcmp(apiResponse.filename, "empty_state") == 0)
             {
               Log.info("%s [%d]: End with empty_state\r\n", __FILE__, __LINE__);
               if (!flag)
@@ -1249,14 +1336,7 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
                 // draw received logo
                 status = true;
                 // set flag to true
-                if (preferences.getBool(PREFERENCES_DEVICE_REGISTERED_KEY, false) != true) // check the flag to avoid the re-writing
-                {
-                  bool res = preferences.putBool(PREFERENCES_DEVICE_REGISTERED_KEY, true);
-                  if (res)
-                    Log.info("%s [%d]: Flag written true successfully\r\n", __FILE__, __LINE__);
-                  else
-                    Log.error("%s [%d]: FLag writing failed\r\n", __FILE__, __LINE__);
-                }
+                settings.setDeviceRegistered(true); // only written to flash if the flag changed
               }
               else
               {
@@ -1269,14 +1349,7 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
               Log.info("%s [%d]: End with NO empty_state\r\n", __FILE__, __LINE__);
               if (flag)
               {
-                if (preferences.getBool(PREFERENCES_DEVICE_REGISTERED_KEY, false) != false) // check the flag to avoid the re-writing
-                {
-                  bool res = preferences.putBool(PREFERENCES_DEVICE_REGISTERED_KEY, false);
-                  if (res)
-                    Log.info("%s [%d]: Flag written false successfully\r\n", __FILE__, __LINE__);
-                  else
-                    Log.error("%s [%d]: FLag writing failed\r\n", __FILE__, __LINE__);
-                }
+                settings.setDeviceRegistered(false); // only written to flash if the flag changed
               }
               status = true;
             }
@@ -1290,31 +1363,35 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
       break;
       case SF_REWIND:
       {
-        String action = apiResponse.action;
+        const auto &action = apiResponse.action;
         if (action.equals("rewind"))
         {
           status = false;
           result = HTTPS_SUCCESS;
           Log.info("%s [%d]: rewind success\r\n", __FILE__, __LINE__);
 
-          bool image_reverse = false;
           bool file_check_bmp = true;
           image_err_e image_proccess_response = PNG_WRONG_FORMAT;
           bmp_err_e bmp_proccess_response = BMP_NOT_BMP;
 
           // showMessageWithLogo(MSG_FORMAT_ERROR);
           String last_dot_file = filesystem_file_exists("/last.bmp") ? "/last.bmp" : "/last.png";
+          uint8_t *image = nullptr; // in flash when the image store has it, else read into buffer
           if (last_dot_file == "/last.bmp")
           {
             Log.info("Rewind BMP\n\r");
-            buffer = (uint8_t *)malloc(DISPLAY_BMP_IMAGE_SIZE);
-            file_check_bmp = filesystem_read_from_file(last_dot_file.c_str(), buffer, DISPLAY_BMP_IMAGE_SIZE);
-            bmp_proccess_response = parseBMPHeader(buffer, image_reverse);
+            image = display_map_file(last_dot_file.c_str(), &file_size, &buffer);
+            file_check_bmp = image != nullptr;
+            if (file_check_bmp)
+            {
+              BmpInfo bmp_info;
+              bmp_proccess_response = parseBMPInfo(image, file_size, bmp_info);
+            }
           }
           else if (last_dot_file == "/last.png")
           {
             Log.info("Rewind PNG\n\r");
-            buffer = display_read_file(last_dot_file.c_str(), &file_size);
+            image = display_map_file(last_dot_file.c_str(), &file_size, &buffer);
             image_proccess_response = PNG_NO_ERR; // DEBUG
           }
 
@@ -1325,7 +1402,8 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
             case PNG_NO_ERR:
             {
               Log.info("Showing image\n\r");
-              display_show_image(buffer, file_size, true);
+              display_show_image(image, file_size, true);
+              current_on_screen = false;
               need_to_refresh_display = 1;
             }
             break;
@@ -1339,7 +1417,8 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
             case BMP_NO_ERR:
             {
               Log.info("Showing image\n\r");
-              display_show_image(buffer, DISPLAY_BMP_IMAGE_SIZE, true);
+              display_show_image(image, file_size, true);
+              current_on_screen = false;
               need_to_refresh_display = 1;
             }
             break;
@@ -1364,7 +1443,7 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
       break;
       case SF_SEND_TO_ME:
       {
-        String action = apiResponse.action;
+        const auto &action = apiResponse.action;
 
         if (action.equals("send_to_me"))
         {
@@ -1372,8 +1451,6 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
           result = HTTPS_SUCCESS;
           Log.info("%s [%d]: send_to_me success\r\n", __FILE__, __LINE__);
 
-          bool image_reverse = false;
-
           if (!filesystem_file_exists("/current.bmp") && !filesystem_file_exists("/current.png"))
           {
             Log.info("%s [%d]: No current image!\r\n", __FILE__, __LINE__);
@@ -1382,20 +1459,20 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
             return HTTPS_WRONG_IMAGE_FORMAT;
           }
 
+          uint8_t *image = nullptr; // in flash when the image store has it, else read into buffer
           if (filesystem_file_exists("/current.bmp"))
           {
             Log.info("%s [%d]: send_to_me BMP\r\n", __FILE__, __LINE__);
-            buffer = (uint8_t *)malloc(DISPLAY_BMP_IMAGE_SIZE);
+            image = display_map_file("/current.bmp", &file_size, &buffer);
 
-            if (!filesystem_read_from_file("/current.bmp", buffer, DISPLAY_BMP_IMAGE_SIZE))
+            if (!image)
             {
-              free(buffer);
-              buffer = nullptr;
               Log_error_submit("Error reading image!");
               return HTTPS_WRONG_IMAGE_FORMAT;
             }
 
-            bmp_err_e bmp_parse_result = parseBMPHeader(buffer, image_reverse);
+            BmpInfo bmp_info;
+            bmp_err_e bmp_parse_result = parseBMPInfo(image, file_size, bmp_info);
             if (bmp_parse_result != BMP_NO_ERR)
             {
               free(buffer);
@@ -1408,7 +1485,7 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
           {
             Log.info("%s [%d]: send_to_me PNG\r\n", __FILE__, __LINE__);
             image_err_e png_parse_result = PNG_NO_ERR; // DEBUG
-            buffer = display_read_file("/current.png", &file_size);
+            image = display_map_file("/current.png", &file_size, &buffer);
 // Disable partial update for now
 //            if (filesystem_file_exists("/last.png")) {
 //                buffer_old = display_read_file("/last.png", &file_size_old);
@@ -1424,7 +1501,8 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
           }
 
           Log.info("Showing image\n\r");
-          display_show_image(buffer, file_size, true);
+          display_show_image(image, file_size, true);
+          current_on_screen = true;
           need_to_refresh_display = 1;
 
           free(buffer);
@@ -1438,23 +1516,23 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
       break;
       case SF_GUEST_MODE:
       {
-        String action = apiResponse.action;
+        const auto &action = apiResponse.action;
         if (action.equals("guest_mode"))
         {
           Log.info("%s [%d]:Guest Mode success\r\n", __FILE__, __LINE__);
-          String image_url = apiResponse.image_url;
+          const auto &image_url = apiResponse.image_url;
           uint64_t rate = apiResponse.refresh_rate;
           if (image_url.length() > 0)
           {
             Log.info("%s [%d]: image_url: %s\r\n", __FILE__, __LINE__, image_url.c_str());
             Log.info("%s [%d]: image url end with: %d\r\n", __FILE__, __LINE__, image_url.endsWith("/setup-logo.bmp"));
 
-            image_url.toCharArray(filename, image_url.length() + 1);
+            strcpy(filename, image_url.c_str());
             // check if plugin is applied
-            bool flag = preferences.getBool(PREFERENCES_DEVICE_REGISTERED_KEY, false);
+            bool flag = settings.deviceRegistered();
             Log.info("%s [%d]: flag: %d\r\n", __FILE__, __LINE__, flag);
 
-            if (apiResponse.filename == "empty_state")
+            if (strcmp(apiResponse.filename, "empty_state") == 0)
             {
               Log.info("%s [%d]: End with empty_state\r\n", __FILE__, __LINE__);
               if (!flag)
@@ -1462,14 +1540,7 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
                 // draw received logo
                 status = true;
                 // set flag to true
-                if (preferences.getBool(PREFERENCES_DEVICE_REGISTERED_KEY, false) != true) // check the flag to avoid the re-writing
-                {
-                  bool res = preferences.putBool(PREFERENCES_DEVICE_REGISTERED_KEY, true);
-                  if (res)
-                    Log.info("%s [%d]: Flag written true successfully\r\n", __FILE__, __LINE__);
-                  else
-                    Log.error("%s [%d]: FLag writing failed\r\n", __FILE__, __LINE__);
-                }
+                settings.setDeviceRegistered(true); // only written to flash if the flag changed
               }
               else
               {
@@ -1482,19 +1553,12 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
               Log.info("%s [%d]: End with NO empty_state\r\n", __FILE__, __LINE__);
               if (flag)
               {
-                if (preferences.getBool(PREFERENCES_DEVICE_REGISTERED_KEY, false) != false) // check the flag to avoid the re-writing
-                {
-                  bool res = preferences.putBool(PREFERENCES_DEVICE_REGISTERED_KEY, false);
-                  if (res)
-                    Log.info("%s [%d]: Flag written false successfully\r\n", __FILE__, __LINE__);
-                  else
-                    Log.error("%s [%d]: FLag writing failed\r\n", __FILE__, __LINE__);
-                }
+                settings.setDeviceRegistered(false); // only written to flash if the flag changed
               }
               status = true;
             }
           }
-          preferences.putUInt(PREFERENCES_SLEEP_TIME_KEY, rate);
+          settings.setRefreshRate(rate);
         }
         else
         {
@@ -1511,7 +1575,7 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
     {
       result = HTTPS_NO_REGISTER;
       Log.info("%s [%d]: write new refresh rate: %d\r\n", __FILE__, __LINE__, SLEEP_TIME_WHILE_NOT_CONNECTED);
-      preferences.putUInt(PREFERENCES_SLEEP_TIME_KEY, SLEEP_TIME_WHILE_NOT_CONNECTED);
+      settings.setRefreshRate(SLEEP_TIME_WHILE_NOT_CONNECTED);
       Log.info("%s [%d]: written new refresh rate: %d\r\n", __FILE__, __LINE__, result);
       status = false;
     }
@@ -1520,7 +1584,7 @@ https_request_err_e handleApiDisplayResponse(ApiDisplayResponse &apiResponse)
     {
       result = HTTPS_RESET;
       Log.info("%s [%d]: write new refresh rate: %d\r\n", __FILE__, __LINE__, SLEEP_TIME_WHILE_NOT_CONNECTED);
-      preferences.putUInt(PREFERENCES_SLEEP_TIME_KEY, SLEEP_TIME_WHILE_NOT_CONNECTED);
+      settings.setRefreshRate(SLEEP_TIME_WHILE_NOT_CONNECTED);
       Log.info("%s [%d]: written new refresh rate: %d\r\n", __FILE__, __LINE__, result);
       status = false;
     }
@@ -1541,7 +1605,7 @@ static bool performApiSetup()
 {
   // Set up the API inputs
   ApiSetupInputs inputs;
-  inputs.baseUrl = preferences.getString(PREFERENCES_API_URL, API_BASE_URL);
+  inputs.baseUrl = settings.apiUrl();
   inputs.macAddress = WiFi.macAddress();
   inputs.firmwareVersion = FW_VERSION_STRING;
 
@@ -1593,23 +1657,19 @@ static bool performApiSetup()
     status = true;
     Log.info("%s [%d]: status OK.\r\n", __FILE__, __LINE__);
 
-    String api_key = apiResponse.api_key;
-    Log.info("%s [%d]: API key - %s\r\n", __FILE__, __LINE__, api_key.c_str());
-    size_t res = preferences.putString(PREFERENCES_API_KEY, api_key);
-    Log.info("%s [%d]: api key saved in the preferences - %d\r\n", __FILE__, __LINE__, res);
+    Log.info("%s [%d]: API key - %s\r\n", __FILE__, __LINE__, apiResponse.api_key.c_str());
+    settings.setApiKey(apiResponse.api_key.c_str());
 
-    String friendly_id = apiResponse.friendly_id;
-    Log.info("%s [%d]: friendly ID - %s\r\n", __FILE__, __LINE__, friendly_id.c_str());
-    res = preferences.putString(PREFERENCES_FRIENDLY_ID, friendly_id);
-    Log.info("%s [%d]: friendly ID saved in the preferences - %d\r\n", __FILE__, __LINE__, res);
+    Log.info("%s [%d]: friendly ID - %s\r\n", __FILE__, __LINE__, apiResponse.friendly_id.c_str());
+    settings.setFriendlyId(apiResponse.friendly_id.c_str());
+    Log.info("%s [%d]: credentials saved in the preferences - %d\r\n", __FILE__, __LINE__, settings.flush());
 
-    String image_url = apiResponse.image_url;
+    const auto &image_url = apiResponse.image_url;
     Log.info("%s [%d]: image_url - %s\r\n", __FILE__, __LINE__, image_url.c_str());
-    image_url.toCharArray(filename, image_url.length() + 1);
+    strcpy(filename, image_url.c_str());
 
-    String message_str = apiResponse.message;
-    Log.info("%s [%d]: message - %s\r\n", __FILE__, __LINE__, message_str.c_str());
-    message_str.toCharArray(message_buffer, message_str.length() + 1);
+    Log.info("%s [%d]: message - %s\r\n", __FILE__, __LINE__, apiResponse.message.c_str());
+    strcpy(message_buffer, apiResponse.message.c_str());
 
     Log.info("%s [%d]: status - %d\r\n", __FILE__, __LINE__, status);
     return true;
@@ -1620,7 +1680,7 @@ static bool performApiSetup()
 
     showMessageWithLogo(MAC_NOT_REGISTERED, apiResponse);
 
-    preferences.putUInt(PREFERENCES_SLEEP_TIME_KEY, SLEEP_TIME_TO_SLEEP);
+    settings.setRefreshRate(SLEEP_TIME_TO_SLEEP);
 
     display_sleep();
     goToSleep();
@@ -1728,8 +1788,9 @@ static void downloadSetupImage()
       writeImageToFile("/logo.bmp", buffer, DEFAULT_IMAGE_SIZE);
 
       // show the image
-      String friendly_id = preferences.getString(PREFERENCES_FRIENDLY_ID, PREFERENCES_FRIENDLY_ID_DEFAULT);
+      String friendly_id = settings.friendlyId();
       display_show_msg(storedLogoOrDefault(0), FRIENDLY_ID, friendly_id, true, "", String(message_buffer));
+      current_on_screen = false;
       need_to_refresh_display = 0;
     }
     else
@@ -1777,6 +1838,7 @@ static void resetDeviceCredentials(void)
   WifiCaptivePortal.resetSettings();
   need_to_refresh_display = 1;
   bool res = preferences.clear();
+  settings.reset();
   if (res)
     Log.info("%s [%d]: The device reset success. Restarting...\r\n", __FILE__, __LINE__);
   else
@@ -1808,19 +1870,38 @@ static void checkAndPerformFirmwareUpdate(void)
                }
              }
 
+             if (binEncoding == OtaEncoding::RAW)
+             {
+               // plain images go straight into the inactive slot, so an interrupted download continues there
+               Log.info("%s [%d]: Downloading .bin file...\r\n", __FILE__, __LINE__);
+               showMessageWithLogo(FW_UPDATE);
+               DownloadOutcome outcome = ota_download(*https, binUrl);
+               if (outcome == DownloadOutcome::Complete)
+               {
+                 Log.info("%s [%d]: Firmware update successful. Rebooting...\r\n", __FILE__, __LINE__);
+                 showMessageWithLogo(FW_UPDATE_SUCCESS);
+               }
+               else
+               {
+                 Log.fatal("%s [%d]: Firmware update %s!\r\n", __FILE__, __LINE__, outcome == DownloadOutcome::Interrupted ? "interrupted, will resume" : "failed");
+                 showMessageWithLogo(FW_UPDATE_FAILED);
+               }
+               return true;
+             }
+
+             ota_forget_partial(); // Update overwrites the inactive slot
              int httpCode = https->GET();
              if (httpCode == HTTP_CODE_OK)
              {
-               Log.info("%s [%d]: Downloading .bin file...\r\n", __FILE__, __LINE__);
+               Log.info("%s [%d]: Downloading .bin file (%s)...\r\n", __FILE__, __LINE__, otaEncodingToString(binEncoding));
 
-               size_t contentLength = https->getSize();
-               // Perform firmware update
-               if (Update.begin(contentLength))
+               // Perform firmware update; the size of a compressed or delta image is only known once it is decoded
+               if (Update.begin(UPDATE_SIZE_UNKNOWN))
                {
                  Log.info("%s [%d]: Firmware update start\r\n", __FILE__, __LINE__);
                  showMessageWithLogo(FW_UPDATE);
 
-                 if (Update.writeStream(https->getStream()))
+                 if (ota_write_encoded(*https, binEncoding))
                  {
                    if (Update.end(true))
                    {
@@ -1835,6 +1916,7 @@ static void checkAndPerformFirmwareUpdate(void)
                  }
                  else
                  {
+                   Update.abort();
                    Log.fatal("%s [%d]: Write to firmware update stream failed!\r\n", __FILE__, __LINE__);
                    showMessageWithLogo(FW_UPDATE_FAILED);
                  }
@@ -1862,11 +1944,18 @@ static void goToSleep(void)
   WiFi.mode(WIFI_OFF); 
   filesystem_deinit();
   uint32_t time_to_sleep = SLEEP_TIME_TO_SLEEP;
-  if (preferences.isKey(PREFERENCES_SLEEP_TIME_KEY))
-    time_to_sleep = preferences.getUInt(PREFERENCES_SLEEP_TIME_KEY, SLEEP_TIME_TO_SLEEP);
+  if (frame_sleep_time > 0)
+    time_to_sleep = frame_sleep_time;
+  else if (settings.exists(SETTING_REFRESH_RATE))
+    time_to_sleep = settings.refreshRate();
+  uint32_t overlay_time = overlay_sleep_time(); // wake up for the next widget update
+  if (overlay_time > 0 && overlay_time < time_to_sleep)
+    time_to_sleep = overlay_time;
   Log.info("%s [%d]: total awake time - %d ms\r\n", __FILE__, __LINE__, millis() - startup_time); 
   Log.info("%s [%d]: time to sleep - %d\r\n", __FILE__, __LINE__, time_to_sleep);
-  preferences.putUInt(PREFERENCES_LAST_SLEEP_TIME, getTime());
+  settings.setLastSleepTime(getTime());
+  uint8_t flushed = settings.flush();
+  Log_info("NVS reads/writes this wake: %u/%u (%d settings flushed)", preferencesPersistence.readCount(), preferencesPersistence.writeCount(), flushed);
   preferences.end();
   esp_sleep_enable_timer_wakeup((uint64_t)time_to_sleep * SLEEP_uS_TO_S_FACTOR);
   // Configure GPIO pin for wakeup
@@ -1960,9 +2049,9 @@ static float readBatteryVoltage(void)
 bool submitLogString(const char *log_buffer)
 {
   String api_key = "";
-  if (preferences.isKey(PREFERENCES_API_KEY))
+  if (settings.exists(SETTING_API_KEY))
   {
-    api_key = preferences.getString(PREFERENCES_API_KEY, PREFERENCES_API_KEY_DEFAULT);
+    api_key = settings.apiKey();
     Log_info("%s key exists. Value - %s", PREFERENCES_API_KEY, api_key.c_str());
   }
   else
@@ -1972,7 +2061,7 @@ bool submitLogString(const char *log_buffer)
   }
 
   LogApiInput input{api_key, log_buffer};
-  return submitLogToApi(input, preferences.getString(PREFERENCES_API_URL, API_BASE_URL).c_str());
+  return submitLogToApi(input, settings.apiUrl());
 }
 
 /**
@@ -2015,9 +2104,9 @@ static void submitStoredLogs(void)
   String log = storedLogs.gather_stored_logs();
 
   String api_key = "";
-  if (preferences.isKey(PREFERENCES_API_KEY))
+  if (settings.exists(SETTING_API_KEY))
   {
-    api_key = preferences.getString(PREFERENCES_API_KEY, PREFERENCES_API_KEY_DEFAULT);
+    api_key = settings.apiKey();
     Log.info("%s [%d]: %s key exists. Value - %s\r\n", __FILE__, __LINE__, PREFERENCES_API_KEY, api_key.c_str());
   }
   else
@@ -2032,7 +2121,7 @@ static void submitStoredLogs(void)
     Log.info("%s [%d]: need to send the log\r\n", __FILE__, __LINE__);
 
     LogApiInput input{api_key, log.c_str()};
-    submitLogToApiResult = submitLogToApi(input, preferences.getString(PREFERENCES_API_URL, API_BASE_URL).c_str());
+    submitLogToApiResult = submitLogToApi(input, settings.apiUrl());
   }
   else
   {
@@ -2059,43 +2148,29 @@ static void writeImageToFile(const char *name, uint8_t *in_buffer, size_t size)
 
 static void writeSpecialFunction(SPECIAL_FUNCTION function)
 {
-  if (preferences.isKey(PREFERENCES_SF_KEY))
+  if (settings.exists(SETTING_SPECIAL_FUNCTION) && (SPECIAL_FUNCTION)settings.specialFunction() == function)
   {
-    Log.info("%s [%d]: SF saved. Reading...\r\n", __FILE__, __LINE__);
-    if ((SPECIAL_FUNCTION)preferences.getUInt(PREFERENCES_SF_KEY, 0) == function)
-    {
-      Log.info("%s [%d]: No needed to re-write\r\n", __FILE__, __LINE__);
-    }
-    else
-    {
-      Log.info("%s [%d]: Writing new special function\r\n", __FILE__, __LINE__);
-      bool res = preferences.putUInt(PREFERENCES_SF_KEY, function);
-      if (res)
-        Log.info("%s [%d]: Written new special function successfully\r\n", __FILE__, __LINE__);
-      else
-        Log.error("%s [%d]: Writing new special function failed\r\n", __FILE__, __LINE__);
-    }
-  }
-  else
-  {
-    Log.error("%s [%d]: SF not saved\r\n", __FILE__, __LINE__);
-    bool res = preferences.putUInt(PREFERENCES_SF_KEY, function);
-    if (res)
-      Log.info("%s [%d]: Written new special function successfully\r\n", __FILE__, __LINE__);
-    else
-      Log.error("%s [%d]: Writing new special function failed\r\n", __FILE__, __LINE__);
+    Log.info("%s [%d]: No needed to re-write\r\n", __FILE__, __LINE__);
+    return;
   }
+  // written by settings.flush() before sleep, which logs a failed write
+  Log.info("%s [%d]: Writing new special function\r\n", __FILE__, __LINE__);
+  settings.setSpecialFunction(function);
 }
 
 static void showMessageWithLogo(MSG message_type, String friendly_id, bool id, const char *fw_version, String message)
 {
+  overlay_stop();
+  current_on_screen = false;
   display_show_msg(storedLogoOrDefault(0), message_type, friendly_id, id, fw_version, message);
   need_to_refresh_display = 1;
-  preferences.putBool(PREFERENCES_DEVICE_REGISTERED_KEY, false);
+  settings.setDeviceRegistered(false);
 }
 
 static void showMessageWithLogo(MSG message_type)
 {
+  overlay_stop();
+  current_on_screen = false;
   display_show_msg(storedLogoOrDefault(0), message_type);
 }
 
@@ -2107,9 +2182,11 @@ static void showMessageWithLogo(MSG message_type)
  */
 static void showMessageWithLogo(MSG message_type, const ApiSetupResponse &apiResponse)
 {
-  display_show_msg(storedLogoOrDefault(0), message_type, "", false, "", apiResponse.message);
+  overlay_stop();
+  current_on_screen = false;
+  display_show_msg(storedLogoOrDefault(0), message_type, "", false, "", apiResponse.message.c_str());
   need_to_refresh_display = 1;
-  preferences.putBool(PREFERENCES_DEVICE_REGISTERED_KEY, false);
+  settings.setDeviceRegistered(false);
 }
 
 // 0 = larger glyph, centered for message screens
@@ -2134,37 +2211,195 @@ static uint8_t *storedLogoOrDefault(int iType)
 #endif
 }
 
-static bool saveCurrentFileName(String &name)
+static void saveCurrentFileName(const char *name)
 {
-  if (!preferences.getString(PREFERENCES_FILENAME_KEY, "").equals(name))
+  if (strcmp(settings.filename(), name) != 0)
   {
-    Log.info("%s [%d]: New filename:  - %s\r\n", __FILE__, __LINE__, name.c_str());
-    size_t res = preferences.putString(PREFERENCES_FILENAME_KEY, name);
-    if (res > 0)
-    {
-      Log.info("%s [%d]: New filename saved in the preferences - %d\r\n", __FILE__, __LINE__, res);
-      return true;
-    }
-    else
-    {
-      Log.error("%s [%d]: New filename saving error!\r\n", __FILE__, __LINE__);
-      return false;
-    }
+    Log.info("%s [%d]: New filename:  - %s\r\n", __FILE__, __LINE__, name);
+    settings.setFilename(name); // written by settings.flush() before sleep
   }
   else
   {
     Log.info("%s [%d]: No needed to re-write\r\n", __FILE__, __LINE__);
+  }
+}
+
+/**
+ * @brief Function to show the next frame of the stored bundle instead of asking the server
+ * @param none
+ * @return bool true if a frame was shown and the device can go back to sleep
+ */
+static bool showPrefetchedFrame(void)
+{
+  BundleFrame frame;
+  uint8_t *image = playlist_next_frame(frame);
+  if (!image)
+    return false;
+
+  display_show_image(image, frame.size, true);
+  free(image);
+  display_sleep();
+  overlay_stop(); // the widgets belong to the image that was replaced
+  history_reset();
+  current_on_screen = false;
+
+  // the server compares it with the next image when the device is back online
+  saveCurrentFileName(frame.name);
+  frame_sleep_time = frame.duration;
+  return true;
+}
+
+/**
+ * @brief Function to redraw the overlay widgets of the current image instead of asking the server
+ * @param none
+ * @return bool true if the widgets are up to date and the device can go back to sleep
+ */
+static bool showOverlays(void)
+{
+  if (!overlay_due() || !overlay_update(vBatt))
+    return false;
+  display_sleep();
+  return true;
+}
+
+/**
+ * @brief Function to go one frame back through the history instead of asking the server to rewind
+ * @param none
+ * @return bool true if an older frame was shown and the device can go back to sleep
+ */
+static bool showOlderFrame(void)
+{
+  if (!history_show_older())
+    return false;
+  display_sleep();
+  overlay_stop(); // the widgets belong to the current image
+  current_on_screen = false;
+  return true;
+}
+
+/**
+ * @brief Function to start a cold boot or button wake with the current image instead of the loading logo
+ * @param none
+ * @return bool true if the current image is on screen; false if there is none and the logo has to be shown
+ */
+static bool showInstantOn(void)
+{
+  bool button = wakeup_reason == ESP_SLEEP_WAKEUP_GPIO || wakeup_reason == ESP_SLEEP_WAKEUP_EXT0 || wakeup_reason == ESP_SLEEP_WAKEUP_EXT1;
+  if (button && current_on_screen)
+  {
+    Log_info("Instant-on: the current image is still on screen");
     return true;
   }
+
+  // a device that isn't set up (or was reset) starts with the logo
+  if (!settings.exists(SETTING_API_KEY))
+    return false;
+  const char *name = filesystem_file_exists("/current.bmp") ? "/current.bmp" : "/current.png";
+  int size = 0;
+  uint8_t *owned = nullptr;
+  uint8_t *image = filesystem_file_exists(name) ? display_map_file(name, &size, &owned) : nullptr;
+  if (!image)
+    return false;
+
+  // waits for the refresh like rewind and playlist frames, so the mode is picked as for any image
+  // (a 4-gray one asks for a full refresh); it also makes this image the base of the next partial update and frame delta
+  unsigned long start = millis();
+  display_show_image(image, size, true);
+  free(owned);
+  current_on_screen = true;
+  Log_info("Instant-on: %s redrawn from flash in %lu ms", name, millis() - start);
+  return true;
+}
+
+/**
+ * @brief Function to draw the display list of the /api/display response in place of its image
+ * @param none
+ * @return bool true if it was shown; false if the image has to be downloaded instead
+ */
+static bool showDisplayList(void)
+{
+  const ApiDisplayResponse &response = apiDisplayResult.response;
+  if (!display_show_list(response.display_list, response.display_list_size))
+    return false;
+
+  // the stored image is no longer on screen, same as when a new one is downloaded
+  keepCurrentImageAsLast();
+  current_on_screen = false;
+  saveCurrentFileName(response.filename.c_str());
+  return true;
+}
+
+/**
+ * @brief Function to patch the image on screen with the delta_url of the /api/display response
+ * @param inputs credentials for a delta hosted on the API server
+ * @return bool true if it was shown; false if the full image has to be downloaded instead
+ */
+static bool showTileDelta(const ApiDisplayInputs &inputs)
+{
+  const ApiDisplayResponse &response = apiDisplayResult.response;
+  uint8_t *image = nullptr;
+  int size = 0;
+  withHttp(
+      response.delta_url.c_str(),
+      [&](HTTPClient *https, HttpError error) -> bool
+      {
+        if (error != HttpError::HTTPCLIENT_SUCCESS)
+        {
+          Log_error("Frame delta download failed: cannot connect");
+          return false;
+        }
+        https->addHeader("Accept-Encoding", "identity");
+        if (strncmp(response.delta_url.c_str(), inputs.baseUrl.c_str(), inputs.baseUrl.length()) == 0)
+        {
+          https->addHeader("ID", inputs.macAddress.c_str());
+          https->addHeader("Access-Token", inputs.apiKey.c_str());
+        }
+        int httpCode = https->GET();
+        if (httpCode != HTTP_CODE_OK)
+        {
+          Log_error("Frame delta download failed: HTTP %d", httpCode);
+          return false;
+        }
+        image = tile_delta_download(*https, &size);
+        return image != nullptr;
+      });
+  if (!image)
+    return false;
+
+  // the patched frame is the base of the next delta and of the overlay widgets
+  keepCurrentImageAsLast();
+  writeImageToFile("/current.bmp", image, size);
+  free(image);
+  current_on_screen = true;
+  saveCurrentFileName(response.filename.c_str());
+  return true;
+}
+
+/**
+ * @brief Function to turn the stored current image into the last one before a new screen is shown
+ * @param none
+ * @return bool true if there was a current image
+ */
+static bool keepCurrentImageAsLast(void)
+{
+  if (!filesystem_file_exists("/current.bmp") && !filesystem_file_exists("/current.png"))
+    return false;
+
+  history_keep_last();
+  filesystem_file_delete("/last.bmp");
+  filesystem_file_delete("/last.png");
+  filesystem_file_rename("/current.png", "/last.png");
+  filesystem_file_rename("/current.bmp", "/last.bmp");
+  return true;
 }
 
-static bool checkCurrentFileName(String &newName)
+static bool checkCurrentFileName(const char *newName)
 {
-  String currentFilename = preferences.getString(PREFERENCES_FILENAME_KEY, "");
+  const char *currentFilename = settings.filename();
 
   Log.error("%s [%d]: Current filename: %s\r\n", __FILE__, __LINE__, currentFilename);
 
-  if (currentFilename.equals(newName))
+  if (strcmp(currentFilename, newName) == 0)
   {
     Log.info("%s [%d]: Current filename equals to the new filename\r\n", __FILE__, __LINE__);
     return true;
@@ -2178,35 +2413,35 @@ static bool checkCurrentFileName(String &newName)
 
 static void wifiErrorDeepSleep()
 {
-  if (!preferences.isKey(PREFERENCES_CONNECT_WIFI_RETRY_COUNT))
+  if (!settings.exists(SETTING_WIFI_RETRY_COUNT))
   {
-    preferences.putInt(PREFERENCES_CONNECT_WIFI_RETRY_COUNT, 1);
+    settings.setWifiRetryCount(1);
   }
 
-  uint8_t retry_count = preferences.getInt(PREFERENCES_CONNECT_WIFI_RETRY_COUNT);
+  uint8_t retry_count = settings.wifiRetryCount();
 
   Log_info("WIFI connection failed! Retry count: %d \n", retry_count);
 
   switch (retry_count)
   {
   case 1:
-    preferences.putUInt(PREFERENCES_SLEEP_TIME_KEY, WIFI_CONNECT_RETRY_TIME::WIFI_FIRST_RETRY);
+    settings.setRefreshRate(WIFI_CONNECT_RETRY_TIME::WIFI_FIRST_RETRY);
     break;
 
   case 2:
-    preferences.putUInt(PREFERENCES_SLEEP_TIME_KEY, WIFI_CONNECT_RETRY_TIME::WIFI_SECOND_RETRY);
+    settings.setRefreshRate(WIFI_CONNECT_RETRY_TIME::WIFI_SECOND_RETRY);
     break;
 
   case 3:
-    preferences.putUInt(PREFERENCES_SLEEP_TIME_KEY, WIFI_CONNECT_RETRY_TIME::WIFI_THIRD_RETRY);
+    settings.setRefreshRate(WIFI_CONNECT_RETRY_TIME::WIFI_THIRD_RETRY);
     break;
 
   default:
-    preferences.putUInt(PREFERENCES_SLEEP_TIME_KEY, SLEEP_TIME_TO_SLEEP);
+    settings.setRefreshRate(SLEEP_TIME_TO_SLEEP);
     break;
   }
   retry_count++;
-  preferences.putInt(PREFERENCES_CONNECT_WIFI_RETRY_COUNT, retry_count);
+  settings.setWifiRetryCount(retry_count);
 
   display_sleep();
   goToSleep();
@@ -2218,7 +2453,7 @@ DeviceStatusStamp getDeviceStatusStamp()
 
   deviceStatus.wifi_rssi_level = WiFi.RSSI();
   strncpy(deviceStatus.wifi_status, wifiStatusStr(WiFi.status()), sizeof(deviceStatus.wifi_status) - 1);
-  deviceStatus.refresh_rate = preferences.getUInt(PREFERENCES_SLEEP_TIME_KEY);
+  deviceStatus.refresh_rate = settings.refreshRate();
   deviceStatus.time_since_last_sleep = time_since_sleep;
   snprintf(deviceStatus.current_fw_version, sizeof(deviceStatus.current_fw_version), "%s", FW_VERSION_STRING);
   parseSpecialFunctionToStr(deviceStatus.special_function, sizeof(deviceStatus.special_function), special_function);
@@ -2232,7 +2467,7 @@ DeviceStatusStamp getDeviceStatusStamp()
 
 void logWithAction(LogAction action, const char *message, time_t time, int line, const char *file)
 {
-  uint32_t log_id = preferences.getUInt(PREFERENCES_LOG_ID_KEY, 1);
+  uint32_t log_id = settings.logId();
 
   LogWithDetails input = {
       .deviceStatusStamp = getDeviceStatusStamp(),
@@ -2241,10 +2476,10 @@ void logWithAction(LogAction action, const char *message, time_t time, int line,
       .sourceFile = file,
       .logMessage = message,
       .logId = log_id,
-      .filenameCurrent = preferences.getString(PREFERENCES_FILENAME_KEY, ""),
-      .filenameNew = new_filename,
+      .filenameCurrent = settings.filename(),
+      .filenameNew = new_filename.c_str(),
       .logRetry = log_retry,
-      .retryAttempt = log_retry ? preferences.getInt(PREFERENCES_CONNECT_API_RETRY_COUNT) : 0};
+      .retryAttempt = log_retry ? settings.apiRetryCount() : 0};
 
   String json_string = serialize_log(input);
 
@@ -2265,7 +2500,7 @@ void logWithAction(LogAction action, const char *message, time_t time, int line,
       break;
   }
 
-  preferences.putUInt(PREFERENCES_LOG_ID_KEY, ++log_id);
+  settings.setLogId(++log_id);
 }
 
 void log_nvs_usage()
@@ -5,6 +5,7 @@
 #include <SPIFFS.h>
 #include <Preferences.h>
 #include <preferences_persistence.h>
+#include <settings.h>
 #include "DEV_Config.h"
 #define MAX_BIT_DEPTH 8
 #ifndef BOARD_TRMNL_X
@@ -39,7 +40,7 @@ const uint8_t u8_graytable[] = {
 /* 15 */  2, 2, 2, 2, 2, 2, 2, 2
 };
 #endif
-RTC_DATA_ATTR int iUpdateCount = 0;
+RTC_DATA_ATTR uint32_t u32FrameCrc = 0; // frameCrc() of the 1-bit image on screen, 0 = not known
 #include "Group5.h"
 #include <config.h>
 #include "wifi_connect_qr.h"
@@ -47,15 +48,25 @@ RTC_DATA_ATTR int iUpdateCount = 0;
 #include <ctype.h> //iscntrl()
 #include <api-client/display.h>
 #include <trmnl_log.h>
-#include "png_flip.h"
+#include <bmp.h>
+#include <filesystem.h>
+#include <message_cache.h>
+#include <display_list.h>
+#include <ghost_budget.h>
+#include <plane_split.h>
+#include <frame_rle.h>
+#include <g5_planes.h>
+#include <new>
+#include <vector>
 #include "../lib/bb_epaper/Fonts/nicoclean_8.h"
 #include "../lib/bb_epaper/Fonts/Inter_18.h"
 #include "../lib/bb_epaper/Fonts/Roboto_Black_24.h"
 extern char filename[];
-extern Preferences preferences;
+extern Settings settings;
 extern ApiDisplayResult apiDisplayResult;
 uint32_t iTempProfile;
 static uint8_t *pDither;
+RTC_DATA_ATTR GhostBudget ghostBudget; // how worn each part of the screen is, see ghost_budget.h
 
 // Runtime control for light sleep (true = enabled, false = disabled)
 static bool g_light_sleep_enabled = true;
@@ -68,7 +79,7 @@ static bool g_light_sleep_enabled = true;
 void display_init(void)
 {
     Log_info("dev module start");
-    iTempProfile = preferences.getUInt(PREFERENCES_TEMP_PROFILE, TEMP_PROFILE_DEFAULT);
+    iTempProfile = settings.tempProfile();
     Log_info("Saved temperature profile: %d", iTempProfile);
 #ifdef BB_EPAPER
     bbep.initIO(EPD_DC_PIN, EPD_RST_PIN, EPD_BUSY_PIN, EPD_CS_PIN, EPD_MOSI_PIN, EPD_SCK_PIN, 8000000);
@@ -109,6 +120,18 @@ void display_sleep(uint32_t u32Millis)
 #endif
 }
 
+#ifdef BB_EPAPER
+/**
+ * @brief Function to note a full or fast refresh of a screen whose pixels weren't scanned (message screens)
+ * @param bFull true for a full refresh, false for a fast one
+ * @return none
+ */
+static void ghost_refreshed(bool bFull)
+{
+    ghostRefreshed(ghostBudget, bbep.width(), bbep.height(), bFull, (uint32_t)time(NULL));
+} /* ghost_refreshed() */
+#endif
+
 /**
  * @brief Function to reset the display
  * @param none
@@ -124,6 +147,7 @@ void display_reset(void)
     } else {
         bbep.refresh(REFRESH_FULL, true); // incompatible panel
     }
+    ghost_refreshed(apiDisplayResult.response.maximum_compatibility);
 #else
     bbep.fullUpdate();
 #endif
@@ -404,6 +428,40 @@ enum {
     PNG_2_BIT_BOTH,
     PNG_2_BIT_INVERTED,
 };
+#ifdef BB_EPAPER
+// When parts of an image are needed in RAM (overlay widgets, frame deltas),
+// png_draw() copies them here instead of sending the rows to the EPD
+struct ImageCrop {
+    int x, y, w, h; // box in the image, x and w are multiples of 8
+    uint8_t *pBits; // top row of the box
+    int iPitch;     // bytes from one row to the next, negative for bottom-up bitmaps
+};
+static ImageCrop *pImageCrops;
+static int iImageCrops;
+static bool bRowCrc; // png_draw() adds the rows it sends to u32RowCrc and ghostFrame
+static uint32_t u32RowCrc;
+static GhostFrame ghostFrame; // tiles of the image the next display_refresh() shows, if it was scanned
+static const uint8_t *pGhostPNG; // where worn tiles can be cropped from for a cleanup: a 1-bit PNG
+static int iGhostPNGSize;
+static const uint8_t *pGhostFrame; // or the top row of the 1-bpp image in memory
+static int iGhostPitch; // distance from one row of pGhostFrame to the next, negative for a bottom-up BMP
+
+/**
+ * @brief Function to copy the parts of one 1-bit image row that are inside the crop boxes
+ * @param y row of the image
+ * @param pRow 1-bit pixels of the full row
+ * @return none
+ */
+static void image_crop_row(int y, const uint8_t *pRow)
+{
+    for (int i = 0; i < iImageCrops; i++) {
+        ImageCrop *pCrop = &pImageCrops[i];
+        if (y >= pCrop->y && y < pCrop->y + pCrop->h) {
+            memcpy(&pCrop->pBits[(y - pCrop->y) * pCrop->iPitch], &pRow[pCrop->x / 8], pCrop->w / 8);
+        }
+    }
+} /* image_crop_row() */
+#endif
 
 /** 
  * @brief Callback function for each line of PNG decoded
@@ -415,7 +473,7 @@ int png_draw(PNGDRAW *pDraw)
 {
     int x;
     uint8_t ucBppChanged = 0, ucInvert = 0;
-    uint8_t uc, ucMask, src, *s, *d, *pTemp = bbep.getCache(); // get some scratch memory (not from the stack)
+    uint8_t *s, *d, *pTemp = bbep.getCache(); // get some scratch memory (not from the stack)
     int iPlane = *(int *)pDraw->pUser;
 
     if (pDraw->iPixelType == PNG_PIXEL_INDEXED || pDraw->iBpp > 2) {
@@ -443,47 +501,23 @@ int png_draw(PNGDRAW *pDraw)
           d[0] = s[0] ^ ucInvert;
           d++; s++;
         }
-    } else { // we need to split the 2-bit data into plane 0 and 1
-        src = *s++;
-        src ^= ucInvert;
-        uc = 0; // suppress warning/error
-        if (iPlane == PNG_2_BIT_BOTH || iPlane == PNG_2_BIT_INVERTED) { // draw 2bpp data as 1-bit to use for partial update
-            if (iPlane == PNG_2_BIT_BOTH) {
-                ucInvert = ~ucInvert; // the invert rule is backwards for grayscale data
-            }
-            src = ~src;
-            for (x=0; x<pDraw->iWidth; x++) {
-                uc <<= 1;
-                if (src & 0xc0) { // non-white -> black
-                    uc |= 1; // high bit of source pair
-                }
-                src <<= 2;
-                if ((x & 3) == 3) { // new input byte
-                    src = *s++;
-                    src ^= ucInvert;
-                }
-                if ((x & 7) == 7) { // new output byte
-                    *d++ = uc;
-                }
-            } // for x
+    } else { // we need to split the 2-bit data into plane 0 and 1 (4 pixels per table lookup)
+        if (iPlane == PNG_2_BIT_BOTH) { // draw 2bpp data as 1-bit to use for partial update
+            twoBitGather(s, d, pDraw->iWidth, TWO_BIT_ANY, ~ucInvert, ~ucInvert); // the invert rule is backwards for grayscale data
+        } else if (iPlane == PNG_2_BIT_INVERTED) {
+            twoBitGather(s, d, pDraw->iWidth, TWO_BIT_ANY, ucInvert, ~ucInvert);
         } else { // normal 0/1 split plane
-            ucMask = (iPlane == PNG_2_BIT_0) ? 0x40 : 0x80; // lower or upper source bit
-            for (x=0; x<pDraw->iWidth; x++) {
-                uc <<= 1;
-                if (src & ucMask) {
-                    uc |= 1; // high bit of source pair
-                }
-                src <<= 2;
-                if ((x & 3) == 3) { // new input byte
-                    src = *s++;
-                    src ^= ucInvert;
-                }
-                if ((x & 7) == 7) { // new output byte
-                    *d++ = uc;
-                }
-            } // for x
+            twoBitGather(s, d, pDraw->iWidth, (iPlane == PNG_2_BIT_0) ? TWO_BIT_LOW : TWO_BIT_HIGH, ucInvert, ucInvert);
         }
     }
+    if (pImageCrops) {
+        image_crop_row(pDraw->y, pTemp);
+        return 1;
+    }
+    if (bRowCrc) {
+        u32RowCrc = ota_crc32(u32RowCrc, pTemp, (pDraw->iWidth+7)/8);
+        ghostScanRow(ghostFrame, pDraw->y, pTemp);
+    }
     bbep.writeData(pTemp, (pDraw->iWidth+7)/8);
     return 1;
 } /* png_draw() */
@@ -699,9 +733,9 @@ int i, iColors;
 int jpeg_draw(JPEGDRAW *pDraw)
 {
 #ifdef BB_EPAPER
-int x, y;
+int y;
 int iPlane = *(int *)pDraw->pUser;
-uint8_t src=0, uc=0, ucMask, *s, *d, *pTemp = bbep.getCache();
+uint8_t *s, *pTemp = bbep.getCache();
 
     bbep.setAddrWindow(pDraw->x, pDraw->y, pDraw->iWidth, pDraw->iHeight);
     if (iPlane == 0) { // 1-bit mode
@@ -712,28 +746,18 @@ uint8_t src=0, uc=0, ucMask, *s, *d, *pTemp = bbep.getCache();
             // The pixel format of the display is the same as JPEGDEC, so just copy it
             bbep.writeData(s, (pDraw->iWidth+7)/8);
         } // for y
-    } else {
-        bbep.startWrite((iPlane == 1) ? PLANE_0 : PLANE_1); // start writing image data to plane 0
-        for (y=0; y<pDraw->iHeight; y++) { // this is 8 or 16 depending on the color subsampling
-            d = pTemp;
-            s = (uint8_t *)pDither;
-            s += (y * (pDraw->iWidth >> 2));
-            ucMask = (iPlane == 1) ? 0x40 : 0x80; // lower or upper source bit
-            for (x=0; x<pDraw->iWidth; x++) {
-                if ((x & 3) == 0) { // new input byte
-                    src = *s++;
-                }
-                uc <<= 1;
-                if (src & ucMask) {
-                    uc |= 1; // high bit of source pair
-                }
-                src <<= 2;
-                if ((x & 7) == 7) { // new output byte
-                    *d++ = uc;
-                }
-            } // for x
-            bbep.writeData(pTemp, (pDraw->iWidth+7)/8);
-        } // for y
+    } else { // 4-gray mode: the band was dithered to 2-bpp once, send it to both planes
+        for (int iBit = 0; iBit < 2; iBit++) {
+            if (iBit) bbep.setAddrWindow(pDraw->x, pDraw->y, pDraw->iWidth, pDraw->iHeight); // same band again
+            bbep.startWrite(iBit ? PLANE_1 : PLANE_0);
+            for (y=0; y<pDraw->iHeight; y++) {
+                s = (uint8_t *)pDraw->pPixels;
+                s += (y * (pDraw->iWidth >> 2));
+                // lower or upper bit of each pixel; 4-gray mode needs inverted grays like 2-bit PNGs
+                twoBitGather(s, pTemp, pDraw->iWidth, iBit ? TWO_BIT_HIGH : TWO_BIT_LOW, 0xff, 0xff);
+                bbep.writeData(pTemp, (pDraw->iWidth+7)/8);
+            } // for y
+        }
     }
 #else // FastEPD
   int x, y, iPitch = bbep.width()/2; // assume 4-bpp drawing mode
@@ -772,27 +796,25 @@ int iPlane = 0;
             rc = -1;
         } else { // okay to decode
 #ifdef BB_EPAPER
-            //bbep.setPanelType(TWO_BIT_PANEL);
-            Log_info("%s [%d]: Decoding jpeg as 1-bpp dithered\r\n", __FILE__, __LINE__);
-            jpg->setPixelType(ONE_BIT_DITHERED); // request 1-bit dithered output
+            if (apiDisplayResult.response.maximum_compatibility) { // keep unknown panels out of 4-gray mode
+                Log_info("%s [%d]: Decoding jpeg as 1-bpp dithered\r\n", __FILE__, __LINE__);
+                jpg->setPixelType(ONE_BIT_DITHERED); // request 1-bit dithered output
+                iPlane = 0;
+            } else { // decoded and dithered once, jpeg_draw() splits each band into both planes
+                bbep.setPanelType(dpList[iTempProfile].TwoBit);
+                Log_info("%s [%d]: Decoding jpeg as 2-bpp dithered\r\n", __FILE__, __LINE__);
+                jpg->setPixelType(TWO_BIT_DITHERED); // request 2-bit dithered output
+                iPlane = 1;
+            }
 #else
             bbep.setMode(BB_MODE_4BPP);
             Log_info("%s [%d]: Decoding jpeg as 4-bpp dithered\r\n", __FILE__, __LINE__);
             jpg->setPixelType(FOUR_BIT_DITHERED); // request 4-bit dithered output
 #endif
             pDither = (uint8_t *)malloc(jpg->getWidth() * 16);
-            iPlane = 0;//1; // Decode first plane
-            Log_info("%s [%d]: Decoding plane 0\r\n", __FILE__, __LINE__);
             jpg->setUserPointer((void *)&iPlane);
             jpg->decodeDither(pDither, 0);
             jpg->close();
-            // Decode the second plane
-//            iPlane = 2;
-//            Log_info("%s [%d]: Decoding plane 1\r\n", __FILE__, __LINE__);
-//            jpg->openRAM((uint8_t *)pJPEG, iDataSize, jpeg_draw);
-//            jpg->setPixelType(TWO_BIT_DITHERED); // request 1-bit dithered output
-//            jpg->setUserPointer((void *)&iPlane);
-//            jpg->decodeDither(pDither, 0);
             free(pDither);
 #ifdef BB_EPAPER
             rc = REFRESH_FULL;
@@ -843,6 +865,9 @@ PNG *png = new PNG();
                 rc = REFRESH_PARTIAL; // the new image is 1bpp - try a partial update
                 bbep.startWrite(PLANE_0); // start writing image data to plane 0
                 png->openRAM((uint8_t *)pPNG, iDataSize, png_draw);
+                // a full screen 1-bit image can be the base of a frame delta
+                bRowCrc = (png->getWidth() == bbep.width() && png->getHeight() == bbep.height());
+                u32RowCrc = 0;
                 if (png->getBpp() == 1 || png->getBpp() > 2) {
                     iPlane = PNG_1_BIT;
                     png->decode(&iPlane, 0);
@@ -854,6 +879,8 @@ PNG *png = new PNG();
                     }
                 }
                 png->close();
+                if (bRowCrc) u32FrameCrc = u32RowCrc;
+                bRowCrc = false;
                 if (iTempProfile != 0) { // need to write the inverted plane to do PLANE_FALSE_DIFF
                     bbep.startWrite(PLANE_1); // start writing image data to plane 1
                     png->openRAM((uint8_t *)pPNG, iDataSize, png_draw);
@@ -867,7 +894,6 @@ PNG *png = new PNG();
             } else { // 2-bpp
                 bbep.setPanelType(dpList[iTempProfile].TwoBit);
                 rc = REFRESH_FULL; // 4gray mode must be full refresh
-                iUpdateCount = 0; // grayscale mode resets the partial update counter
                 bbep.startWrite(PLANE_0); // start writing image data to plane 0
                 iPlane = PNG_2_BIT_0;
                 Log_info("%s [%d]: decoding 4-gray plane 0\r\n", __FILE__, __LINE__);
@@ -890,6 +916,761 @@ PNG *png = new PNG();
     free(png); // free the decoder instance
     return rc;
 } /* png_to_epd() */
+#ifdef BB_EPAPER
+// Screens made of text, shapes and G5 images are recorded and sent to the
+// EPD a strip at a time instead of being drawn into a 48K framebuffer
+#define DISPLAY_LIST_SIZE 4096
+#define DISPLAY_STRIP_ROWS 16
+static uint32_t *pDisplayList; // 32-bit for the alignment bb_epaper needs
+
+/**
+ * @brief Function to record the following drawing calls instead of drawing them
+ * @param none
+ * @return true if recording; false if the framebuffer has to be used instead
+ */
+static bool display_list_begin(void)
+{
+    pDisplayList = (uint32_t *)malloc(DISPLAY_LIST_SIZE);
+    if (!pDisplayList)
+        return false;
+    int rc = bbep.beginDisplayList((uint8_t *)pDisplayList, DISPLAY_LIST_SIZE);
+    if (rc != BBEP_SUCCESS)
+    {
+        Log_info("Display list not available (%d), using the framebuffer", rc);
+        free(pDisplayList);
+        pDisplayList = nullptr;
+        return false;
+    }
+    return true;
+} /* display_list_begin() */
+
+/**
+ * @brief Function to send the recorded drawing to the EPD strip by strip (same plane as writePlane(PLANE_0))
+ * @param pfnBand optional callback that sees every strip after it was sent
+ * @param pUser passed to pfnBand
+ * @return true on success; false if nothing was sent and the screen has to be drawn into the framebuffer
+ */
+static bool display_list_render(BB_BAND_CALLBACK *pfnBand, void *pUser)
+{
+    int pitch = (bbep.width() + 7) / 8;
+    uint8_t *pStrip = (uint8_t *)malloc(pitch * DISPLAY_STRIP_ROWS);
+    // ends the recording even when the strip can't be allocated
+    int rc = bbep.renderDisplayList(pStrip, pStrip ? pitch * DISPLAY_STRIP_ROWS : 0, pfnBand, pUser);
+    Log_info("Display list sent in %d-row strips: rc = %d, max alloc heap %d", DISPLAY_STRIP_ROWS, rc, ESP.getMaxAllocHeap());
+    free(pStrip);
+    free(pDisplayList);
+    pDisplayList = nullptr;
+    return rc == BBEP_SUCCESS;
+} /* display_list_render() */
+
+/**
+ * @brief Function to forget what is known about the image that is shown next
+ * @param none
+ * @return none
+ */
+static void ghost_scan_begin(void)
+{
+    ghostScanBegin(ghostFrame, bbep.width(), bbep.height());
+    pGhostPNG = nullptr;
+    pGhostFrame = nullptr;
+} /* ghost_scan_begin() */
+
+/**
+ * @brief Function to add rows of the image to the ghosting scan (a display list strip or the whole framebuffer)
+ * @param pUser unused
+ * @param y first row
+ * @param iHeight number of rows
+ * @param pRows 1-bpp pixels
+ * @return none
+ */
+static void ghost_band(void *pUser, int y, int iHeight, uint8_t *pRows)
+{
+    int iPitch = (bbep.width() + 7) / 8;
+    for (int i = 0; i < iHeight; i++) {
+        ghostScanRow(ghostFrame, y + i, &pRows[i * iPitch]);
+    }
+} /* ghost_band() */
+
+static bool ghost_cleanup(const GhostDecision &decision);
+
+/**
+ * @brief Function to refresh the EPD with the image data that was sent to it
+ * @param iRefreshMode refresh mode the image asks for; adjusted to the ghosting budget of the screen
+ * @param bWait wait for the refresh to finish
+ * @return none
+ */
+static void display_refresh(int iRefreshMode, bool bWait)
+{
+    int iWidth = bbep.width(), iHeight = bbep.height();
+    uint32_t now = (uint32_t)time(NULL);
+
+    if (iTempProfile != apiDisplayResult.response.temp_profile) {
+        iTempProfile = apiDisplayResult.response.temp_profile;
+        Log_info("Saving new temperature profile (%d) to FLASH", iTempProfile);
+        settings.setTempProfile(iTempProfile);
+    }
+    // a full or fast refresh only when a part of the screen has used up its budget of partial updates
+    GhostDecision decision = ghostDecide(ghostBudget, &ghostFrame, iWidth, iHeight, now, pGhostPNG || pGhostFrame);
+    if (iRefreshMode == REFRESH_FULL) {
+        decision.action = GHOST_FULL;
+        decision.reason = "the image needs a full refresh";
+    }
+    if (apiDisplayResult.response.maximum_compatibility == true) {
+        decision.action = GHOST_FULL;
+        decision.reason = "maximum compatibility";
+    }
+    if (!bWait) { // fast update when showing loading screen
+        decision.action = GHOST_PARTIAL;
+        decision.reason = "not waiting for the refresh";
+    }
+    Log_info("Ghosting budget: %d tiles changed, %d over budget, max wear %d/%d -> %s (%s)", decision.changed,
+             decision.over, decision.maxWear, GHOST_TILE_BUDGET, ghostActionName(decision.action), decision.reason);
+    if (decision.action == GHOST_FULL) iRefreshMode = REFRESH_FULL;
+    else if (decision.action == GHOST_FAST) iRefreshMode = REFRESH_FAST;
+    else iRefreshMode = REFRESH_PARTIAL;
+    Log_info("%s [%d]: EPD refresh mode: %d\r\n", __FILE__, __LINE__, iRefreshMode);
+    bbep.refresh(iRefreshMode, bWait);
+    if (decision.action == GHOST_CLEANUP && !ghost_cleanup(decision)) {
+        decision.action = GHOST_PARTIAL; // the tiles stay worn, the next image cleans them
+    }
+    ghostApply(ghostBudget, &ghostFrame, decision, iWidth, iHeight, now);
+} /* display_refresh() */
+
+// Draws a display list from /api/display with the same fonts as the message screens
+class BbepListCanvas : public DisplayListCanvas
+{
+public:
+    void clear(DisplayListColor color) override
+    {
+        bbep.fillScreen(bbep_color(color));
+    }
+    void text(DisplayListFont font, int x, int y, const char *text, DisplayListColor fg, DisplayListColor bg) override
+    {
+        static const void *fonts[DL_FONT_COUNT] = {nicoclean_8, Inter_18, Roboto_Black_24};
+        bbep.setFont(fonts[font]);
+        bbep.setTextColor(bbep_color(fg), bbep_color(bg));
+        bbep.drawString(text, x == DISPLAY_LIST_CENTER ? CENTER_X : x, y);
+    }
+    void rect(int x, int y, int w, int h, int r, DisplayListColor color, bool filled) override
+    {
+        if (r > 0) {
+            if (filled) bbep.fillRoundRect(x, y, w, h, r, bbep_color(color));
+            else bbep.drawRoundRect(x, y, w, h, r, bbep_color(color));
+        } else {
+            if (filled) bbep.fillRect(x, y, w, h, bbep_color(color));
+            else bbep.drawRect(x, y, w, h, bbep_color(color));
+        }
+    }
+    void ellipse(int cx, int cy, int rx, int ry, DisplayListColor color, bool filled) override
+    {
+        if (filled) bbep.fillEllipse(cx, cy, rx, ry, bbep_color(color));
+        else bbep.drawEllipse(cx, cy, rx, ry, bbep_color(color));
+    }
+    void line(int x1, int y1, int x2, int y2, DisplayListColor color) override
+    {
+        bbep.drawLine(x1, y1, x2, y2, bbep_color(color));
+    }
+    void sprite(const uint8_t *data, size_t size, int x, int y, int scale) override
+    {
+        bbep.loadG5Image(data, x, y, BBEP_WHITE, BBEP_BLACK, (float)scale);
+    }
+
+private:
+    static int bbep_color(DisplayListColor color)
+    {
+        return color == DL_BLACK ? BBEP_BLACK : (color == DL_WHITE ? BBEP_WHITE : BBEP_TRANSPARENT);
+    }
+};
+#endif // BB_EPAPER
+
+/**
+ * @brief Function to draw a display list sent by the server instead of an image
+ * @param list display list (see display_list.h)
+ * @param size length of the list in bytes
+ * @return true if it was shown; false if it is invalid or can't be drawn on this display
+ */
+bool display_show_list(const uint8_t *list, size_t size)
+{
+#ifdef BB_EPAPER
+    const char *error = displayListCheck(list, size, display_width(), display_height());
+    if (error) {
+        Log_error("Display list not shown: %s", error);
+        return false;
+    }
+    Log_info("Drawing display list of %d bytes", (int)size);
+    u32FrameCrc = 0;
+    ghost_scan_begin();
+
+    BbepListCanvas canvas;
+    bool bAlloc = false;
+    bool bBanded = display_list_begin();
+    if (!bBanded) {
+        bbep.allocBuffer(false);
+        bAlloc = true;
+    }
+    bbep.fillScreen(BBEP_WHITE); // the list may not start with a clear
+    displayListDraw(list, size, canvas);
+    if (bBanded && !display_list_render(ghost_band, NULL)) { // not enough memory for a strip, draw it the old way
+        bBanded = false;
+        bbep.allocBuffer(false);
+        bAlloc = true;
+        bbep.fillScreen(BBEP_WHITE);
+        displayListDraw(list, size, canvas);
+    }
+    if (!bBanded) {
+        bbep.writePlane(PLANE_0);
+        ghost_band(NULL, 0, bbep.height(), (uint8_t *)bbep.getBuffer());
+        pGhostFrame = (const uint8_t *)bbep.getBuffer();
+        iGhostPitch = bbep.width() / 8;
+    }
+    Log_info("Display refresh start");
+    display_refresh(REFRESH_PARTIAL, true);
+    if (bAlloc) {
+        bbep.freeBuffer();
+    }
+    return true;
+#else
+    return false; // the display lists use bb_epaper fonts and primitives
+#endif
+} /* display_show_list() */
+
+#ifdef BB_EPAPER
+/**
+ * @brief Function to draw the text of one overlay widget onto a copy of the image under it
+ * @param widget the widget
+ * @param x0 left edge of the copy on the screen (multiple of 8)
+ * @param w8 width of the copy (multiple of 8)
+ * @param pBits copy of the image under the widget, w8/8 * widget.h bytes
+ * @param text what the widget shows; empty leaves the image as it is
+ * @return none
+ */
+static void overlay_draw_text(const OverlayWidget &widget, int x0, int w8, uint8_t *pBits, const char *text)
+{
+    static const void *fonts[DL_FONT_COUNT] = {nicoclean_8, Inter_18, Roboto_Black_24};
+    BBEPAPER canvas(EP75_800x480);
+    BB_RECT rect;
+
+    if (!text[0]) return;
+    canvas.createVirtual(w8, widget.h, 0);
+    canvas.setBuffer(pBits);
+    canvas.setFont(fonts[widget.font]);
+    canvas.setTextColor(widget.color == DL_WHITE ? BBEP_WHITE : BBEP_BLACK, BBEP_TRANSPARENT);
+    canvas.getStringBox(text, &rect); // rect.y = top of the text relative to the baseline
+    canvas.drawString(text, widget.x - x0 + (widget.w - rect.w) / 2, (widget.h - rect.h) / 2 - rect.y);
+} /* overlay_draw_text() */
+
+/**
+ * @brief Function to send a box of 1-bit pixels to one memory plane of the EPD
+ * @param iPlane PLANE_0 (new image) or PLANE_1 (old image)
+ * @param x, y, w, h the box; x and w are multiples of 8
+ * @param pBits w/8 * h bytes
+ * @param bInvert send the inverted pixels
+ * @return none
+ */
+static void write_box(int iPlane, int x, int y, int w, int h, const uint8_t *pBits, bool bInvert)
+{
+    uint8_t *pTemp = bbep.getCache();
+    int iPitch = w / 8;
+
+    bbep.setAddrWindow(x, y, w, h);
+    bbep.startWrite(iPlane);
+    for (int i = 0; i < h; i++) {
+        for (int j = 0; j < iPitch; j++) {
+            pTemp[j] = bInvert ? ~pBits[i * iPitch + j] : pBits[i * iPitch + j];
+        }
+        bbep.writeData(pTemp, iPitch); // writeData() may change the data it sends
+    }
+} /* write_box() */
+
+/**
+ * @brief Function to change one box of the screen with a windowed partial refresh
+ * @param x, y, w, h the box; x and w are multiples of 8
+ * @param pOld what the box shows now, w/8 * h bytes
+ * @param pNew what it should show
+ * @return none
+ */
+static void update_box(int x, int y, int w, int h, const uint8_t *pOld, const uint8_t *pNew)
+{
+    // the partial waveform drives the difference between the two planes;
+    // the temperature profiles expect the inverted image in the old plane
+    if (iTempProfile != 0) write_box(PLANE_1, x, y, w, h, pNew, true);
+    else write_box(PLANE_1, x, y, w, h, pOld, false);
+    write_box(PLANE_0, x, y, w, h, pNew, false);
+    bbep.refreshRect(x, y, w, h, true);
+} /* update_box() */
+
+/**
+ * @brief Function to decode boxes of a 1-bit PNG or BMP into memory without touching the EPD
+ * @param pImage PNG, or an uncompressed 1-bpp BMP with a black to white palette
+ * @param iSize length of the image in bytes
+ * @param iWidth, iHeight size the image must have
+ * @param pCrops boxes to fill
+ * @param iCount number of boxes
+ * @return true on success; false if it isn't such an image or can't be decoded
+ */
+static bool image_crop(const uint8_t *pImage, int iSize, int iWidth, int iHeight, ImageCrop *pCrops, int iCount)
+{
+    BmpInfo bmp;
+    bool bPNG = iSize >= 4 && MOTOLONG(pImage) == (int32_t)0x89504e47;
+    bool bBMP = !bPNG && iSize >= 2 && pImage[0] == 'B' && pImage[1] == 'M' &&
+                parseBMPInfo(pImage, iSize, bmp) == BMP_NO_ERR &&
+                bmp.width == iWidth && bmp.height == iHeight && bmp.bpp == 1 && !bmp.reversed;
+    bool bOK = false;
+    int iPlane;
+
+    if (bPNG) {
+        PNG *png = new PNG();
+        bOK = png && png->openRAM((uint8_t *)pImage, iSize, png_draw) == PNG_SUCCESS;
+        if (bOK) { // same checks as png_to_epd() for a 1-bit image
+            bOK = png->getWidth() == iWidth && png->getHeight() == iHeight &&
+                  (png->getBpp() == 1 || (png->getBpp() == 2 && png_count_colors(png, pImage, iSize) == 2));
+        }
+        if (bOK) {
+            iPlane = (png->getBpp() == 1) ? PNG_1_BIT : PNG_2_BIT_BOTH;
+            png->openRAM((uint8_t *)pImage, iSize, png_draw);
+            pImageCrops = pCrops;
+            iImageCrops = iCount;
+            bOK = png->decode(&iPlane, 0) == PNG_SUCCESS;
+            pImageCrops = nullptr;
+            png->close();
+        }
+        if (png) free(png);
+    } else if (bBMP) { // the rows are already 1-bit EPD data, in either order
+        pImageCrops = pCrops;
+        iImageCrops = iCount;
+        for (int y = 0; y < iHeight; y++) {
+            image_crop_row(y, bmpRow(pImage, bmp, y));
+        }
+        pImageCrops = nullptr;
+        bOK = true;
+    }
+    return bOK;
+} /* image_crop() */
+
+/**
+ * @brief Function to decode one tile of a frame delta
+ * @param tile the tile
+ * @param pBits receives tile.w/8 * tile.h bytes
+ * @return true on success
+ */
+static bool tile_decode(const DeltaTile &tile, uint8_t *pBits)
+{
+    if (tile.encoding == DELTA_TILE_G5) {
+        const BB_BITMAP *pBBB = (const BB_BITMAP *)tile.data;
+        if (tile.size < sizeof(BB_BITMAP) || pBBB->u16Marker != BB_BITMAP_MARKER || pBBB->width != tile.w || pBBB->height != tile.h)
+            return false;
+        BBEPAPER canvas(EP75_800x480);
+        canvas.createVirtual(tile.w, tile.h, 0);
+        canvas.setBuffer(pBits);
+        return canvas.loadG5Image(tile.data, 0, 0, BBEP_WHITE, BBEP_BLACK) == BBEP_SUCCESS;
+    }
+    ImageCrop crop = {0, 0, tile.w, tile.h, pBits, tile.w / 8};
+    return image_crop(tile.data, tile.size, tile.w, tile.h, &crop, 1);
+} /* tile_decode() */
+
+/**
+ * @brief Function to clean worn tiles with a windowed refresh that drives every pixel of their box
+ * @param decision ghosting decision with the box of the worn tiles
+ * @return true on success; false if the box couldn't be cropped out of the image
+ */
+static bool ghost_cleanup(const GhostDecision &decision)
+{
+    int iPitch = decision.w / 8;
+    uint8_t *pBits = (uint8_t *)malloc(iPitch * decision.h);
+    bool bOK = pBits != nullptr;
+
+    if (bOK && pGhostFrame) {
+        for (int y = 0; y < decision.h; y++) {
+            memcpy(&pBits[y * iPitch], &pGhostFrame[(decision.y + y) * iGhostPitch + decision.x / 8], iPitch);
+        }
+    } else if (bOK) {
+        ImageCrop crop = {decision.x, decision.y, decision.w, decision.h, pBits, iPitch};
+        bOK = image_crop(pGhostPNG, iGhostPNGSize, bbep.width(), bbep.height(), &crop, 1);
+    }
+    if (bOK) {
+        Log_info("Cleaning worn tiles (%d,%d %dx%d)", decision.x, decision.y, decision.w, decision.h);
+        // the inverted image as the old plane makes the partial waveform drive every pixel
+        write_box(PLANE_1, decision.x, decision.y, decision.w, decision.h, pBits, true);
+        write_box(PLANE_0, decision.x, decision.y, decision.w, decision.h, pBits, false);
+        bbep.refreshRect(decision.x, decision.y, decision.w, decision.h, true);
+    }
+    free(pBits);
+    return bOK;
+} /* ghost_cleanup() */
+#endif // BB_EPAPER
+
+/**
+ * @brief Function to redraw overlay widgets over the image that is on the display
+ * @param frame the image as it was shown (PNG or BMP)
+ * @param size length of the image in bytes
+ * @param plan widgets and what they show now; the texts of the redrawn widgets are updated
+ * @param texts what each widget should show
+ * @return true if the widgets were redrawn; false if this image can't have local overlays
+ */
+bool display_show_overlays(const uint8_t *frame, int size, OverlayPlan &plan, const char texts[][OVERLAY_TEXT_SIZE])
+{
+#ifdef BB_EPAPER
+    ImageCrop crops[OVERLAY_MAX_WIDGETS];
+    bool bOK = true;
+
+    memset(crops, 0, sizeof(crops));
+    for (int i = 0; i < plan.count; i++) {
+        const OverlayWidget &widget = plan.widgets[i];
+        crops[i].x = widget.x & ~7;
+        crops[i].y = widget.y;
+        crops[i].w = ((widget.x + widget.w + 7) & ~7) - crops[i].x;
+        crops[i].h = widget.h;
+        crops[i].iPitch = crops[i].w / 8;
+        crops[i].pBits = (uint8_t *)malloc(crops[i].w / 8 * crops[i].h * 2); // image + old text
+        if (!crops[i].pBits) bOK = false;
+    }
+    if (bOK) bOK = image_crop(frame, size, bbep.width(), bbep.height(), crops, plan.count);
+    if (bOK) {
+        bbep.setPanelType(dpList[iTempProfile].OneBit);
+        for (int i = 0; i < plan.count; i++) {
+            ImageCrop *pCrop = &crops[i];
+            OverlayWidget &widget = plan.widgets[i];
+            int iLen = pCrop->w / 8 * pCrop->h;
+            uint8_t *pOld = &pCrop->pBits[iLen];
+            if (strcmp(widget.text, texts[i]) == 0) continue;
+            Log_info("Overlay widget %d: \"%s\" -> \"%s\"", i, widget.text, texts[i]);
+            memcpy(pOld, pCrop->pBits, iLen);
+            overlay_draw_text(widget, pCrop->x, pCrop->w, pOld, widget.text);
+            overlay_draw_text(widget, pCrop->x, pCrop->w, pCrop->pBits, texts[i]);
+            update_box(pCrop->x, pCrop->y, pCrop->w, pCrop->h, pOld, pCrop->pBits);
+            ghostTouch(ghostBudget, pCrop->x, pCrop->y, pCrop->w, pCrop->h); // adds ghosting like any partial update
+            strcpy(widget.text, texts[i]);
+        }
+    } else {
+        Log_info("Overlays need a full screen 1-bit PNG or BMP image");
+    }
+    for (int i = 0; i < plan.count; i++) {
+        free(crops[i].pBits);
+    }
+    return bOK;
+#else
+    return false; // FastEPD has no windowed partial refresh
+#endif
+} /* display_show_overlays() */
+
+/**
+ * @brief Function to read the checksum of the image on the display
+ * @param none
+ * @return frameCrc() of the full screen 1-bit image that was shown last; 0 if there is none
+ */
+uint32_t display_frame_crc(void)
+{
+    return u32FrameCrc;
+} /* display_frame_crc() */
+
+/**
+ * @brief Function to fill in what the decoders and the panel can do
+ * @param caps receives the formats, refresh features and bit planes
+ * @return none
+ */
+void display_capabilities(DeviceCapabilities &caps)
+{
+    caps.flags |= CAP_PNG | CAP_JPEG | CAP_G5;
+#ifdef BB_EPAPER
+    caps.flags |= CAP_BMP | CAP_RLE | CAP_G5_PLANES | CAP_PARTIAL | CAP_FRAME_DELTA | CAP_DISPLAY_LIST | CAP_OVERLAY;
+    caps.planes = 2; // 4 grays
+#else
+    caps.planes = 4; // 16 grays
+#endif
+} /* display_capabilities() */
+
+/**
+ * @brief Function to decode a full screen 1-bit image into memory without touching the EPD
+ * @param image PNG or BMP
+ * @param size length of the image in bytes
+ * @param frame receives the top row of the 1-bit image
+ * @param pitch bytes from one row to the next, negative for a bottom-up bitmap
+ * @return true on success; false if it isn't a full screen 1-bit image
+ */
+bool display_decode_frame(const uint8_t *image, int size, uint8_t *frame, int pitch)
+{
+#ifdef BB_EPAPER
+    ImageCrop crop = {0, 0, bbep.width(), bbep.height(), frame, pitch};
+    return image_crop(image, size, bbep.width(), bbep.height(), &crop, 1);
+#else
+    return false;
+#endif
+} /* display_decode_frame() */
+
+/**
+ * @brief Function to apply a frame delta to the image in memory and refresh only its tiles
+ * @param frame top row of the 1-bit image on the display; patched in place
+ * @param pitch bytes from one row to the next, negative for a bottom-up bitmap
+ * @param delta parsed delta (see frame_delta.h)
+ * @return true if the tiles were shown; false if nothing changed on the display
+ */
+bool display_show_tiles(uint8_t *frame, int pitch, const FrameDelta &delta)
+{
+#ifdef BB_EPAPER
+    uint8_t *pOld[DELTA_MAX_TILES], *pNew[DELTA_MAX_TILES];
+    int iWidth = bbep.width(), iHeight = bbep.height();
+    bool bOK = frameCrc(frame, pitch, iWidth, iHeight) == delta.baseCrc;
+
+    if (!bOK) Log_error("Frame delta was made for another image");
+    memset(pOld, 0, sizeof(pOld));
+    memset(pNew, 0, sizeof(pNew));
+    for (int i = 0; bOK && i < delta.count; i++) {
+        const DeltaTile &tile = delta.tiles[i];
+        pOld[i] = (uint8_t *)malloc(tile.w / 8 * tile.h);
+        pNew[i] = (uint8_t *)malloc(tile.w / 8 * tile.h);
+        bOK = pOld[i] && pNew[i];
+        if (bOK) {
+            frameGetBox(frame, pitch, tile, pOld[i]); // includes the earlier tiles it overlaps
+            bOK = tile_decode(tile, pNew[i]);
+            if (!bOK) Log_error("Tile %d of the frame delta can't be decoded", i);
+        }
+        if (bOK) framePutBox(frame, pitch, tile, pNew[i]);
+    }
+    if (bOK && frameCrc(frame, pitch, iWidth, iHeight) != delta.resultCrc) {
+        Log_error("Frame delta doesn't give the expected image");
+        bOK = false;
+    }
+    if (bOK) { // only now is anything sent to the EPD
+        bbep.setPanelType(dpList[iTempProfile].OneBit);
+        for (int i = 0; i < delta.count; i++) {
+            const DeltaTile &tile = delta.tiles[i];
+            Log_info("Refreshing tile %d (%d,%d %dx%d)", i, tile.x, tile.y, tile.w, tile.h);
+            update_box(tile.x, tile.y, tile.w, tile.h, pOld[i], pNew[i]);
+            ghostTouch(ghostBudget, tile.x, tile.y, tile.w, tile.h);
+        }
+        u32FrameCrc = delta.resultCrc;
+    }
+    for (int i = 0; i < delta.count; i++) {
+        free(pOld[i]);
+        free(pNew[i]);
+    }
+    return bOK;
+#else
+    return false; // FastEPD has no windowed partial refresh
+#endif
+} /* display_show_tiles() */
+
+#ifdef BB_EPAPER
+/**
+ * @brief Function to stream an uncompressed BMP to the EPD one row at a time
+ *        The rows are sent straight from the file in display order, so a bottom-up
+ *        bitmap doesn't have to be flipped or copied into a framebuffer first
+ * @param pBMP pointer to the BMP file
+ * @param iDataSize size of the BMP file
+ * @param bmp parsed header of the file
+ * @return refresh mode, or -1 if the image can't be shown on this display
+ */
+static int bmp_to_epd(const uint8_t *pBMP, int iDataSize, const BmpInfo &bmp)
+{
+    int iWidth = bbep.width(), iHeight = bbep.height();
+    int iPitch = (bmp.width + 7) / 8; // bytes per row sent to the EPD
+    const uint8_t *s;
+    uint8_t *pTemp = bbep.getCache(); // writeData() may change the data it sends, never pass it the file
+    uint8_t ucInvert;
+
+    if (bmp.width > iWidth || bmp.height > iHeight || (bmp.bpp == 2 && (bmp.width != iWidth || bmp.height != iHeight))) {
+        Log_error("%d-bpp BMP image of %dx%d can't be shown on the %dx%d display", bmp.bpp, bmp.width, bmp.height, iWidth, iHeight);
+        return -1;
+    }
+    if (bmp.bpp == 2) { // 4-gray, split into both planes like a 2-bit PNG
+        bbep.setPanelType(dpList[iTempProfile].TwoBit);
+        ucInvert = bmp.reversed ? 0 : 0xff; // 4-gray mode needs inverted grays
+        for (int iBit = 0; iBit < 2; iBit++) {
+            bbep.setAddrWindow(0, 0, iWidth, iHeight);
+            bbep.startWrite(iBit ? PLANE_1 : PLANE_0);
+            for (int y = 0; y < iHeight; y++) {
+                twoBitGather(bmpRow(pBMP, bmp, y), pTemp, iWidth, iBit ? TWO_BIT_HIGH : TWO_BIT_LOW, ucInvert, ucInvert);
+                bbep.writeData(pTemp, iPitch);
+            }
+        }
+        return REFRESH_FULL; // 4gray mode must be full refresh
+    }
+
+    int x = ((iWidth - bmp.width) / 2) & ~7; // center it on a byte boundary
+    int y = (iHeight - bmp.height) / 2;
+    bool bFrame = (bmp.width == iWidth && bmp.height == iHeight);
+    uint8_t ucEndMask = (bmp.width & 7) ? (0xff >> (bmp.width & 7)) : 0; // pixels past the width are white
+    ucInvert = bmp.reversed ? 0xff : 0;
+    bbep.setPanelType(dpList[iTempProfile].OneBit);
+    // same planes as a 1-bit PNG: the temperature profiles need the inverted image in plane 1
+    for (int iPass = 0; iPass < ((iTempProfile != 0) ? 2 : 1); iPass++) {
+        if (!bFrame) { // only clear if the image is smaller than the display
+            bbep.fillScreen(iPass ? BBEP_BLACK : BBEP_WHITE, iPass ? PLANE_1 : PLANE_0);
+        }
+        bbep.setAddrWindow(x, y, bmp.width, bmp.height);
+        bbep.startWrite(iPass ? PLANE_1 : PLANE_0);
+        for (int i = 0; i < bmp.height; i++) {
+            s = bmpRow(pBMP, bmp, i);
+            for (int j = 0; j < iPitch; j++) {
+                pTemp[j] = s[j] ^ ucInvert;
+            }
+            pTemp[iPitch - 1] |= ucEndMask;
+            if (iPass) { // inverted plane
+                for (int j = 0; j < iPitch; j++) {
+                    pTemp[j] = ~pTemp[j];
+                }
+            } else if (bFrame) {
+                ghost_band(NULL, i, 1, pTemp);
+            }
+            bbep.writeData(pTemp, iPitch);
+        }
+    }
+    if (bFrame && !bmp.reversed) { // the rows in the file are the frame as it is on screen
+        pGhostFrame = bmpRow(pBMP, bmp, 0);
+        iGhostPitch = bmp.bottomUp ? -(int)bmp.pitch : (int)bmp.pitch;
+        // only the layout /current.bmp is patched in by tile deltas can be their base
+        if (bmp.bottomUp && bmp.offset == FRAME_BMP_HEADER_SIZE && iDataSize == FRAME_BMP_HEADER_SIZE + iPitch * iHeight) {
+            u32FrameCrc = frameCrc(pGhostFrame, iGhostPitch, iWidth, iHeight);
+        }
+    }
+    return REFRESH_PARTIAL;
+} /* bmp_to_epd() */
+
+/**
+ * @brief Function to stream a TRLE run-length image to the EPD one row at a time
+ *        The rows are coded in plane order, so each one is decoded into a single
+ *        row buffer and sent without a framebuffer
+ * @param pData pointer to the TRLE image
+ * @param iDataSize size of the image
+ * @return refresh mode, or -1 if the image can't be shown on this display
+ */
+static int rle_to_epd(const uint8_t *pData, int iDataSize)
+{
+    FrameRleDecoder rle;
+    int iWidth = bbep.width(), iHeight = bbep.height();
+    uint8_t *pTemp = bbep.getCache(); // writeData() may change the data it sends, never pass it the row
+    uint8_t *pRow = (uint8_t *)malloc((iWidth + 7) / 8); // holds the row above between calls
+    const uint8_t *s;
+    uint8_t ucInvert;
+
+    if (!pRow || !frameRleBegin(rle, pData, iDataSize, pRow)) {
+        Log_error("TRLE image can't be decoded");
+        free(pRow);
+        return -1;
+    }
+    const FrameRleHeader &hdr = rle.header;
+    int iPitch = rle.pitch;
+    if (hdr.width > iWidth || hdr.height > iHeight || (hdr.planes == 2 && (hdr.width != iWidth || hdr.height != iHeight))) {
+        Log_error("%d-plane TRLE image of %dx%d can't be shown on the %dx%d display", hdr.planes, hdr.width, hdr.height, iWidth, iHeight);
+        free(pRow);
+        return -1;
+    }
+    if (hdr.planes == 2) { // 4-gray, both planes follow each other in the file
+        bbep.setPanelType(dpList[iTempProfile].TwoBit);
+        for (int iBit = 0; iBit < 2; iBit++) {
+            ucInvert = ~frameRleInvert(hdr, iBit); // 4-gray mode needs inverted grays
+            bbep.setAddrWindow(0, 0, iWidth, iHeight);
+            bbep.startWrite(iBit ? PLANE_1 : PLANE_0);
+            for (int y = 0; y < iHeight; y++) {
+                s = frameRleRow(rle);
+                if (!s) { // damaged, the rest of the plane stays white
+                    memset(pRow, ucInvert, iPitch);
+                    s = pRow;
+                }
+                for (int j = 0; j < iPitch; j++) {
+                    pTemp[j] = s[j] ^ ucInvert;
+                }
+                bbep.writeData(pTemp, iPitch);
+            }
+        }
+        free(pRow);
+        return REFRESH_FULL; // 4gray mode must be full refresh
+    }
+
+    int x = ((iWidth - hdr.width) / 2) & ~7; // center it on a byte boundary
+    int y = (iHeight - hdr.height) / 2;
+    bool bFrame = (hdr.width == iWidth && hdr.height == iHeight);
+    uint8_t ucEndMask = (hdr.width & 7) ? (0xff >> (hdr.width & 7)) : 0; // pixels past the width are white
+    ucInvert = frameRleInvert(hdr, 0);
+    bbep.setPanelType(dpList[iTempProfile].OneBit);
+    // same planes as a 1-bit PNG: the temperature profiles need the inverted image in plane 1
+    for (int iPass = 0; iPass < ((iTempProfile != 0) ? 2 : 1); iPass++) {
+        if (iPass) {
+            frameRleBegin(rle, pData, iDataSize, pRow); // decode it again
+        }
+        if (!bFrame) { // only clear if the image is smaller than the display
+            bbep.fillScreen(iPass ? BBEP_BLACK : BBEP_WHITE, iPass ? PLANE_1 : PLANE_0);
+        }
+        bbep.setAddrWindow(x, y, hdr.width, hdr.height);
+        bbep.startWrite(iPass ? PLANE_1 : PLANE_0);
+        for (int i = 0; i < hdr.height; i++) {
+            s = frameRleRow(rle);
+            if (!s) { // damaged, the rest of the image stays white
+                memset(pRow, ucInvert ^ 0xff, iPitch);
+                s = pRow;
+            }
+            for (int j = 0; j < iPitch; j++) {
+                pTemp[j] = s[j] ^ ucInvert;
+            }
+            pTemp[iPitch - 1] |= ucEndMask;
+            if (iPass) { // inverted plane
+                for (int j = 0; j < iPitch; j++) {
+                    pTemp[j] = ~pTemp[j];
+                }
+            } else if (bFrame) {
+                ghost_band(NULL, i, 1, pTemp);
+            }
+            bbep.writeData(pTemp, iPitch);
+        }
+    }
+    free(pRow);
+    return REFRESH_PARTIAL;
+} /* rle_to_epd() */
+
+/**
+ * @brief Function to stream a 4-gray image made of two G5 planes to the EPD
+ *        Each plane is decoded a row at a time and sent as it is, the bits are
+ *        already in the layout the 4-gray mode of the panel takes
+ * @param pData pointer to the G5 planes container
+ * @param iDataSize size of the container
+ * @return refresh mode, or -1 if the image can't be shown on this display
+ */
+static int g5planes_to_epd(const uint8_t *pData, int iDataSize)
+{
+    G5PlanesHeader hdr;
+    const uint8_t *pPlanes[2];
+    int iWidth = bbep.width(), iHeight = bbep.height();
+    int iPitch = (iWidth + 7) / 8;
+    uint8_t *pTemp = bbep.getCache();
+    int rc;
+
+    if (!g5PlanesParse(pData, iDataSize, hdr, pPlanes)) {
+        Log_error("4-gray G5 image can't be decoded");
+        return -1;
+    }
+    if (hdr.width != iWidth || hdr.height != iHeight) {
+        Log_error("4-gray G5 image of %dx%d can't be shown on the %dx%d display", hdr.width, hdr.height, iWidth, iHeight);
+        return -1;
+    }
+    G5DECODER *pG5 = new (std::nothrow) G5DECODER;
+    if (!pG5) {
+        Log_error("Not enough memory for the G5 decoder");
+        return -1;
+    }
+    bbep.setPanelType(dpList[iTempProfile].TwoBit);
+    for (int iBit = 0; iBit < 2; iBit++) {
+        rc = pG5->init(iWidth, iHeight, (uint8_t *)pPlanes[iBit], hdr.size[iBit]);
+        bbep.setAddrWindow(0, 0, iWidth, iHeight);
+        bbep.startWrite(iBit ? PLANE_1 : PLANE_0);
+        for (int y = 0; y < iHeight; y++) {
+            if (rc == G5_SUCCESS) {
+                rc = pG5->decodeLine(pTemp);
+                if (rc == G5_DECODE_COMPLETE && y == iHeight - 1) rc = G5_SUCCESS;
+            }
+            if (rc != G5_SUCCESS) { // damaged, the rest of the plane stays white
+                memset(pTemp, 0, iPitch);
+            }
+            bbep.writeData(pTemp, iPitch);
+        }
+        if (rc != G5_SUCCESS) {
+            Log_error("G5 plane %d is damaged, code: %d", iBit, rc);
+        }
+    }
+    delete pG5;
+    return REFRESH_FULL; // 4gray mode must be full refresh
+} /* g5planes_to_epd() */
+#endif // BB_EPAPER
+
 /** 
  * @brief Function to show the image on the display
  * @param image_buffer pointer to the uint8_t image buffer
@@ -905,6 +1686,7 @@ void display_show_image(uint8_t *image_buffer, int data_size, bool bWait)
 //    uint32_t *d32;
     bool bAlloc = false;
 #ifdef BB_EPAPER
+    bool bBanded = false; // G5 image already sent by display_list_render()
     int iRefreshMode = REFRESH_FULL; // assume full (slow) refresh
 #else
     int iRefreshMode = 0;
@@ -912,6 +1694,10 @@ void display_show_image(uint8_t *image_buffer, int data_size, bool bWait)
 
    // Log_info("Paint_NewImage %d", reverse);
     Log_info("display_show_image start");
+    u32FrameCrc = 0; // set again below for full screen 1-bit images
+#ifdef BB_EPAPER
+    ghost_scan_begin();
+#endif
     Log_info("maximum_compatibility = %d\n", apiDisplayResult.response.maximum_compatibility);
 #ifdef FUTURE
     if (reverse)
@@ -933,6 +1719,10 @@ void display_show_image(uint8_t *image_buffer, int data_size, bool bWait)
     {
         Log_info("Drawing PNG");
         iRefreshMode = png_to_epd(image_buffer, data_size);
+#ifdef BB_EPAPER
+        pGhostPNG = image_buffer; // worn tiles can be cropped from a 1-bit PNG
+        iGhostPNGSize = data_size;
+#endif
     }
     else if (MOTOSHORT(image_buffer) == 0xffd8) {
         Log_info("Drawing JPEG");
@@ -945,8 +1735,11 @@ void display_show_image(uint8_t *image_buffer, int data_size, bool bWait)
             // G5 compressed image
             BB_BITMAP *pBBB = (BB_BITMAP *)image_buffer;
 #ifdef BB_EPAPER
-            bbep.allocBuffer(false);
-            bAlloc = true;
+            bBanded = display_list_begin();
+            if (!bBanded) {
+                bbep.allocBuffer(false);
+                bAlloc = true;
+            }
 #endif
             int x = (width - pBBB->width)/2;
             int y = (height - pBBB->height)/2; // center it
@@ -955,45 +1748,60 @@ void display_show_image(uint8_t *image_buffer, int data_size, bool bWait)
                 bbep.fillScreen(BBEP_WHITE); 
             }     
             bbep.loadG5Image(image_buffer, x, y, BBEP_WHITE, BBEP_BLACK);
+#ifdef BB_EPAPER
+            if (bBanded && !display_list_render(ghost_band, NULL)) { // not enough memory for a strip, draw it the old way
+                bBanded = false;
+                bbep.allocBuffer(false);
+                bAlloc = true;
+                if (x > 0 || y > 0) bbep.fillScreen(BBEP_WHITE);
+                bbep.loadG5Image(image_buffer, x, y, BBEP_WHITE, BBEP_BLACK);
+            }
+            if (!bBanded) {
+                ghost_band(NULL, 0, bbep.height(), (uint8_t *)bbep.getBuffer());
+                pGhostFrame = (const uint8_t *)bbep.getBuffer();
+                iGhostPitch = bbep.width() / 8;
+            }
+            if (!bBanded) bbep.writePlane(PLANE_0); // send image data to the EPD
+            iRefreshMode = REFRESH_PARTIAL;
+#endif
         } 
-        else 
+        else if (g5PlanesMatch(image_buffer, data_size))
         {
-         // This work-around is due to a lack of RAM; the correct method would be to use loadBMP()
-            flip_image(image_buffer+62, bbep.width(), bbep.height(), false); // fix bottom-up bitmap images
 #ifdef BB_EPAPER
-            bbep.setBuffer(image_buffer+62); // uncompressed 1-bpp bitmap
+            iRefreshMode = g5planes_to_epd(image_buffer, data_size);
+#else
+            Log_error("4-gray G5 images are only shown on 2-bit panels");
 #endif
         }
+        else if (frameRleMatch(image_buffer, data_size))
+        {
 #ifdef BB_EPAPER
-        bbep.writePlane(PLANE_0); // send image data to the EPD
-        iRefreshMode = REFRESH_PARTIAL;
+            iRefreshMode = rle_to_epd(image_buffer, data_size);
+#else
+            Log_error("TRLE images are only shown on 1- and 2-bit panels");
 #endif
-        iUpdateCount = 1; // use partial update
+        }
+        else 
+        {
+            // uncompressed BMP, streamed to the EPD straight from the buffer
+            BmpInfo bmp;
+            bmp_err_e bmpResult = parseBMPInfo(image_buffer, data_size, bmp);
+            if (bmpResult != BMP_NO_ERR) {
+                Log_error("BMP image can't be shown, code: %d", bmpResult);
+            }
+#ifdef BB_EPAPER
+            else {
+                iRefreshMode = bmp_to_epd(image_buffer, data_size, bmp);
+            }
+#endif
+        }
     }
     Log_info("Display refresh start");
 #ifdef BB_EPAPER
-    if (iTempProfile != apiDisplayResult.response.temp_profile) {
-        iTempProfile = apiDisplayResult.response.temp_profile;
-        Log_info("Saving new temperature profile (%d) to FLASH", iTempProfile);
-        preferences.putUInt(PREFERENCES_TEMP_PROFILE, iTempProfile);
-    }
-    if ((iUpdateCount & 7) == 0 || apiDisplayResult.response.maximum_compatibility == true) {
-        Log_info("%s [%d]: Forcing full refresh; desired refresh mode was: %d\r\n", __FILE__, __LINE__, iRefreshMode);
-        iRefreshMode = REFRESH_FULL; // force full refresh every 8 partials
-    }
-    int refresh_seconds = preferences.getUInt(PREFERENCES_SLEEP_TIME_KEY, SLEEP_TIME_TO_SLEEP);
-    if (refresh_seconds >= 30*60 && iRefreshMode == REFRESH_PARTIAL) {
-        // For users who set updates 30 minutes or longer, use the "fast" update to prevent ghosting
-        Log_info("%s [%d]: Forcing fast refresh (not partial) since the TRMNL refresh_rate is set to > 30 min\n", __FILE__, __LINE__);
-        iRefreshMode = REFRESH_FAST;
-    }
-    if (!bWait) iRefreshMode = REFRESH_PARTIAL; // fast update when showing loading screen
-    Log_info("%s [%d]: EPD refresh mode: %d\r\n", __FILE__, __LINE__, iRefreshMode);
-    bbep.refresh(iRefreshMode, bWait);
+    display_refresh(iRefreshMode, bWait);
     if (bAlloc) {
         bbep.freeBuffer();
     }
-    iUpdateCount++;
 #else
     bbep.setCustomMatrix(u8_graytable, sizeof(u8_graytable));
     bbep.fullUpdate();
@@ -1008,9 +1816,18 @@ void display_show_image(uint8_t *image_buffer, int data_size, bool bWait)
  */
 uint8_t * display_read_file(const char *filename, int *file_size)
 {
-File f = SPIFFS.open(filename, "r");
+File f;
 uint8_t *buffer;
-
+size_t stored;
+const uint8_t *mapped = filesystem_map_file(filename, &stored);
+
+  if (mapped) {
+    buffer = (uint8_t *)malloc(stored);
+    *file_size = buffer ? stored : 0;
+    if (buffer) memcpy(buffer, mapped, stored);
+    return buffer;
+  }
+  f = SPIFFS.open(filename, "r");
   if (!f) {
     Serial.println("Failed to open file!");
     *file_size = 0;
@@ -1029,23 +1846,216 @@ uint8_t *buffer;
 } /* display_read_file() */
 
 /**
- * @brief Function to show the image with message on the display
+ * @brief Function to get an image from the file system without copying it if it can
+ * @param filename
+ * @param pointer to file size returned
+ * @param owned set to the buffer to free when the file had to be read into RAM, else nullptr
+ * @return pointer to the image (read-only when it is mapped from flash); nullptr if it can't be read
+ */
+uint8_t * display_map_file(const char *filename, int *file_size, uint8_t **owned)
+{
+size_t stored;
+const uint8_t *mapped = filesystem_map_file(filename, &stored);
+
+  *owned = nullptr;
+  if (mapped) {
+    *file_size = stored;
+    return (uint8_t *)mapped; // the decoders only read it
+  }
+  *owned = display_read_file(filename, file_size);
+  return *owned;
+} /* display_map_file() */
+
+#ifdef BB_EPAPER
+/**
+ * @brief Function to name the cache file of a message screen
+ * @param image_buffer logo drawn behind the message
+ * @param key message type and dynamic text of the screen
+ * @param name buffer for the file name
+ * @param size size of the name buffer
+ * @return true if the screen can be cached
+ */
+static bool msg_cache_name(const uint8_t *image_buffer, MessageCacheKey &key, char *name, size_t size)
+{
+    if (image_buffer)
+    {
+        // only G5 logos have a known length to hash, raw bitmaps are drawn every time
+        if (*(uint16_t *)image_buffer != BB_BITMAP_MARKER)
+            return false;
+        const BB_BITMAP *pBBB = (const BB_BITMAP *)image_buffer;
+        key.add(image_buffer, sizeof(BB_BITMAP) + pBBB->size);
+    }
+    key.add(FW_VERSION_STRING);
+    key.fileName(name, size);
+    return true;
+} /* msg_cache_name() */
+
+/**
+ * @brief Function to show a cached message screen without a framebuffer
+ * @param name cache file name
+ * @return true if the screen was shown, false if it has to be rendered
+ */
+static bool msg_cache_show(const char *name)
+{
+    if (!SPIFFS.exists(name))
+        return false;
+
+    unsigned long start = millis();
+    int size;
+    uint8_t *owned;
+    uint8_t *data = display_map_file(name, &size, &owned);
+    if (!data)
+        return false;
+    int heap = ESP.getMaxAllocHeap();
+    if (!messageCacheValid(data, size, bbep.width(), bbep.height()))
+    {
+        Log_error("Cached message screen %s is invalid, removing it", name);
+        free(owned);
+        SPIFFS.remove(name);
+        return false;
+    }
+    // without a back buffer the decoded rows go straight to the panel, same plane as writePlane(PLANE_0)
+    bbep.setPlane(PLANE_0);
+    int rc = bbep.loadG5Image(data, 0, 0, BBEP_BLACK, BBEP_WHITE);
+    free(owned);
+    if (rc != BBEP_SUCCESS)
+    {
+        Log_error("Cached message screen %s failed to decode (%d), removing it", name, rc);
+        SPIFFS.remove(name);
+        return false;
+    }
+    Log_info("Message screen %s from cache: %d bytes in %lu ms, max alloc heap %d", name, size, millis() - start, heap);
+    bbep.refresh(REFRESH_FULL, true);
+    ghost_refreshed(true);
+    return true;
+} /* msg_cache_show() */
+
+/**
+ * @brief Function to drop all cached message screens once the cache is full
+ * @param none
+ * @return none
+ */
+static void msg_cache_make_room(void)
+{
+    std::vector<String> files;
+    File rootDir = SPIFFS.open("/");
+    while (File file = rootDir.openNextFile())
+    {
+        if (strncmp(file.path(), MESSAGE_CACHE_PREFIX, strlen(MESSAGE_CACHE_PREFIX)) == 0)
+            files.push_back(file.path());
+    }
+    rootDir.close();
+
+    // screens of older firmware versions pile up here too, so the cache simply starts over
+    if (files.size() < MESSAGE_CACHE_MAX_FILES)
+        return;
+    Log_info("Message cache full, removing %d screens", (int)files.size());
+    for (const String &file : files)
+        SPIFFS.remove(file);
+} /* msg_cache_make_room() */
+
+// G5 encoder state while a message screen is being sent to the EPD
+struct MsgCacheEncoder
+{
+    G5ENCODER *pEnc;
+    uint8_t *out;
+    int rc;
+};
+
+/**
+ * @brief Function to prepare the G5 encoder for a message screen
+ * @param enc encoder state to initialize
+ * @return true if there was enough memory
+ */
+static bool msg_cache_begin(MsgCacheEncoder &enc)
+{
+    enc.pEnc = new (std::nothrow) G5ENCODER;
+    enc.out = (uint8_t *)malloc(MESSAGE_CACHE_MAX_SIZE);
+    if (!enc.pEnc || !enc.out)
+    {
+        Log_error("Not enough memory to cache the message screen");
+        delete enc.pEnc;
+        free(enc.out);
+        enc.pEnc = nullptr;
+        enc.out = nullptr;
+        return false;
+    }
+    enc.rc = enc.pEnc->init(bbep.width(), bbep.height(), enc.out + MESSAGE_CACHE_HEADER_SIZE, MESSAGE_CACHE_MAX_SIZE - MESSAGE_CACHE_HEADER_SIZE);
+    return true;
+} /* msg_cache_begin() */
+
+/**
+ * @brief Function to G5 encode rows of the message screen (a display list strip or the whole framebuffer)
+ * @param pUser MsgCacheEncoder
+ * @param y first row
+ * @param iHeight number of rows
+ * @param pRows 1-bpp pixels
+ * @return none
+ */
+static void msg_cache_band(void *pUser, int y, int iHeight, uint8_t *pRows)
+{
+    MsgCacheEncoder *enc = (MsgCacheEncoder *)pUser;
+    int pitch = (bbep.width() + 7) / 8;
+    for (int i = 0; i < iHeight && enc->rc == G5_SUCCESS; i++)
+    {
+        enc->rc = enc->pEnc->encodeLine(&pRows[i * pitch]);
+    }
+} /* msg_cache_band() */
+
+/**
+ * @brief Function to store the encoded screen as a cached message screen
+ * @param name cache file name
+ * @param enc encoder that has seen every row; freed here
+ * @param render_time milliseconds it took to draw the screen and send it to the EPD
+ * @return none
+ */
+static void msg_cache_store(const char *name, MsgCacheEncoder &enc, unsigned long render_time)
+{
+    Log_info("Message screen rendered in %lu ms, max alloc heap %d", render_time, ESP.getMaxAllocHeap());
+
+    unsigned long start = millis();
+    int size = enc.pEnc->size();
+    uint8_t *out = enc.out;
+    delete enc.pEnc;
+    enc.pEnc = nullptr;
+    enc.out = nullptr;
+    if (enc.rc != G5_ENCODE_COMPLETE)
+    {
+        Log_info("Message screen does not compress below %d bytes, not cached", MESSAGE_CACHE_MAX_SIZE);
+        free(out);
+        return;
+    }
+    messageCacheHeader(out, bbep.width(), bbep.height(), size);
+
+    msg_cache_make_room();
+    File file = SPIFFS.open(name, FILE_WRITE);
+    size_t written = file ? file.write(out, MESSAGE_CACHE_HEADER_SIZE + size) : 0;
+    if (file)
+        file.close();
+    free(out);
+    if (written != (size_t)(MESSAGE_CACHE_HEADER_SIZE + size))
+    {
+        Log_error("Failed to write cached message screen %s", name);
+        SPIFFS.remove(name);
+        return;
+    }
+    Log_info("Message screen cached as %s: %d bytes in %lu ms", name, MESSAGE_CACHE_HEADER_SIZE + size, millis() - start);
+} /* msg_cache_store() */
+#endif // BB_EPAPER
+
+/**
+ * @brief Function to draw the image and text of a message screen
  * @param image_buffer pointer to the uint8_t image buffer
  * @param message_type type of message that will show on the screen
  * @return none
  */
-void display_show_msg(uint8_t *image_buffer, MSG message_type)
+static void display_draw_msg(uint8_t *image_buffer, MSG message_type)
 {
     auto width = display_width();
     auto height = display_height();
     UWORD Imagesize = ((width % 8 == 0) ? (width / 8) : (width / 8 + 1)) * height;
     BB_RECT rect;
 
-    Log_info("display_show_msg start");
-    Log_info("maximum_compatibility = %d\n", apiDisplayResult.response.maximum_compatibility);
-#ifdef BB_EPAPER
-    bbep.allocBuffer(false);
-#endif
     if (image_buffer && *(uint16_t *)image_buffer == BB_BITMAP_MARKER)
     {
         // G5 compressed image
@@ -1354,11 +2364,62 @@ void display_show_msg(uint8_t *image_buffer, MSG message_type)
     default:
         break;
     }
+} /* display_draw_msg() */
+
+/**
+ * @brief Function to show the image with message on the display
+ * @param image_buffer pointer to the uint8_t image buffer
+ * @param message_type type of message that will show on the screen
+ * @return none
+ */
+void display_show_msg(uint8_t *image_buffer, MSG message_type)
+{
+    Log_info("display_show_msg start");
+    Log_info("maximum_compatibility = %d\n", apiDisplayResult.response.maximum_compatibility);
+    u32FrameCrc = 0; // a frame delta can't be applied to a message screen
 #ifdef BB_EPAPER
-    bbep.writePlane(PLANE_0);
+    char cache_name[24];
+    unsigned long render_start = millis();
+    MessageCacheKey key(message_type);
+    key.add(message_type == MSG_TOO_BIG ? filename : "");
+    bool cacheable = message_type != TEST && message_type != FILL_WHITE &&
+                     msg_cache_name(image_buffer, key, cache_name, sizeof(cache_name));
+    if (cacheable && msg_cache_show(cache_name))
+    {
+        Log_info("display_show_msg end");
+        return;
+    }
+    MsgCacheEncoder enc;
+    if (cacheable)
+        cacheable = msg_cache_begin(enc);
+    // raw bitmaps are copied into the framebuffer, everything else can be sent in strips
+    bool banded = !(image_buffer && *(uint16_t *)image_buffer != BB_BITMAP_MARKER) && display_list_begin();
+    if (!banded)
+        bbep.allocBuffer(false);
+#endif
+    display_draw_msg(image_buffer, message_type);
+#ifdef BB_EPAPER
+    if (banded && !display_list_render(cacheable ? msg_cache_band : NULL, &enc))
+    {
+        // nothing was sent, draw it the old way
+        banded = false;
+        bbep.allocBuffer(false);
+        display_draw_msg(image_buffer, message_type);
+    }
+    if (!banded)
+    {
+        bbep.writePlane(PLANE_0);
+        if (cacheable)
+            msg_cache_band(&enc, 0, bbep.height(), (uint8_t *)bbep.getBuffer());
+    }
+    unsigned long render_time = millis() - render_start;
     bbep.refresh(REFRESH_FULL, true);
+    ghost_refreshed(true);
+    if (cacheable)
+        msg_cache_store(cache_name, enc, render_time);
     bbep.freeBuffer();
 #else
+    display_draw_msg(image_buffer, message_type);
     bbep.fullUpdate();
 #endif
     Log_info("display_show_msg end");
@@ -1374,6 +2435,7 @@ void display_show_msg_qa(uint8_t *image_buffer, const float *voltage, const floa
 
     Log_info("display_show_msg start");
     Log_info("maximum_compatibility = %d\n", apiDisplayResult.response.maximum_compatibility);
+    u32FrameCrc = 0; // a frame delta can't be applied to a message screen
 #ifdef BB_EPAPER
     bbep.allocBuffer(false);
 #endif
@@ -1445,6 +2507,7 @@ void display_show_msg_qa(uint8_t *image_buffer, const float *voltage, const floa
     #ifdef BB_EPAPER
         bbep.writePlane(PLANE_0);
         bbep.refresh(REFRESH_FULL, true);
+        ghost_refreshed(true);
         bbep.freeBuffer();
     #else
         bbep.fullUpdate();
@@ -1463,7 +2526,7 @@ void display_show_msg_qa(uint8_t *image_buffer, const float *voltage, const floa
 }
 
 /**
- * @brief Function to show the image with message on the display
+ * @brief Function to draw the image and text of a setup message screen
  * @param image_buffer pointer to the uint8_t image buffer
  * @param message_type type of message that will show on the screen
  * @param friendly_id device friendly ID
@@ -1472,39 +2535,13 @@ void display_show_msg_qa(uint8_t *image_buffer, const float *voltage, const floa
  * @param message additional message
  * @return none
  */
-void display_show_msg(uint8_t *image_buffer, MSG message_type, String friendly_id, bool id, const char *fw_version, String message)
+static void display_draw_msg2(uint8_t *image_buffer, MSG message_type, const String &friendly_id, bool id, const char *fw_version, const String &message)
 {
-    Log_info("Free heap in display_show_msg - %d", ESP.getMaxAllocHeap());
-    Log_info("maximum_compatibility = %d\n", apiDisplayResult.response.maximum_compatibility);
-#ifdef BB_EPAPER
-    bbep.allocBuffer(false);
-    Log_info("Free heap after bbep.allocBuffer() - %d", ESP.getMaxAllocHeap());
-#endif
-
-    if (message_type == WIFI_CONNECT)
-    {
-        Log_info("Display set to white");
-        bbep.fillScreen(BBEP_WHITE);
-#ifdef BB_EPAPER
-        bbep.writePlane(PLANE_0);
-        if (!apiDisplayResult.response.maximum_compatibility) {
-            bbep.refresh(REFRESH_FAST, true); // newer panel can handle the fast refresh
-        } else {
-            bbep.refresh(REFRESH_FULL, true); // incompatible panel (for now)
-        }
-#else
-        bbep.fullUpdate();
-#endif
-        display_sleep(1000);
-    }
-
     auto width = display_width();
     auto height = display_height();
     UWORD Imagesize = ((width % 8 == 0) ? (width / 8) : (width / 8 + 1)) * height;
     BB_RECT rect;
 
-    Log_info("display_show_msg2 start");
-
     // Load the image into the bb_epaper framebuffer
     if (image_buffer && *(uint16_t *)image_buffer == BB_BITMAP_MARKER)
     {
@@ -1598,10 +2635,89 @@ void display_show_msg(uint8_t *image_buffer, MSG message_type, String friendly_i
     default:
         break;
     }
+} /* display_draw_msg2() */
+
+/**
+ * @brief Function to show the image with message on the display
+ * @param image_buffer pointer to the uint8_t image buffer
+ * @param message_type type of message that will show on the screen
+ * @param friendly_id device friendly ID
+ * @param id shows if ID exists
+ * @param fw_version version of the firmware
+ * @param message additional message
+ * @return none
+ */
+void display_show_msg(uint8_t *image_buffer, MSG message_type, String friendly_id, bool id, const char *fw_version, String message)
+{
+    Log_info("Free heap in display_show_msg - %d", ESP.getMaxAllocHeap());
+    Log_info("maximum_compatibility = %d\n", apiDisplayResult.response.maximum_compatibility);
+    u32FrameCrc = 0; // a frame delta can't be applied to a message screen
+#ifdef BB_EPAPER
+    char cache_name[24];
+    unsigned long render_start = millis();
+    MessageCacheKey key(message_type);
+    key.add(id ? friendly_id.c_str() : "").add(fw_version).add(message.c_str());
+    // the WiFi setup screen clears the panel first, it is not worth a cache entry
+    bool cacheable = message_type != WIFI_CONNECT &&
+                     msg_cache_name(image_buffer, key, cache_name, sizeof(cache_name));
+    if (cacheable && msg_cache_show(cache_name))
+    {
+        Log_info("display_show_msg2 end");
+        return;
+    }
+    MsgCacheEncoder enc;
+    if (cacheable)
+        cacheable = msg_cache_begin(enc);
+#endif
+
+    if (message_type == WIFI_CONNECT)
+    {
+        Log_info("Display set to white");
+#ifdef BB_EPAPER
+        bbep.fillScreen(BBEP_WHITE, PLANE_0); // no framebuffer yet, this goes straight to the EPD
+        if (!apiDisplayResult.response.maximum_compatibility) {
+            bbep.refresh(REFRESH_FAST, true); // newer panel can handle the fast refresh
+        } else {
+            bbep.refresh(REFRESH_FULL, true); // incompatible panel (for now)
+        }
+#else
+        bbep.fillScreen(BBEP_WHITE);
+        bbep.fullUpdate();
+#endif
+        display_sleep(1000);
+    }
+
+#ifdef BB_EPAPER
+    // raw bitmaps are copied into the framebuffer, everything else can be sent in strips
+    bool banded = !(image_buffer && *(uint16_t *)image_buffer != BB_BITMAP_MARKER) && display_list_begin();
+    if (!banded)
+    {
+        bbep.allocBuffer(false);
+        Log_info("Free heap after bbep.allocBuffer() - %d", ESP.getMaxAllocHeap());
+    }
+#endif
+    Log_info("display_show_msg2 start");
+    display_draw_msg2(image_buffer, message_type, friendly_id, id, fw_version, message);
     Log_info("Start drawing...");
 #ifdef BB_EPAPER
-    bbep.writePlane(PLANE_0);
+    if (banded && !display_list_render(cacheable ? msg_cache_band : NULL, &enc))
+    {
+        // nothing was sent, draw it the old way
+        banded = false;
+        bbep.allocBuffer(false);
+        display_draw_msg2(image_buffer, message_type, friendly_id, id, fw_version, message);
+    }
+    if (!banded)
+    {
+        bbep.writePlane(PLANE_0);
+        if (cacheable)
+            msg_cache_band(&enc, 0, bbep.height(), (uint8_t *)bbep.getBuffer());
+    }
+    unsigned long render_time = millis() - render_start;
     bbep.refresh(REFRESH_FULL, true);
+    ghost_refreshed(true);
+    if (cacheable)
+        msg_cache_store(cache_name, enc, render_time);
     bbep.freeBuffer();
 #else
     bbep.fullUpdate();
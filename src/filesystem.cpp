@@ -1,8 +1,55 @@
 #include <filesystem.h>
 #include <Arduino.h>
 #include <SPIFFS.h>
+#include <esp_partition.h>
+#include <image_store.h>
 #include <trmnl_log.h>
 
+/** The image store partition, memory mapped for reading */
+class PartitionFlash : public ImageFlash
+{
+public:
+    bool begin()
+    {
+        partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)IMAGE_STORE_SUBTYPE, IMAGE_STORE_PARTITION);
+        if (!partition)
+            return false;
+        const void *ptr = nullptr;
+        if (esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &ptr, &handle) != ESP_OK)
+        {
+            Log_error("Failed to map the %s partition", IMAGE_STORE_PARTITION);
+            return false;
+        }
+        mapped = (const uint8_t *)ptr;
+        return true;
+    }
+
+    const uint8_t *data() const override { return mapped; }
+    size_t size() const override { return partition->size; }
+    size_t sectorSize() const override { return SPI_FLASH_SEC_SIZE; }
+
+    bool erase(size_t offset, size_t length) override
+    {
+        return esp_partition_erase_range(partition, offset, length) == ESP_OK;
+    }
+
+    bool write(size_t offset, const uint8_t *data, size_t length) override
+    {
+        return esp_partition_write(partition, offset, data, length) == ESP_OK;
+    }
+
+private:
+    const esp_partition_t *partition = nullptr;
+    spi_flash_mmap_handle_t handle = 0;
+    const uint8_t *mapped = nullptr;
+};
+
+static PartitionFlash imageFlash;
+static ImageStore imageStore(imageFlash);
+static bool imageStoreReady = false; // false without the partition: everything stays in SPIFFS
+
+#define FILESYSTEM_SPARE_MARGIN 8192 // left free by filesystem_write_spare_file()
+
 /**
  * @brief Function to init the filesystem
  * @param none
@@ -19,6 +66,11 @@ bool filesystem_init(void)
     else
     {
         Log_info("SPIFFS mounted");
+        if (!imageStoreReady)
+        {
+            imageStoreReady = imageFlash.begin() && imageStore.mount();
+            Log_info("Image store %s", imageStoreReady ? "mounted" : "not available");
+        }
         return true;
     }
 }
@@ -41,6 +93,13 @@ void filesystem_deinit(void)
  */
 bool filesystem_read_from_file(const char *name, uint8_t *out_buffer, size_t size)
 {
+    size_t stored = 0;
+    const uint8_t *data = filesystem_map_file(name, &stored);
+    if (data)
+    {
+        memcpy(out_buffer, data, _min(size, stored));
+        return true;
+    }
     if (SPIFFS.exists(name))
     {
         Log_info("file %s exists", name);
@@ -72,6 +131,18 @@ bool filesystem_read_from_file(const char *name, uint8_t *out_buffer, size_t siz
  */
 size_t filesystem_write_to_file(const char *name, uint8_t *in_buffer, size_t size)
 {
+    if (imageStoreReady)
+    {
+        if (imageStore.write(name, in_buffer, size))
+        {
+            Log_info("file %s stored in flash - %d bytes", name, size);
+            if (SPIFFS.exists(name))
+                SPIFFS.remove(name);
+            return size;
+        }
+        Log_error("Image store write of %s failed, using SPIFFS", name);
+        imageStore.remove(name); // the older version must not shadow the new one
+    }
     uint32_t SPIFFS_freeBytes = (SPIFFS.totalBytes() - SPIFFS.usedBytes());
     Log_info("SPIFFS free space - %d, total -%d", SPIFFS_freeBytes, SPIFFS.totalBytes());
     if (SPIFFS.exists(name))
@@ -127,6 +198,51 @@ size_t filesystem_write_to_file(const char *name, uint8_t *in_buffer, size_t siz
     }
 }
 
+/**
+ * @brief Function to get the free space of SPIFFS
+ * @param none
+ * @return size_t bytes that can still be written
+ */
+size_t filesystem_free_bytes(void)
+{
+    size_t total = SPIFFS.totalBytes(), used = SPIFFS.usedBytes();
+    return used < total ? total - used : 0;
+}
+
+/**
+ * @brief Function to write a file that may be lost (e.g. a partial download) to SPIFFS
+ * @param name filename
+ * @param in_buffer pointer to input buffer
+ * @param size size of the input buffer
+ * @return size of written bytes; 0 if it doesn't fit, then only this file is removed (SPIFFS is never formatted)
+ */
+size_t filesystem_write_spare_file(const char *name, const uint8_t *in_buffer, size_t size)
+{
+    if (SPIFFS.exists(name))
+        SPIFFS.remove(name);
+    // SPIFFS slows down and fails writes when it is nearly full
+    if (size + FILESYSTEM_SPARE_MARGIN > filesystem_free_bytes())
+    {
+        Log_info("No room for %s - %d bytes, %d free", name, size, filesystem_free_bytes());
+        return 0;
+    }
+    File file = SPIFFS.open(name, FILE_WRITE);
+    if (!file)
+    {
+        Log_error("File open ERROR");
+        return 0;
+    }
+    size_t written = file.write(in_buffer, size);
+    file.close();
+    if (written != size)
+    {
+        Log_error("file %s writing failed, removed", name);
+        SPIFFS.remove(name);
+        return 0;
+    }
+    return written;
+}
+
 /**
  * @brief Function to check if file exists
  * @param name filename
@@ -134,7 +250,7 @@ size_t filesystem_write_to_file(const char *name, uint8_t *in_buffer, size_t siz
  */
 bool filesystem_file_exists(const char *name)
 {
-    if (SPIFFS.exists(name))
+    if ((imageStoreReady && imageStore.exists(name)) || SPIFFS.exists(name))
     {
         Log_info("file %s exists.", name);
         return true;
@@ -153,6 +269,8 @@ bool filesystem_file_exists(const char *name)
  */
 bool filesystem_file_delete(const char *name)
 {
+    if (imageStoreReady && imageStore.remove(name))
+        Log_info("file %s removed from the image store", name);
     if (SPIFFS.exists(name))
     {
         if (SPIFFS.remove(name))
@@ -181,6 +299,18 @@ bool filesystem_file_delete(const char *name)
  */
 bool filesystem_file_rename(const char *old_name, const char *new_name)
 {
+    if (imageStoreReady && imageStore.exists(old_name))
+    {
+        if (imageStore.rename(old_name, new_name))
+        {
+            Log_info("file %s renamed to %s.", old_name, new_name);
+            if (SPIFFS.exists(new_name))
+                SPIFFS.remove(new_name);
+            return true;
+        }
+        Log_error("file %s wasn't renamed.", old_name);
+        return false;
+    }
     if (SPIFFS.exists(old_name))
     {
         Log_info("file %s exists.", old_name);
@@ -201,6 +331,29 @@ bool filesystem_file_rename(const char *old_name, const char *new_name)
     }
 }
 
+/**
+ * @brief Function to find a file in the image store
+ * @param name filename
+ * @param size size of the file returned
+ * @return pointer to the file in memory mapped flash (read-only); nullptr if it isn't in the store
+ */
+const uint8_t *filesystem_map_file(const char *name, size_t *size)
+{
+    if (!imageStoreReady)
+        return nullptr;
+    return imageStore.find(name, *size);
+}
+
+/**
+ * @brief Function to check if a file is kept in the image store (not in SPIFFS)
+ * @param name filename
+ * @return result - true if it is in the store; false - if it isn't or there is no store
+ */
+bool filesystem_in_image_store(const char *name)
+{
+    return imageStoreReady && imageStore.exists(name);
+}
+
 void list_files()
 {
     Log_info("Filesystem Usage: %d/%d", SPIFFS.usedBytes(), SPIFFS.totalBytes());
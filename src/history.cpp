@@ -0,0 +1,109 @@
+#include <history.h>
+#include <Arduino.h>
+#include <display.h>
+#include <filesystem.h>
+#include <trmnl_log.h>
+
+// plain RTC memory: after a power cycle the current image is simply on screen
+static RTC_DATA_ATTR HistoryCursor historyCursor;
+
+// frames are only kept in the image store: SPIFFS is too small for them and is formatted when a write fails
+static void loadIndex(HistoryIndex &index)
+{
+  if (!filesystem_in_image_store(HISTORY_INDEX_FILE) ||
+      !filesystem_read_from_file(HISTORY_INDEX_FILE, (uint8_t *)&index, sizeof(index)) ||
+      !historyIndexValid(index))
+    historyClear(index);
+}
+
+static const char *storedImageFile(const char *bmp, const char *png)
+{
+  if (filesystem_file_exists(bmp))
+    return bmp;
+  if (filesystem_file_exists(png))
+    return png;
+  return nullptr;
+}
+
+static bool showFile(const char *name)
+{
+  int size = 0;
+  uint8_t *owned = nullptr;
+  uint8_t *image = display_map_file(name, &size, &owned);
+  if (!image)
+  {
+    Log_error("Frame %s can't be read", name);
+    return false;
+  }
+  display_show_image(image, size, true);
+  free(owned);
+  return true;
+}
+
+void history_keep_last(void)
+{
+  historyReset(historyCursor);
+  const char *last = storedImageFile("/last.bmp", "/last.png");
+  if (!last || !filesystem_in_image_store(last))
+    return;
+
+  // a rename, the image itself is not copied
+  HistoryIndex index;
+  loadIndex(index);
+  char name[16];
+  historyFrameFile(historyPush(index), name, sizeof(name));
+  filesystem_file_delete(name);
+  if (!filesystem_file_rename(last, name))
+  {
+    Log_error("Failed to keep %s in the frame history", last);
+    return;
+  }
+  if (filesystem_write_to_file(HISTORY_INDEX_FILE, (uint8_t *)&index, sizeof(index)) != sizeof(index))
+    Log_error("Failed to write the frame history index");
+}
+
+uint8_t history_frames(void)
+{
+  HistoryIndex index;
+  loadIndex(index);
+  return storedImageFile("/last.bmp", "/last.png") ? 1 + index.count : 0;
+}
+
+bool history_show_older(void)
+{
+  HistoryIndex index;
+  loadIndex(index);
+  const char *last = storedImageFile("/last.bmp", "/last.png");
+  int back = historyRewind(historyCursor, last ? 1 + index.count : 0);
+  if (back < 0)
+  {
+    Log_info("No older frame kept on flash");
+    return false;
+  }
+
+  char name[16];
+  if (back > 1)
+    historyFrameFile(historySlot(index, back - 1), name, sizeof(name));
+  unsigned long start = millis();
+  if (!showFile(back > 1 ? name : last))
+    return false;
+  Log_info("Rewound %d frames without WiFi in %lu ms", back, millis() - start);
+  return true;
+}
+
+bool history_show_current(void)
+{
+  if (!historyRewound(historyCursor))
+    return false;
+  historyReset(historyCursor);
+  const char *current = storedImageFile("/current.bmp", "/current.png");
+  if (!current || !showFile(current))
+    return false;
+  Log_info("Current image shown again after a rewind");
+  return true;
+}
+
+void history_reset(void)
+{
+  historyReset(historyCursor);
+}
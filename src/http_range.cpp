@@ -0,0 +1,70 @@
+#include <http_range.h>
+#include <sink_stream.h>
+#include <trmnl_log.h>
+
+HttpRangeRequest::HttpRangeRequest(HTTPClient &https, const String &redirectBase)
+    : https(https), redirectBase(redirectBase), httpCode(0)
+{
+}
+
+int HttpRangeRequest::send(uint32_t from, const char *ifRange)
+{
+  const char *headers[] = {"Content-Type", "Content-Range", "ETag", "X-Checksum-CRC32"};
+  https.collectHeaders(headers, 4);
+
+  if (from > 0)
+  {
+    char range[24];
+    snprintf(range, sizeof(range), "bytes=%u-", from);
+    https.addHeader("Range", range);
+    if (ifRange)
+      https.addHeader("If-Range", ifRange);
+  }
+  return https.GET();
+}
+
+bool HttpRangeRequest::get(uint32_t from, const char *ifRange, RangeHandler &handler)
+{
+  httpCode = send(from, ifRange);
+  if ((httpCode == HTTP_CODE_PERMANENT_REDIRECT || httpCode == HTTP_CODE_TEMPORARY_REDIRECT) && redirectBase.length() > 0)
+  {
+    String location = https.getLocation();
+    https.end();
+    https.begin(redirectBase + location);
+    Log_info("Redirected to: %s", location.c_str());
+    httpCode = send(from, ifRange);
+  }
+
+  if (httpCode <= 0)
+    return false;
+
+  String etag = https.header("ETag");
+  RangeResponse response = {};
+  response.status = httpCode;
+  response.etag = etag.c_str();
+
+  if (httpCode == HTTP_CODE_PARTIAL_CONTENT)
+  {
+    uint32_t end;
+    if (!parseContentRange(https.header("Content-Range").c_str(), response.start, end, response.total))
+      response.status = 0; // unusable partial response
+  }
+  else
+  {
+    int size = https.getSize();
+    response.total = size > 0 ? size : 0;
+  }
+
+  String crc = https.header("X-Checksum-CRC32");
+  if (crc.length() > 0)
+  {
+    response.hasCrc = true;
+    response.crc = strtoul(crc.c_str(), nullptr, 16);
+  }
+
+  if (!handler.onResponse(response))
+    return true;
+
+  SinkStream stream(handler);
+  return https.writeToStream(&stream) >= 0;
+}
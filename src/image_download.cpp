@@ -0,0 +1,96 @@
+#include <image_download.h>
+#include <config.h>
+#include <filesystem.h>
+#include <trmnl_log.h>
+
+// garbage after power-on fails the magic check
+RTC_NOINIT_ATTR DownloadCheckpoint imageCheckpoint;
+
+ImageBufferSink::ImageBufferSink(const DownloadCheckpoint &checkpoint)
+    : checkpoint(checkpoint), data(nullptr), capacity(0), length(0), wasTooBig(false), wasOutOfMemory(false)
+{
+}
+
+ImageBufferSink::~ImageBufferSink()
+{
+  free(data);
+}
+
+bool ImageBufferSink::reserve(size_t size)
+{
+  if (size <= capacity)
+    return true;
+  if (size > MAX_IMAGE_SIZE)
+  {
+    wasTooBig = true;
+    return false;
+  }
+
+  // without a Content-Length, grow in steps instead of byte by byte
+  size_t grown = capacity + 16 * 1024;
+  if (size < grown)
+    size = grown < MAX_IMAGE_SIZE ? grown : MAX_IMAGE_SIZE;
+
+  uint8_t *bigger = (uint8_t *)realloc(data, size);
+  if (!bigger)
+  {
+    Log_error("Failed to allocate %d bytes for image buffer", size);
+    wasOutOfMemory = true;
+    return false;
+  }
+  data = bigger;
+  capacity = size;
+  return true;
+}
+
+bool ImageBufferSink::resumeAt(uint32_t offset, uint32_t total)
+{
+  length = 0;
+  if (!reserve(total > offset ? total : offset))
+    return false;
+
+  if (offset == 0)
+  {
+    if (filesystem_file_exists(IMAGE_PARTIAL_FILE))
+      filesystem_file_delete(IMAGE_PARTIAL_FILE);
+    return true;
+  }
+
+  if (!filesystem_read_from_file(IMAGE_PARTIAL_FILE, data, offset) || ota_crc32(0, data, offset) != checkpoint.crc)
+  {
+    Log_error("Stored partial image is missing or damaged");
+    return false;
+  }
+  length = offset;
+  return true;
+}
+
+bool ImageBufferSink::write(const uint8_t *chunk, size_t size)
+{
+  if (!reserve(length + size))
+    return false;
+  memcpy(data + length, chunk, size);
+  length += size;
+  return true;
+}
+
+bool ImageBufferSink::savePartial()
+{
+  if (checkpoint.received == 0 || checkpoint.received > length)
+    return false;
+  // not filesystem_write_to_file(): a full SPIFFS must not be formatted for a partial image
+  size_t written = filesystem_write_spare_file(IMAGE_PARTIAL_FILE, data, checkpoint.received);
+  if (!written)
+    return false;
+  Log_info("Saved %d of %d bytes of the image to continue later", written, checkpoint.total);
+  return true;
+}
+
+uint8_t *ImageBufferSink::release()
+{
+  uint8_t *image = data;
+  data = nullptr;
+  capacity = 0;
+  length = 0;
+  return image;
+}
@@ -0,0 +1,149 @@
+#include <ota.h>
+#include <Update.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <esp_spi_flash.h>
+#include <trmnl_log.h>
+#include <sink_stream.h>
+#include <http_range.h>
+#include <memory>
+
+/** Delta patches are applied against the image we are running from */
+class RunningPartitionSource : public OtaSource
+{
+public:
+  RunningPartitionSource() : partition(esp_ota_get_running_partition()) {}
+
+  bool read(uint32_t offset, uint8_t *data, size_t length) override
+  {
+    return partition && esp_partition_read(partition, offset, data, length) == ESP_OK;
+  }
+
+private:
+  const esp_partition_t *partition;
+};
+
+/**
+ * The inactive OTA slot, written sector by sector without Update so that a
+ * download can continue there after a sleep. Each sector is erased when its
+ * first byte arrives; resume offsets are sector aligned.
+ */
+class PartitionSink : public ResumableSink
+{
+public:
+  PartitionSink() : partition(esp_ota_get_next_update_partition(nullptr)), offset(0) {}
+
+  const esp_partition_t *target() const { return partition; }
+
+  bool resumeAt(uint32_t start, uint32_t total) override
+  {
+    if (!partition || total > partition->size || start % SPI_FLASH_SEC_SIZE != 0)
+      return false;
+    offset = start;
+    return true;
+  }
+
+  bool write(const uint8_t *data, size_t length) override
+  {
+    while (length > 0)
+    {
+      size_t n = SPI_FLASH_SEC_SIZE - offset % SPI_FLASH_SEC_SIZE;
+      if (n > length)
+        n = length;
+      if (offset + n > partition->size)
+        return false;
+      if (offset % SPI_FLASH_SEC_SIZE == 0 && esp_partition_erase_range(partition, offset, SPI_FLASH_SEC_SIZE) != ESP_OK)
+        return false;
+      if (esp_partition_write(partition, offset, data, n) != ESP_OK)
+        return false;
+      offset += n;
+      data += n;
+      length -= n;
+    }
+    return true;
+  }
+
+private:
+  const esp_partition_t *partition;
+  uint32_t offset;
+};
+
+// survives deep sleep and the restart after an update attempt; garbage after power-on fails the magic check
+static RTC_NOINIT_ATTR DownloadCheckpoint otaCheckpoint;
+
+class UpdateSink : public OtaSink
+{
+public:
+  bool write(const uint8_t *data, size_t length) override
+  {
+    return Update.write((uint8_t *)data, length) == length;
+  }
+};
+
+bool ota_write_encoded(HTTPClient &https, OtaEncoding encoding)
+{
+  RunningPartitionSource running;
+  UpdateSink update;
+
+  // the decoder carries the 2 KB heatshrink window, keep it off the loop task stack
+  std::unique_ptr<OtaDecoder> decoder(new (std::nothrow) OtaDecoder(encoding, running, update));
+  if (!decoder)
+  {
+    Log_error("Not enough memory for the firmware decoder");
+    return false;
+  }
+
+  SinkStream stream(*decoder);
+  int result = https.writeToStream(&stream);
+  if (result < 0)
+  {
+    Log_error("Firmware download failed: %s", decoder->error() ? decoder->error() : HTTPClient::errorToString(result).c_str());
+    return false;
+  }
+
+  if (!decoder->finish())
+  {
+    Log_error("Firmware image rejected: %s", decoder->error());
+    return false;
+  }
+
+  Log_info("Firmware decoded (%s): %u bytes downloaded, %u bytes written", otaEncodingToString(encoding), decoder->bytesIn(), decoder->bytesOut());
+  return true;
+}
+
+DownloadOutcome ota_download(HTTPClient &https, const char *url)
+{
+  PartitionSink partition;
+  ResumableDownload download(otaCheckpoint, url, partition, SPI_FLASH_SEC_SIZE);
+  if (download.canResume())
+    Log_info("Resuming firmware download at %u of %u bytes", otaCheckpoint.received, otaCheckpoint.total);
+
+  HttpRangeRequest request(https);
+  DownloadOutcome outcome = download.attempt(request);
+  if (outcome == DownloadOutcome::Interrupted)
+  {
+    Log_error("Firmware download interrupted at %u bytes (%s, HTTP %d), will resume", download.received(), download.error(), request.status());
+    return outcome;
+  }
+  if (outcome == DownloadOutcome::Failed)
+  {
+    Log_error("Firmware download failed: %s (HTTP %d)", download.error(), request.status());
+    return outcome;
+  }
+
+  // checks the image (checksum and SHA-256) before making it the boot image
+  esp_err_t err = esp_ota_set_boot_partition(partition.target());
+  if (err != ESP_OK)
+  {
+    Log_error("Downloaded firmware rejected: %s", esp_err_to_name(err));
+    return DownloadOutcome::Failed;
+  }
+
+  Log_info("Firmware downloaded: %u bytes (resumed at %u)", download.received(), download.resumedFrom());
+  return outcome;
+}
+
+void ota_forget_partial(void)
+{
+  clearDownloadCheckpoint(otaCheckpoint);
+}
@@ -0,0 +1,98 @@
+#include <overlay.h>
+#include <bl.h>
+#include <display.h>
+#include <filesystem.h>
+#include <trmnl_log.h>
+
+// plain RTC memory: a power cycle (or flashing) simply makes the device go online
+static RTC_DATA_ATTR OverlayPlan overlayPlan;
+static RTC_DATA_ATTR int overlayRssi;
+static RTC_DATA_ATTR bool overlayOffline;
+
+static const char *currentImageFile(void)
+{
+  if (filesystem_file_exists("/current.png"))
+    return "/current.png";
+  if (filesystem_file_exists("/current.bmp"))
+    return "/current.bmp";
+  return nullptr;
+}
+
+bool overlay_start(const char *spec, bool newImage, int rssi, uint32_t refreshRate)
+{
+  OverlayPlan plan;
+  if (!spec[0])
+  {
+    overlayStop(overlayPlan);
+    return false;
+  }
+  const char *error = overlayParse(spec, display_width(), display_height(), plan);
+  uint32_t now = getTime();
+  if (!error && !currentImageFile())
+    error = "no stored image to draw on";
+  if (!error && now == 0)
+    error = "the clock is not set";
+  if (error)
+  {
+    Log_error("Overlay not used: %s", error);
+    overlayStop(overlayPlan);
+    return false;
+  }
+
+  overlayStart(plan, overlayPlan, newImage, now, refreshRate);
+  overlayPlan = plan;
+  overlayRssi = rssi;
+  overlayOffline = false;
+  Log_info("Drawing %d overlay widgets locally for %u s", plan.count, refreshRate);
+  return true;
+}
+
+bool overlay_update(float vBatt)
+{
+  OverlayInputs inputs;
+  inputs.now = getTime();
+  inputs.batteryVoltage = vBatt;
+  inputs.rssi = overlayRssi;
+  inputs.offline = overlayOffline;
+
+  char texts[OVERLAY_MAX_WIDGETS][OVERLAY_TEXT_SIZE];
+  if (overlayRender(overlayPlan, inputs, texts) == 0)
+    return true;
+
+  const char *name = currentImageFile();
+  int size = 0;
+  uint8_t *owned = nullptr;
+  uint8_t *frame = name ? display_map_file(name, &size, &owned) : nullptr;
+  bool shown = frame && display_show_overlays(frame, size, overlayPlan, texts);
+  free(owned);
+  if (!shown)
+  {
+    Log_error("Overlay widgets can't be drawn on this image, going online");
+    overlayStop(overlayPlan);
+  }
+  return shown;
+}
+
+bool overlay_due(void)
+{
+  return overlayDue(overlayPlan, getTime());
+}
+
+void overlay_offline(float vBatt)
+{
+  // the image stays on screen while the device retries, its widgets keep going
+  if (overlayPlan.magic != OVERLAY_MAGIC)
+    return;
+  overlayOffline = true;
+  overlay_update(vBatt);
+}
+
+uint32_t overlay_sleep_time(void)
+{
+  return overlaySleepTime(overlayPlan, getTime());
+}
+
+void overlay_stop(void)
+{
+  overlayStop(overlayPlan);
+}
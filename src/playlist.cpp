@@ -0,0 +1,161 @@
+#include <playlist.h>
+#include <SPIFFS.h>
+#include <bl.h>
+#include <config.h>
+#include <filesystem.h>
+#include <sink_stream.h>
+#include <trmnl_log.h>
+#include <memory>
+
+// plain RTC memory: a power cycle (or flashing) simply makes the device go online
+static RTC_DATA_ATTR PlaylistCursor playlistCursor;
+
+// SPIFFS left to the next image and the message cache; filesystem_write_to_file() formats SPIFFS when a write fails
+#define PLAYLIST_SPIFFS_RESERVE MAX_IMAGE_SIZE
+
+class SpiffsFrameStorage : public FrameStorage
+{
+public:
+  bool create(const char *name) override
+  {
+    file = SPIFFS.open(name, FILE_WRITE);
+    return (bool)file;
+  }
+
+  bool append(const uint8_t *data, size_t length) override
+  {
+    if (length + PLAYLIST_SPIFFS_RESERVE > filesystem_free_bytes())
+      return false;
+    return file && file.write(data, length) == length;
+  }
+
+  void close() override
+  {
+    if (file)
+      file.close();
+  }
+
+  size_t read(const char *name, uint8_t *buffer, size_t size) override
+  {
+    if (!SPIFFS.exists(name))
+      return 0;
+    File in = SPIFFS.open(name, FILE_READ);
+    if (!in)
+      return 0;
+    size_t n = in.read(buffer, size);
+    in.close();
+    return n;
+  }
+
+  bool remove(const char *name) override
+  {
+    return SPIFFS.exists(name) && SPIFFS.remove(name);
+  }
+
+private:
+  File file;
+};
+
+// the index first, so a bundle that is cut short is never played
+static void removeBundle(SpiffsFrameStorage &storage)
+{
+  char file[16];
+  storage.remove(BUNDLE_INDEX_FILE);
+  for (uint8_t i = 0; i < BUNDLE_MAX_FRAMES; i++)
+  {
+    bundleFrameFile(i, file, sizeof(file));
+    storage.remove(file);
+  }
+}
+
+uint32_t playlist_budget(void)
+{
+  // a new bundle replaces the frames of the stored one
+  size_t room = filesystem_free_bytes();
+  SpiffsFrameStorage storage;
+  BundleIndex index;
+  if (loadBundleIndex(storage, index))
+  {
+    for (uint8_t i = 0; i < index.count; i++)
+      room += index.frames[i].size;
+  }
+  size_t reserve = PLAYLIST_SPIFFS_RESERVE + sizeof(BundleIndex);
+  return room > reserve ? room - reserve : 0;
+}
+
+bool playlist_download(HTTPClient &https, uint32_t validFor)
+{
+  playlistStop(playlistCursor);
+
+  SpiffsFrameStorage storage;
+  removeBundle(storage);
+  int size = https.getSize();
+  if (size > 0 && (uint32_t)size > playlist_budget())
+  {
+    Log_error("Bundle of %d bytes doesn't fit, %u bytes are free for frames", size, playlist_budget());
+    return false;
+  }
+
+  // the writer holds the index with all frame names, keep it off the loop task stack
+  std::unique_ptr<BundleWriter> writer(new (std::nothrow) BundleWriter(storage, MAX_IMAGE_SIZE));
+  if (!writer)
+  {
+    Log_error("Not enough memory for the bundle writer");
+    return false;
+  }
+
+  SinkStream stream(*writer);
+  int result = https.writeToStream(&stream);
+  if (result < 0 || !writer->finish())
+  {
+    Log_error("Bundle download failed: %s", writer->error() ? writer->error() : HTTPClient::errorToString(result).c_str());
+    return false;
+  }
+
+  playlistStart(playlistCursor, writer->index().count, getTime(), validFor);
+  Log_info("Bundle stored: %d frames, %d bytes, valid for %u s", writer->index().count, result, validFor);
+  return true;
+}
+
+uint8_t *playlist_next_frame(BundleFrame &frame)
+{
+  int next = playlistNextFrame(playlistCursor, getTime());
+  if (next < 0)
+    return nullptr;
+
+  SpiffsFrameStorage storage;
+  BundleIndex index;
+  if (!loadBundleIndex(storage, index) || next >= index.count)
+  {
+    Log_error("Frame store has no bundle, going online");
+    playlistStop(playlistCursor);
+    return nullptr;
+  }
+
+  frame = index.frames[next];
+  uint8_t *image = (uint8_t *)malloc(frame.size);
+  if (!image)
+  {
+    Log_error("Failed to allocate %u bytes for frame %d", frame.size, next);
+    playlistStop(playlistCursor);
+    return nullptr;
+  }
+
+  char file[16];
+  bundleFrameFile(next, file, sizeof(file));
+  if (storage.read(file, image, frame.size) != frame.size)
+  {
+    Log_error("Frame %d is damaged, going online", next);
+    free(image);
+    playlistStop(playlistCursor);
+    return nullptr;
+  }
+
+  Log_info("Showing frame %d of %d (%s) without WiFi", next + 1, index.count, frame.name);
+  return image;
+}
+
+void playlist_stop(void)
+{
+  playlistStop(playlistCursor);
+}
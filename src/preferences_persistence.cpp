@@ -1,4 +1,3 @@
-
 #include <Preferences.h>
 #include <ArduinoLog.h>
 #include <preferences_persistence.h>
@@ -7,55 +6,88 @@ PreferencesPersistence::PreferencesPersistence(Preferences &preferences) : _pref
 
 bool PreferencesPersistence::recordExists(const char *key)
 {
+  _reads++;
   return _preferences.isKey(key);
 }
 
 String PreferencesPersistence::readString(const char *key, const String defaultValue)
 {
+  _reads++;
   return _preferences.getString(key, defaultValue);
 }
 
 uint32_t PreferencesPersistence::readUint(const char *key, const uint32_t defaultValue)
 {
+  _reads++;
   return _preferences.getUInt(key, defaultValue);
 }
 
 size_t PreferencesPersistence::writeUint(const char *key, const uint32_t value)
 {
+  _writes++;
   return _preferences.putUInt(key, value);
 }
 
+int32_t PreferencesPersistence::readInt(const char *key, const int32_t defaultValue)
+{
+  _reads++;
+  return _preferences.getInt(key, defaultValue);
+}
+
+size_t PreferencesPersistence::writeInt(const char *key, const int32_t value)
+{
+  _writes++;
+  return _preferences.putInt(key, value);
+}
+
 size_t PreferencesPersistence::writeString(const char *key, const char *value)
 {
+  _writes++;
   return _preferences.putString(key, value);
 }
 
 uint8_t PreferencesPersistence::readUChar(const char *key, const uint8_t defaultValue)
 {
+  _reads++;
   return _preferences.getUChar(key, defaultValue);
 }
 
 size_t PreferencesPersistence::writeUChar(const char *key, const uint8_t value)
 {
+  _writes++;
   return _preferences.putUChar(key, value);
 }
 
 bool PreferencesPersistence::readBool(const char *key, const bool defaultValue)
 {
+  _reads++;
   return _preferences.getBool(key, defaultValue);
 }
 
 size_t PreferencesPersistence::writeBool(const char *key, const bool value)
 {
+  _writes++;
   return _preferences.putBool(key, value);
 }
 
 bool PreferencesPersistence::clear()
 {
+  _writes++;
   return _preferences.clear();
 }
 
 bool PreferencesPersistence::remove(const char *key)
 {
+  _writes++;
   return _preferences.remove(key);
 }
+
+uint32_t PreferencesPersistence::readCount() const
+{
+  return _reads;
+}
+
+uint32_t PreferencesPersistence::writeCount() const
+{
+  return _writes;
+}
@@ -0,0 +1,77 @@
+#include <tile_delta.h>
+#include <config.h>
+#include <display.h>
+#include <filesystem.h>
+#include <sink_stream.h>
+#include <trmnl_log.h>
+
+/**
+ * Read the stored current image into a 1-bit frame; frame/pitch as in frameCrc().
+ * A stored BMP already is the frame, so it is read in place.
+ */
+static bool readCurrentFrame(uint8_t *bmp, int size, uint8_t *frame, int pitch)
+{
+  if (filesystem_file_exists("/current.bmp"))
+    return filesystem_read_from_file("/current.bmp", bmp, size) && bmp[0] == 'B' && bmp[1] == 'M';
+  if (!filesystem_file_exists("/current.png"))
+    return false;
+
+  int length = 0;
+  uint8_t *owned = nullptr;
+  uint8_t *image = display_map_file("/current.png", &length, &owned);
+  bool decoded = image && display_decode_frame(image, length, frame, pitch);
+  free(owned);
+  return decoded;
+}
+
+uint8_t *tile_delta_download(HTTPClient &https, int *size)
+{
+  FrameDeltaBuffer buffer(MAX_IMAGE_SIZE);
+  SinkStream stream(buffer);
+  int result = https.writeToStream(&stream);
+  if (result < 0)
+  {
+    Log_error("Frame delta download failed: %s", buffer.tooBig() ? "too big" : HTTPClient::errorToString(result).c_str());
+    return nullptr;
+  }
+
+  FrameDelta delta;
+  int width = display_width();
+  int height = display_height();
+  int pitch = width / 8;
+  const char *error = frameDeltaParse(buffer.data(), buffer.size(), width, height, delta);
+  if (!error && delta.baseCrc != display_frame_crc())
+    error = "it was made for another image";
+  // beyond this the full image is about as small, and the tiles need two copies in RAM
+  if (!error && frameDeltaArea(delta) > (uint32_t)width * height / 2)
+    error = "too much of the screen changed";
+  if (error)
+  {
+    Log_error("Frame delta not used: %s", error);
+    return nullptr;
+  }
+
+  // the patched frame is kept the same way a downloaded BMP is stored
+  *size = FRAME_BMP_HEADER_SIZE + pitch * height;
+  uint8_t *bmp = (uint8_t *)malloc(*size);
+  if (!bmp)
+  {
+    Log_error("Failed to allocate %d bytes for the frame delta", *size);
+    return nullptr;
+  }
+  uint8_t *frame = bmp + FRAME_BMP_HEADER_SIZE + (height - 1) * pitch; // top row of the bottom-up bitmap
+  if (!readCurrentFrame(bmp, *size, frame, -pitch))
+  {
+    Log_error("Frame delta not used: the current image can't be read");
+    free(bmp);
+    return nullptr;
+  }
+  if (!display_show_tiles(frame, -pitch, delta))
+  {
+    free(bmp);
+    return nullptr;
+  }
+  frameBmpHeader(bmp, width, height);
+  Log_info("Frame delta shown: %d tiles, %u of %d pixels in %d bytes", delta.count, frameDeltaArea(delta), width * height, (int)buffer.size());
+  return bmp;
+}
@@ -0,0 +1,60 @@
+#include <unity.h>
+#include <api_wake.h>
+
+void test_hostname_drops_scheme_port_and_slashes(void)
+{
+  FixedString<API_BASE_URL_SIZE> hostname;
+
+  apiHostname("https://usetrmnl.com", hostname);
+  TEST_ASSERT_EQUAL_STRING("usetrmnl.com", hostname.c_str());
+
+  apiHostname("http://192.168.1.10:2300/", hostname);
+  TEST_ASSERT_EQUAL_STRING("192.168.1.10", hostname.c_str());
+
+  apiHostname("byos.local", hostname);
+  TEST_ASSERT_EQUAL_STRING("byos.local", hostname.c_str());
+}
+
+void test_display_url_appends_the_endpoint(void)
+{
+  FixedString<API_DISPLAY_URL_SIZE> url;
+
+  apiDisplayUrl("https://usetrmnl.com", url);
+  TEST_ASSERT_EQUAL_STRING("https://usetrmnl.com/api/display", url.c_str());
+
+  apiDisplayUrl("http://192.168.1.10:2300", url);
+  TEST_ASSERT_EQUAL_STRING("http://192.168.1.10:2300/api/display", url.c_str());
+}
+
+void test_empty_state_keeps_the_filename(void)
+{
+  static ApiDisplayResponse response;
+  FixedString<API_DISPLAY_FILENAME_SIZE> filename = "plugin-1a2b";
+
+  response.filename = "empty_state";
+  TEST_ASSERT_FALSE(apiResponseFilename(response, filename));
+  TEST_ASSERT_EQUAL_STRING("plugin-1a2b", filename.c_str());
+
+  response.filename = "plugin-3c4d";
+  TEST_ASSERT_TRUE(apiResponseFilename(response, filename));
+  TEST_ASSERT_EQUAL_STRING("plugin-3c4d", filename.c_str());
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_hostname_drops_scheme_port_and_slashes);
+  RUN_TEST(test_display_url_appends_the_endpoint);
+  RUN_TEST(test_empty_state_keeps_the_filename);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
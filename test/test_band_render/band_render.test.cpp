@@ -0,0 +1,269 @@
+// Banded rendering of bb_epaper must send the same pixels to the panel as
+// drawing into a full back buffer and writing plane 0.
+#undef ARDUINO
+#include <unity.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the C core is compiled without its I/O layer, the panel is captured instead
+#define BB_EP_HOST_PANEL
+#include "../../lib/bb_epaper/host/bb_ep_host.h"
+
+#define WIDTH 800
+#define HEIGHT 480
+#define PITCH (WIDTH / 8)
+
+static uint8_t panel[PITCH * HEIGHT + 64]; // what was sent after the plane 0 write command
+static int panelLength;
+static uint8_t lastCommand;
+
+// same choice as bbepStartWrite(PLANE_0)
+static uint8_t plane0Command(BBEPDISP *pBBEP)
+{
+  if (pBBEP->chip_type != BBEP_CHIP_UC81xx)
+    return SSD1608_WRITE_RAM;
+  return (pBBEP->iFlags & BBEP_RED_SWAPPED) ? UC8151_DTM1 : UC8151_DTM2;
+}
+
+void bbepWriteCmd(BBEPDISP *pBBEP, uint8_t cmd)
+{
+  lastCommand = cmd;
+  if (cmd == plane0Command(pBBEP))
+    panelLength = 0;
+}
+void bbepWriteData(BBEPDISP *pBBEP, uint8_t *pData, int iLen)
+{
+  if (lastCommand != plane0Command(pBBEP))
+    return;
+  TEST_ASSERT_TRUE(panelLength + iLen <= (int)sizeof(panel));
+  memcpy(&panel[panelLength], pData, iLen);
+  memset(pData, 0x5a, iLen); // the SPI write on most targets overwrites the data
+  panelLength += iLen;
+}
+void bbepCMD2(BBEPDISP *pBBEP, uint8_t cmd1, uint8_t cmd2) { lastCommand = cmd1; }
+
+#include "../../lib/bb_epaper/src/bb_ep.inl"
+#include "../../lib/bb_epaper/src/bb_ep_gfx.inl"
+#include "../../lib/bb_epaper/src/g5enc.inl"
+#include "../../lib/bb_epaper/Fonts/nicoclean_8.h"
+#include "../../lib/bb_epaper/Fonts/Inter_18.h"
+#include "../../lib/bb_epaper/Fonts/Roboto_Black_24.h"
+#include "../../src/wifi_failed_qr.h"
+
+static BBEPDISP bbep;
+static uint8_t reference[PITCH * HEIGHT * 2];
+static uint32_t list[1024]; // 4 KB, word aligned
+
+// same as BBEPAPER::print(): one character at a time from the cursor
+static void print(const void *font, const char *text)
+{
+  char c[2] = {0, 0};
+  for (int i = 0; text[i]; i++)
+  {
+    c[0] = text[i];
+    bbepWriteStringCustom(&bbep, (void *)font, -1, -1, c, BBEP_BLACK, 0);
+  }
+}
+
+// a message screen plus every primitive that can be recorded
+static void drawScene(void)
+{
+  bbepFill(&bbep, BBEP_WHITE, PLANE_DUPLICATE);
+  bbep.iBG = BBEP_WHITE;
+  bbepLoadG5(&bbep, wifi_failed_qr, WIDTH - 66 - 40, 40, BBEP_WHITE, BBEP_BLACK, 1.0f);
+  bbepLoadG5(&bbep, wifi_failed_qr, WIDTH - (66 * 2) - 80, 300, BBEP_WHITE, BBEP_BLACK, 2.0f);
+  bbepWriteStringCustom(&bbep, (void *)Inter_18, CENTER_X, 200, (char *)"Can't establish WiFi connection.", BBEP_BLACK, 0);
+  bbepWriteStringCustom(&bbep, (void *)Roboto_Black_24, 10, 3, (char *)"Clipped at the top", BBEP_BLACK, 0);
+  bbep.iCursorX = 20;
+  bbep.iCursorY = 250;
+  print(nicoclean_8, "TRMNL firmware 1.6.0 - scan the QR code for help");
+  bbep.iBG = BBEP_TRANSPARENT;
+  bbep.iCursorX = 20;
+  bbep.iCursorY = 470;
+  print(Roboto_Black_24, "Bottom edge gjpqy");
+  bbepWriteStringCustom(&bbep, (void *)Inter_18, 740, 120, (char *)"Right edge", BBEP_BLACK, 0);
+  bbepRectangle(&bbep, 20, 20, 300, 60, BBEP_BLACK, 1);
+  bbepRectangle(&bbep, 40, 30, 280, 50, BBEP_WHITE, 1);
+  bbepRectangle(&bbep, 10, 100, 400, 180, BBEP_BLACK, 0);
+  bbepDrawLine(&bbep, 0, 0, WIDTH - 1, HEIGHT - 1, BBEP_BLACK);
+  bbepDrawLine(&bbep, 500, 10, 510, 470, BBEP_BLACK);
+  bbepEllipse(&bbep, 450, 400, 60, 30, 0xf, BBEP_BLACK, 1);
+  bbepEllipse(&bbep, 450, 400, 70, 40, 0xf, BBEP_BLACK, 0);
+  bbepRoundRect(&bbep, 30, 300, 200, 100, 12, BBEP_BLACK, 0);
+  for (int i = 0; i < 50; i++)
+    (*bbep.pfnSetPixel)(&bbep, 600 + i, 460 - i, BBEP_BLACK);
+}
+
+static void (*scene)(void) = drawScene;
+static uint8_t fullScreenG5[sizeof(BB_BITMAP) + PITCH * HEIGHT];
+
+// a full-screen G5 image (the usual server image) with some text drawn over it
+static void drawFullScreenImage(void)
+{
+  bbepFill(&bbep, BBEP_WHITE, PLANE_DUPLICATE);
+  bbepLoadG5(&bbep, fullScreenG5, 0, 0, BBEP_WHITE, BBEP_BLACK, 1.0f);
+  bbepWriteStringCustom(&bbep, (void *)Inter_18, 20, 240, (char *)"Offline since 10:42", BBEP_BLACK, 0);
+}
+
+static void encodeFullScreenImage(void)
+{
+  static uint8_t image[PITCH * HEIGHT];
+  G5ENCIMAGE g5enc;
+  BB_BITMAP header;
+
+  for (int y = 0; y < HEIGHT; y++)
+    for (int x = 0; x < PITCH; x++) // boxes, stripes and a gradient of dots
+      image[y * PITCH + x] = ((y / 40 + x / 10) & 1) ? 0xff : (uint8_t)(((y & 7) < x % 8) ? 0xaa >> (y & 1) : 0x0f);
+  TEST_ASSERT_EQUAL_INT(G5_SUCCESS, g5_encode_init(&g5enc, WIDTH, HEIGHT, &fullScreenG5[sizeof(header)], PITCH * HEIGHT));
+  for (int y = 0; y < HEIGHT; y++)
+    g5_encode_encodeLine(&g5enc, &image[y * PITCH]);
+  header.u16Marker = BB_BITMAP_MARKER;
+  header.width = WIDTH;
+  header.height = HEIGHT;
+  header.size = g5_encode_getOutSize(&g5enc);
+  memcpy(fullScreenG5, &header, sizeof(header));
+}
+
+static void renderReference(void)
+{
+  bbep.ucScreen = reference;
+  scene();
+  bbepWritePlane(&bbep, PLANE_0, 0);
+  TEST_ASSERT_EQUAL_INT(PITCH * HEIGHT, panelLength);
+  memcpy(reference, panel, PITCH * HEIGHT);
+  bbep.ucScreen = NULL;
+}
+
+static int bands;
+static int bandRows;
+
+static void countBand(void *user, int y, int height, uint8_t *rows)
+{
+  TEST_ASSERT_EQUAL_INT(bandRows, y);
+  TEST_ASSERT_EQUAL_MEMORY(&reference[y * PITCH], rows, height * PITCH);
+  bandRows += height;
+  bands++;
+}
+
+static void renderBands(int rows)
+{
+  uint8_t *strip = (uint8_t *)malloc(rows * PITCH);
+  TEST_ASSERT_EQUAL_INT(BBEP_SUCCESS, bbepBeginDisplayList(&bbep, (uint8_t *)list, sizeof(list)));
+  scene();
+  bands = bandRows = 0;
+  memset(panel, 0, sizeof(panel));
+  TEST_ASSERT_EQUAL_INT(BBEP_SUCCESS, bbepRenderDisplayList(&bbep, strip, rows * PITCH, countBand, NULL));
+  free(strip);
+
+  TEST_ASSERT_EQUAL_INT(HEIGHT, bandRows);
+  TEST_ASSERT_EQUAL_INT((HEIGHT + rows - 1) / rows, bands);
+  TEST_ASSERT_EQUAL_INT(PITCH * HEIGHT, panelLength);
+  TEST_ASSERT_EQUAL_MEMORY(reference, panel, PITCH * HEIGHT);
+}
+
+void test_single_row_strip(void) { renderBands(1); }
+
+void test_odd_strip(void) { renderBands(7); }
+
+void test_16_row_strip(void) { renderBands(16); }
+
+void test_whole_screen_strip(void) { renderBands(HEIGHT); }
+
+// the image keeps its decoder from band to band, with text drawn in between
+void test_full_screen_image(void)
+{
+  encodeFullScreenImage();
+  scene = drawFullScreenImage;
+  renderReference();
+  renderBands(16);
+  renderBands(7);
+  renderBands(1);
+  scene = drawScene;
+  renderReference();
+}
+
+void test_list_is_compact(void)
+{
+  TEST_ASSERT_EQUAL_INT(BBEP_SUCCESS, bbepBeginDisplayList(&bbep, (uint8_t *)list, sizeof(list)));
+  drawScene();
+  // the character-by-character text runs end up as one command each
+  TEST_ASSERT_TRUE(bbep.iListLen < 2048);
+  TEST_ASSERT_EQUAL_INT(BBEP_SUCCESS, bbep.iListError);
+  // nothing was drawn or sent while recording
+  TEST_ASSERT_EQUAL_INT(0, panelLength);
+  bbepRenderDisplayList(&bbep, NULL, 0, NULL, NULL);
+}
+
+void test_drawing_outside_the_list_still_works(void)
+{
+  uint8_t strip[PITCH * 8];
+  TEST_ASSERT_EQUAL_INT(BBEP_SUCCESS, bbepBeginDisplayList(&bbep, (uint8_t *)list, sizeof(list)));
+  drawScene();
+  bbepRenderDisplayList(&bbep, strip, sizeof(strip), NULL, NULL);
+
+  // the full buffer path is unaffected afterwards
+  renderReference();
+  renderBands(8);
+  TEST_ASSERT_NULL(bbep.pDisplayList);
+  TEST_ASSERT_EQUAL_INT(0, bbep.iBandH);
+  TEST_ASSERT_TRUE(bbep.pfnSetPixelFast == bbepSetPixelFast2Clr);
+}
+
+void test_list_overflow(void)
+{
+  uint8_t strip[PITCH * 8];
+  TEST_ASSERT_EQUAL_INT(BBEP_SUCCESS, bbepBeginDisplayList(&bbep, (uint8_t *)list, 256));
+  drawScene();
+  TEST_ASSERT_EQUAL_INT(BBEP_ERROR_NO_MEMORY, bbepRenderDisplayList(&bbep, strip, sizeof(strip), NULL, NULL));
+}
+
+void test_unsupported_drawing(void)
+{
+  uint8_t strip[PITCH * 8];
+  TEST_ASSERT_EQUAL_INT(BBEP_SUCCESS, bbepBeginDisplayList(&bbep, (uint8_t *)list, sizeof(list)));
+  bbepWriteString(&bbep, 0, 0, (char *)"built-in font", FONT_8x8, BBEP_BLACK, BBEP_WHITE);
+  TEST_ASSERT_EQUAL_INT(BBEP_ERROR_NOT_SUPPORTED, bbepRenderDisplayList(&bbep, strip, sizeof(strip), NULL, NULL));
+}
+
+void test_rejects_unsupported_panels(void)
+{
+  TEST_ASSERT_EQUAL_INT(BBEP_ERROR_BAD_PARAMETER, bbepBeginDisplayList(&bbep, (uint8_t *)list + 1, 64));
+  bbep.iFlags |= BBEP_3COLOR;
+  TEST_ASSERT_EQUAL_INT(BBEP_ERROR_NOT_SUPPORTED, bbepBeginDisplayList(&bbep, (uint8_t *)list, sizeof(list)));
+  bbep.iFlags &= ~BBEP_3COLOR;
+  TEST_ASSERT_NULL(bbep.pDisplayList);
+}
+
+void setUp(void)
+{
+  bbepSetPanelType(&bbep, EP75_800x480);
+  panelLength = 0;
+  lastCommand = 0;
+}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  bbepSetPanelType(&bbep, EP75_800x480);
+  renderReference();
+  RUN_TEST(test_single_row_strip);
+  RUN_TEST(test_odd_strip);
+  RUN_TEST(test_16_row_strip);
+  RUN_TEST(test_whole_screen_strip);
+  RUN_TEST(test_full_screen_image);
+  RUN_TEST(test_list_is_compact);
+  RUN_TEST(test_drawing_outside_the_list_still_works);
+  RUN_TEST(test_list_overflow);
+  RUN_TEST(test_unsupported_drawing);
+  RUN_TEST(test_rejects_unsupported_panels);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
@@ -103,6 +103,101 @@ void test_parseBMPHeader_BMP_INVALID_OFFSET(void)
   TEST_ASSERT_EQUAL(BMP_INVALID_OFFSET, parseBMPHeader(bmp_data.data(), image_reverse));
 }
 
+static void putLe32(std::vector<uint8_t> &out, size_t at, uint32_t value)
+{
+  for (int i = 0; i < 4; i++)
+    out[at + i] = (uint8_t)(value >> (i * 8));
+}
+
+// uncompressed BMP with a gray palette from black to white, pixel rows filled with their row number
+static std::vector<uint8_t> makeBMP(int width, int height, int bpp, uint32_t headerSize = 40)
+{
+  int colors = 1 << bpp;
+  uint32_t pitch = ((width * bpp + 31) / 32) * 4;
+  uint32_t rows = height > 0 ? height : -height;
+  uint32_t offset = 14 + headerSize + colors * 4;
+  std::vector<uint8_t> bmp(offset + pitch * rows, 0);
+  bmp[0] = 'B';
+  bmp[1] = 'M';
+  putLe32(bmp, 2, bmp.size());
+  putLe32(bmp, 10, offset);
+  putLe32(bmp, 14, headerSize);
+  putLe32(bmp, 18, width);
+  putLe32(bmp, 22, height);
+  bmp[26] = 1;
+  bmp[28] = bpp;
+  putLe32(bmp, 34, pitch * rows);
+  for (int i = 0; i < colors; i++)
+    memset(&bmp[14 + headerSize + i * 4], i * 255 / (colors - 1), 3);
+  for (uint32_t row = 0; row < rows; row++)
+    memset(&bmp[offset + row * pitch], row, pitch);
+  return bmp;
+}
+
+void test_parseBMPInfo_any_size_and_row_order(void)
+{
+  BmpInfo info;
+  std::vector<uint8_t> bmp = makeBMP(10, 3, 1);
+  TEST_ASSERT_EQUAL(BMP_NO_ERR, parseBMPInfo(bmp.data(), bmp.size(), info));
+  TEST_ASSERT_EQUAL_INT(10, info.width);
+  TEST_ASSERT_EQUAL_INT(3, info.height);
+  TEST_ASSERT_EQUAL_UINT8(1, info.bpp);
+  TEST_ASSERT_EQUAL_UINT32(4, info.pitch); // 2 bytes of pixels padded to 4
+  TEST_ASSERT_EQUAL_UINT32(62, info.offset);
+  TEST_ASSERT_TRUE(info.bottomUp);
+  TEST_ASSERT_FALSE(info.reversed);
+  TEST_ASSERT_EQUAL_UINT8(2, bmpRow(bmp.data(), info, 0)[0]); // the last row of the file is the top one
+  TEST_ASSERT_EQUAL_UINT8(0, bmpRow(bmp.data(), info, 2)[0]);
+
+  bmp = makeBMP(10, -3, 1);
+  TEST_ASSERT_EQUAL(BMP_NO_ERR, parseBMPInfo(bmp.data(), bmp.size(), info));
+  TEST_ASSERT_EQUAL_INT(3, info.height);
+  TEST_ASSERT_FALSE(info.bottomUp);
+  TEST_ASSERT_EQUAL_UINT8(0, bmpRow(bmp.data(), info, 0)[0]);
+  TEST_ASSERT_EQUAL_UINT8(2, bmpRow(bmp.data(), info, 2)[0]);
+}
+
+void test_parseBMPInfo_2bpp_and_v5_header(void)
+{
+  BmpInfo info;
+  std::vector<uint8_t> bmp = makeBMP(800, 480, 2, 124);
+  TEST_ASSERT_EQUAL(BMP_NO_ERR, parseBMPInfo(bmp.data(), bmp.size(), info));
+  TEST_ASSERT_EQUAL_UINT8(2, info.bpp);
+  TEST_ASSERT_EQUAL_UINT32(200, info.pitch);
+  TEST_ASSERT_EQUAL_UINT32(14 + 124 + 16, info.offset);
+  TEST_ASSERT_FALSE(info.reversed);
+
+  // white to black
+  for (int i = 0; i < 4; i++)
+    memset(&bmp[14 + 124 + i * 4], 255 - i * 85, 3);
+  TEST_ASSERT_EQUAL(BMP_NO_ERR, parseBMPInfo(bmp.data(), bmp.size(), info));
+  TEST_ASSERT_TRUE(info.reversed);
+
+  // grays out of order can't be sent to the EPD as they are
+  memset(&bmp[14 + 124 + 4], 0, 3);
+  TEST_ASSERT_EQUAL(BMP_COLOR_SCHEME_FAILED, parseBMPInfo(bmp.data(), bmp.size(), info));
+}
+
+void test_parseBMPInfo_rejects_what_it_cant_stream(void)
+{
+  BmpInfo info;
+  std::vector<uint8_t> bmp = makeBMP(16, 16, 1);
+  TEST_ASSERT_EQUAL(BMP_BAD_SIZE, parseBMPInfo(bmp.data(), bmp.size() - 1, info)); // truncated
+  TEST_ASSERT_EQUAL(BMP_NOT_BMP, parseBMPInfo(bmp.data(), 1, info));
+
+  std::vector<uint8_t> bad = makeBMP(16, 16, 4);
+  TEST_ASSERT_EQUAL(BMP_BAD_SIZE, parseBMPInfo(bad.data(), bad.size(), info));
+  bad = bmp;
+  bad[30] = 1; // RLE8
+  TEST_ASSERT_EQUAL(BMP_BAD_SIZE, parseBMPInfo(bad.data(), bad.size(), info));
+  bad = bmp;
+  putLe32(bad, 34, 16); // image data size smaller than the rows
+  TEST_ASSERT_EQUAL(BMP_BAD_SIZE, parseBMPInfo(bad.data(), bad.size(), info));
+  bad = bmp;
+  putLe32(bad, 10, 60); // pixels overlap the color table
+  TEST_ASSERT_EQUAL(BMP_INVALID_OFFSET, parseBMPInfo(bad.data(), bad.size(), info));
+}
+
 void setUp(void) {
   // set stuff up here
 }
@@ -120,6 +215,9 @@ void process()
   RUN_TEST(test_parseBMPHeader_BMP_BAD_SIZE);
   RUN_TEST(test_parseBMPHeader_BMP_COLOR_SCHEME_FAILED);
   RUN_TEST(test_parseBMPHeader_BMP_INVALID_OFFSET);
+  RUN_TEST(test_parseBMPInfo_any_size_and_row_order);
+  RUN_TEST(test_parseBMPInfo_2bpp_and_v5_header);
+  RUN_TEST(test_parseBMPInfo_rejects_what_it_cant_stream);
   UNITY_END();
 }
 
@@ -0,0 +1,89 @@
+#include <unity.h>
+#include <capabilities.h>
+#include <string.h>
+
+static DeviceCapabilities og(void)
+{
+  DeviceCapabilities caps;
+  memset(&caps, 0, sizeof(caps));
+  caps.flags = CAP_PNG | CAP_JPEG | CAP_BMP | CAP_G5 | CAP_RLE | CAP_G5_PLANES | CAP_PARTIAL | CAP_FRAME_DELTA | CAP_DISPLAY_LIST | CAP_BUNDLE | CAP_OVERLAY;
+  caps.planes = 2;
+  caps.cache = CAP_CACHE_CURRENT | CAP_CACHE_LAST;
+  caps.history = 4;
+  caps.maxImageBytes = 90000;
+  caps.freeHeap = 151000;
+  caps.maxAlloc = 110580;
+  caps.bundleBytes = 120000;
+  return caps;
+}
+
+void test_full_header(void)
+{
+  char header[CAPABILITIES_SIZE];
+  size_t length = capabilitiesHeader(og(), header, sizeof(header));
+  TEST_ASSERT_EQUAL_STRING("v=1;fmt=png,jpeg,bmp,g5,rle,g5gray;bytes=90000;heap=151000;alloc=110580;planes=2;"
+                           "feat=partial,delta,list,bundle,overlay;cache=current,last;history=4;bundle_bytes=120000",
+                           header);
+  TEST_ASSERT_EQUAL_UINT32(strlen(header), length);
+
+  // everything at its largest still fits
+  DeviceCapabilities caps = og();
+  caps.flags = 0xffff;
+  caps.cache = 0xff;
+  caps.history = 255;
+  caps.planes = 255;
+  caps.maxImageBytes = caps.freeHeap = caps.maxAlloc = caps.bundleBytes = 0xffffffff;
+  TEST_ASSERT_GREATER_THAN(0, capabilitiesHeader(caps, header, sizeof(header)));
+}
+
+void test_image_bytes_follow_the_heap(void)
+{
+  DeviceCapabilities caps = og();
+  TEST_ASSERT_EQUAL_UINT32(90000, capabilityImageBytes(caps));
+  caps.maxAlloc = 40000; // fragmented heap
+  TEST_ASSERT_EQUAL_UINT32(40000, capabilityImageBytes(caps));
+
+  char header[CAPABILITIES_SIZE];
+  capabilitiesHeader(caps, header, sizeof(header));
+  TEST_ASSERT_NOT_NULL(strstr(header, ";bytes=40000;"));
+}
+
+void test_empty_lists_are_left_out(void)
+{
+  DeviceCapabilities caps = og();
+  caps.flags = CAP_JPEG | CAP_G5;
+  caps.cache = 0;
+  caps.history = 0;
+  caps.planes = 4;
+  char header[CAPABILITIES_SIZE];
+  capabilitiesHeader(caps, header, sizeof(header));
+  TEST_ASSERT_EQUAL_STRING("v=1;fmt=jpeg,g5;bytes=90000;heap=151000;alloc=110580;planes=4", header);
+}
+
+void test_too_small_buffer(void)
+{
+  char header[32];
+  memset(header, 'x', sizeof(header));
+  TEST_ASSERT_EQUAL_UINT32(0, capabilitiesHeader(og(), header, sizeof(header)));
+  TEST_ASSERT_EQUAL_UINT32(0, capabilitiesHeader(og(), header, 0));
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_full_header);
+  RUN_TEST(test_image_bytes_follow_the_heap);
+  RUN_TEST(test_empty_lists_are_left_out);
+  RUN_TEST(test_too_small_buffer);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
@@ -0,0 +1,289 @@
+#include <unity.h>
+#include <display_list.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// writes down every call as one line of text
+class RecordingCanvas : public DisplayListCanvas
+{
+public:
+  std::string calls;
+
+  void clear(DisplayListColor color) override { add("clear %d", color); }
+
+  void text(DisplayListFont font, int x, int y, const char *text, DisplayListColor fg, DisplayListColor bg) override
+  {
+    add("text %d %d,%d '%s' %d/%d", font, x, y, text, fg, bg);
+  }
+
+  void rect(int x, int y, int w, int h, int r, DisplayListColor color, bool filled) override
+  {
+    add("rect %d,%d %dx%d r%d %d %d", x, y, w, h, r, color, filled);
+  }
+
+  void ellipse(int cx, int cy, int rx, int ry, DisplayListColor color, bool filled) override
+  {
+    add("ellipse %d,%d %dx%d %d %d", cx, cy, rx, ry, color, filled);
+  }
+
+  void line(int x1, int y1, int x2, int y2, DisplayListColor color) override
+  {
+    add("line %d,%d-%d,%d %d", x1, y1, x2, y2, color);
+  }
+
+  void sprite(const uint8_t *data, size_t size, int x, int y, int scale) override
+  {
+    // the test sprites carry their name as the G5 data
+    add("sprite %.*s %d,%d x%d", (int)(size - DISPLAY_LIST_SPRITE_HEADER_SIZE), (const char *)data + DISPLAY_LIST_SPRITE_HEADER_SIZE, x, y, scale);
+  }
+
+private:
+  void add(const char *format, ...) __attribute__((format(printf, 2, 3)))
+  {
+    char line[128];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    calls += line;
+    calls += "\n";
+  }
+};
+
+// builds a display list the way the server would
+struct ListBuilder
+{
+  std::vector<uint8_t> data;
+  std::vector<size_t> opStarts;
+
+  explicit ListBuilder(int width = 800, int height = 480, uint8_t strings = 0, uint8_t sprites = 0)
+  {
+    bytes("TRDL", 4);
+    u8(DISPLAY_LIST_VERSION);
+    u8(strings);
+    u8(sprites);
+    u8(0);
+    u16(width);
+    u16(height);
+  }
+
+  ListBuilder &u8(uint8_t value)
+  {
+    data.push_back(value);
+    return *this;
+  }
+
+  ListBuilder &u16(int value)
+  {
+    data.push_back(value & 0xff);
+    data.push_back((value >> 8) & 0xff);
+    return *this;
+  }
+
+  ListBuilder &bytes(const char *value, size_t length)
+  {
+    data.insert(data.end(), value, value + length);
+    return *this;
+  }
+
+  ListBuilder &op(DisplayListOp code)
+  {
+    opStarts.push_back(data.size());
+    return u8(code);
+  }
+
+  ListBuilder &string(const char *value) { return u8(strlen(value)).bytes(value, strlen(value)); }
+
+  // a BB_BITMAP header and value as the G5 data
+  ListBuilder &sprite(const char *value, int width = 66, int height = 66, int marker = DISPLAY_LIST_SPRITE_MARKER)
+  {
+    size_t size = strlen(value);
+    return u16(DISPLAY_LIST_SPRITE_HEADER_SIZE + size).u16(marker).u16(width).u16(height).u16(size).bytes(value, size);
+  }
+
+  const char *check() const { return displayListCheck(data.data(), data.size(), 800, 480); }
+};
+
+static ListBuilder sampleScreen()
+{
+  ListBuilder list(800, 480, 2, 2);
+  list.string("Weather").string("21\xc2\xb0");
+  list.sprite("G5:sun").sprite("G5:cloud");
+  list.op(DL_OP_CLEAR).u8(DL_WHITE);
+  list.op(DL_OP_TEXT).u8(DL_FONT_LARGE).u8(DL_BLACK).u8(DL_TRANSPARENT).u16(DISPLAY_LIST_CENTER).u16(40).u8(0);
+  list.op(DL_OP_TEXT).u8(DL_FONT_SMALL).u8(DL_WHITE).u8(DL_BLACK).u16(-5).u16(470).u8(1);
+  list.op(DL_OP_RECT).u16(10).u16(20).u16(300).u16(60).u8(DL_BLACK).u8(0);
+  list.op(DL_OP_ROUND_RECT).u16(30).u16(300).u16(200).u16(100).u16(12).u8(DL_WHITE).u8(1);
+  list.op(DL_OP_ELLIPSE).u16(450).u16(400).u16(60).u16(30).u8(DL_BLACK).u8(1);
+  list.op(DL_OP_LINE).u16(0).u16(0).u16(799).u16(479).u8(DL_BLACK);
+  list.op(DL_OP_SPRITE).u8(1).u16(600).u16(100).u8(2);
+  return list;
+}
+
+void test_draws_every_op_in_order(void)
+{
+  ListBuilder list = sampleScreen();
+  TEST_ASSERT_NULL(list.check());
+
+  RecordingCanvas canvas;
+  displayListDraw(list.data.data(), list.data.size(), canvas);
+  TEST_ASSERT_EQUAL_STRING("clear 1\n"
+                           "text 2 32767,40 'Weather' 0/2\n"
+                           "text 0 -5,470 '21\xc2\xb0' 1/0\n"
+                           "rect 10,20 300x60 r0 0 0\n"
+                           "rect 30,300 200x100 r12 1 1\n"
+                           "ellipse 450,400 60x30 0 1\n"
+                           "line 0,0-799,479 0\n"
+                           "sprite G5:cloud 600,100 x2\n",
+                           canvas.calls.c_str());
+}
+
+void test_typical_screen_is_small(void)
+{
+  // a few hundred bytes at most, instead of a 48K bitmap
+  TEST_ASSERT_TRUE(sampleScreen().data.size() < 144);
+}
+
+void test_empty_list_is_valid(void)
+{
+  ListBuilder list;
+  TEST_ASSERT_NULL(list.check());
+
+  RecordingCanvas canvas;
+  displayListDraw(list.data.data(), list.data.size(), canvas);
+  TEST_ASSERT_EQUAL_STRING("", canvas.calls.c_str());
+}
+
+void test_rejects_bad_headers(void)
+{
+  ListBuilder list;
+  TEST_ASSERT_EQUAL_STRING("Not a display list", displayListCheck(list.data.data(), DISPLAY_LIST_HEADER_SIZE - 1, 800, 480));
+
+  list.data[0] = 'X';
+  TEST_ASSERT_EQUAL_STRING("Not a display list", list.check());
+
+  ListBuilder version;
+  version.data[4] = DISPLAY_LIST_VERSION + 1;
+  TEST_ASSERT_EQUAL_STRING("Unsupported display list version", version.check());
+
+  ListBuilder small(400, 300);
+  TEST_ASSERT_EQUAL_STRING("Display list is for another screen size", small.check());
+}
+
+void test_rejects_short_tables(void)
+{
+  ListBuilder strings(800, 480, 2, 0);
+  strings.string("one").u8(10).bytes("short", 5);
+  TEST_ASSERT_EQUAL_STRING("String table is cut short", strings.check());
+
+  ListBuilder sprites(800, 480, 0, 1);
+  sprites.u8(0xff);
+  TEST_ASSERT_EQUAL_STRING("Sprite table is cut short", sprites.check());
+}
+
+void test_rejects_bad_ops(void)
+{
+  ListBuilder unknown;
+  unknown.u8(0x7f);
+  TEST_ASSERT_EQUAL_STRING("Unknown display list op", unknown.check());
+
+  ListBuilder cut;
+  cut.op(DL_OP_LINE).u16(0).u16(0).u16(10);
+  TEST_ASSERT_EQUAL_STRING("Display list op is cut short", cut.check());
+
+  ListBuilder color;
+  color.op(DL_OP_LINE).u16(0).u16(0).u16(10).u16(10).u8(DL_TRANSPARENT);
+  TEST_ASSERT_EQUAL_STRING("Bad color", color.check());
+
+  ListBuilder string(800, 480, 1, 0);
+  string.string("only");
+  string.op(DL_OP_TEXT).u8(DL_FONT_SMALL).u8(DL_BLACK).u8(DL_WHITE).u16(0).u16(0).u8(1);
+  TEST_ASSERT_EQUAL_STRING("String index out of range", string.check());
+
+  ListBuilder font;
+  font.op(DL_OP_TEXT).u8(DL_FONT_COUNT).u8(DL_BLACK).u8(DL_WHITE).u16(0).u16(0).u8(0);
+  TEST_ASSERT_EQUAL_STRING("Unknown font", font.check());
+
+  ListBuilder sprite(800, 480, 0, 1);
+  sprite.sprite("G5");
+  sprite.op(DL_OP_SPRITE).u8(0).u16(0).u16(0).u8(5);
+  TEST_ASSERT_EQUAL_STRING("Bad sprite scale", sprite.check());
+
+  ListBuilder rect;
+  rect.op(DL_OP_RECT).u16(0).u16(0).u16(-1).u16(10).u8(DL_BLACK).u8(1);
+  TEST_ASSERT_EQUAL_STRING("Bad rectangle", rect.check());
+}
+
+void test_rejects_bad_sprites(void)
+{
+  ListBuilder shortEntry(800, 480, 0, 1);
+  shortEntry.u16(6).u16(DISPLAY_LIST_SPRITE_MARKER).u16(66).u16(66);
+  TEST_ASSERT_EQUAL_STRING("Sprite is not a G5 image", shortEntry.check());
+
+  ListBuilder marker(800, 480, 0, 1);
+  marker.sprite("G5", 66, 66, 0x1234);
+  TEST_ASSERT_EQUAL_STRING("Sprite is not a G5 image", marker.check());
+
+  // the header claims more G5 data than the entry holds
+  ListBuilder size(800, 480, 0, 2);
+  size.u16(DISPLAY_LIST_SPRITE_HEADER_SIZE + 2).u16(DISPLAY_LIST_SPRITE_MARKER).u16(66).u16(66).u16(200).bytes("G5", 2);
+  size.sprite("next");
+  TEST_ASSERT_EQUAL_STRING("Sprite data is cut short", size.check());
+
+  ListBuilder wide(800, 480, 0, 1);
+  wide.sprite("G5", 801, 10);
+  TEST_ASSERT_EQUAL_STRING("Bad sprite size", wide.check());
+
+  ListBuilder empty(800, 480, 0, 1);
+  empty.sprite("G5", 0, 10);
+  TEST_ASSERT_EQUAL_STRING("Bad sprite size", empty.check());
+
+  ListBuilder fits(800, 480, 0, 1);
+  fits.sprite("G5", 800, 480);
+  TEST_ASSERT_NULL(fits.check());
+}
+
+void test_cut_inside_a_table_or_op_is_rejected(void)
+{
+  ListBuilder list = sampleScreen();
+  // cutting the list anywhere inside a table or an op must not read past the end
+  for (size_t size = 0; size < list.data.size(); size++)
+  {
+    std::vector<uint8_t> cut(list.data.begin(), list.data.begin() + size);
+    const char *error = displayListCheck(cut.data(), cut.size(), 800, 480);
+    bool opBoundary = false;
+    for (size_t start : list.opStarts)
+      opBoundary |= start == size;
+    if (opBoundary)
+      TEST_ASSERT_NULL_MESSAGE(error, "op boundary");
+    else
+      TEST_ASSERT_NOT_NULL_MESSAGE(error, "inside a table or op");
+  }
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_draws_every_op_in_order);
+  RUN_TEST(test_typical_screen_is_small);
+  RUN_TEST(test_empty_list_is_valid);
+  RUN_TEST(test_rejects_bad_headers);
+  RUN_TEST(test_rejects_short_tables);
+  RUN_TEST(test_rejects_bad_ops);
+  RUN_TEST(test_rejects_bad_sprites);
+  RUN_TEST(test_cut_inside_a_table_or_op_is_rejected);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
@@ -0,0 +1,220 @@
+#include <unity.h>
+#include <fixed_string.h>
+#include <api_types.h>
+#include <api_display_parser.h>
+#include <api_wake.h>
+#include <new>
+#include <stdlib.h>
+
+static size_t allocationCount = 0;
+
+void *operator new(size_t size)
+{
+  allocationCount++;
+  void *p = malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+  free(p);
+}
+
+#if defined(__GLIBC__)
+// String allocates with malloc/realloc, so count those too where the libc lets us
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_realloc(void *p, size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void __libc_free(void *p);
+
+extern "C" void *malloc(size_t size)
+{
+  allocationCount++;
+  return __libc_malloc(size);
+}
+
+extern "C" void *realloc(void *p, size_t size)
+{
+  allocationCount++;
+  return __libc_realloc(p, size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+  allocationCount++;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void free(void *p)
+{
+  __libc_free(p);
+}
+#endif
+
+void test_assign_and_compare()
+{
+  FixedString<16> s = "hello";
+  TEST_ASSERT_EQUAL_STRING("hello", s.c_str());
+  TEST_ASSERT_EQUAL(5, s.length());
+  TEST_ASSERT_TRUE(s == "hello");
+  TEST_ASSERT_TRUE("hello" == s);
+  TEST_ASSERT_TRUE(s != "world");
+  TEST_ASSERT_TRUE(s.equals("hello"));
+  TEST_ASSERT_FALSE(s.isEmpty());
+
+  FixedString<32> other = s.c_str();
+  TEST_ASSERT_TRUE(s == other);
+
+  s.clear();
+  TEST_ASSERT_TRUE(s.isEmpty());
+  TEST_ASSERT_TRUE(s == "");
+}
+
+void test_assign_truncates_to_capacity()
+{
+  FixedString<6> s;
+  TEST_ASSERT_EQUAL(5, s.capacity());
+  TEST_ASSERT_FALSE(s.assign("too long"));
+  TEST_ASSERT_EQUAL_STRING("too l", s.c_str());
+  TEST_ASSERT_TRUE(s.assign("fits!"));
+  TEST_ASSERT_EQUAL_STRING("fits!", s.c_str());
+}
+
+void test_concat()
+{
+  FixedString<24> s = "wifi_";
+  s += 3;
+  s += '_';
+  s += "ssid";
+  TEST_ASSERT_EQUAL_STRING("wifi_3_ssid", s.c_str());
+
+  s.assign("rate=");
+  s.concat(900u);
+  TEST_ASSERT_EQUAL_STRING("rate=900", s.c_str());
+
+  FixedString<8> small = "1234";
+  TEST_ASSERT_FALSE(small.concat("5678"));
+  TEST_ASSERT_EQUAL_STRING("1234567", small.c_str());
+}
+
+void test_search()
+{
+  FixedString<64> s = "https://usetrmnl.com/api/display";
+  TEST_ASSERT_TRUE(s.startsWith("https://"));
+  TEST_ASSERT_TRUE(s.endsWith("/display"));
+  TEST_ASSERT_FALSE(s.endsWith("https://usetrmnl.com/api/display/longer"));
+  TEST_ASSERT_EQUAL(5, s.indexOf(':'));
+  TEST_ASSERT_EQUAL(20, s.indexOf("/api"));
+  TEST_ASSERT_EQUAL(-1, s.indexOf('#'));
+  TEST_ASSERT_EQUAL(24, s.indexOf('/', 21));
+}
+
+void test_replace_and_remove()
+{
+  FixedString<64> s = "http://localhost:2300/";
+  s.replace("https://", "");
+  s.replace("http://", "");
+  s.replace("/", "");
+  TEST_ASSERT_EQUAL_STRING("localhost:2300", s.c_str());
+
+  s.remove(s.indexOf(':'));
+  TEST_ASSERT_EQUAL_STRING("localhost", s.c_str());
+
+  s.remove(0, 5);
+  TEST_ASSERT_EQUAL_STRING("host", s.c_str());
+
+  FixedString<12> grow = "a\"b\"c";
+  TEST_ASSERT_TRUE(grow.replace("\"", "\\\""));
+  TEST_ASSERT_EQUAL_STRING("a\\\"b\\\"c", grow.c_str());
+  TEST_ASSERT_FALSE(grow.replace("a", "aaaaaaa"));
+}
+
+void test_interop_with_string()
+{
+  String str = "network";
+  FixedString<16> s = str;
+  TEST_ASSERT_TRUE(s == str);
+  TEST_ASSERT_TRUE(str == s);
+
+  s = String("other");
+  TEST_ASSERT_EQUAL_STRING("other", s.c_str());
+}
+
+static const char *recordedResponse = "{\"status\":0,\"image_url\":\"https://usetrmnl.com/plugin-1a2b.bmp\",\"filename\":\"plugin-1a2b\",\"refresh_rate\":900,\"reset_firmware\":false,\"update_firmware\":false,\"firmware_url\":null,\"special_function\":\"none\",\"temperature_profile\":\"default\"}";
+
+// the string handling of every wake (bl.cpp and fetchApiDisplay()), from the stored settings to the new filename
+static void simulateWake(ApiDisplayInputs &inputs, ApiDisplayResponse &response, FixedString<API_DISPLAY_FILENAME_SIZE> &newFilename)
+{
+  const char *storedUrl = "https://usetrmnl.com";
+
+  inputs.baseUrl = storedUrl;
+  inputs.apiKey = "abcdefghijklmnopqrstuvwx";
+  inputs.friendlyId = "A1B2C3";
+  inputs.macAddress = "AA:BB:CC:DD:EE:FF";
+  inputs.firmwareVersion = "1.6.9";
+  inputs.model = "og";
+
+  FixedString<API_BASE_URL_SIZE> hostname;
+  apiHostname(storedUrl, hostname);
+
+  FixedString<API_DISPLAY_URL_SIZE> url;
+  apiDisplayUrl(inputs.baseUrl.c_str(), url);
+
+  ApiDisplayParser parser(response);
+  parser.feed(recordedResponse, strlen(recordedResponse));
+  parser.finish();
+
+  apiResponseFilename(response, newFilename);
+}
+
+void test_wake_path_does_not_allocate()
+{
+  static ApiDisplayInputs inputs;
+  static ApiDisplayResponse response;
+  static FixedString<API_DISPLAY_FILENAME_SIZE> newFilename;
+
+  simulateWake(inputs, response, newFilename); // warm-up (first log line etc.)
+
+  size_t before = allocationCount;
+  simulateWake(inputs, response, newFilename);
+  size_t allocations = allocationCount - before;
+
+  TEST_ASSERT_EQUAL(0, allocations);
+  TEST_ASSERT_EQUAL_STRING("plugin-1a2b", newFilename.c_str());
+  TEST_ASSERT_EQUAL(900, response.refresh_rate);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_assign_and_compare);
+  RUN_TEST(test_assign_truncates_to_capacity);
+  RUN_TEST(test_concat);
+  RUN_TEST(test_search);
+  RUN_TEST(test_replace_and_remove);
+  RUN_TEST(test_interop_with_string);
+  RUN_TEST(test_wake_path_does_not_allocate);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
@@ -0,0 +1,255 @@
+#include <unity.h>
+#include <frame_bundle.h>
+#include <stdint.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// SPIFFS stand-in
+class MemoryStorage : public FrameStorage
+{
+public:
+  std::map<std::string, std::vector<uint8_t>> files;
+  std::string open;
+  size_t failAppendAfter = SIZE_MAX;
+
+  bool create(const char *name) override
+  {
+    open = name;
+    files[open].clear();
+    return true;
+  }
+
+  bool append(const uint8_t *data, size_t length) override
+  {
+    if (open.empty() || length > failAppendAfter)
+      return false;
+    failAppendAfter -= length;
+    files[open].insert(files[open].end(), data, data + length);
+    return true;
+  }
+
+  void close() override { open.clear(); }
+
+  size_t read(const char *name, uint8_t *buffer, size_t size) override
+  {
+    auto it = files.find(name);
+    if (it == files.end())
+      return 0;
+    size_t n = it->second.size() < size ? it->second.size() : size;
+    memcpy(buffer, it->second.data(), n);
+    return n;
+  }
+
+  bool remove(const char *name) override { return files.erase(name) > 0; }
+};
+
+struct TestFrame
+{
+  std::string name;
+  uint32_t duration;
+  std::vector<uint8_t> data;
+};
+
+static void putLe32(std::vector<uint8_t> &out, uint32_t value)
+{
+  for (int i = 0; i < 4; i++)
+    out.push_back((uint8_t)(value >> (8 * i)));
+}
+
+static std::vector<uint8_t> makeBundle(const std::vector<TestFrame> &frames)
+{
+  std::vector<uint8_t> out = {'T', 'R', 'B', '1', (uint8_t)frames.size(), 0, 0, 0};
+  for (const TestFrame &frame : frames)
+  {
+    putLe32(out, frame.data.size());
+    putLe32(out, frame.duration);
+    out.push_back((uint8_t)frame.name.size());
+    out.insert(out.end(), frame.name.begin(), frame.name.end());
+    out.insert(out.end(), frame.data.begin(), frame.data.end());
+  }
+  return out;
+}
+
+static std::vector<TestFrame> makeFrames(size_t count)
+{
+  std::vector<TestFrame> frames;
+  for (size_t i = 0; i < count; i++)
+  {
+    TestFrame frame;
+    frame.name = "plugin-" + std::to_string(i) + ".png";
+    frame.duration = 300 + i * 60;
+    frame.data.resize(1000 + i * 777);
+    for (size_t j = 0; j < frame.data.size(); j++)
+      frame.data[j] = (uint8_t)(j * 7 + i);
+    frames.push_back(frame);
+  }
+  return frames;
+}
+
+// feed the way an HTTP stream does, in uneven pieces
+static bool feed(BundleWriter &writer, const std::vector<uint8_t> &bundle, size_t chunk)
+{
+  for (size_t offset = 0; offset < bundle.size(); offset += chunk)
+  {
+    size_t n = bundle.size() - offset < chunk ? bundle.size() - offset : chunk;
+    if (!writer.write(bundle.data() + offset, n))
+      return false;
+  }
+  return true;
+}
+
+void test_bundle_is_split_into_frame_files(void)
+{
+  std::vector<TestFrame> frames = makeFrames(3);
+  std::vector<uint8_t> bundle = makeBundle(frames);
+
+  const size_t chunks[] = {1, 7, 1460, bundle.size()};
+  for (size_t chunk : chunks)
+  {
+    MemoryStorage storage;
+    BundleWriter writer(storage, 48000);
+    TEST_ASSERT_TRUE(feed(writer, bundle, chunk));
+    TEST_ASSERT_TRUE(writer.finish());
+
+    BundleIndex index;
+    TEST_ASSERT_TRUE(loadBundleIndex(storage, index));
+    TEST_ASSERT_EQUAL_UINT8(3, index.count);
+    for (uint8_t i = 0; i < 3; i++)
+    {
+      char file[16];
+      bundleFrameFile(i, file, sizeof(file));
+      TEST_ASSERT_EQUAL_STRING(frames[i].name.c_str(), index.frames[i].name);
+      TEST_ASSERT_EQUAL_UINT32(frames[i].duration, index.frames[i].duration);
+      TEST_ASSERT_EQUAL_UINT32(frames[i].data.size(), index.frames[i].size);
+      TEST_ASSERT_TRUE(storage.files[file] == frames[i].data);
+    }
+  }
+}
+
+void test_truncated_bundle_leaves_no_index(void)
+{
+  std::vector<uint8_t> bundle = makeBundle(makeFrames(4));
+  bundle.resize(bundle.size() - 10);
+
+  MemoryStorage storage;
+  BundleWriter writer(storage, 48000);
+  TEST_ASSERT_TRUE(feed(writer, bundle, 512));
+  TEST_ASSERT_FALSE(writer.finish());
+  TEST_ASSERT_EQUAL_STRING("Bundle is incomplete", writer.error());
+  TEST_ASSERT_EQUAL(0, storage.files.size());
+
+  BundleIndex index;
+  TEST_ASSERT_FALSE(loadBundleIndex(storage, index));
+}
+
+void test_failed_download_invalidates_previous_bundle(void)
+{
+  MemoryStorage storage;
+  {
+    BundleWriter writer(storage, 48000);
+    TEST_ASSERT_TRUE(feed(writer, makeBundle(makeFrames(2)), 100));
+    TEST_ASSERT_TRUE(writer.finish());
+  }
+
+  // SPIFFS fills up half way through the next bundle
+  storage.failAppendAfter = 2000;
+  BundleWriter writer(storage, 48000);
+  TEST_ASSERT_FALSE(feed(writer, makeBundle(makeFrames(3)), 100));
+  TEST_ASSERT_FALSE(writer.finish());
+  TEST_ASSERT_EQUAL_STRING("Failed to write frame file", writer.error());
+
+  BundleIndex index;
+  TEST_ASSERT_FALSE(loadBundleIndex(storage, index));
+}
+
+void test_rejects_bad_containers(void)
+{
+  BundleIndex index;
+
+  std::vector<uint8_t> bundle = makeBundle(makeFrames(1));
+  bundle[0] = 'X';
+  MemoryStorage storage;
+  BundleWriter notBundle(storage, 48000);
+  TEST_ASSERT_FALSE(feed(notBundle, bundle, 64));
+  TEST_ASSERT_EQUAL_STRING("Not a frame bundle", notBundle.error());
+
+  BundleWriter tooMany(storage, 48000);
+  TEST_ASSERT_FALSE(feed(tooMany, makeBundle(makeFrames(BUNDLE_MAX_FRAMES + 1)), 64));
+  TEST_ASSERT_EQUAL_STRING("Frame count out of range", tooMany.error());
+
+  BundleWriter tooBig(storage, 1500);
+  TEST_ASSERT_FALSE(feed(tooBig, makeBundle(makeFrames(2)), 64));
+  TEST_ASSERT_EQUAL_STRING("Frame size out of range", tooBig.error());
+  TEST_ASSERT_FALSE(tooBig.finish());
+  TEST_ASSERT_FALSE(loadBundleIndex(storage, index));
+
+  bundle = makeBundle(makeFrames(1));
+  bundle.push_back(0);
+  BundleWriter trailing(storage, 48000);
+  TEST_ASSERT_FALSE(feed(trailing, bundle, 64));
+  TEST_ASSERT_EQUAL_STRING("Trailing data after bundle", trailing.error());
+}
+
+void test_playlist_steps_through_frames(void)
+{
+  PlaylistCursor cursor;
+  playlistStart(cursor, 3, 1700000000, 0);
+
+  TEST_ASSERT_EQUAL(0, playlistNextFrame(cursor, 1700000300));
+  TEST_ASSERT_EQUAL(1, playlistNextFrame(cursor, 1700000600));
+  TEST_ASSERT_EQUAL(2, playlistNextFrame(cursor, 1700000900));
+  TEST_ASSERT_EQUAL(-1, playlistNextFrame(cursor, 1700001200));
+  TEST_ASSERT_EQUAL(-1, playlistNextFrame(cursor, 1700001500));
+}
+
+void test_playlist_expires(void)
+{
+  PlaylistCursor cursor;
+  playlistStart(cursor, 8, 1700000000, 1800);
+
+  TEST_ASSERT_EQUAL(0, playlistNextFrame(cursor, 1700000600));
+  TEST_ASSERT_EQUAL(1, playlistNextFrame(cursor, 1700001200));
+  TEST_ASSERT_EQUAL(-1, playlistNextFrame(cursor, 1700001800));
+  TEST_ASSERT_EQUAL(-1, playlistNextFrame(cursor, 1700000000));
+
+  // without a synced clock only the frame count limits the playlist
+  playlistStart(cursor, 1, 0, 1800);
+  TEST_ASSERT_EQUAL(0, playlistNextFrame(cursor, 1700009999));
+}
+
+void test_playlist_rejects_uninitialised_cursor(void)
+{
+  // RTC memory after power-on
+  PlaylistCursor cursor;
+  memset(&cursor, 0xa5, sizeof(cursor));
+  TEST_ASSERT_EQUAL(-1, playlistNextFrame(cursor, 0));
+
+  playlistStart(cursor, 2, 0, 0);
+  playlistStop(cursor);
+  TEST_ASSERT_EQUAL(-1, playlistNextFrame(cursor, 0));
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_bundle_is_split_into_frame_files);
+  RUN_TEST(test_truncated_bundle_leaves_no_index);
+  RUN_TEST(test_failed_download_invalidates_previous_bundle);
+  RUN_TEST(test_rejects_bad_containers);
+  RUN_TEST(test_playlist_steps_through_frames);
+  RUN_TEST(test_playlist_expires);
+  RUN_TEST(test_playlist_rejects_uninitialised_cursor);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
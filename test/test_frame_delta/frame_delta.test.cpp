@@ -0,0 +1,228 @@
+#include <unity.h>
+#include <frame_delta.h>
+#include <bmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#define WIDTH 800
+#define HEIGHT 480
+#define PITCH (WIDTH / 8)
+
+struct TestTile
+{
+  uint16_t x, y, w, h;
+  uint8_t encoding;
+  std::vector<uint8_t> data;
+};
+
+static void putLe16(std::vector<uint8_t> &out, uint16_t value)
+{
+  out.push_back(value & 0xff);
+  out.push_back(value >> 8);
+}
+
+static void putLe32(std::vector<uint8_t> &out, uint32_t value)
+{
+  putLe16(out, value & 0xffff);
+  putLe16(out, value >> 16);
+}
+
+static std::vector<uint8_t> makeDelta(const std::vector<TestTile> &tiles, uint32_t baseCrc = 0x11223344, uint32_t resultCrc = 0x55667788)
+{
+  std::vector<uint8_t> out = {'T', 'R', 'F', 'D', DELTA_VERSION, (uint8_t)tiles.size(), 0, 0};
+  putLe16(out, WIDTH);
+  putLe16(out, HEIGHT);
+  putLe32(out, baseCrc);
+  putLe32(out, resultCrc);
+  for (const TestTile &tile : tiles)
+  {
+    putLe16(out, tile.x);
+    putLe16(out, tile.y);
+    putLe16(out, tile.w);
+    putLe16(out, tile.h);
+    putLe32(out, tile.data.size());
+    out.push_back(tile.encoding);
+    out.insert(out.end(), 3, 0);
+    out.insert(out.end(), tile.data.begin(), tile.data.end());
+  }
+  return out;
+}
+
+static const char *parse(const std::vector<uint8_t> &data, FrameDelta &delta)
+{
+  return frameDeltaParse(data.data(), data.size(), WIDTH, HEIGHT, delta);
+}
+
+void test_parses_tiles(void)
+{
+  std::vector<TestTile> tiles = {
+      {640, 8, 152, 40, DELTA_TILE_G5, {1, 2, 3}},
+      {0, 400, 800, 80, DELTA_TILE_PNG, {4, 5, 6, 7, 8}},
+  };
+  std::vector<uint8_t> data = makeDelta(tiles);
+  FrameDelta delta;
+  TEST_ASSERT_NULL(parse(data, delta));
+
+  TEST_ASSERT_EQUAL_UINT8(2, delta.count);
+  TEST_ASSERT_EQUAL_HEX32(0x11223344, delta.baseCrc);
+  TEST_ASSERT_EQUAL_HEX32(0x55667788, delta.resultCrc);
+  TEST_ASSERT_EQUAL_UINT16(640, delta.tiles[0].x);
+  TEST_ASSERT_EQUAL_UINT16(8, delta.tiles[0].y);
+  TEST_ASSERT_EQUAL_UINT16(152, delta.tiles[0].w);
+  TEST_ASSERT_EQUAL_UINT16(40, delta.tiles[0].h);
+  TEST_ASSERT_EQUAL_UINT8(DELTA_TILE_G5, delta.tiles[0].encoding);
+  TEST_ASSERT_EQUAL_UINT32(3, delta.tiles[0].size);
+  TEST_ASSERT_EQUAL_UINT8(1, delta.tiles[0].data[0]);
+  TEST_ASSERT_EQUAL_UINT8(DELTA_TILE_PNG, delta.tiles[1].encoding);
+  TEST_ASSERT_EQUAL_UINT32(5, delta.tiles[1].size);
+  TEST_ASSERT_EQUAL_UINT8(8, delta.tiles[1].data[4]);
+
+  TEST_ASSERT_EQUAL_UINT32(152 * 40 + 800 * 80, frameDeltaArea(delta));
+}
+
+void test_rejects_bad_deltas(void)
+{
+  FrameDelta delta;
+  TestTile ok = {8, 8, 16, 16, DELTA_TILE_G5, {1}};
+
+  std::vector<uint8_t> data = makeDelta({ok});
+  data[0] = 'X';
+  TEST_ASSERT_EQUAL_STRING("Not a frame delta", parse(data, delta));
+  TEST_ASSERT_EQUAL_STRING("Not a frame delta", frameDeltaParse(data.data(), 10, WIDTH, HEIGHT, delta));
+
+  data = makeDelta({ok});
+  data[4] = 2;
+  TEST_ASSERT_EQUAL_STRING("Unsupported frame delta version", parse(data, delta));
+  data = makeDelta({ok});
+  TEST_ASSERT_EQUAL_STRING("Frame delta is for another screen size", frameDeltaParse(data.data(), data.size(), 480, 800, delta));
+  TEST_ASSERT_EQUAL_STRING("Bad number of tiles", parse(makeDelta({}), delta));
+  TEST_ASSERT_EQUAL_STRING("Bad number of tiles", parse(makeDelta(std::vector<TestTile>(DELTA_MAX_TILES + 1, ok)), delta));
+
+  TestTile tile = ok;
+  tile.x = 4;
+  TEST_ASSERT_EQUAL_STRING("Tile is not byte aligned", parse(makeDelta({tile}), delta));
+  tile = ok;
+  tile.w = 12;
+  TEST_ASSERT_EQUAL_STRING("Tile is not byte aligned", parse(makeDelta({tile}), delta));
+  tile = ok;
+  tile.y = 470;
+  TEST_ASSERT_EQUAL_STRING("Tile is off the screen", parse(makeDelta({tile}), delta));
+  tile = ok;
+  tile.h = 0;
+  TEST_ASSERT_EQUAL_STRING("Tile is off the screen", parse(makeDelta({tile}), delta));
+  tile = ok;
+  tile.encoding = 7;
+  TEST_ASSERT_EQUAL_STRING("Unknown tile encoding", parse(makeDelta({tile}), delta));
+  tile = ok;
+  tile.data.clear();
+  TEST_ASSERT_EQUAL_STRING("Frame delta is truncated", parse(makeDelta({tile}), delta));
+
+  data = makeDelta({ok, ok});
+  data.pop_back();
+  TEST_ASSERT_EQUAL_STRING("Frame delta is truncated", parse(data, delta));
+  data.resize(DELTA_HEADER_SIZE + 4);
+  TEST_ASSERT_EQUAL_STRING("Frame delta is truncated", parse(data, delta));
+  data = makeDelta({ok});
+  data.push_back(0);
+  TEST_ASSERT_EQUAL_STRING("Frame delta has extra data", parse(data, delta));
+}
+
+static std::vector<uint8_t> testFrame(void)
+{
+  std::vector<uint8_t> frame(PITCH * HEIGHT);
+  for (size_t i = 0; i < frame.size(); i++)
+    frame[i] = (uint8_t)(i * 7 + i / PITCH);
+  return frame;
+}
+
+void test_crc_is_the_same_for_both_row_orders(void)
+{
+  std::vector<uint8_t> frame = testFrame();
+  uint32_t crc = frameCrc(frame.data(), PITCH, WIDTH, HEIGHT);
+  TEST_ASSERT_EQUAL_HEX32(ota_crc32(0, frame.data(), frame.size()), crc);
+
+  std::vector<uint8_t> bottomUp(frame.size());
+  for (int y = 0; y < HEIGHT; y++)
+    memcpy(&bottomUp[(HEIGHT - 1 - y) * PITCH], &frame[y * PITCH], PITCH);
+  TEST_ASSERT_EQUAL_HEX32(crc, frameCrc(&bottomUp[(HEIGHT - 1) * PITCH], -PITCH, WIDTH, HEIGHT));
+}
+
+void test_boxes(void)
+{
+  std::vector<uint8_t> frame = testFrame();
+  std::vector<uint8_t> original = frame;
+  DeltaTile tile = {24, 100, 32, 3, DELTA_TILE_G5, 0, nullptr};
+  uint8_t box[4 * 3], patch[4 * 3];
+
+  frameGetBox(frame.data(), PITCH, tile, box);
+  TEST_ASSERT_EQUAL_MEMORY(&frame[100 * PITCH + 3], box, 4);
+  TEST_ASSERT_EQUAL_MEMORY(&frame[102 * PITCH + 3], box + 8, 4);
+
+  memset(patch, 0xaa, sizeof(patch));
+  framePutBox(frame.data(), PITCH, tile, patch);
+  frameGetBox(frame.data(), PITCH, tile, box);
+  TEST_ASSERT_EQUAL_MEMORY(patch, box, sizeof(box));
+  // nothing outside the box changed
+  TEST_ASSERT_EQUAL_UINT8(original[100 * PITCH + 2], frame[100 * PITCH + 2]);
+  TEST_ASSERT_EQUAL_UINT8(original[100 * PITCH + 7], frame[100 * PITCH + 7]);
+  TEST_ASSERT_EQUAL_MEMORY(&original[103 * PITCH], &frame[103 * PITCH], PITCH);
+
+  // the same pixels through a bottom-up buffer
+  std::vector<uint8_t> bottomUp(frame.size());
+  for (int y = 0; y < HEIGHT; y++)
+    memcpy(&bottomUp[(HEIGHT - 1 - y) * PITCH], &original[y * PITCH], PITCH);
+  framePutBox(&bottomUp[(HEIGHT - 1) * PITCH], -PITCH, tile, patch);
+  TEST_ASSERT_EQUAL_HEX32(frameCrc(frame.data(), PITCH, WIDTH, HEIGHT), frameCrc(&bottomUp[(HEIGHT - 1) * PITCH], -PITCH, WIDTH, HEIGHT));
+}
+
+void test_bmp_header_is_accepted(void)
+{
+  uint8_t header[FRAME_BMP_HEADER_SIZE];
+  frameBmpHeader(header, WIDTH, HEIGHT);
+  bool reversed = true;
+  TEST_ASSERT_EQUAL(BMP_NO_ERR, parseBMPHeader(header, reversed));
+  TEST_ASSERT_FALSE(reversed);
+  TEST_ASSERT_EQUAL_UINT32(FRAME_BMP_HEADER_SIZE + PITCH * HEIGHT, header[2] | (header[3] << 8) | (header[4] << 16));
+}
+
+void test_buffer_collects_up_to_its_limit(void)
+{
+  FrameDeltaBuffer buffer(10000);
+  uint8_t chunk[3000];
+  for (size_t i = 0; i < sizeof(chunk); i++)
+    chunk[i] = (uint8_t)i;
+
+  TEST_ASSERT_TRUE(buffer.write(chunk, sizeof(chunk)));
+  TEST_ASSERT_TRUE(buffer.write(chunk, sizeof(chunk)));
+  TEST_ASSERT_TRUE(buffer.write(chunk, sizeof(chunk)));
+  TEST_ASSERT_EQUAL_UINT32(9000, buffer.size());
+  TEST_ASSERT_EQUAL_MEMORY(chunk, buffer.data() + 6000, sizeof(chunk));
+  TEST_ASSERT_FALSE(buffer.tooBig());
+
+  TEST_ASSERT_FALSE(buffer.write(chunk, sizeof(chunk)));
+  TEST_ASSERT_TRUE(buffer.tooBig());
+  TEST_ASSERT_EQUAL_UINT32(9000, buffer.size());
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_parses_tiles);
+  RUN_TEST(test_rejects_bad_deltas);
+  RUN_TEST(test_crc_is_the_same_for_both_row_orders);
+  RUN_TEST(test_boxes);
+  RUN_TEST(test_bmp_header_is_accepted);
+  RUN_TEST(test_buffer_collects_up_to_its_limit);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
@@ -0,0 +1,80 @@
+#include <unity.h>
+#include <frame_history.h>
+#include <string.h>
+
+void test_slots_are_reused_oldest_first(void)
+{
+  HistoryIndex index;
+  historyClear(index);
+  TEST_ASSERT_TRUE(historyIndexValid(index));
+  TEST_ASSERT_EQUAL_INT(-1, historySlot(index, 1));
+
+  TEST_ASSERT_EQUAL_UINT8(0, historyPush(index));
+  TEST_ASSERT_EQUAL_UINT8(1, historyPush(index));
+  TEST_ASSERT_EQUAL_UINT8(2, index.count);
+  TEST_ASSERT_EQUAL_INT(1, historySlot(index, 1));
+  TEST_ASSERT_EQUAL_INT(0, historySlot(index, 2));
+  TEST_ASSERT_EQUAL_INT(-1, historySlot(index, 3));
+
+  for (int i = 2; i < HISTORY_SLOTS + 2; i++)
+    TEST_ASSERT_EQUAL_UINT8(i % HISTORY_SLOTS, historyPush(index));
+  TEST_ASSERT_EQUAL_UINT8(HISTORY_SLOTS, index.count);
+  // slot 0 and 1 were overwritten last, so they are the newest frames now
+  TEST_ASSERT_EQUAL_INT(1, historySlot(index, 1));
+  TEST_ASSERT_EQUAL_INT(0, historySlot(index, 2));
+  TEST_ASSERT_EQUAL_INT(2, historySlot(index, HISTORY_SLOTS));
+  TEST_ASSERT_EQUAL_INT(-1, historySlot(index, HISTORY_SLOTS + 1));
+  TEST_ASSERT_EQUAL_INT(-1, historySlot(index, 0));
+
+  char name[16];
+  historyFrameFile(3, name, sizeof(name));
+  TEST_ASSERT_EQUAL_STRING("/hist3", name);
+}
+
+void test_damaged_index_is_rejected(void)
+{
+  HistoryIndex index;
+  memset(&index, 0xff, sizeof(index));
+  TEST_ASSERT_FALSE(historyIndexValid(index));
+  historyClear(index);
+  index.next = HISTORY_SLOTS;
+  TEST_ASSERT_FALSE(historyIndexValid(index));
+}
+
+void test_rewind_steps_back_until_the_oldest(void)
+{
+  HistoryCursor cursor;
+  memset(&cursor, 0xa5, sizeof(cursor)); // RTC memory after a power cycle
+  TEST_ASSERT_FALSE(historyRewound(cursor));
+
+  TEST_ASSERT_EQUAL_INT(1, historyRewind(cursor, 3));
+  TEST_ASSERT_TRUE(historyRewound(cursor));
+  TEST_ASSERT_EQUAL_INT(2, historyRewind(cursor, 3));
+  TEST_ASSERT_EQUAL_INT(3, historyRewind(cursor, 3));
+  TEST_ASSERT_EQUAL_INT(-1, historyRewind(cursor, 3));
+  TEST_ASSERT_TRUE(historyRewound(cursor)); // the oldest frame stays on screen
+
+  historyReset(cursor);
+  TEST_ASSERT_FALSE(historyRewound(cursor));
+  TEST_ASSERT_EQUAL_INT(-1, historyRewind(cursor, 0));
+  TEST_ASSERT_FALSE(historyRewound(cursor));
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_slots_are_reused_oldest_first);
+  RUN_TEST(test_damaged_index_is_rejected);
+  RUN_TEST(test_rewind_steps_back_until_the_oldest);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
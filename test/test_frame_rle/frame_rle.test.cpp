@@ -0,0 +1,177 @@
+#include <unity.h>
+#include <frame_rle.h>
+#include <string.h>
+#include <vector>
+#include "../../lib/trmnl/src/frame_rle_enc.inl"
+
+/** A dashboard-like 1-bit plane: white with boxes, rules and noisy "text" lines */
+static std::vector<uint8_t> dashboard(int pitch, int height, uint32_t seed)
+{
+  std::vector<uint8_t> plane(pitch * height, 0xff);
+  for (int y = 0; y < height; y++)
+  {
+    uint8_t *row = &plane[y * pitch];
+    if (y % 60 == 10)
+      memset(row + 2, 0x00, pitch - 4); // rule
+    if (y % 60 > 20 && y % 60 < 36)
+    {
+      for (int x = 4; x < pitch / 2; x++)
+      {
+        seed = seed * 1103515245 + 12345;
+        row[x] = (uint8_t)(seed >> 16) | 0x81; // glyphs
+      }
+    }
+    row[0] = 0x7f; // box edges
+    row[pitch - 1] = 0xfe;
+  }
+  return plane;
+}
+
+static std::vector<uint8_t> encode(int width, int height, int planes, uint8_t palette, const std::vector<uint8_t> &pixels)
+{
+  int pitch = (width + 7) / 8;
+  std::vector<uint8_t> out(sizeof(FrameRleHeader) + planes * height * FRAME_RLE_ROW_BOUND(pitch));
+  frameRleHeaderInit((FrameRleHeader *)out.data(), width, height, planes, palette);
+  size_t size = sizeof(FrameRleHeader);
+  for (int p = 0; p < planes; p++)
+    size += frameRleEncodePlane(&pixels[p * pitch * height], pitch, height, &out[size]);
+  out.resize(size);
+  return out;
+}
+
+static void assertDecodes(const std::vector<uint8_t> &image, int planes, const std::vector<uint8_t> &pixels)
+{
+  FrameRleDecoder decoder;
+  uint8_t row[256];
+  TEST_ASSERT_TRUE(frameRleMatch(image.data(), image.size()));
+  TEST_ASSERT_TRUE(frameRleBegin(decoder, image.data(), image.size(), row));
+  int pitch = decoder.pitch, height = decoder.header.height;
+  for (int p = 0; p < planes; p++)
+  {
+    for (int y = 0; y < height; y++)
+    {
+      TEST_ASSERT_EQUAL_INT(p, decoder.plane);
+      TEST_ASSERT_EQUAL_INT(y, decoder.y);
+      const uint8_t *decoded = frameRleRow(decoder);
+      TEST_ASSERT_NOT_NULL(decoded);
+      TEST_ASSERT_EQUAL_MEMORY(&pixels[(p * height + y) * pitch], decoded, pitch);
+    }
+  }
+  TEST_ASSERT_NULL(frameRleRow(decoder));
+  TEST_ASSERT_TRUE(decoder.data == decoder.end);
+}
+
+void test_a_dashboard_frame_round_trips(void)
+{
+  std::vector<uint8_t> pixels = dashboard(100, 480, 1);
+  std::vector<uint8_t> image = encode(800, 480, 1, FRAME_RLE_PALETTE, pixels);
+  assertDecodes(image, 1, pixels);
+  // the blank rows take a byte, the text lines most of their size
+  TEST_ASSERT_TRUE(image.size() < pixels.size() / 3);
+  TEST_ASSERT_EQUAL_HEX8(0, frameRleInvert(*(const FrameRleHeader *)image.data(), 0));
+}
+
+void test_gray_planes_and_long_rows(void)
+{
+  // 1872 pixels: rows longer than the longest op
+  int pitch = 234, height = 40;
+  std::vector<uint8_t> pixels = dashboard(pitch, height, 2);
+  std::vector<uint8_t> second = dashboard(pitch, height, 3);
+  pixels.insert(pixels.end(), second.begin(), second.end());
+  uint8_t inverted = 0x1b; // gray level 3 - value
+  std::vector<uint8_t> image = encode(1872, height, 2, inverted, pixels);
+  assertDecodes(image, 2, pixels);
+  const FrameRleHeader &header = *(const FrameRleHeader *)image.data();
+  TEST_ASSERT_EQUAL_HEX8(0xff, frameRleInvert(header, 0));
+  TEST_ASSERT_EQUAL_HEX8(0xff, frameRleInvert(header, 1));
+
+  // a blank row is one run with a long length
+  uint8_t row[234], out[FRAME_RLE_ROW_BOUND(234)];
+  memset(row, 0xff, sizeof(row));
+  TEST_ASSERT_EQUAL_INT(3, frameRleEncodeRow(row, NULL, sizeof(row), out));
+  TEST_ASSERT_EQUAL_HEX8(FRAME_RLE_RUN | 63, out[0]);
+  TEST_ASSERT_EQUAL_HEX8(234 - 64, out[1]);
+  TEST_ASSERT_EQUAL_INT(1, frameRleEncodeRow(row, row, sizeof(row), out));
+  TEST_ASSERT_EQUAL_HEX8(FRAME_RLE_SAME_ROW, out[0]);
+}
+
+void test_palettes(void)
+{
+  std::vector<uint8_t> pixels(4 * 2, 0x0f);
+  std::vector<uint8_t> image = encode(32, 2, 1, 0x03, pixels); // 0 = white, 1 = black
+  FrameRleDecoder decoder;
+  uint8_t row[4];
+  TEST_ASSERT_TRUE(frameRleBegin(decoder, image.data(), image.size(), row));
+  TEST_ASSERT_EQUAL_HEX8(0xff, frameRleInvert(decoder.header, 0));
+
+  // only the lightest plane of this 4-gray image is inverted
+  image = encode(32, 1, 2, 0xb1, pixels);
+  TEST_ASSERT_TRUE(frameRleBegin(decoder, image.data(), image.size(), row));
+  TEST_ASSERT_EQUAL_HEX8(0xff, frameRleInvert(decoder.header, 0));
+  TEST_ASSERT_EQUAL_HEX8(0x00, frameRleInvert(decoder.header, 1));
+
+  // palettes that would need a lookup per pixel
+  image = encode(32, 1, 2, 0x9c, pixels);
+  TEST_ASSERT_FALSE(frameRleBegin(decoder, image.data(), image.size(), row));
+  image = encode(32, 1, 1, 0x00, pixels);
+  TEST_ASSERT_FALSE(frameRleBegin(decoder, image.data(), image.size(), row));
+}
+
+void test_damaged_images_are_rejected(void)
+{
+  FrameRleDecoder decoder;
+  uint8_t row[4];
+  std::vector<uint8_t> pixels(8, 0x55);
+  std::vector<uint8_t> image = encode(32, 2, 1, FRAME_RLE_PALETTE, pixels);
+
+  std::vector<uint8_t> bad = image;
+  bad[0] = 'X';
+  TEST_ASSERT_FALSE(frameRleMatch(bad.data(), bad.size()));
+  TEST_ASSERT_FALSE(frameRleBegin(decoder, bad.data(), bad.size(), row));
+  bad = image;
+  bad[4] = FRAME_RLE_VERSION + 1;
+  TEST_ASSERT_FALSE(frameRleBegin(decoder, bad.data(), bad.size(), row));
+
+  // the first row can't refer to the row above
+  bad = image;
+  bad.resize(sizeof(FrameRleHeader));
+  bad.push_back(FRAME_RLE_COPY | 3);
+  TEST_ASSERT_TRUE(frameRleBegin(decoder, bad.data(), bad.size(), row));
+  TEST_ASSERT_NULL(frameRleRow(decoder));
+  bad.back() = FRAME_RLE_SAME_ROW;
+  TEST_ASSERT_TRUE(frameRleBegin(decoder, bad.data(), bad.size(), row));
+  TEST_ASSERT_NULL(frameRleRow(decoder));
+
+  // an op longer than the row
+  bad.back() = FRAME_RLE_RUN | 4;
+  bad.push_back(0);
+  TEST_ASSERT_TRUE(frameRleBegin(decoder, bad.data(), bad.size(), row));
+  TEST_ASSERT_NULL(frameRleRow(decoder));
+
+  // cut short
+  bad = image;
+  bad.pop_back();
+  TEST_ASSERT_TRUE(frameRleBegin(decoder, bad.data(), bad.size(), row));
+  TEST_ASSERT_NOT_NULL(frameRleRow(decoder));
+  TEST_ASSERT_NULL(frameRleRow(decoder));
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_a_dashboard_frame_round_trips);
+  RUN_TEST(test_gray_planes_and_long_rows);
+  RUN_TEST(test_palettes);
+  RUN_TEST(test_damaged_images_are_rejected);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
@@ -0,0 +1,77 @@
+#include <unity.h>
+#include <g5_planes.h>
+#include <string.h>
+#include <vector>
+
+static std::vector<uint8_t> container(uint32_t size0, uint32_t size1, size_t data)
+{
+  G5PlanesHeader header;
+  memset(&header, 0, sizeof(header));
+  header.u16Marker = G5_PLANES_MARKER;
+  header.width = 800;
+  header.height = 480;
+  header.mode = G5_PLANES_GRAY4;
+  header.size[0] = size0;
+  header.size[1] = size1;
+  std::vector<uint8_t> file((const uint8_t *)&header, (const uint8_t *)(&header + 1));
+  for (size_t i = 0; i < data; i++)
+    file.push_back((uint8_t)i);
+  return file;
+}
+
+void test_planes_are_found(void)
+{
+  std::vector<uint8_t> file = container(100, 60, 160);
+  G5PlanesHeader header;
+  const uint8_t *planes[2];
+  TEST_ASSERT_TRUE(g5PlanesMatch(file.data(), file.size()));
+  TEST_ASSERT_EQUAL_HEX8(0xc2, file[0]); // stored little endian like BB_BITMAP
+  TEST_ASSERT_TRUE(g5PlanesParse(file.data(), file.size(), header, planes));
+  TEST_ASSERT_EQUAL_UINT16(800, header.width);
+  TEST_ASSERT_EQUAL_UINT16(480, header.height);
+  TEST_ASSERT_TRUE(planes[0] == file.data() + sizeof(G5PlanesHeader));
+  TEST_ASSERT_TRUE(planes[1] == planes[0] + 100);
+  TEST_ASSERT_EQUAL_UINT8(100, planes[1][0]);
+
+  // trailing bytes are allowed, as after a BB_BITMAP
+  file.push_back(0);
+  TEST_ASSERT_TRUE(g5PlanesParse(file.data(), file.size(), header, planes));
+}
+
+void test_damaged_containers_are_rejected(void)
+{
+  G5PlanesHeader header;
+  const uint8_t *planes[2];
+  std::vector<uint8_t> file = container(100, 60, 159);
+  TEST_ASSERT_FALSE(g5PlanesParse(file.data(), file.size(), header, planes));
+  file = container(0xffffffff, 2, 160); // sizes that wrap around
+  TEST_ASSERT_FALSE(g5PlanesParse(file.data(), file.size(), header, planes));
+  file = container(100, 0, 160);
+  TEST_ASSERT_FALSE(g5PlanesParse(file.data(), file.size(), header, planes));
+
+  file = container(100, 60, 160);
+  file[6] = G5_PLANES_GRAY4 + 1; // mode
+  TEST_ASSERT_FALSE(g5PlanesParse(file.data(), file.size(), header, planes));
+  file = container(100, 60, 160);
+  file[0] = 0xbf; // a plain G5 image
+  TEST_ASSERT_FALSE(g5PlanesMatch(file.data(), file.size()));
+  TEST_ASSERT_FALSE(g5PlanesMatch(file.data(), sizeof(G5PlanesHeader) - 1));
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_planes_are_found);
+  RUN_TEST(test_damaged_containers_are_rejected);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
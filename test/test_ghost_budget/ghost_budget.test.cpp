@@ -0,0 +1,226 @@
+#include <unity.h>
+#include <ghost_budget.h>
+#include <string.h>
+#include <vector>
+
+#define WIDTH 800
+#define HEIGHT 480
+#define PITCH (WIDTH / 8)
+#define NOW 1709298270u
+
+typedef std::vector<uint8_t> Image;
+
+static Image whiteImage(void)
+{
+  return Image(PITCH * HEIGHT, 0xff);
+}
+
+// black box; x and w are multiples of 8
+static void fillBlack(Image &image, int x, int y, int w, int h)
+{
+  for (int row = y; row < y + h; row++)
+    memset(&image[row * PITCH + x / 8], 0, w / 8);
+}
+
+static void scan(const Image &image, GhostFrame &frame)
+{
+  ghostScanBegin(frame, WIDTH, HEIGHT);
+  for (int y = 0; y < HEIGHT; y++)
+    ghostScanRow(frame, y, &image[y * PITCH]);
+}
+
+// decide and apply like display_refresh() does
+static GhostDecision show(GhostBudget &budget, const Image &image, uint32_t now, bool canClean = true)
+{
+  GhostFrame frame;
+  scan(image, frame);
+  GhostDecision decision = ghostDecide(budget, &frame, WIDTH, HEIGHT, now, canClean);
+  ghostApply(budget, &frame, decision, WIDTH, HEIGHT, now);
+  return decision;
+}
+
+static GhostBudget freshBudget(const Image &image)
+{
+  GhostBudget budget;
+  memset(&budget, 0, sizeof(budget));
+  TEST_ASSERT_EQUAL_UINT8(GHOST_FULL, show(budget, image, NOW).action);
+  return budget;
+}
+
+void test_scan_counts_ink_per_tile(void)
+{
+  Image image = whiteImage();
+  fillBlack(image, 80, 80, 40, 10); // tile 1,1
+  fillBlack(image, 792, 472, 8, 8); // last tile
+  GhostFrame frame;
+  scan(image, frame);
+
+  TEST_ASSERT_TRUE(ghostScanComplete(frame));
+  TEST_ASSERT_EQUAL_UINT16(80, frame.tileW);
+  TEST_ASSERT_EQUAL_UINT16(80, frame.tileH);
+  TEST_ASSERT_EQUAL_UINT16(0, frame.ink[0]);
+  TEST_ASSERT_EQUAL_UINT16(400, frame.ink[GHOST_COLS + 1]);
+  TEST_ASSERT_EQUAL_UINT16(64, frame.ink[GHOST_TILES - 1]);
+  TEST_ASSERT_EQUAL_HEX32(frame.hash[0], frame.hash[2]);
+  TEST_ASSERT_NOT_EQUAL(frame.hash[0], frame.hash[GHOST_COLS + 1]);
+
+  // rows out of order leave the scan incomplete
+  ghostScanBegin(frame, WIDTH, HEIGHT);
+  ghostScanRow(frame, 1, &image[0]);
+  TEST_ASSERT_FALSE(ghostScanComplete(frame));
+}
+
+void test_unchanged_tiles_wear_nothing(void)
+{
+  Image image = whiteImage();
+  GhostBudget budget = freshBudget(image);
+
+  for (int i = 0; i < 50; i++)
+  {
+    GhostDecision decision = show(budget, image, NOW + i * 60);
+    TEST_ASSERT_EQUAL_UINT8(GHOST_PARTIAL, decision.action);
+    TEST_ASSERT_EQUAL_UINT8(0, decision.changed);
+  }
+  TEST_ASSERT_EQUAL_UINT8(0, budget.tiles[0].wear);
+}
+
+void test_changing_region_is_cleaned_locally(void)
+{
+  Image image = whiteImage();
+  GhostBudget budget = freshBudget(image);
+
+  // a clock in the top right corner changes on every update
+  Image clocks[2] = {image, image};
+  fillBlack(clocks[0], 680, 0, 80, 80);
+  fillBlack(clocks[1], 640, 40, 160, 40);
+  GhostDecision decision;
+  int updates = 0;
+  do
+  {
+    decision = show(budget, clocks[updates & 1], NOW + updates * 60);
+    updates++;
+    TEST_ASSERT_EQUAL_UINT8(2, decision.changed);
+  } while (decision.action == GHOST_PARTIAL && updates < 100);
+
+  TEST_ASSERT_EQUAL_UINT8(GHOST_CLEANUP, decision.action);
+  TEST_ASSERT_GREATER_THAN(4, updates);
+  TEST_ASSERT_EQUAL_UINT16(640, decision.x);
+  TEST_ASSERT_EQUAL_UINT16(0, decision.y);
+  TEST_ASSERT_EQUAL_UINT16(160, decision.w);
+  TEST_ASSERT_EQUAL_UINT16(80, decision.h);
+  TEST_ASSERT_EQUAL_UINT8(0, budget.tiles[8].wear);
+  TEST_ASSERT_EQUAL_UINT8(0, budget.tiles[9].wear);
+
+  // without the pixels of the image the screen gets a fast refresh instead
+  do
+  {
+    decision = show(budget, clocks[updates & 1], NOW + updates * 60, false);
+    updates++;
+  } while (decision.action == GHOST_PARTIAL && updates < 200);
+  TEST_ASSERT_EQUAL_UINT8(GHOST_FAST, decision.action);
+}
+
+void test_unknown_images_follow_the_old_rule(void)
+{
+  Image image = whiteImage();
+  GhostBudget budget = freshBudget(image);
+  int partials = 0;
+  GhostDecision decision;
+  for (;;)
+  {
+    decision = ghostDecide(budget, nullptr, WIDTH, HEIGHT, NOW + partials * 60, true);
+    ghostApply(budget, nullptr, decision, WIDTH, HEIGHT, NOW + partials * 60);
+    if (decision.action != GHOST_PARTIAL)
+      break;
+    partials++;
+  }
+  TEST_ASSERT_EQUAL_INT(GHOST_TILE_BUDGET / GHOST_UNKNOWN_COST, partials);
+  TEST_ASSERT_EQUAL_UINT8(GHOST_FAST, decision.action); // can't crop an image that wasn't scanned
+  TEST_ASSERT_EQUAL_UINT8(GHOST_TILES, decision.changed);
+  TEST_ASSERT_EQUAL_UINT8(GHOST_FAST_WEAR, budget.tiles[0].wear);
+}
+
+void test_fast_refreshes_lead_to_a_full_one(void)
+{
+  Image image = whiteImage();
+  GhostBudget budget = freshBudget(image);
+  int fasts = 0;
+  for (int i = 0; i < 200; i++)
+  {
+    image = whiteImage();
+    fillBlack(image, 0, (i & 1) * 240, WIDTH, 240); // half of the screen flips every time
+    GhostDecision decision = show(budget, image, NOW + i * 60);
+    if (decision.action == GHOST_FAST)
+      fasts++;
+    if (decision.action == GHOST_FULL)
+      break;
+    TEST_ASSERT_NOT_EQUAL(GHOST_CLEANUP, decision.action);
+  }
+  TEST_ASSERT_EQUAL_INT(GHOST_FASTS_PER_FULL - 1, fasts);
+  TEST_ASSERT_EQUAL_UINT8(0, budget.fasts);
+}
+
+void test_idle_screens_wear_faster(void)
+{
+  Image image = whiteImage();
+  GhostBudget budget = freshBudget(image);
+  GhostBudget idle = budget;
+
+  fillBlack(image, 0, 0, 80, 80);
+  show(budget, image, NOW + 60);
+  show(idle, image, NOW + GHOST_IDLE_SECONDS);
+  TEST_ASSERT_EQUAL_UINT8(GHOST_PARTIAL_COST + GHOST_DRIFT_COST, budget.tiles[0].wear);
+  TEST_ASSERT_EQUAL_UINT8(2 * (GHOST_PARTIAL_COST + GHOST_DRIFT_COST), idle.tiles[0].wear);
+  TEST_ASSERT_EQUAL_UINT8(0, budget.tiles[1].wear);
+}
+
+void test_touch_and_message_screens(void)
+{
+  Image image = whiteImage();
+  GhostBudget budget = freshBudget(image);
+
+  // an overlay widget across two tiles
+  ghostTouch(budget, 150, 10, 20, 20);
+  TEST_ASSERT_EQUAL_UINT8(GHOST_UNKNOWN_COST, budget.tiles[1].wear);
+  TEST_ASSERT_EQUAL_UINT8(GHOST_UNKNOWN_COST, budget.tiles[2].wear);
+  TEST_ASSERT_EQUAL_UINT8(0, budget.tiles[3].wear);
+  TEST_ASSERT_EQUAL_UINT16(0, budget.tiles[1].hash);
+  // the server's image is then different there, even if its pixels are the same
+  TEST_ASSERT_EQUAL_UINT8(2, show(budget, image, NOW + 60).changed);
+
+  // after a message screen nothing is known about the pixels on screen
+  ghostRefreshed(budget, WIDTH, HEIGHT, true, NOW + 120);
+  TEST_ASSERT_EQUAL_UINT8(0, budget.tiles[1].wear);
+  GhostFrame frame;
+  scan(image, frame);
+  GhostDecision decision = ghostDecide(budget, &frame, WIDTH, HEIGHT, NOW + 180, true);
+  TEST_ASSERT_EQUAL_UINT8(GHOST_TILES, decision.changed);
+  TEST_ASSERT_EQUAL_UINT16(GHOST_UNKNOWN_COST, decision.maxWear);
+
+  // a new screen size starts over with a full refresh
+  ghostScanBegin(frame, 480, 800);
+  TEST_ASSERT_EQUAL_UINT8(GHOST_FULL, ghostDecide(budget, &frame, 480, 800, NOW, true).action);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_scan_counts_ink_per_tile);
+  RUN_TEST(test_unchanged_tiles_wear_nothing);
+  RUN_TEST(test_changing_region_is_cleaned_locally);
+  RUN_TEST(test_unknown_images_follow_the_old_rule);
+  RUN_TEST(test_fast_refreshes_lead_to_a_full_one);
+  RUN_TEST(test_idle_screens_wear_faster);
+  RUN_TEST(test_touch_and_message_screens);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
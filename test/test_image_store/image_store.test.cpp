@@ -0,0 +1,338 @@
+#include <unity.h>
+#include <image_store.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <vector>
+
+#define SECTOR 4096
+#define SECTORS 16
+
+/** A file mapped like the partition is on the device, written with NOR flash rules */
+class MappedFlash : public ImageFlash
+{
+public:
+  explicit MappedFlash(const char *path, bool create)
+  {
+    fd = fileno(fopen(path, create ? "w+b" : "r+b"));
+    if (create)
+    {
+      std::vector<uint8_t> erased(SECTOR * SECTORS, 0xff);
+      TEST_ASSERT_EQUAL_INT((int)erased.size(), ::write(fd, erased.data(), erased.size()));
+    }
+    map = (uint8_t *)mmap(nullptr, SECTOR * SECTORS, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    TEST_ASSERT_TRUE(map != MAP_FAILED);
+    erases = 0;
+    overwrites = 0;
+    reads = 0;
+  }
+  ~MappedFlash()
+  {
+    munmap(map, SECTOR * SECTORS);
+    close(fd);
+  }
+
+  const uint8_t *data() const override
+  {
+    reads++;
+    return map;
+  }
+  size_t size() const override { return SECTOR * SECTORS; }
+  size_t sectorSize() const override { return SECTOR; }
+
+  bool erase(size_t offset, size_t length) override
+  {
+    TEST_ASSERT_EQUAL_UINT32(0, offset % SECTOR);
+    TEST_ASSERT_EQUAL_UINT32(0, length % SECTOR);
+    TEST_ASSERT_TRUE(offset + length <= size());
+    memset(map + offset, 0xff, length);
+    erases += length / SECTOR;
+    return true;
+  }
+
+  bool write(size_t offset, const uint8_t *data, size_t length) override
+  {
+    TEST_ASSERT_TRUE(offset + length <= size());
+    for (size_t i = 0; i < length; i++)
+    {
+      if (map[offset + i] != 0xff)
+        overwrites++;
+      map[offset + i] &= data[i]; // programming only clears bits
+    }
+    return true;
+  }
+
+  uint8_t *map;
+  int fd;
+  int erases, overwrites;
+  mutable int reads; // data() calls, about one per record looked at
+};
+
+static char path[64];
+
+static std::vector<uint8_t> image(size_t size, uint8_t seed)
+{
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0; i < size; i++)
+    data[i] = (uint8_t)(i * 7 + seed);
+  return data;
+}
+
+static void assertImage(ImageStore &store, const char *name, const std::vector<uint8_t> &expected)
+{
+  size_t size = 0;
+  const uint8_t *data = store.find(name, size);
+  TEST_ASSERT_NOT_NULL(data);
+  TEST_ASSERT_EQUAL_UINT32(expected.size(), size);
+  TEST_ASSERT_EQUAL_MEMORY(expected.data(), data, size);
+}
+
+void test_images_survive_a_remount(void)
+{
+  std::vector<uint8_t> first = image(5000, 1), second = image(123, 2);
+  {
+    MappedFlash flash(path, true);
+    ImageStore store(flash);
+    TEST_ASSERT_TRUE(store.mount());
+    TEST_ASSERT_FALSE(store.exists("/current.bmp"));
+    TEST_ASSERT_TRUE(store.write("/current.bmp", first.data(), first.size()));
+    TEST_ASSERT_TRUE(store.write("/last.bmp", second.data(), second.size()));
+    assertImage(store, "/current.bmp", first);
+    // the data is in the mapping itself, not in a copy
+    size_t size;
+    const uint8_t *data = store.find("/current.bmp", size);
+    TEST_ASSERT_TRUE(data > flash.map && data < flash.map + flash.size());
+    TEST_ASSERT_EQUAL_INT(0, flash.overwrites);
+  }
+  MappedFlash flash(path, false);
+  ImageStore store(flash);
+  TEST_ASSERT_TRUE(store.mount());
+  assertImage(store, "/current.bmp", first);
+  assertImage(store, "/last.bmp", second);
+  TEST_ASSERT_FALSE(store.exists("/logo.bmp"));
+
+  // writing goes on after the newest record
+  std::vector<uint8_t> third = image(700, 3);
+  TEST_ASSERT_TRUE(store.write("/current.bmp", third.data(), third.size()));
+  assertImage(store, "/current.bmp", third);
+  assertImage(store, "/last.bmp", second);
+  TEST_ASSERT_EQUAL_INT(0, flash.overwrites);
+}
+
+void test_rename_and_remove(void)
+{
+  MappedFlash flash(path, true);
+  ImageStore store(flash);
+  TEST_ASSERT_TRUE(store.mount());
+  std::vector<uint8_t> old = image(3000, 4), next = image(3000, 5);
+  TEST_ASSERT_TRUE(store.write("/current.bmp", old.data(), old.size()));
+  TEST_ASSERT_TRUE(store.write("/last.bmp", next.data(), next.size()));
+
+  TEST_ASSERT_TRUE(store.rename("/current.bmp", "/last.bmp"));
+  TEST_ASSERT_FALSE(store.exists("/current.bmp"));
+  assertImage(store, "/last.bmp", old);
+  TEST_ASSERT_FALSE(store.rename("/current.bmp", "/other.bmp"));
+
+  TEST_ASSERT_TRUE(store.remove("/last.bmp"));
+  TEST_ASSERT_FALSE(store.exists("/last.bmp"));
+  TEST_ASSERT_FALSE(store.remove("/last.bmp"));
+  TEST_ASSERT_FALSE(store.write("/a-name-that-is-much-too-long-to-store.bmp", old.data(), 1));
+
+  MappedFlash again(path, false);
+  ImageStore remounted(again);
+  TEST_ASSERT_TRUE(remounted.mount());
+  TEST_ASSERT_FALSE(remounted.exists("/last.bmp"));
+  TEST_ASSERT_FALSE(remounted.exists("/current.bmp"));
+}
+
+void test_the_oldest_images_make_room(void)
+{
+  MappedFlash flash(path, true);
+  ImageStore store(flash);
+  TEST_ASSERT_TRUE(store.mount());
+  char name[IMAGE_STORE_NAME_SIZE];
+  // 48000 byte frames: a 64K store holds one at a time
+  for (int i = 0; i < 5; i++)
+  {
+    std::vector<uint8_t> frame = image(48000, (uint8_t)i);
+    snprintf(name, sizeof(name), "/frame%d.bmp", i);
+    TEST_ASSERT_TRUE(store.write(name, frame.data(), frame.size()));
+    assertImage(store, name, frame);
+    if (i > 0)
+    {
+      snprintf(name, sizeof(name), "/frame%d.bmp", i - 1);
+      TEST_ASSERT_FALSE(store.exists(name));
+    }
+  }
+  TEST_ASSERT_EQUAL_INT(0, flash.overwrites);
+
+  // small images keep each other while there is room
+  std::vector<uint8_t> small = image(4000, 9);
+  for (int i = 0; i < 40; i++)
+  {
+    snprintf(name, sizeof(name), "/small%d.bmp", i);
+    TEST_ASSERT_TRUE(store.write(name, small.data(), small.size()));
+  }
+  assertImage(store, "/small39.bmp", small);
+  assertImage(store, "/small35.bmp", small);
+  TEST_ASSERT_FALSE(store.exists("/small0.bmp"));
+  TEST_ASSERT_FALSE(store.write("/huge.bmp", small.data(), store.capacity() + 1));
+
+  MappedFlash again(path, false);
+  ImageStore remounted(again);
+  TEST_ASSERT_TRUE(remounted.mount());
+  assertImage(remounted, "/small39.bmp", small);
+  std::vector<uint8_t> last = image(100, 10);
+  TEST_ASSERT_TRUE(remounted.write("/small40.bmp", last.data(), last.size()));
+  assertImage(remounted, "/small40.bmp", last);
+  assertImage(remounted, "/small39.bmp", small);
+  TEST_ASSERT_EQUAL_INT(0, again.overwrites);
+}
+
+void test_streamed_writes_and_power_loss(void)
+{
+  std::vector<uint8_t> old = image(6000, 11), next = image(6000, 12);
+  {
+    MappedFlash flash(path, true);
+    ImageStore store(flash);
+    TEST_ASSERT_TRUE(store.mount());
+    TEST_ASSERT_TRUE(store.begin("/current.bmp", 48000));
+    for (size_t i = 0; i < old.size(); i += 1000)
+      TEST_ASSERT_TRUE(store.append(&old[i], 1000));
+    TEST_ASSERT_FALSE(store.exists("/current.bmp"));
+    TEST_ASSERT_TRUE(store.commit());
+    assertImage(store, "/current.bmp", old);
+
+    // the power goes out before the new version gets its header
+    TEST_ASSERT_TRUE(store.begin("/current.bmp", 48000));
+    TEST_ASSERT_TRUE(store.append(next.data(), 3000));
+  }
+  {
+    MappedFlash flash(path, false);
+    ImageStore store(flash);
+    TEST_ASSERT_TRUE(store.mount());
+    assertImage(store, "/current.bmp", old);
+    // the half written data is never programmed over
+    TEST_ASSERT_TRUE(store.write("/current.bmp", next.data(), next.size()));
+    assertImage(store, "/current.bmp", next);
+    TEST_ASSERT_EQUAL_INT(0, flash.overwrites);
+
+    // too much data gives up on the image
+    TEST_ASSERT_TRUE(store.begin("/last.bmp", 100));
+    TEST_ASSERT_FALSE(store.append(old.data(), 101));
+    TEST_ASSERT_FALSE(store.commit());
+    TEST_ASSERT_FALSE(store.exists("/last.bmp"));
+    TEST_ASSERT_TRUE(store.write("/last.bmp", old.data(), 100));
+    TEST_ASSERT_EQUAL_INT(0, flash.overwrites);
+  }
+}
+
+void test_damaged_images_are_not_shown(void)
+{
+  std::vector<uint8_t> data = image(2000, 13), other = image(100, 14);
+  {
+    MappedFlash flash(path, true);
+    ImageStore store(flash);
+    TEST_ASSERT_TRUE(store.mount());
+    TEST_ASSERT_TRUE(store.write("/current.bmp", data.data(), data.size()));
+    // the first record: its data follows the header at the start of the flash
+    flash.map[sizeof(ImageRecord) + 1000] ^= 0x10;
+    size_t size;
+    TEST_ASSERT_NULL(store.find("/current.bmp", size));
+
+    TEST_ASSERT_TRUE(store.write("/last.bmp", other.data(), other.size()));
+    assertImage(store, "/last.bmp", other);
+    // checked once per mount, damage after that is found on the next one
+    flash.map[2 * sizeof(ImageRecord) + data.size() + 50] ^= 0x10;
+    TEST_ASSERT_NOT_NULL(store.find("/last.bmp", size));
+  }
+  MappedFlash flash(path, false);
+  ImageStore store(flash);
+  TEST_ASSERT_TRUE(store.mount());
+  size_t size;
+  TEST_ASSERT_NULL(store.find("/last.bmp", size));
+
+  // a damaged header hides the record, later records are still found
+  TEST_ASSERT_TRUE(store.write("/logo.bmp", other.data(), other.size()));
+  flash.map[8] ^= 0x01;
+  TEST_ASSERT_FALSE(store.exists("/current.bmp"));
+  assertImage(store, "/logo.bmp", other);
+}
+
+void test_lookups_use_the_index(void)
+{
+  MappedFlash flash(path, true);
+  ImageStore store(flash);
+  TEST_ASSERT_TRUE(store.mount());
+  std::vector<uint8_t> frame = image(1000, 15);
+  char name[IMAGE_STORE_NAME_SIZE];
+  for (int i = 0; i < IMAGE_STORE_INDEX_SIZE - 1; i++)
+  {
+    snprintf(name, sizeof(name), "/frame%d.bmp", i);
+    TEST_ASSERT_TRUE(store.write(name, frame.data(), frame.size()));
+  }
+  TEST_ASSERT_TRUE(store.rename("/frame0.bmp", "/current.bmp"));
+  TEST_ASSERT_TRUE(store.remove("/frame1.bmp"));
+
+  // a full index answers without reading the log, even for names it doesn't have
+  flash.reads = 0;
+  assertImage(store, "/current.bmp", frame);
+  TEST_ASSERT_FALSE(store.exists("/frame0.bmp"));
+  TEST_ASSERT_FALSE(store.exists("/frame1.bmp"));
+  TEST_ASSERT_FALSE(store.exists("/logo.bmp"));
+  TEST_ASSERT_LESS_OR_EQUAL(4 * 2 * IMAGE_STORE_INDEX_SIZE, flash.reads);
+
+  // more names than the index holds are still found, before and after a remount
+  for (int i = IMAGE_STORE_INDEX_SIZE - 1; i < 2 * IMAGE_STORE_INDEX_SIZE; i++)
+  {
+    snprintf(name, sizeof(name), "/frame%d.bmp", i);
+    TEST_ASSERT_TRUE(store.write(name, frame.data(), frame.size()));
+  }
+  TEST_ASSERT_TRUE(store.remove("/frame2.bmp"));
+  MappedFlash again(path, false);
+  ImageStore remounted(again);
+  TEST_ASSERT_TRUE(remounted.mount());
+  ImageStore *stores[] = {&store, &remounted};
+  for (ImageStore *s : stores)
+  {
+    assertImage(*s, "/current.bmp", frame);
+    TEST_ASSERT_FALSE(s->exists("/frame0.bmp"));
+    TEST_ASSERT_FALSE(s->exists("/frame1.bmp"));
+    TEST_ASSERT_FALSE(s->exists("/frame2.bmp"));
+    for (int i = 3; i < 2 * IMAGE_STORE_INDEX_SIZE; i++)
+    {
+      snprintf(name, sizeof(name), "/frame%d.bmp", i);
+      assertImage(*s, name, frame);
+    }
+  }
+}
+
+void setUp(void)
+{
+  snprintf(path, sizeof(path), "/tmp/image_store_%d.bin", (int)getpid());
+}
+
+void tearDown(void)
+{
+  unlink(path);
+}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_images_survive_a_remount);
+  RUN_TEST(test_rename_and_remove);
+  RUN_TEST(test_the_oldest_images_make_room);
+  RUN_TEST(test_streamed_writes_and_power_loss);
+  RUN_TEST(test_damaged_images_are_not_shown);
+  RUN_TEST(test_lookups_use_the_index);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
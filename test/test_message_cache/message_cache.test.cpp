@@ -0,0 +1,87 @@
+#include <unity.h>
+#include <message_cache.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+void test_key_depends_on_every_field(void)
+{
+  uint32_t base = MessageCacheKey(3).add("1.5.2").add("ABCDEF").value();
+
+  TEST_ASSERT_EQUAL_UINT32(base, MessageCacheKey(3).add("1.5.2").add("ABCDEF").value());
+  TEST_ASSERT_NOT_EQUAL(base, MessageCacheKey(4).add("1.5.2").add("ABCDEF").value());
+  TEST_ASSERT_NOT_EQUAL(base, MessageCacheKey(3).add("1.5.3").add("ABCDEF").value());
+  TEST_ASSERT_NOT_EQUAL(base, MessageCacheKey(3).add("1.5.2").add("ABCDEG").value());
+}
+
+void test_key_separates_fields(void)
+{
+  TEST_ASSERT_NOT_EQUAL(MessageCacheKey(1).add("ab").add("c").value(),
+                        MessageCacheKey(1).add("a").add("bc").value());
+  TEST_ASSERT_EQUAL_UINT32(MessageCacheKey(1).add((const char *)nullptr).value(),
+                           MessageCacheKey(1).add("").value());
+}
+
+void test_key_covers_logo_bytes(void)
+{
+  uint8_t logo[16] = {0xbf, 0xbb, 16, 0, 8, 0, 8, 0};
+  uint32_t before = MessageCacheKey(1).add(logo, sizeof(logo)).value();
+  logo[12] ^= 1;
+  TEST_ASSERT_NOT_EQUAL(before, MessageCacheKey(1).add(logo, sizeof(logo)).value());
+}
+
+void test_file_name(void)
+{
+  MessageCacheKey key(2);
+  char expected[24], name[24];
+  snprintf(expected, sizeof(expected), "/msg_%08x.g5", (unsigned int)key.value());
+  key.fileName(name, sizeof(name));
+  TEST_ASSERT_EQUAL_STRING(expected, name);
+  TEST_ASSERT_EQUAL(16, strlen(name));
+}
+
+void test_header_round_trip(void)
+{
+  uint8_t file[MESSAGE_CACHE_HEADER_SIZE + 5] = {0};
+  messageCacheHeader(file, 800, 480, 5);
+
+  const uint8_t expected[] = {0xbf, 0xbb, 0x20, 0x03, 0xe0, 0x01, 0x05, 0x00};
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, file, sizeof(expected));
+  TEST_ASSERT_TRUE(messageCacheValid(file, sizeof(file), 800, 480));
+}
+
+void test_rejects_stale_or_damaged_files(void)
+{
+  uint8_t file[MESSAGE_CACHE_HEADER_SIZE + 5] = {0};
+  messageCacheHeader(file, 800, 480, 5);
+
+  TEST_ASSERT_FALSE(messageCacheValid(file, sizeof(file), 480, 800));      // other panel
+  TEST_ASSERT_FALSE(messageCacheValid(file, sizeof(file) - 1, 800, 480));  // truncated write
+  TEST_ASSERT_FALSE(messageCacheValid(file, MESSAGE_CACHE_HEADER_SIZE, 800, 480));
+  TEST_ASSERT_FALSE(messageCacheValid(nullptr, 0, 800, 480));
+
+  file[0] = 0;
+  TEST_ASSERT_FALSE(messageCacheValid(file, sizeof(file), 800, 480));
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_key_depends_on_every_field);
+  RUN_TEST(test_key_separates_fields);
+  RUN_TEST(test_key_covers_logo_bytes);
+  RUN_TEST(test_file_name);
+  RUN_TEST(test_header_round_trip);
+  RUN_TEST(test_rejects_stale_or_damaged_files);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
@@ -0,0 +1,357 @@
+#include <unity.h>
+#include <ota_decoder.h>
+#include <string.h>
+#include <vector>
+
+// The running firmware: a flash partition we can only read from
+class FakePartition : public OtaSource
+{
+public:
+  explicit FakePartition(const std::vector<uint8_t> &image) : image(image) {}
+
+  bool read(uint32_t offset, uint8_t *data, size_t length) override
+  {
+    if (offset + length > image.size())
+      return false;
+    memcpy(data, image.data() + offset, length);
+    return true;
+  }
+
+private:
+  const std::vector<uint8_t> &image;
+};
+
+// The OTA partition being written (what Update.write would do)
+class FakeUpdate : public OtaSink
+{
+public:
+  std::vector<uint8_t> written;
+  size_t writes = 0;
+  size_t largestWrite = 0;
+
+  bool write(const uint8_t *data, size_t length) override
+  {
+    written.insert(written.end(), data, data + length);
+    writes++;
+    if (length > largestWrite)
+      largestWrite = length;
+    return true;
+  }
+};
+
+static std::vector<uint8_t> makeImage(size_t size, uint32_t seed)
+{
+  // firmware-like: runs of repeated words mixed with noise
+  std::vector<uint8_t> image(size);
+  uint32_t x = seed;
+  for (size_t i = 0; i < size; i++)
+  {
+    x = x * 1103515245 + 12345;
+    image[i] = (i % 64) < 40 ? (uint8_t)(i / 64) : (uint8_t)(x >> 16);
+  }
+  return image;
+}
+
+// Reference heatshrink encoder (-w 11 -l 4), greedy longest match
+static std::vector<uint8_t> heatshrinkEncode(const std::vector<uint8_t> &input)
+{
+  std::vector<uint8_t> out;
+  uint8_t current = 0;
+  int used = 0;
+  auto putBits = [&](uint32_t value, int count)
+  {
+    for (int i = count - 1; i >= 0; i--)
+    {
+      current = (current << 1) | ((value >> i) & 1);
+      if (++used == 8)
+      {
+        out.push_back(current);
+        current = 0;
+        used = 0;
+      }
+    }
+  };
+
+  const size_t window = 1 << HEATSHRINK_WINDOW_BITS;
+  const size_t maxCount = 1 << HEATSHRINK_LOOKAHEAD_BITS;
+  size_t pos = 0;
+  while (pos < input.size())
+  {
+    size_t bestLength = 0;
+    size_t bestDistance = 0;
+    for (size_t distance = 1; distance <= window && distance <= pos; distance++)
+    {
+      size_t length = 0;
+      while (length < maxCount && pos + length < input.size() && input[pos + length - distance] == input[pos + length])
+        length++;
+      if (length > bestLength)
+      {
+        bestLength = length;
+        bestDistance = distance;
+      }
+    }
+
+    if (bestLength >= 2)
+    {
+      putBits(0, 1);
+      putBits(bestDistance - 1, HEATSHRINK_WINDOW_BITS);
+      putBits(bestLength - 1, HEATSHRINK_LOOKAHEAD_BITS);
+      pos += bestLength;
+    }
+    else
+    {
+      putBits(1, 1);
+      putBits(input[pos], 8);
+      pos++;
+    }
+  }
+  if (used > 0)
+    out.push_back(current << (8 - used));
+  return out;
+}
+
+static void putLe32(std::vector<uint8_t> &out, uint32_t value)
+{
+  for (int i = 0; i < 4; i++)
+    out.push_back(value >> (8 * i));
+}
+
+static void putVarint(std::vector<uint8_t> &out, uint64_t value)
+{
+  do
+  {
+    uint8_t byte = value & 0x7f;
+    value >>= 7;
+    out.push_back(value ? byte | 0x80 : byte);
+  } while (value);
+}
+
+struct PatchRecord
+{
+  uint32_t oldPos;    // where the diff starts in the old image
+  uint32_t diffCount; // bytes taken from old + diff
+  uint32_t newPos;    // where the record starts in the new image
+  uint32_t extraCount;
+};
+
+static std::vector<uint8_t> makePatch(const std::vector<uint8_t> &oldImage, const std::vector<uint8_t> &newImage,
+                                      const std::vector<PatchRecord> &records)
+{
+  std::vector<uint8_t> patch(DELTA_PATCH_MAGIC, DELTA_PATCH_MAGIC + 4);
+  putLe32(patch, oldImage.size());
+  putLe32(patch, ota_crc32(0, oldImage.data(), oldImage.size()));
+  putLe32(patch, newImage.size());
+  putLe32(patch, ota_crc32(0, newImage.data(), newImage.size()));
+
+  for (size_t r = 0; r < records.size(); r++)
+  {
+    const PatchRecord &record = records[r];
+    putVarint(patch, record.diffCount);
+    for (uint32_t i = 0; i < record.diffCount; i++)
+      patch.push_back(newImage[record.newPos + i] - oldImage[record.oldPos + i]);
+    putVarint(patch, record.extraCount);
+    for (uint32_t i = 0; i < record.extraCount; i++)
+      patch.push_back(newImage[record.newPos + record.diffCount + i]);
+
+    int64_t oldPos = record.oldPos + record.diffCount;
+    int64_t seek = r + 1 < records.size() ? (int64_t)records[r + 1].oldPos - oldPos : 0;
+    putVarint(patch, ((uint64_t)seek << 1) ^ (uint64_t)(seek >> 63));
+  }
+  return patch;
+}
+
+// new = old with a few patched bytes, an inserted block and a removed block
+static std::vector<uint8_t> oldImage = makeImage(16384, 1);
+static std::vector<uint8_t> newImage;
+static std::vector<PatchRecord> records;
+
+static void buildNewImage()
+{
+  newImage.assign(oldImage.begin(), oldImage.begin() + 5000);
+  newImage[100] ^= 0x5a;
+  newImage[4000] = 0;
+  for (int i = 0; i < 300; i++)
+    newImage.push_back((uint8_t)(i * 7));
+  newImage.insert(newImage.end(), oldImage.begin() + 5200, oldImage.end());
+  newImage[newImage.size() - 1] ^= 0xff;
+
+  records = {
+      {0, 5000, 0, 300},
+      {5200, (uint32_t)oldImage.size() - 5200, 5300, 0},
+  };
+}
+
+static bool feedInChunks(OtaSink &sink, const std::vector<uint8_t> &data, size_t chunk)
+{
+  for (size_t i = 0; i < data.size(); i += chunk)
+  {
+    size_t n = data.size() - i < chunk ? data.size() - i : chunk;
+    if (!sink.write(data.data() + i, n))
+      return false;
+  }
+  return true;
+}
+
+void test_crc32_matches_zlib(void)
+{
+  const char *check = "123456789";
+  TEST_ASSERT_EQUAL_HEX32(0xcbf43926, ota_crc32(0, (const uint8_t *)check, 9));
+  uint32_t crc = ota_crc32(0, (const uint8_t *)check, 4);
+  TEST_ASSERT_EQUAL_HEX32(0xcbf43926, ota_crc32(crc, (const uint8_t *)check + 4, 5));
+}
+
+void test_heatshrink_roundtrip_any_chunk_size(void)
+{
+  std::vector<uint8_t> compressed = heatshrinkEncode(oldImage);
+  TEST_ASSERT_TRUE(compressed.size() < oldImage.size());
+
+  const size_t chunks[] = {1, 3, 512, compressed.size()};
+  for (size_t chunk : chunks)
+  {
+    FakeUpdate update;
+    HeatshrinkDecoder decoder(update);
+    TEST_ASSERT_TRUE(feedInChunks(decoder, compressed, chunk));
+    TEST_ASSERT_TRUE(decoder.finish());
+    TEST_ASSERT_EQUAL(oldImage.size(), update.written.size());
+    TEST_ASSERT_TRUE(update.written == oldImage);
+    TEST_ASSERT_LESS_OR_EQUAL(256, update.largestWrite);
+  }
+}
+
+void test_heatshrink_detects_truncated_stream(void)
+{
+  std::vector<uint8_t> compressed = heatshrinkEncode(std::vector<uint8_t>{'A'});
+  TEST_ASSERT_EQUAL(2, compressed.size());
+
+  FakeUpdate update;
+  HeatshrinkDecoder decoder(update);
+  decoder.write(compressed.data(), 1);
+  TEST_ASSERT_FALSE(decoder.finish());
+
+  decoder.reset();
+  decoder.write(compressed.data(), 2);
+  TEST_ASSERT_TRUE(decoder.finish());
+  TEST_ASSERT_EQUAL(1, update.written.size());
+  TEST_ASSERT_EQUAL('A', update.written[0]);
+}
+
+void test_delta_patch_rebuilds_new_image(void)
+{
+  std::vector<uint8_t> patch = makePatch(oldImage, newImage, records);
+  TEST_ASSERT_TRUE(patch.size() < newImage.size() + 64);
+
+  const size_t chunks[] = {1, 7, 4096, patch.size()};
+  for (size_t chunk : chunks)
+  {
+    FakePartition running(oldImage);
+    FakeUpdate update;
+    DeltaPatch delta(running, update);
+    TEST_ASSERT_TRUE(feedInChunks(delta, patch, chunk));
+    TEST_ASSERT_TRUE(delta.finish());
+    TEST_ASSERT_NULL(delta.error());
+    TEST_ASSERT_EQUAL(newImage.size(), delta.newSize());
+    TEST_ASSERT_TRUE(update.written == newImage);
+  }
+}
+
+void test_compressed_delta_through_ota_decoder(void)
+{
+  // a patch of a small change is mostly zeros, which is what makes it compress so well
+  std::vector<uint8_t> compressed = heatshrinkEncode(makePatch(oldImage, newImage, records));
+  TEST_ASSERT_TRUE(compressed.size() < newImage.size() / 4);
+
+  FakePartition running(oldImage);
+  FakeUpdate update;
+  OtaDecoder decoder(OtaEncoding::DELTA_HEATSHRINK, running, update);
+  TEST_ASSERT_TRUE(feedInChunks(decoder, compressed, 1460));
+  TEST_ASSERT_TRUE(decoder.finish());
+  TEST_ASSERT_EQUAL(compressed.size(), decoder.bytesIn());
+  TEST_ASSERT_EQUAL(newImage.size(), decoder.bytesOut());
+  TEST_ASSERT_TRUE(update.written == newImage);
+}
+
+void test_raw_and_compressed_full_images(void)
+{
+  FakePartition running(oldImage);
+
+  FakeUpdate raw;
+  OtaDecoder rawDecoder(OtaEncoding::RAW, running, raw);
+  TEST_ASSERT_TRUE(feedInChunks(rawDecoder, newImage, 1000));
+  TEST_ASSERT_TRUE(rawDecoder.finish());
+  TEST_ASSERT_TRUE(raw.written == newImage);
+
+  FakeUpdate compressed;
+  OtaDecoder compressedDecoder(OtaEncoding::HEATSHRINK, running, compressed);
+  TEST_ASSERT_TRUE(feedInChunks(compressedDecoder, heatshrinkEncode(newImage), 1000));
+  TEST_ASSERT_TRUE(compressedDecoder.finish());
+  TEST_ASSERT_TRUE(compressed.written == newImage);
+}
+
+void test_delta_patch_rejects_other_base_image(void)
+{
+  std::vector<uint8_t> patch = makePatch(oldImage, newImage, records);
+  std::vector<uint8_t> otherImage = makeImage(oldImage.size(), 2);
+
+  FakePartition running(otherImage);
+  FakeUpdate update;
+  OtaDecoder decoder(OtaEncoding::DELTA, running, update);
+  TEST_ASSERT_FALSE(decoder.write(patch.data(), patch.size()));
+  TEST_ASSERT_FALSE(decoder.finish());
+  TEST_ASSERT_EQUAL_STRING("Patch does not match running image", decoder.error());
+  TEST_ASSERT_EQUAL(0, update.written.size());
+}
+
+void test_delta_patch_detects_corruption(void)
+{
+  std::vector<uint8_t> patch = makePatch(oldImage, newImage, records);
+  patch[DELTA_PATCH_HEADER_SIZE + 2000] ^= 1;
+
+  FakePartition running(oldImage);
+  FakeUpdate update;
+  DeltaPatch delta(running, update);
+  TEST_ASSERT_TRUE(delta.write(patch.data(), patch.size()));
+  TEST_ASSERT_FALSE(delta.finish());
+  TEST_ASSERT_EQUAL_STRING("New image CRC mismatch", delta.error());
+
+  patch = makePatch(oldImage, newImage, records);
+  patch.resize(patch.size() - 100);
+  DeltaPatch truncated(running, update);
+  truncated.write(patch.data(), patch.size());
+  TEST_ASSERT_FALSE(truncated.finish());
+  TEST_ASSERT_EQUAL_STRING("Patch is incomplete", truncated.error());
+}
+
+void test_decoder_memory_is_fixed(void)
+{
+  // window + output buffer + old-image block, independent of the firmware size
+  TEST_ASSERT_LESS_OR_EQUAL(3 * 1024, sizeof(OtaDecoder));
+}
+
+void setUp(void)
+{
+  if (newImage.empty())
+    buildNewImage();
+}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_crc32_matches_zlib);
+  RUN_TEST(test_heatshrink_roundtrip_any_chunk_size);
+  RUN_TEST(test_heatshrink_detects_truncated_stream);
+  RUN_TEST(test_delta_patch_rebuilds_new_image);
+  RUN_TEST(test_compressed_delta_through_ota_decoder);
+  RUN_TEST(test_raw_and_compressed_full_images);
+  RUN_TEST(test_delta_patch_rejects_other_base_image);
+  RUN_TEST(test_delta_patch_detects_corruption);
+  RUN_TEST(test_decoder_memory_is_fixed);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
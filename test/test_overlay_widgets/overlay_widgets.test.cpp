@@ -0,0 +1,200 @@
+#include <unity.h>
+#include <overlay_widgets.h>
+#include <string.h>
+
+// 2024-03-01 13:04:30 UTC
+#define NOW 1709298270u
+
+static OverlayPlan parse(const char *spec)
+{
+  OverlayPlan plan;
+  const char *error = overlayParse(spec, 800, 480, plan);
+  TEST_ASSERT_NULL_MESSAGE(error, error);
+  return plan;
+}
+
+static OverlayInputs inputs(uint32_t now)
+{
+  OverlayInputs in;
+  in.now = now;
+  in.batteryVoltage = 3.92f;
+  in.rssi = -67;
+  in.offline = false;
+  return in;
+}
+
+void test_parses_widgets_and_settings(void)
+{
+  OverlayPlan plan = parse("utc=-300;every=120;time,680,8,110,32,1;battery,700,450,90,24,0,1;offline,0,0,100,20");
+  TEST_ASSERT_EQUAL_INT16(-300, plan.utcOffset);
+  TEST_ASSERT_EQUAL_UINT16(120, plan.interval);
+  TEST_ASSERT_EQUAL_UINT8(3, plan.count);
+
+  const OverlayWidget &time = plan.widgets[0];
+  TEST_ASSERT_EQUAL_UINT8(OVERLAY_TIME, time.source);
+  TEST_ASSERT_EQUAL_INT16(680, time.x);
+  TEST_ASSERT_EQUAL_INT16(8, time.y);
+  TEST_ASSERT_EQUAL_INT16(110, time.w);
+  TEST_ASSERT_EQUAL_INT16(32, time.h);
+  TEST_ASSERT_EQUAL_UINT8(DL_FONT_MEDIUM, time.font);
+  TEST_ASSERT_EQUAL_UINT8(DL_BLACK, time.color);
+
+  TEST_ASSERT_EQUAL_UINT8(OVERLAY_BATTERY, plan.widgets[1].source);
+  TEST_ASSERT_EQUAL_UINT8(DL_WHITE, plan.widgets[1].color);
+  TEST_ASSERT_EQUAL_UINT8(DL_FONT_SMALL, plan.widgets[2].font);
+
+  OverlayPlan defaults = parse("rssi,0,0,80,20");
+  TEST_ASSERT_EQUAL_INT16(0, defaults.utcOffset);
+  TEST_ASSERT_EQUAL_UINT16(OVERLAY_DEFAULT_INTERVAL, defaults.interval);
+}
+
+void test_rejects_bad_specs(void)
+{
+  OverlayPlan plan;
+  TEST_ASSERT_EQUAL_STRING("No overlay widgets", overlayParse("", 800, 480, plan));
+  TEST_ASSERT_EQUAL_STRING("No overlay widgets", overlayParse("utc=60", 800, 480, plan));
+  TEST_ASSERT_EQUAL_STRING("Unknown overlay source", overlayParse("weather,0,0,10,10", 800, 480, plan));
+  TEST_ASSERT_EQUAL_STRING("Overlay widget needs x,y,w,h", overlayParse("time,0,0,10", 800, 480, plan));
+  TEST_ASSERT_EQUAL_STRING("Overlay widget needs x,y,w,h", overlayParse("time,0,0,10,1x", 800, 480, plan));
+  TEST_ASSERT_EQUAL_STRING("Overlay widget is off the screen", overlayParse("time,750,0,51,10", 800, 480, plan));
+  TEST_ASSERT_EQUAL_STRING("Overlay widget is off the screen", overlayParse("time,0,0,0,10", 800, 480, plan));
+  TEST_ASSERT_EQUAL_STRING("Bad overlay font", overlayParse("time,0,0,10,10,3", 800, 480, plan));
+  TEST_ASSERT_EQUAL_STRING("Bad overlay color", overlayParse("time,0,0,10,10,0,2", 800, 480, plan));
+  TEST_ASSERT_EQUAL_STRING("Overlay widget has extra fields", overlayParse("time,0,0,10,10,0,0,0", 800, 480, plan));
+  TEST_ASSERT_EQUAL_STRING("Bad overlay utc offset", overlayParse("utc=900;time,0,0,10,10", 800, 480, plan));
+  TEST_ASSERT_EQUAL_STRING("Bad overlay interval", overlayParse("every=10;time,0,0,10,10", 800, 480, plan));
+  TEST_ASSERT_EQUAL_STRING("Too many overlay widgets",
+                           overlayParse("time,0,0,9,9;time,0,0,9,9;time,0,0,9,9;time,0,0,9,9;time,0,0,9,9", 800, 480, plan));
+}
+
+void test_widget_texts(void)
+{
+  OverlayPlan plan = parse("utc=-300;time,0,0,9,9;time12,0,0,9,9;battery,0,0,9,9;rssi,0,0,9,9;");
+  OverlayInputs in = inputs(NOW);
+  char text[OVERLAY_TEXT_SIZE];
+
+  overlayText(plan, plan.widgets[0], in, text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("08:04", text);
+  overlayText(plan, plan.widgets[1], in, text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("8:04 AM", text);
+  overlayText(plan, plan.widgets[2], in, text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("70%", text);
+  overlayText(plan, plan.widgets[3], in, text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("-67 dBm", text);
+
+  // a negative offset that crosses midnight, and noon in 12-hour time
+  plan.utcOffset = -14 * 60;
+  overlayText(plan, plan.widgets[0], in, text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("23:04", text);
+  plan.utcOffset = -60;
+  overlayText(plan, plan.widgets[1], in, text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("12:04 PM", text);
+
+  OverlayPlan offline = parse("offline,0,0,9,9");
+  overlayText(offline, offline.widgets[0], in, text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("", text);
+  in.offline = true;
+  overlayText(offline, offline.widgets[0], in, text, sizeof(text));
+  TEST_ASSERT_EQUAL_STRING("offline", text);
+}
+
+void test_battery_percent(void)
+{
+  TEST_ASSERT_EQUAL_INT(0, overlayBatteryPercent(2.5f));
+  TEST_ASSERT_EQUAL_INT(0, overlayBatteryPercent(3.0f));
+  TEST_ASSERT_EQUAL_INT(50, overlayBatteryPercent(3.82f));
+  TEST_ASSERT_EQUAL_INT(95, overlayBatteryPercent(4.134f));
+  TEST_ASSERT_EQUAL_INT(100, overlayBatteryPercent(4.2f));
+  TEST_ASSERT_EQUAL_INT(100, overlayBatteryPercent(4.35f));
+}
+
+void test_only_changed_widgets_are_redrawn(void)
+{
+  OverlayPlan none;
+  overlayStop(none);
+  OverlayPlan plan = parse("time,0,0,9,9;battery,0,0,9,9;offline,0,0,9,9");
+  overlayStart(plan, none, true, NOW, 900);
+
+  char texts[OVERLAY_MAX_WIDGETS][OVERLAY_TEXT_SIZE];
+  OverlayInputs in = inputs(NOW);
+  // a new image: every widget that has something to show is drawn
+  TEST_ASSERT_EQUAL_UINT8(0x3, overlayRender(plan, in, texts));
+  for (int i = 0; i < plan.count; i++)
+    strcpy(plan.widgets[i].text, texts[i]);
+
+  TEST_ASSERT_EQUAL_UINT8(0, overlayRender(plan, in, texts));
+  in.now += 60;
+  TEST_ASSERT_EQUAL_UINT8(0x1, overlayRender(plan, in, texts));
+  in.offline = true;
+  TEST_ASSERT_EQUAL_UINT8(0x5, overlayRender(plan, in, texts));
+}
+
+void test_texts_survive_a_refetch_of_the_same_image(void)
+{
+  OverlayPlan none;
+  overlayStop(none);
+  OverlayPlan previous = parse("time,0,0,9,9;battery,0,0,9,9");
+  overlayStart(previous, none, true, NOW, 900);
+  strcpy(previous.widgets[0].text, "13:04");
+  strcpy(previous.widgets[1].text, "70%");
+
+  // same image, the battery box moved
+  OverlayPlan plan = parse("time,0,0,9,9;battery,10,0,9,9");
+  overlayStart(plan, previous, false, NOW, 900);
+  TEST_ASSERT_EQUAL_STRING("13:04", plan.widgets[0].text);
+  TEST_ASSERT_EQUAL_STRING("", plan.widgets[1].text);
+
+  // a new image has none of the old texts
+  plan = parse("time,0,0,9,9");
+  overlayStart(plan, previous, true, NOW, 900);
+  TEST_ASSERT_EQUAL_STRING("", plan.widgets[0].text);
+}
+
+void test_schedule(void)
+{
+  OverlayPlan none;
+  overlayStop(none);
+  TEST_ASSERT_FALSE(overlayDue(none, NOW));
+  TEST_ASSERT_EQUAL_UINT32(0, overlaySleepTime(none, NOW));
+
+  OverlayPlan plan = parse("time,0,0,9,9");
+  overlayStart(plan, none, true, NOW, 900);
+  TEST_ASSERT_TRUE(overlayDue(plan, NOW + 60));
+  TEST_ASSERT_FALSE(overlayDue(plan, NOW + 900));
+  TEST_ASSERT_FALSE(overlayDue(plan, 0)); // clock not set
+
+  // wake just after the next minute starts
+  TEST_ASSERT_EQUAL_UINT32(30 + OVERLAY_WAKE_SLACK, overlaySleepTime(plan, NOW));
+  TEST_ASSERT_EQUAL_UINT32(60 + OVERLAY_WAKE_SLACK, overlaySleepTime(plan, NOW + 30));
+  // but never past the time to go online
+  TEST_ASSERT_EQUAL_UINT32(10, overlaySleepTime(plan, NOW + 890));
+  TEST_ASSERT_EQUAL_UINT32(0, overlaySleepTime(plan, NOW + 900));
+
+  // hourly updates follow the local clock (UTC+5:30)
+  plan = parse("utc=330;every=3600;battery,0,0,9,9");
+  overlayStart(plan, none, true, NOW, 86400);
+  TEST_ASSERT_EQUAL_UINT32(25 * 60 + 30 + OVERLAY_WAKE_SLACK, overlaySleepTime(plan, NOW));
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_parses_widgets_and_settings);
+  RUN_TEST(test_rejects_bad_specs);
+  RUN_TEST(test_widget_texts);
+  RUN_TEST(test_battery_percent);
+  RUN_TEST(test_only_changed_widgets_are_redrawn);
+  RUN_TEST(test_texts_survive_a_refetch_of_the_same_image);
+  RUN_TEST(test_schedule);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
@@ -0,0 +1,243 @@
+#include <unity.h>
+#include <plane_split.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define WIDTH 800
+#define ROW_BYTES (WIDTH / 4)
+
+enum
+{
+  PNG_2_BIT_0,
+  PNG_2_BIT_1,
+  PNG_2_BIT_BOTH,
+  PNG_2_BIT_INVERTED,
+};
+
+// the per-pixel loops png_draw() used before, kept as the reference
+static void referencePng(const uint8_t *s, uint8_t *d, int width, int iPlane, uint8_t ucInvert)
+{
+  uint8_t uc = 0, ucMask, src;
+  src = *s++;
+  src ^= ucInvert;
+  if (iPlane == PNG_2_BIT_BOTH || iPlane == PNG_2_BIT_INVERTED)
+  {
+    if (iPlane == PNG_2_BIT_BOTH)
+      ucInvert = ~ucInvert;
+    src = ~src;
+    for (int x = 0; x < width; x++)
+    {
+      uc <<= 1;
+      if (src & 0xc0)
+        uc |= 1;
+      src <<= 2;
+      if ((x & 3) == 3)
+      {
+        src = *s++;
+        src ^= ucInvert;
+      }
+      if ((x & 7) == 7)
+        *d++ = uc;
+    }
+  }
+  else
+  {
+    ucMask = (iPlane == PNG_2_BIT_0) ? 0x40 : 0x80;
+    for (int x = 0; x < width; x++)
+    {
+      uc <<= 1;
+      if (src & ucMask)
+        uc |= 1;
+      src <<= 2;
+      if ((x & 3) == 3)
+      {
+        src = *s++;
+        src ^= ucInvert;
+      }
+      if ((x & 7) == 7)
+        *d++ = uc;
+    }
+  }
+}
+
+// the same calls png_draw() makes now
+static void lutPng(const uint8_t *s, uint8_t *d, int width, int iPlane, uint8_t ucInvert)
+{
+  switch (iPlane)
+  {
+  case PNG_2_BIT_0:
+    twoBitGather(s, d, width, TWO_BIT_LOW, ucInvert, ucInvert);
+    break;
+  case PNG_2_BIT_1:
+    twoBitGather(s, d, width, TWO_BIT_HIGH, ucInvert, ucInvert);
+    break;
+  case PNG_2_BIT_BOTH:
+    twoBitGather(s, d, width, TWO_BIT_ANY, ~ucInvert, ~ucInvert);
+    break;
+  default:
+    twoBitGather(s, d, width, TWO_BIT_ANY, ucInvert, ~ucInvert);
+    break;
+  }
+}
+
+static void randomRow(uint8_t *row, int bytes)
+{
+  for (int i = 0; i < bytes; i++)
+    row[i] = (uint8_t)rand();
+}
+
+void test_png_planes_are_identical(void)
+{
+  uint8_t src[ROW_BYTES + 1], expected[WIDTH / 8 + 1], actual[WIDTH / 8 + 1];
+  static const int widths[] = {8, 16, 100, 480, 800};
+  srand(1);
+  for (int iPlane = PNG_2_BIT_0; iPlane <= PNG_2_BIT_INVERTED; iPlane++)
+  {
+    for (int inv = 0; inv < 2; inv++)
+    {
+      for (unsigned w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+      {
+        for (int n = 0; n < 50; n++)
+        {
+          randomRow(src, sizeof(src));
+          memset(expected, 0x5a, sizeof(expected));
+          memset(actual, 0x5a, sizeof(actual));
+          referencePng(src, expected, widths[w], iPlane, inv ? 0xff : 0);
+          lutPng(src, actual, widths[w], iPlane, inv ? 0xff : 0);
+          TEST_ASSERT_EQUAL_MEMORY(expected, actual, sizeof(expected));
+        }
+      }
+    }
+  }
+}
+
+void test_rows_split_in_place(void)
+{
+  uint8_t row[ROW_BYTES + 1], expected[WIDTH / 8];
+  srand(2);
+  for (int iPlane = PNG_2_BIT_0; iPlane <= PNG_2_BIT_INVERTED; iPlane++)
+  {
+    randomRow(row, sizeof(row));
+    referencePng(row, expected, WIDTH, iPlane, 0xff);
+    lutPng(row, row, WIDTH, iPlane, 0xff); // png_draw() reduces palette images into the buffer it splits
+    TEST_ASSERT_EQUAL_MEMORY(expected, row, sizeof(expected));
+  }
+}
+
+void test_partial_bytes_are_not_written(void)
+{
+  uint8_t src[4] = {0xff, 0xff, 0xff, 0xff}, dst[2] = {0x5a, 0x5a};
+  twoBitGather(src, dst, 12, TWO_BIT_LOW, 0, 0);
+  TEST_ASSERT_EQUAL_HEX8(0xff, dst[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x5a, dst[1]);
+  twoBitGather(src, dst, 7, TWO_BIT_LOW, 0xff, 0xff);
+  TEST_ASSERT_EQUAL_HEX8(0xff, dst[0]);
+
+  // pixels 0, 1, 2, 3 = 0, 1, 2, 3
+  src[0] = src[1] = 0x1b;
+  twoBitGather(src, dst, 8, TWO_BIT_LOW, 0, 0);
+  TEST_ASSERT_EQUAL_HEX8(0x55, dst[0]);
+  twoBitGather(src, dst, 8, TWO_BIT_HIGH, 0, 0);
+  TEST_ASSERT_EQUAL_HEX8(0x33, dst[0]);
+  twoBitGather(src, dst, 8, TWO_BIT_ANY, 0, 0);
+  TEST_ASSERT_EQUAL_HEX8(0x77, dst[0]);
+}
+
+static double timeRows(bool lut, int iPlane)
+{
+  static uint8_t src[480][ROW_BYTES + 1];
+  uint8_t dst[WIDTH / 8];
+  static volatile unsigned sum; // keeps the loops from being optimized away
+  for (int y = 0; y < 480; y++)
+    randomRow(src[y], sizeof(src[y]));
+  clock_t start = clock();
+  for (int n = 0; n < 20; n++)
+  {
+    for (int y = 0; y < 480; y++)
+    {
+      if (lut)
+        lutPng(src[y], dst, WIDTH, iPlane, 0xff);
+      else
+        referencePng(src[y], dst, WIDTH, iPlane, 0xff);
+      sum += dst[y % sizeof(dst)];
+    }
+  }
+  return (double)(clock() - start) * 1000000.0 / CLOCKS_PER_SEC / (20 * 480);
+}
+
+void test_tables_are_faster(void)
+{
+  static const char *names[] = {"plane 0", "plane 1", "both", "inverted"};
+  bool faster = true;
+  for (int iPlane = PNG_2_BIT_0; iPlane <= PNG_2_BIT_INVERTED; iPlane++)
+  {
+    double lutTime = timeRows(true, iPlane);
+    double pixelTime = timeRows(false, iPlane);
+    char message[96];
+    snprintf(message, sizeof(message), "%d-pixel line, %s: %.3f us with tables, %.3f us a pixel at a time", WIDTH, names[iPlane], lutTime, pixelTime);
+    TEST_MESSAGE(message);
+    faster = faster && lutTime < pixelTime;
+  }
+  TEST_ASSERT_TRUE(faster);
+}
+
+// micro-benchmark of the split alone: 16-row bands of an 800x480 screen sent
+// as 1-bit rows or split into both 4-gray planes; nothing is decoded or dithered
+static double timePlaneSplit(bool fourGray)
+{
+  static uint8_t band[16 * ROW_BYTES];
+  static uint8_t epd[2][WIDTH / 8 * 480]; // stands in for the two EPD planes
+  randomRow(band, sizeof(band));
+  clock_t start = clock();
+  for (int n = 0; n < 20; n++)
+  {
+    for (int y = 0; y < 480; y += 16)
+    {
+      for (int row = 0; row < 16; row++)
+      {
+        uint8_t *out = &epd[0][(y + row) * (WIDTH / 8)];
+        if (!fourGray)
+        {
+          memcpy(out, &band[row * (WIDTH / 8)], WIDTH / 8); // 1-bit output is sent as it is
+          continue;
+        }
+        twoBitGather(&band[row * ROW_BYTES], out, WIDTH, TWO_BIT_LOW, 0xff, 0xff);
+        twoBitGather(&band[row * ROW_BYTES], &epd[1][(y + row) * (WIDTH / 8)], WIDTH, TWO_BIT_HIGH, 0xff, 0xff);
+      }
+    }
+  }
+  return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC / 20;
+}
+
+void test_plane_split_cost(void)
+{
+  double oneBit = timePlaneSplit(false);
+  double fourGray = timePlaneSplit(true);
+  char message[128];
+  snprintf(message, sizeof(message), "800x480 in 16-row bands: %.3f ms to copy 1-bit rows, %.3f ms to split into both 4-gray planes", oneBit, fourGray);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(fourGray < 10.0); // small next to a JPEG decode
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_png_planes_are_identical);
+  RUN_TEST(test_rows_split_in_place);
+  RUN_TEST(test_partial_bytes_are_not_written);
+  RUN_TEST(test_tables_are_faster);
+  RUN_TEST(test_plane_split_cost);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
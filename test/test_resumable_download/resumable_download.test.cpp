@@ -0,0 +1,329 @@
+#include <unity.h>
+#include <resumable_download.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Stand-in for the HTTP server: honours Range/If-Range and drops the
+// connection at pseudo-random offsets
+class FlakyServer : public RangeTransport
+{
+public:
+  std::vector<uint8_t> content;
+  std::string etag = "\"v1\"";
+  bool supportsRange = true;
+  bool knownLength = true;
+  bool sendCrc = false;
+  uint32_t dropChance = 0; // in percent, per request
+  uint32_t seed = 12345;
+
+  size_t requests = 0;
+  size_t bytesSent = 0;
+
+  bool get(uint32_t from, const char *ifRange, RangeHandler &handler) override
+  {
+    requests++;
+
+    bool partial = from > 0 && supportsRange && (!ifRange || etag == ifRange);
+    RangeResponse response = {};
+    response.status = partial ? 206 : 200;
+    response.start = partial ? from : 0;
+    response.total = knownLength ? content.size() : 0;
+    response.etag = etag.c_str();
+    response.hasCrc = sendCrc;
+    response.crc = ota_crc32(0, content.data(), content.size());
+
+    if (!handler.onResponse(response))
+      return true;
+
+    uint32_t end = content.size();
+    bool drop = next() % 100 < dropChance;
+    if (drop)
+      end = response.start + next() % (content.size() - response.start);
+
+    for (uint32_t offset = response.start; offset < end;)
+    {
+      uint32_t n = 1 + next() % 1460; // TCP-segment sized pieces
+      if (n > end - offset)
+        n = end - offset;
+      bytesSent += n;
+      if (!handler.write(content.data() + offset, n))
+        return false;
+      offset += n;
+    }
+    return !drop;
+  }
+
+private:
+  uint32_t next()
+  {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+  }
+};
+
+// The inactive OTA partition: erase-before-write NOR flash that keeps its contents between wakes
+class FakeFlash : public ResumableSink
+{
+public:
+  static const uint32_t SECTOR = 4096;
+  std::vector<uint8_t> memory;
+  uint32_t offset = 0;
+  bool rewroteWithoutErase = false;
+
+  explicit FakeFlash(size_t size) : memory(size, 0xff) {}
+
+  bool resumeAt(uint32_t start, uint32_t total) override
+  {
+    if (total > memory.size())
+      return false;
+    offset = start;
+    return true;
+  }
+
+  bool write(const uint8_t *data, size_t length) override
+  {
+    for (size_t i = 0; i < length; i++, offset++)
+    {
+      if (offset % SECTOR == 0)
+        memset(memory.data() + offset, 0xff, SECTOR);
+      if (memory[offset] != 0xff)
+        rewroteWithoutErase = true;
+      memory[offset] &= data[i]; // flash can only clear bits
+    }
+    return true;
+  }
+};
+
+static std::vector<uint8_t> makeContent(size_t size, uint8_t salt)
+{
+  std::vector<uint8_t> content(size);
+  for (size_t i = 0; i < size; i++)
+    content[i] = (uint8_t)(i * 31 + (i >> 8) + salt);
+  return content;
+}
+
+static bool flashHolds(const FakeFlash &flash, const std::vector<uint8_t> &content)
+{
+  return memcmp(flash.memory.data(), content.data(), content.size()) == 0;
+}
+
+void test_parse_content_range(void)
+{
+  uint32_t start, end, total;
+  TEST_ASSERT_TRUE(parseContentRange("bytes 4096-1048575/1048576", start, end, total));
+  TEST_ASSERT_EQUAL_UINT32(4096, start);
+  TEST_ASSERT_EQUAL_UINT32(1048575, end);
+  TEST_ASSERT_EQUAL_UINT32(1048576, total);
+
+  TEST_ASSERT_TRUE(parseContentRange("bytes 0-9/*", start, end, total));
+  TEST_ASSERT_EQUAL_UINT32(0, total);
+
+  TEST_ASSERT_FALSE(parseContentRange("bytes */1000", start, end, total));
+  TEST_ASSERT_FALSE(parseContentRange("bytes 10-5/100", start, end, total));
+  TEST_ASSERT_FALSE(parseContentRange("bytes 0-100/100", start, end, total));
+  TEST_ASSERT_FALSE(parseContentRange(nullptr, start, end, total));
+}
+
+void test_resumes_across_wakes_after_dropped_connections(void)
+{
+  FlakyServer server;
+  server.content = makeContent(300 * 1024, 1);
+  server.dropChance = 80;
+  server.sendCrc = true;
+
+  // both survive deep sleep: the checkpoint in RTC memory, the data in the partition
+  DownloadCheckpoint checkpoint;
+  clearDownloadCheckpoint(checkpoint);
+  FakeFlash flash(512 * 1024);
+
+  DownloadOutcome outcome = DownloadOutcome::Interrupted;
+  int wakes = 0;
+  while (outcome == DownloadOutcome::Interrupted && wakes < 100)
+  {
+    wakes++;
+    ResumableDownload download(checkpoint, "https://example.com/FW1.6.0.bin", flash, FakeFlash::SECTOR);
+    outcome = download.attempt(server);
+    if (outcome == DownloadOutcome::Interrupted)
+      TEST_ASSERT_EQUAL_UINT32(0, checkpoint.received % FakeFlash::SECTOR);
+  }
+
+  TEST_ASSERT_EQUAL(DownloadOutcome::Complete, outcome);
+  TEST_ASSERT_GREATER_THAN(3, wakes);
+  TEST_ASSERT_TRUE(flashHolds(flash, server.content));
+  TEST_ASSERT_FALSE(flash.rewroteWithoutErase);
+  TEST_ASSERT_EQUAL_UINT32(0, checkpoint.magic);
+
+  // each resume costs at most one sector of re-sent data
+  TEST_ASSERT_LESS_OR_EQUAL(server.content.size() + wakes * FakeFlash::SECTOR, server.bytesSent);
+}
+
+void test_run_retries_within_one_wake(void)
+{
+  FlakyServer server;
+  server.content = makeContent(64 * 1024, 2);
+  server.dropChance = 50;
+
+  DownloadCheckpoint checkpoint;
+  clearDownloadCheckpoint(checkpoint);
+  FakeFlash flash(64 * 1024);
+  ResumableDownload download(checkpoint, "image-1", flash, 1);
+
+  TEST_ASSERT_EQUAL(DownloadOutcome::Complete, download.run(server, 50));
+  TEST_ASSERT_EQUAL_UINT32(server.content.size(), download.received());
+  TEST_ASSERT_TRUE(flashHolds(flash, server.content));
+}
+
+void test_starts_over_when_resource_changes(void)
+{
+  FlakyServer server;
+  server.content = makeContent(40 * 1024, 3);
+  server.dropChance = 100;
+  server.seed = 7;
+
+  DownloadCheckpoint checkpoint;
+  clearDownloadCheckpoint(checkpoint);
+  FakeFlash flash(64 * 1024);
+
+  // first wake stops half way
+  {
+    ResumableDownload download(checkpoint, "fw", flash, FakeFlash::SECTOR);
+    while (checkpoint.received == 0)
+      TEST_ASSERT_EQUAL(DownloadOutcome::Interrupted, download.attempt(server));
+  }
+
+  // a new build is published before the next wake: If-Range no longer matches
+  server.content = makeContent(44 * 1024, 4);
+  server.etag = "\"v2\"";
+  server.dropChance = 0;
+
+  ResumableDownload download(checkpoint, "fw", flash, FakeFlash::SECTOR);
+  TEST_ASSERT_TRUE(download.canResume());
+  TEST_ASSERT_EQUAL(DownloadOutcome::Complete, download.attempt(server));
+  TEST_ASSERT_EQUAL_UINT32(0, download.resumedFrom());
+  TEST_ASSERT_TRUE(flashHolds(flash, server.content));
+}
+
+void test_server_without_range_support(void)
+{
+  FlakyServer server;
+  server.content = makeContent(20 * 1024, 5);
+  server.supportsRange = false;
+  server.dropChance = 100;
+  server.seed = 3;
+
+  DownloadCheckpoint checkpoint;
+  clearDownloadCheckpoint(checkpoint);
+  FakeFlash flash(32 * 1024);
+  ResumableDownload download(checkpoint, "fw", flash, 1);
+  TEST_ASSERT_EQUAL(DownloadOutcome::Interrupted, download.attempt(server));
+
+  server.dropChance = 0;
+  TEST_ASSERT_EQUAL(DownloadOutcome::Complete, download.attempt(server));
+  TEST_ASSERT_EQUAL_UINT32(0, download.resumedFrom());
+  TEST_ASSERT_TRUE(flashHolds(flash, server.content));
+}
+
+void test_other_resource_does_not_resume(void)
+{
+  FlakyServer server;
+  server.content = makeContent(20 * 1024, 6);
+  server.dropChance = 100;
+  server.seed = 11;
+
+  DownloadCheckpoint checkpoint;
+  clearDownloadCheckpoint(checkpoint);
+  FakeFlash flash(32 * 1024);
+  {
+    ResumableDownload download(checkpoint, "plugin-a", flash, 1);
+    while (checkpoint.received == 0)
+      download.attempt(server);
+    TEST_ASSERT_TRUE(download.canResume());
+  }
+
+  ResumableDownload other(checkpoint, "plugin-b", flash, 1);
+  TEST_ASSERT_FALSE(other.canResume());
+}
+
+void test_checksum_mismatch_fails_and_clears(void)
+{
+  // a proxy that flips a bit in the body but keeps the server's checksum header
+  class Corrupting : public RangeTransport
+  {
+  public:
+    std::vector<uint8_t> content = makeContent(10 * 1024, 7);
+
+    bool get(uint32_t from, const char *ifRange, RangeHandler &handler) override
+    {
+      RangeResponse response = {};
+      response.status = 200;
+      response.total = content.size();
+      response.etag = "\"v1\"";
+      response.hasCrc = true;
+      response.crc = ota_crc32(0, content.data(), content.size());
+      handler.onResponse(response);
+
+      std::vector<uint8_t> body = content;
+      body[5000] ^= 0x01;
+      return handler.write(body.data(), body.size());
+    }
+  } server;
+
+  DownloadCheckpoint checkpoint;
+  clearDownloadCheckpoint(checkpoint);
+  FakeFlash flash(16 * 1024);
+  ResumableDownload download(checkpoint, "fw", flash, 1);
+
+  TEST_ASSERT_EQUAL(DownloadOutcome::Failed, download.attempt(server));
+  TEST_ASSERT_EQUAL_STRING("Checksum mismatch", download.error());
+  TEST_ASSERT_EQUAL_UINT32(0, checkpoint.magic);
+}
+
+void test_rejects_more_data_than_announced(void)
+{
+  class Overlong : public RangeTransport
+  {
+  public:
+    bool get(uint32_t from, const char *ifRange, RangeHandler &handler) override
+    {
+      uint8_t body[200] = {0};
+      RangeResponse response = {};
+      response.status = 200;
+      response.total = 100;
+      response.etag = "\"x\"";
+      handler.onResponse(response);
+      return handler.write(body, sizeof(body));
+    }
+  } server;
+
+  DownloadCheckpoint checkpoint;
+  clearDownloadCheckpoint(checkpoint);
+  FakeFlash flash(4096);
+  ResumableDownload download(checkpoint, "fw", flash, 1);
+  TEST_ASSERT_EQUAL(DownloadOutcome::Failed, download.attempt(server));
+  TEST_ASSERT_EQUAL_STRING("More data than announced", download.error());
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_parse_content_range);
+  RUN_TEST(test_resumes_across_wakes_after_dropped_connections);
+  RUN_TEST(test_run_retries_within_one_wake);
+  RUN_TEST(test_starts_over_when_resource_changes);
+  RUN_TEST(test_server_without_range_support);
+  RUN_TEST(test_other_resource_does_not_resume);
+  RUN_TEST(test_checksum_mismatch_fails_and_clears);
+  RUN_TEST(test_rejects_more_data_than_announced);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
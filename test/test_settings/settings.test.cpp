@@ -0,0 +1,195 @@
+#include <unity.h>
+#include <settings.h>
+#include <config.h>
+#include "memory_persistence.h"
+
+void test_defaults_when_persistence_is_empty()
+{
+  MemoryPersistence persistence;
+  Settings settings(persistence);
+  settings.load();
+
+  TEST_ASSERT_FALSE(settings.exists(SETTING_API_KEY));
+  TEST_ASSERT_FALSE(settings.exists(SETTING_REFRESH_RATE));
+  TEST_ASSERT_EQUAL_STRING(API_BASE_URL, settings.apiUrl());
+  TEST_ASSERT_EQUAL_STRING("", settings.apiKey());
+  TEST_ASSERT_EQUAL(SLEEP_TIME_TO_SLEEP, settings.refreshRate());
+  TEST_ASSERT_EQUAL(TEMP_PROFILE_DEFAULT, settings.tempProfile());
+  TEST_ASSERT_EQUAL(1, settings.logId());
+  TEST_ASSERT_FALSE(settings.isDirty());
+}
+
+void test_load_reads_stored_values()
+{
+  MemoryPersistence persistence;
+  persistence.writeString(PREFERENCES_API_KEY, "abc123");
+  persistence.writeString(PREFERENCES_API_URL, "https://example.com");
+  persistence.writeUint(PREFERENCES_SLEEP_TIME_KEY, 300);
+  persistence.writeInt(PREFERENCES_CONNECT_API_RETRY_COUNT, 2);
+  persistence.writeBool(PREFERENCES_DEVICE_REGISTERED_KEY, true);
+
+  Settings settings(persistence);
+  settings.load();
+
+  TEST_ASSERT_TRUE(settings.exists(SETTING_API_KEY));
+  TEST_ASSERT_EQUAL_STRING("abc123", settings.apiKey());
+  TEST_ASSERT_EQUAL_STRING("https://example.com", settings.apiUrl());
+  TEST_ASSERT_EQUAL(300, settings.refreshRate());
+  TEST_ASSERT_EQUAL(2, settings.apiRetryCount());
+  TEST_ASSERT_TRUE(settings.deviceRegistered());
+}
+
+void test_setting_same_value_is_not_dirty()
+{
+  MemoryPersistence persistence;
+  persistence.writeUint(PREFERENCES_SLEEP_TIME_KEY, 300);
+
+  Settings settings(persistence);
+  settings.load();
+  settings.setRefreshRate(300);
+
+  TEST_ASSERT_FALSE(settings.isDirty(SETTING_REFRESH_RATE));
+  TEST_ASSERT_EQUAL(0, settings.flush());
+}
+
+void test_load_reads_each_key_once()
+{
+  MemoryPersistence persistence;
+  persistence.writeString(PREFERENCES_API_KEY, "abc123");
+  persistence.writeUint(PREFERENCES_SLEEP_TIME_KEY, SLEEP_TIME_TO_SLEEP);
+
+  Settings settings(persistence);
+  settings.load();
+
+  TEST_ASSERT_EQUAL(SETTING_COUNT, persistence.reads);
+  TEST_ASSERT_TRUE(settings.exists(SETTING_API_KEY));
+  // a stored default is the same as a missing key
+  TEST_ASSERT_FALSE(settings.exists(SETTING_REFRESH_RATE));
+  TEST_ASSERT_EQUAL(SLEEP_TIME_TO_SLEEP, settings.refreshRate());
+}
+
+void test_setting_missing_key_to_default_is_not_written()
+{
+  MemoryPersistence persistence;
+  Settings settings(persistence);
+  settings.load();
+  settings.setApiRetryCount(0);
+  settings.setDeviceRegistered(false);
+
+  TEST_ASSERT_FALSE(settings.isDirty());
+  TEST_ASSERT_EQUAL(0, settings.flush());
+  TEST_ASSERT_FALSE(persistence.recordExists(PREFERENCES_CONNECT_API_RETRY_COUNT));
+
+  settings.setApiRetryCount(1);
+  TEST_ASSERT_TRUE(settings.exists(SETTING_API_RETRY_COUNT));
+  TEST_ASSERT_EQUAL(1, settings.flush());
+  TEST_ASSERT_TRUE(persistence.recordExists(PREFERENCES_CONNECT_API_RETRY_COUNT));
+}
+
+void test_changes_are_only_written_on_flush()
+{
+  MemoryPersistence persistence;
+  Settings settings(persistence);
+  settings.load();
+
+  settings.setApiKey("key");
+  settings.setRefreshRate(900);
+  settings.setRefreshRate(600);
+  settings.setLogId(5);
+
+  TEST_ASSERT_FALSE(persistence.recordExists(PREFERENCES_API_KEY));
+  TEST_ASSERT_EQUAL_STRING("key", settings.apiKey());
+  TEST_ASSERT_EQUAL(600, settings.refreshRate());
+
+  TEST_ASSERT_EQUAL(3, settings.flush());
+  TEST_ASSERT_FALSE(settings.isDirty());
+  TEST_ASSERT_EQUAL_STRING("key", persistence.readString(PREFERENCES_API_KEY, "").c_str());
+  TEST_ASSERT_EQUAL(600, persistence.readUint(PREFERENCES_SLEEP_TIME_KEY, 0));
+  TEST_ASSERT_EQUAL(5, persistence.readUint(PREFERENCES_LOG_ID_KEY, 0));
+}
+
+void test_flush_skips_clean_fields()
+{
+  MemoryPersistence persistence;
+  persistence.writeString(PREFERENCES_FRIENDLY_ID, "ABCDEF");
+
+  Settings settings(persistence);
+  settings.load();
+  settings.setTempProfile(2);
+
+  // a clean field must not be rewritten, even if the stored value moved on
+  persistence.writeString(PREFERENCES_FRIENDLY_ID, "CHANGED");
+  TEST_ASSERT_EQUAL(1, settings.flush());
+  TEST_ASSERT_EQUAL_STRING("CHANGED", persistence.readString(PREFERENCES_FRIENDLY_ID, "").c_str());
+  TEST_ASSERT_EQUAL(2, persistence.readUint(PREFERENCES_TEMP_PROFILE, 0));
+}
+
+void test_reload_picks_up_external_change()
+{
+  MemoryPersistence persistence;
+  Settings settings(persistence);
+  settings.load();
+
+  persistence.writeString(PREFERENCES_API_URL, "http://local.server");
+  TEST_ASSERT_EQUAL_STRING(API_BASE_URL, settings.apiUrl());
+
+  settings.reload(SETTING_API_URL);
+  TEST_ASSERT_EQUAL_STRING("http://local.server", settings.apiUrl());
+  TEST_ASSERT_TRUE(settings.exists(SETTING_API_URL));
+}
+
+void test_long_strings_are_truncated()
+{
+  MemoryPersistence persistence;
+  Settings settings(persistence);
+  settings.load();
+
+  String longKey;
+  for (int i = 0; i < SETTINGS_API_KEY_SIZE * 2; i++)
+    longKey += "x";
+  settings.setApiKey(longKey.c_str());
+
+  TEST_ASSERT_EQUAL(SETTINGS_API_KEY_SIZE - 1, strlen(settings.apiKey()));
+}
+
+void test_reset_forgets_values()
+{
+  MemoryPersistence persistence;
+  persistence.writeUint(PREFERENCES_SLEEP_TIME_KEY, 300);
+
+  Settings settings(persistence);
+  settings.load();
+  settings.setFilename("image.bmp");
+  settings.reset();
+
+  TEST_ASSERT_FALSE(settings.exists(SETTING_REFRESH_RATE));
+  TEST_ASSERT_EQUAL(SLEEP_TIME_TO_SLEEP, settings.refreshRate());
+  TEST_ASSERT_EQUAL_STRING("", settings.filename());
+  TEST_ASSERT_EQUAL(0, settings.flush());
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_defaults_when_persistence_is_empty);
+  RUN_TEST(test_load_reads_stored_values);
+  RUN_TEST(test_setting_same_value_is_not_dirty);
+  RUN_TEST(test_load_reads_each_key_once);
+  RUN_TEST(test_setting_missing_key_to_default_is_not_written);
+  RUN_TEST(test_changes_are_only_written_on_flush);
+  RUN_TEST(test_flush_skips_clean_fields);
+  RUN_TEST(test_reload_picks_up_external_change);
+  RUN_TEST(test_long_strings_are_truncated);
+  RUN_TEST(test_reset_forgets_values);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
@@ -0,0 +1,190 @@
+// Filled shapes drawn with horizontal spans must set exactly the same pixels
+// as drawing them one pixel at a time, in every back buffer layout.
+#undef ARDUINO
+#include <unity.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the C core is compiled without its I/O layer, only the back buffer is used
+#include "../../lib/bb_epaper/host/bb_ep_host.h"
+
+#include "../../lib/bb_epaper/src/bb_ep.inl"
+#include "../../lib/bb_epaper/src/bb_ep_gfx.inl"
+
+#define BUFFER_SIZE (800 * 480) // enough for 4-bpp or two 1-bpp planes
+
+static BBEPDISP spans, pixels;
+static uint8_t spanBuffer[BUFFER_SIZE], pixelBuffer[BUFFER_SIZE];
+
+// an unknown pixel function makes bbepDrawSpan() fall back to one call per pixel
+static BB_SET_PIXEL_FAST *realSetPixelFast;
+static void perPixel(void *pb, int x, int y, unsigned char ucColor)
+{
+  (*realSetPixelFast)(pb, x, y, ucColor);
+}
+
+static void createBoth(int width, int height, int flags)
+{
+  bbepCreateVirtual(&spans, width, height, flags);
+  bbepCreateVirtual(&pixels, width, height, flags);
+  memset(spanBuffer, 0x5a, sizeof(spanBuffer));
+  memset(pixelBuffer, 0x5a, sizeof(pixelBuffer));
+  spans.ucScreen = spanBuffer;
+  pixels.ucScreen = pixelBuffer;
+  realSetPixelFast = pixels.pfnSetPixelFast;
+  pixels.pfnSetPixelFast = perPixel;
+}
+
+// every filled primitive, partly off the screen, 1 pixel wide and at odd offsets
+static void drawScene(BBEPDISP *pBBEP, int colors)
+{
+  int w = pBBEP->width, h = pBBEP->height;
+  srand(1234);
+  for (int i = 0; i < 300; i++)
+  {
+    int x1 = rand() % w, y1 = rand() % h;
+    int x2 = rand() % w, y2 = rand() % h;
+    uint8_t color = rand() % colors;
+    switch (i % 6)
+    {
+    case 0:
+      bbepRectangle(pBBEP, x1, y1, x2, y2, color, 1);
+      break;
+    case 1: // narrow
+      x2 = x1 + rand() % 9;
+      bbepRectangle(pBBEP, x1, y1, x2 < w ? x2 : w - 1, y2, color, i & 8);
+      break;
+    case 2:
+      bbepEllipse(pBBEP, x1 - 20, y1, 1 + rand() % 120, 1 + rand() % 90, 0xf, color, 1);
+      break;
+    case 3:
+      bbepRoundRect(pBBEP, x1 / 2, y1 / 2, 20 + rand() % (w / 2), 20 + rand() % (h / 2), rand() % 10, color, 1);
+      break;
+    case 4:
+      bbepDrawLine(pBBEP, x1, y1, x2, y1, color); // horizontal
+      break;
+    case 5:
+      bbepRectangle(pBBEP, x1, y1, x2, y2, color, 0);
+      break;
+    }
+  }
+}
+
+static void compare(int width, int height, int flags, int colors)
+{
+  createBoth(width, height, flags);
+  drawScene(&spans, colors);
+  drawScene(&pixels, colors);
+  TEST_ASSERT_EQUAL_MEMORY(pixelBuffer, spanBuffer, sizeof(spanBuffer));
+  // and something was drawn
+  TEST_ASSERT_TRUE(memcmp(spanBuffer, spanBuffer + 1, width / 8) != 0);
+}
+
+void test_bw(void)
+{
+  compare(800, 480, 0, 2);
+  compare(203, 97, 0, 2);
+}
+
+void test_bw_second_plane(void)
+{
+  createBoth(203, 97, 0);
+  spans.iPlane = pixels.iPlane = PLANE_1;
+  drawScene(&spans, 2);
+  drawScene(&pixels, 2);
+  TEST_ASSERT_EQUAL_MEMORY(pixelBuffer, spanBuffer, sizeof(spanBuffer));
+}
+
+void test_4gray(void)
+{
+  compare(800, 480, BBEP_4GRAY, 4);
+  compare(203, 97, BBEP_4GRAY, 4);
+}
+
+void test_3color(void)
+{
+  compare(800, 480, BBEP_3COLOR, 4);
+  compare(203, 97, BBEP_3COLOR, 4);
+}
+
+void test_4color(void)
+{
+  compare(800, 480, BBEP_4COLOR, 4);
+  compare(203, 97, BBEP_4COLOR, 4);
+}
+
+void test_7color(void)
+{
+  compare(600, 448, BBEP_7COLOR, 7);
+  compare(202, 97, BBEP_7COLOR, 7);
+}
+
+void test_span_edges(void)
+{
+  // every start and end bit of a short run, at each pixel size
+  for (int shift = 0; shift <= 2; shift++)
+  {
+    for (int x1 = 0; x1 < 24; x1++)
+    {
+      for (int x2 = x1; x2 < 24; x2++)
+      {
+        uint8_t row[16], expected[16];
+        memset(row, 0xa5, sizeof(row));
+        memset(expected, 0xa5, sizeof(expected));
+        bbepFillSpan(row, x1, x2, shift, 0x00);
+        int bpp = 1 << shift;
+        for (int x = x1; x <= x2; x++)
+        {
+          int bit = x * bpp;
+          expected[bit / 8] &= ~(((1 << bpp) - 1) << (8 - bpp - bit % 8));
+        }
+        TEST_ASSERT_EQUAL_MEMORY(expected, row, sizeof(row));
+      }
+    }
+  }
+}
+
+static double timeScene(BBEPDISP *pBBEP)
+{
+  clock_t start = clock();
+  for (int i = 0; i < 20; i++)
+    drawScene(pBBEP, 2);
+  return (double)(clock() - start) * 1000.0 / CLOCKS_PER_SEC / 20;
+}
+
+void test_spans_are_faster(void)
+{
+  createBoth(800, 480, 0);
+  double spanTime = timeScene(&spans);
+  double pixelTime = timeScene(&pixels);
+  char message[96];
+  snprintf(message, sizeof(message), "300 filled shapes: %.2f ms with spans, %.2f ms per pixel", spanTime, pixelTime);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_TRUE(spanTime < pixelTime);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void process()
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_bw);
+  RUN_TEST(test_bw_second_plane);
+  RUN_TEST(test_4gray);
+  RUN_TEST(test_3color);
+  RUN_TEST(test_4color);
+  RUN_TEST(test_7color);
+  RUN_TEST(test_span_edges);
+  RUN_TEST(test_spans_are_faster);
+  UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+  process();
+  return 0;
+}
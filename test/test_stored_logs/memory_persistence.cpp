@@ -42,6 +42,29 @@ size_t MemoryPersistence::writeUint(const char *key, const uint32_t value)
   return sizeof(uint32_t);
 }
 
+int32_t MemoryPersistence::readInt(const char *key, const int32_t defaultValue)
+{
+  auto it = storage.find(key);
+  if (it != storage.end())
+  {
+    try
+    {
+      return std::stol(it->second);
+    }
+    catch (...)
+    {
+      return defaultValue;
+    }
+  }
+  return defaultValue;
+}
+
+size_t MemoryPersistence::writeInt(const char *key, const int32_t value)
+{
+  storage[key] = std::to_string(value);
+  return sizeof(int32_t);
+}
+
 size_t MemoryPersistence::writeString(const char *key, const char *value)
 {
   storage[key] = value;
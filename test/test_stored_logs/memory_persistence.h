@@ -11,6 +11,8 @@ public:
   String readString(const char *key, const String defaultValue) override;
   uint32_t readUint(const char *key, const uint32_t defaultValue) override;
   size_t writeUint(const char *key, const uint32_t value) override;
+  int32_t readInt(const char *key, const int32_t defaultValue) override;
+  size_t writeInt(const char *key, const int32_t value) override;
   size_t writeString(const char *key, const char *value) override;
   uint8_t readUChar(const char *key, const uint8_t defaultValue) override;
   size_t writeUChar(const char *key, const uint8_t value) override;